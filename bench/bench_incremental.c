@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scanner.h"
+#include "lexical.h"
+#include "parser.h"
+#include "syntax_def.h"
+#include "incremental.h"
+
+/**
+ * 检查增量解析的结果与解析整个文档的结果相同，并测量大文档中一次单字符编辑的耗时
+ *
+ * 用法：bench_incremental file...
+ * 对每个文件进行随机的插入、删除与替换，每次编辑之后解析整个文档：成功时各段的语法树连接起来必须与之逐个节点相同
+ * （token 在文档中的位置相同），失败时必须有失败的段。编辑每隔若干次全部撤销，使文档回到没有错误的状态。
+ * 之后把所有文件重复连接为至少 100000 行的文档，比较解析整个文档与单字符编辑的耗时
+ */
+
+#define EDITS 4000         // 每个文件的随机编辑次数
+#define UNDO_INTERVAL 8    // 每隔多少次编辑全部撤销一次
+#define BIG_LINES 100000   // 测量耗时的文档的最少行数
+#define TIMED_EDITS 1000   // 测量耗时的编辑次数，插入与删除各一半
+
+// 随机插入的文本，包括会使段的末尾不结束的注释、字符串与标识符
+static const char *snippets[] = {
+    " ", "\n", "x", "1", "e", ";", "(", ")", ",", "+", "/", "*", "//", "/*", "*/", "\"", "'", "\\",
+    "END", "BEGIN", "INT", "REAL", "RETURN", "IF", "ELSE", "WHILE", "\nINT y;\n", "INT g() BEGIN RETURN 0; END\n",
+    "// c\n", "/* c */", "\"s\"",
+};
+
+static unsigned long long seed = 20261019;
+
+static int random_int(int n)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (int)((seed >> 33) % n);
+}
+
+static char *read_file(const char *path, int *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *code = malloc(size + 1);
+    *len = fread(code, 1, size, file);
+    code[*len] = '\0';
+    fclose(file);
+    return code;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * 解析整个文档得到的语法树，作为比较的基准
+ */
+struct full_s
+{
+    tiny_symbol_table_t symbols;
+    tiny_lex_t lex;
+    tiny_scanner_t scanner;
+    tiny_parser_result_t result;
+};
+
+static void full_parse(struct full_s *full, struct trie *parsers, const char *text)
+{
+    tiny_symbol_table_init(&full->symbols);
+    tiny_lex_begin(&full->lex, text);
+    full->lex.symbols = &full->symbols;
+    tiny_scanner_begin(&full->scanner, &full->lex, tiny_lex_reader);
+    tiny_parser_ctx_t ctx;
+    ctx.parsers = parsers;
+    ctx.current_parser = trie_search(parsers, "root");
+    ctx.errors = NULL;
+    full->result = tiny_syntax_parse(ctx, &full->scanner);
+}
+
+static void full_free(struct full_s *full)
+{
+    if (full->result.state == 0)
+        tiny_free_ast(full->result.ast);
+    tiny_scanner_end(&full->scanner);
+    tiny_lex_end(&full->lex);
+    tiny_symbol_table_free(&full->symbols);
+}
+
+/**
+ * 比较 a（text 中）与 b（chunk 的源码副本中）及其后代和兄弟节点
+ */
+static bool same_ast(const tiny_ast_t *a, const char *text, const tiny_ast_t *b, const tiny_chunk_t *chunk)
+{
+    for (; a && b; a = a->sibling, b = b->sibling)
+    {
+        if (a->desc != b->desc || a->token.kind != b->token.kind || !a->token.s != !b->token.s)
+            return false;
+        if (a->token.s && (a->token.s - text != chunk->offset + (b->token.s - chunk->code) ||
+                           a->token.e - a->token.s != b->token.e - b->token.s))
+            return false;
+        if (!same_ast(a->child, text, b->child, chunk))
+            return false;
+    }
+    return !a && !b;
+}
+
+static bool same_item(const tiny_ast_t *a, const char *text, const tiny_ast_t *b, const tiny_chunk_t *chunk)
+{
+    tiny_ast_t copy = *a;
+    copy.sibling = NULL;
+    return same_ast(&copy, text, b, chunk);
+}
+
+/**
+ * @return 文档的各段与解析整个文档的结果一致时为 NULL，否则为不一致的原因
+ */
+static const char *verify(const tiny_document_t *doc, struct trie *parsers)
+{
+    int end = 0;
+    for (int i = 0; i < doc->chunk_count; ++i)
+    {
+        const tiny_chunk_t *chunk = &doc->chunks[i];
+        if (chunk->offset != end || memcmp(chunk->code, doc->text + end, chunk->len) != 0)
+            return "chunks do not cover the document";
+        end += chunk->len;
+    }
+    if (end != doc->len)
+        return "chunks do not cover the document";
+
+    struct full_s full;
+    full_parse(&full, parsers, doc->text);
+    const char *reason = NULL;
+    if (full.result.state != 0)
+    {
+        if (tiny_document_failed(doc) == 0)
+            reason = "incremental parse succeeded but full parse failed";
+    }
+    else if (tiny_document_failed(doc) != 0)
+        reason = "incremental parse failed but full parse succeeded";
+    else
+    {
+        const tiny_ast_t *item = full.result.ast->child;
+        for (int i = 0; i < doc->chunk_count && !reason; ++i)
+        {
+            const tiny_ast_t *mine = doc->chunks[i].item;
+            if (!mine)
+                continue;
+            const tiny_ast_t *next = item ? item->sibling : NULL;
+            if (!item || !same_item(item, doc->text, mine, &doc->chunks[i]))
+                reason = "syntax trees differ";
+            item = next;
+        }
+        if (!reason && item)
+            reason = "syntax trees differ";
+    }
+    full_free(&full);
+    return reason;
+}
+
+/**
+ * 编辑及其逆操作，text 与 removed 由这里保存
+ */
+struct undo_s
+{
+    tiny_edit_t edit;
+    char *text;
+    char *removed;
+};
+
+static tiny_edit_t random_edit(const tiny_document_t *doc, struct undo_s *undo)
+{
+    tiny_edit_t edit;
+    edit.offset = random_int(doc->len + 1);
+    // 段的边界处的编辑最容易出错，四分之一的编辑从某一段的起点或其前一个字符开始
+    if (random_int(4) == 0)
+    {
+        edit.offset = doc->chunks[random_int(doc->chunk_count)].offset - random_int(2);
+        if (edit.offset < 0)
+            edit.offset = 0;
+    }
+    int op = random_int(3);
+    edit.removed = op == 0 ? 0 : 1 + random_int(8);
+    if (edit.removed > doc->len - edit.offset)
+        edit.removed = doc->len - edit.offset;
+    const char *text = op == 1 ? "" : snippets[random_int(sizeof(snippets) / sizeof(snippets[0]))];
+    undo->text = strdup(text);
+    undo->removed = strndup(doc->text + edit.offset, edit.removed);
+    edit.text = undo->text;
+    edit.inserted = strlen(text);
+    undo->edit.offset = edit.offset;
+    undo->edit.removed = edit.inserted;
+    undo->edit.text = undo->removed;
+    undo->edit.inserted = edit.removed;
+    return edit;
+}
+
+static bool apply(tiny_document_t *doc, struct trie *parsers, tiny_edit_t edit, const char *path, int n)
+{
+    tiny_document_edit(doc, edit);
+    const char *reason = verify(doc, parsers);
+    if (!reason)
+        return true;
+    fprintf(stderr, "%s: edit %d at %d replacing %d bytes with \"%.*s\": %s\n", path, n, edit.offset, edit.removed,
+            edit.inserted, edit.text, reason);
+    fprintf(stderr, "document:\n%s\n", doc->text);
+    return false;
+}
+
+static bool check_file(struct trie *parsers, const char *path, const char *code, int len, int *edits)
+{
+    tiny_symbol_table_t symbols;
+    tiny_symbol_table_init(&symbols);
+    tiny_document_t doc;
+    tiny_document_init(&doc, parsers, &symbols);
+    tiny_document_set_text(&doc, code, len);
+    bool ok = true;
+    if (tiny_document_failed(&doc) != 0 || verify(&doc, parsers))
+    {
+        fprintf(stderr, "%s: syntax error\n", path);
+        ok = false;
+    }
+
+    struct undo_s undo[UNDO_INTERVAL];
+    int count = 0;
+    for (int n = 0; n < EDITS && ok; ++n)
+    {
+        tiny_edit_t edit = random_edit(&doc, &undo[count]);
+        ok = apply(&doc, parsers, edit, path, n);
+        count++;
+        ++*edits;
+        if (count == UNDO_INTERVAL || !ok)
+        {
+            while (count > 0)
+            {
+                --count;
+                if (ok)
+                {
+                    ok = apply(&doc, parsers, undo[count].edit, path, n);
+                    ++*edits;
+                }
+                free(undo[count].text);
+                free(undo[count].removed);
+            }
+            if (ok && (doc.len != len || memcmp(doc.text, code, len) != 0 || tiny_document_failed(&doc) != 0))
+            {
+                fprintf(stderr, "%s: undoing edits did not restore the document\n", path);
+                ok = false;
+            }
+        }
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        free(undo[i].text);
+        free(undo[i].removed);
+    }
+    tiny_document_free(&doc);
+    tiny_symbol_table_free(&symbols);
+    return ok;
+}
+
+/**
+ * 在至少 BIG_LINES 行的文档中随机插入一个空格再删除，测量每次编辑的平均耗时
+ */
+static void time_edits(struct trie *parsers, char **codes, int *lens, int n)
+{
+    int size = 0, len = 0, lines = 0;
+    char *text = NULL;
+    while (lines < BIG_LINES)
+        for (int i = 0; i < n; ++i)
+        {
+            if (len + lens[i] + 2 > size)
+                text = realloc(text, size = (len + lens[i] + 2) * 2);
+            memcpy(text + len, codes[i], lens[i]);
+            len += lens[i];
+            text[len++] = '\n';
+            for (int k = 0; k < lens[i]; ++k)
+                lines += codes[i][k] == '\n';
+            lines++;
+        }
+
+    tiny_symbol_table_t symbols;
+    tiny_symbol_table_init(&symbols);
+    tiny_document_t doc;
+    tiny_document_init(&doc, parsers, &symbols);
+    double start = now();
+    tiny_document_set_text(&doc, text, len);
+    double full = now() - start;
+    int failed = tiny_document_failed(&doc);
+
+    long reparsed = 0;
+    start = now();
+    for (int k = 0; k < TIMED_EDITS / 2; ++k)
+    {
+        tiny_edit_t insert = {random_int(len + 1), 0, " ", 1};
+        tiny_document_edit(&doc, insert);
+        reparsed += doc.reparsed;
+        tiny_edit_t remove = {insert.offset, 1, "", 0};
+        tiny_document_edit(&doc, remove);
+        reparsed += doc.reparsed;
+    }
+    double edit = (now() - start) / TIMED_EDITS;
+    if (failed || tiny_document_failed(&doc) || doc.len != len || memcmp(doc.text, text, len) != 0)
+        printf("check-incremental: the %d-line document did not parse\n", lines);
+    printf("%d lines, %d chunks: full parse %.3f ms, one-character edit %.3f ms (%ld bytes reparsed on average)\n",
+           lines, doc.chunk_count, full * 1e3, edit * 1e3, reparsed / TIMED_EDITS);
+
+    tiny_document_free(&doc);
+    tiny_symbol_table_free(&symbols);
+    free(text);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 2;
+    }
+    struct trie *parsers = prepare_parsers();
+    char **codes = calloc(argc - 1, sizeof(char *));
+    int *lens = malloc((argc - 1) * sizeof(int));
+    int edits = 0, ret = 0;
+    for (int i = 1; i < argc && !ret; ++i)
+    {
+        codes[i - 1] = read_file(argv[i], &lens[i - 1]);
+        if (!codes[i - 1])
+        {
+            fprintf(stderr, "cannot open %s\n", argv[i]);
+            return 2;
+        }
+        if (!check_file(parsers, argv[i], codes[i - 1], lens[i - 1], &edits))
+            ret = 1;
+    }
+    if (!ret)
+    {
+        printf("check-incremental: %d files, %d edits ok\n", argc - 1, edits);
+        time_edits(parsers, codes, lens, argc - 1);
+    }
+    for (int i = 0; i < argc - 1; ++i)
+        free(codes[i]);
+    free(codes);
+    free(lens);
+    free_parsers(parsers);
+    return ret;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scanner.h"
+#include "lexical.h"
+#include "parser.h"
+#include "syntax_def.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "jit.h"
+#include "memo.h"
+#include "walker.h"
+
+/**
+ * 比较 JIT、字节码虚拟机、缓存纯函数结果的虚拟机与直接遍历 AST 的解释器执行同一个函数的耗时
+ *
+ * 用法：bench_vm [file] [function] [argument] [repeat]
+ * 默认为 bench/fib.tny fib 27 5。bench/fib.tny 中的 fib 修改全局变量，不是纯函数，
+ * bench/memo.tny 中的 fib 是纯函数
+ */
+
+static void reader(void *ctx, tiny_lex_token_t *token)
+{
+    token->error = tiny_lex_next(ctx, token);
+}
+
+static char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *code = malloc(len + 1);
+    code[fread(code, 1, len, file)] = '\0';
+    fclose(file);
+    return code;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_value(const char *name, double seconds, int type, tiny_value_t value)
+{
+    if (type == TINY_TYPE_REAL)
+        printf("%-8s %10.3f ms  result %.17g\n", name, seconds * 1e3, value.r);
+    else
+        printf("%-8s %10.3f ms  result %lld\n", name, seconds * 1e3, (long long)value.i);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "bench/fib.tny";
+    const char *name = argc > 2 ? argv[2] : "fib";
+    const char *arg = argc > 3 ? argv[3] : "27";
+    int repeat = argc > 4 ? atoi(argv[4]) : 5;
+
+    char *code = read_file(path);
+    if (!code)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 2;
+    }
+
+    tiny_symbol_table_t table;
+    tiny_symbol_table_init(&table);
+    tiny_lex_t lex;
+    tiny_lex_begin(&lex, code);
+    lex.symbols = &table;
+    tiny_scanner_t scanner;
+    tiny_scanner_begin(&scanner, &lex, reader);
+    tiny_parser_ctx_t ctx;
+    ctx.parsers = prepare_parsers();
+    ctx.current_parser = trie_search(ctx.parsers, "root");
+    ctx.errors = NULL;
+    tiny_parser_result_t result = tiny_syntax_parse(ctx, &scanner);
+    if (result.state != 0)
+    {
+        fprintf(stderr, "%s: syntax error\n", path);
+        return 1;
+    }
+
+    tiny_resolve_t resolve;
+    tiny_typecheck_t check;
+    if (tiny_resolve(&resolve, &table, result.ast) || tiny_typecheck(&check, &resolve, result.ast))
+    {
+        fprintf(stderr, "%s: semantic error\n", path);
+        return 1;
+    }
+
+    int symbol = tiny_symbol_find(&table, name, name + strlen(name));
+    int func = -1;
+    for (int i = 0; i < resolve.decl_count; ++i)
+        if (resolve.decls[i].kind == TINY_DECL_FUNC && resolve.decls[i].symbol == symbol)
+            func = resolve.decls[i].index;
+    if (func < 0)
+    {
+        fprintf(stderr, "%s: no function named %s\n", path, name);
+        return 1;
+    }
+
+    tiny_program_t program;
+    if (tiny_compile(&program, &check, result.ast) != 0)
+    {
+        fprintf(stderr, "%s: too many registers in a function\n", path);
+        return 1;
+    }
+    const tiny_function_t *f = &program.functions[func];
+    tiny_value_t args[1];
+    if (f->nparams > 1)
+    {
+        fprintf(stderr, "%s takes more than one argument\n", name);
+        return 1;
+    }
+    if (f->nparams == 1 && f->param_types[0] == TINY_TYPE_REAL)
+        args[0].r = atof(arg);
+    else
+        args[0].i = atoll(arg);
+
+    tiny_value_t jit_result = {0}, vm_result = {0}, memo_result = {0}, walker_result = {0};
+    double jit_time = 1e30, vm_time = 1e30, memo_time = 1e30, walker_time = 1e30;
+    for (int i = 0; i < repeat; ++i)
+    {
+        tiny_vm_t vm;
+        tiny_jit_t jit;
+        tiny_vm_init(&vm, &program);
+        tiny_jit_init(&jit, &vm, TINY_JIT_THRESHOLD);
+        double start = now();
+        int ret = tiny_jit_call(&jit, func, args, &jit_result);
+        double elapsed = now() - start;
+        tiny_jit_free(&jit);
+        tiny_vm_free(&vm);
+        if (ret)
+        {
+            fprintf(stderr, "jit: runtime error %d\n", ret);
+            return 1;
+        }
+        if (elapsed < jit_time)
+            jit_time = elapsed;
+
+        tiny_vm_init(&vm, &program);
+        start = now();
+        ret = tiny_vm_call(&vm, func, args, &vm_result);
+        elapsed = now() - start;
+        tiny_vm_free(&vm);
+        if (ret)
+        {
+            fprintf(stderr, "vm: runtime error %d\n", ret);
+            return 1;
+        }
+        if (elapsed < vm_time)
+            vm_time = elapsed;
+
+        tiny_memo_t memo;
+        tiny_vm_init(&vm, &program);
+        tiny_memo_init(&memo, &program);
+        vm.memo = &memo;
+        start = now();
+        ret = tiny_vm_call(&vm, func, args, &memo_result);
+        elapsed = now() - start;
+        tiny_memo_free(&memo);
+        tiny_vm_free(&vm);
+        if (ret)
+        {
+            fprintf(stderr, "memo: runtime error %d\n", ret);
+            return 1;
+        }
+        if (elapsed < memo_time)
+            memo_time = elapsed;
+
+        tiny_walker_t walker;
+        tiny_walker_init(&walker, &check, result.ast);
+        start = now();
+        ret = tiny_walker_call(&walker, func, args, &walker_result);
+        elapsed = now() - start;
+        tiny_walker_free(&walker);
+        if (ret)
+        {
+            fprintf(stderr, "walker: runtime error %d\n", ret);
+            return 1;
+        }
+        if (elapsed < walker_time)
+            walker_time = elapsed;
+    }
+
+    printf("%s(%s), best of %d\n", name, arg, repeat);
+    print_value("jit", jit_time, f->ret_type, jit_result);
+    print_value("vm", vm_time, f->ret_type, vm_result);
+    print_value("memo", memo_time, f->ret_type, memo_result);
+    print_value("walker", walker_time, f->ret_type, walker_result);
+    printf("vm  / walker %7.2fx\n", walker_time / vm_time);
+    printf("jit / walker %7.2fx\n", walker_time / jit_time);
+    printf("memo / walker %6.2fx\n", walker_time / memo_time);
+
+    tiny_program_free(&program);
+    tiny_typecheck_free(&check);
+    tiny_resolve_free(&resolve);
+    tiny_symbol_table_free(&table);
+    free(code);
+    return jit_result.i == walker_result.i && vm_result.i == walker_result.i && memo_result.i == walker_result.i ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * 解析服务的客户端：tiny_client SOCKET [选项] FILE...
+ *
+ * 在同一个连接上依次发送每个文件的请求，输出与 parser 处理同一文件时相同，错误信息带有文件名。
+ * 文件默认由服务进程按绝对路径读取；--send-source 时由客户端读取后随请求发送，"-" 表示标准输入。
+ * --ast-bin 把返回的二进制语法树写入 <FILE>.ast.bin，标准输入的写入 ast.bin。
+ */
+#include "server.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUF_SIZE 65536
+
+static char *read_stream(FILE *stream, size_t *len)
+{
+    size_t size = BUF_SIZE, n;
+    char *data = malloc(size);
+    *len = 0;
+    while (data && (n = fread(data + *len, 1, size - *len, stream)) > 0)
+    {
+        *len += n;
+        if (*len == size)
+            data = realloc(data, size *= 2);
+    }
+    return data;
+}
+
+/**
+ * 把连接上的 len 字节复制到 stream，stream 为 NULL 时丢弃
+ */
+static int copy_out(int fd, uint64_t len, FILE *stream)
+{
+    char buf[BUF_SIZE];
+    while (len > 0)
+    {
+        size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (tiny_server_read(fd, buf, n) != 0)
+            return -1;
+        if (stream)
+            fwrite(buf, 1, n, stream);
+        len -= n;
+    }
+    return 0;
+}
+
+static char *concat(const char *a, const char *b)
+{
+    char *s = malloc(strlen(a) + strlen(b) + 1);
+    strcpy(s, a);
+    strcat(s, b);
+    return s;
+}
+
+/**
+ * 发送 path 的请求并输出响应
+ * @return 0 表示没有错误，1 表示文件有错误，2 表示连接出错
+ */
+static int request(int fd, const char *path, uint32_t flags)
+{
+    const char *name = path;
+    char resolved[PATH_MAX];
+    char *code = NULL;
+    size_t len = 0;
+    if (flags & TINY_REQUEST_SOURCE)
+    {
+        FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+        if (!file)
+        {
+            fprintf(stderr, "%s: file not found\n", path);
+            return 1;
+        }
+        code = read_stream(file, &len);
+        if (file != stdin)
+            fclose(file);
+    }
+    else if (realpath(path, resolved))
+    {
+        // 服务进程的工作目录与客户端不同
+        name = resolved;
+    }
+
+    tiny_request_t req = {TINY_SERVER_MAGIC, flags, strlen(name), 0, len};
+    int ret = tiny_server_write(fd, &req, sizeof(req)) != 0 || tiny_server_write(fd, name, req.name_len) != 0 ||
+              (len > 0 && tiny_server_write(fd, code, len) != 0);
+    free(code);
+    tiny_response_t resp;
+    if (ret != 0 || tiny_server_read(fd, &resp, sizeof(resp)) != 0 || resp.magic != TINY_SERVER_MAGIC)
+        return 2;
+    if (copy_out(fd, resp.out_len, stdout) != 0 || copy_out(fd, resp.err_len, stderr) != 0)
+        return 2;
+
+    if (resp.ast_len > 0)
+    {
+        char *bin_path = strcmp(path, "-") == 0 ? strdup("ast.bin") : concat(path, ".ast.bin");
+        FILE *bin = fopen(bin_path, "wb");
+        if (!bin)
+            fprintf(stderr, "cannot write %s\n", bin_path);
+        ret = copy_out(fd, resp.ast_len, bin);
+        if (bin && fclose(bin) != 0)
+            fprintf(stderr, "cannot write %s\n", bin_path);
+        free(bin_path);
+        if (ret != 0)
+            return 2;
+    }
+    return resp.failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s SOCKET [--lazy] [--symbols] [--check] [--fold] [--ast-bin] [--send-source] FILE...\n",
+                argv[0]);
+        return 2;
+    }
+    uint32_t flags = 0;
+    int first = argc;
+    for (int i = 2; i < argc && first == argc; ++i)
+    {
+        if (strcmp(argv[i], "--lazy") == 0)
+            flags |= TINY_REQUEST_LAZY;
+        else if (strcmp(argv[i], "--symbols") == 0)
+            flags |= TINY_REQUEST_SYMBOLS;
+        else if (strcmp(argv[i], "--check") == 0)
+            flags |= TINY_REQUEST_CHECK;
+        else if (strcmp(argv[i], "--fold") == 0)
+            flags |= TINY_REQUEST_FOLD;
+        else if (strcmp(argv[i], "--ast-bin") == 0)
+            flags |= TINY_REQUEST_AST_BIN;
+        else if (strcmp(argv[i], "--send-source") == 0)
+            flags |= TINY_REQUEST_SOURCE;
+        else
+            first = i;
+    }
+
+    int fd = tiny_server_connect(argv[1]);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot connect to %s\n", argv[1]);
+        return 2;
+    }
+    int status = 0;
+    for (int i = first; i < argc; ++i)
+    {
+        // "-" 只能随请求发送
+        uint32_t file_flags = strcmp(argv[i], "-") == 0 ? flags | TINY_REQUEST_SOURCE : flags;
+        int ret = request(fd, argv[i], file_flags);
+        if (ret == 2)
+        {
+            fprintf(stderr, "connection to %s lost\n", argv[1]);
+            close(fd);
+            return 2;
+        }
+        status |= ret;
+    }
+    close(fd);
+    return status;
+}
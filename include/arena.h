@@ -0,0 +1,42 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * 区域分配器：从大块内存中顺序分配，整体一次性释放，不支持单独释放某个对象
+ */
+struct tiny_arena_block_s
+{
+    struct tiny_arena_block_s *next;
+    size_t size, used; // used 总是 16 的倍数
+    _Alignas(16) char data[]; // malloc 的结果按 16 字节对齐，data 的偏移也是 16 的倍数
+};
+
+struct tiny_arena_s
+{
+    struct tiny_arena_block_s *head;
+};
+
+typedef struct tiny_arena_s tiny_arena_t;
+
+void tiny_arena_init(tiny_arena_t *arena);
+
+/**
+ * @brief 分配 size 字节，按 16 字节对齐
+ */
+void *tiny_arena_alloc(tiny_arena_t *arena, size_t size);
+
+/**
+ * @brief 在 arena 中复制 s[0, len)，并以 '\0' 结尾
+ */
+char *tiny_arena_strndup(tiny_arena_t *arena, const char *s, size_t len);
+
+/**
+ * 释放 arena 中所有对象，但保留最大的一块内存供下次使用
+ */
+void tiny_arena_reset(tiny_arena_t *arena);
+
+void tiny_arena_free(tiny_arena_t *arena);
+
+#endif // ARENA_H
@@ -6,6 +6,7 @@
 
 struct tiny_ast_s {
     int desc;
+    int id; // 由 tiny_ast_number 按先序编号，语义分析的结果保存在以 id 为下标的数组中
     tiny_lex_token_t token;
 
     struct tiny_ast_s *child;
@@ -20,6 +21,36 @@ void tiny_free_ast(tiny_ast_t *ast);
 
 void tiny_ast_add_child(tiny_ast_t *ast, tiny_ast_t *child);
 
+/**
+ * @brief 把 child 链接到 *tail，返回新的末尾，连续追加多个子节点时不必每次从头查找末尾
+ * @param tail 最后一个子节点的 sibling，没有子节点时为父节点的 child
+ */
+tiny_ast_t **tiny_ast_append(tiny_ast_t **tail, tiny_ast_t *child);
+
 size_t tiny_ast_child_count(tiny_ast_t *ast);
 
+/**
+ * @brief 按先序遍历为 ast 及其所有后代（不含 ast 的兄弟节点）编号
+ * @param first 第一个编号
+ * @return 下一个未使用的编号
+ */
+int tiny_ast_number(tiny_ast_t *ast, int first);
+
+/**
+ * @brief ast 在源码中的起点，即先序遍历中第一个 token 的起点，没有任何 token 时为 NULL
+ */
+const char *tiny_ast_begin(const tiny_ast_t *ast);
+
+/**
+ * @brief ast 在源码中的终点，即最后一个 token 的终点，没有任何 token 时为 NULL
+ */
+const char *tiny_ast_end(const tiny_ast_t *ast);
+
+/**
+ * @brief 把 ast 及其后代（不含兄弟节点）的 token 从 old_code 平移到 new_code，
+ * 每个 token 在源码中的偏移都加上 delta，用于把一段语法树连同其源码复制到别处
+ * @param new_len new_code 的长度
+ */
+void tiny_ast_move(tiny_ast_t *ast, const char *old_code, const char *new_code, int new_len, int delta);
+
 #endif // AST_H
\ No newline at end of file
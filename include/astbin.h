@@ -0,0 +1,164 @@
+#ifndef ASTBIN_H
+#define ASTBIN_H
+
+#include "ast.h"
+#include "scanner.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 语法树的二进制格式，可以直接 mmap 使用，不需要反序列化：
+ *
+ *     header | node[node_count] | token[token_count] | strings[string_size]
+ *
+ * 节点按先序排列，0 号节点为根，子节点与兄弟节点以下标表示，-1 表示没有。
+ * token 的文本以 (offset, length) 指向字符串区，字符串区的开头是 source_size 字节的源码本身。
+ * token 表是可选的，按顺序保存词法分析得到的 token，不含 EOF 与出错的 token。
+ * 所有整数都按写入时机器的字节序保存，读取时通过 byte_order 检查。
+ */
+
+#define TINY_ASTBIN_MAGIC "TINYAST"   // 连同末尾的 \0 共 8 字节
+#define TINY_ASTBIN_VERSION 2         // 格式改变时递增，读取时只接受相同的版本
+#define TINY_ASTBIN_BYTE_ORDER 0x01020304u
+
+#define TINY_ASTBIN_NO_TEXT 1 // 节点没有源码文本，例如常量折叠的结果，数值在 value 中
+
+struct tiny_astbin_header_s
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t node_size;  // sizeof(tiny_astbin_node_t)
+    uint32_t token_size; // sizeof(tiny_astbin_token_t)
+    uint64_t node_count;
+    uint64_t node_offset; // 节点表相对文件开头的偏移，8 字节对齐
+    uint64_t token_count;
+    uint64_t token_offset;
+    uint64_t string_offset;
+    uint64_t string_size;
+    uint64_t source_size;
+};
+
+struct tiny_astbin_node_s
+{
+    int32_t desc;
+    int32_t kind; // TINY_TOKEN_*
+    int32_t child;
+    int32_t sibling;
+    uint64_t offset; // token 文本在字符串区中的偏移
+    uint32_t length;
+    uint32_t flags; // TINY_ASTBIN_*
+    union
+    {
+        int64_t integer; // TINY_TOKEN_INT
+        double real;     // TINY_TOKEN_REAL
+    } value;
+};
+
+struct tiny_astbin_token_s
+{
+    uint64_t offset; // 在源码中的偏移
+    uint32_t length;
+    int32_t kind;
+};
+
+/**
+ * 映射到内存中的二进制语法树
+ */
+struct tiny_astbin_s
+{
+    void *base;
+    size_t size;
+    const struct tiny_astbin_header_s *header;
+    const struct tiny_astbin_node_s *nodes;
+    const struct tiny_astbin_token_s *tokens;
+    const char *strings;
+};
+
+typedef struct tiny_astbin_header_s tiny_astbin_header_t;
+typedef struct tiny_astbin_node_s tiny_astbin_node_t;
+typedef struct tiny_astbin_token_s tiny_astbin_token_t;
+typedef struct tiny_astbin_s tiny_astbin_t;
+
+/**
+ * @brief 把 root 及其后代写入文件 path
+ *
+ * root 的兄弟节点不写入。token 指向 code[0, len) 之外的节点，其文本复制到源码之后。
+ *
+ * @param tokens 如果不为 NULL，把其中缓存的 token 写入 token 表，它们必须都在 code[0, len) 中
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_astbin_write(const tiny_ast_t *root, const char *code, size_t len, tiny_scanner_t *tokens, const char *path);
+
+/**
+ * @brief 与 tiny_astbin_write 相同，写入已经打开的文件描述符 fd 的当前位置，fd 不会被关闭
+ */
+int tiny_astbin_write_fd(const tiny_ast_t *root, const char *code, size_t len, tiny_scanner_t *tokens, int fd);
+
+/**
+ * @brief 只读映射文件 path
+ *
+ * 只检查文件头与各区的范围，耗时与文件大小无关；节点中的下标与偏移在访问时检查。
+ *
+ * @return 0、TINY_IO_ERROR 或 TINY_INVALID_AST_FILE
+ */
+int tiny_astbin_open(tiny_astbin_t *bin, const char *path);
+
+void tiny_astbin_close(tiny_astbin_t *bin);
+
+/**
+ * @brief 下标为 index 的节点，越界时返回 NULL
+ */
+static inline const tiny_astbin_node_t *tiny_astbin_node(const tiny_astbin_t *bin, int32_t index)
+{
+    if (index < 0 || (uint64_t)index >= bin->header->node_count)
+        return NULL;
+    return &bin->nodes[index];
+}
+
+/**
+ * @brief 第一个子节点。先序中子节点总在父节点之后，不满足时视为没有，因此损坏的文件也不会形成环
+ */
+static inline const tiny_astbin_node_t *tiny_astbin_child(const tiny_astbin_t *bin, const tiny_astbin_node_t *node)
+{
+    return node->child > node - bin->nodes ? tiny_astbin_node(bin, node->child) : NULL;
+}
+
+static inline const tiny_astbin_node_t *tiny_astbin_sibling(const tiny_astbin_t *bin, const tiny_astbin_node_t *node)
+{
+    return node->sibling > node - bin->nodes ? tiny_astbin_node(bin, node->sibling) : NULL;
+}
+
+/**
+ * @brief 节点的 token 文本，直接指向映射的内存，不以 \0 结尾
+ * @return 没有文本或范围越界时返回 NULL，len 为 0
+ */
+static inline const char *tiny_astbin_text(const tiny_astbin_t *bin, const tiny_astbin_node_t *node, size_t *len)
+{
+    uint64_t size = bin->header->string_size;
+    if ((node->flags & TINY_ASTBIN_NO_TEXT) || node->offset > size || node->length > size - node->offset)
+    {
+        *len = 0;
+        return NULL;
+    }
+    *len = node->length;
+    return bin->strings + node->offset;
+}
+
+/**
+ * @brief token 表中第 index 个 token 的文本，越界时返回 NULL，len 为 0
+ */
+static inline const char *tiny_astbin_token_text(const tiny_astbin_t *bin, uint64_t index, size_t *len)
+{
+    uint64_t size = bin->header->source_size;
+    *len = 0;
+    if (index >= bin->header->token_count)
+        return NULL;
+    const tiny_astbin_token_t *token = &bin->tokens[index];
+    if (token->offset > size || token->length > size - token->offset)
+        return NULL;
+    *len = token->length;
+    return bin->strings + token->offset;
+}
+
+#endif // ASTBIN_H
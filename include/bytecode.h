@@ -0,0 +1,122 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "typecheck.h"
+#include "runtime.h"
+#include <stdio.h>
+
+/**
+ * 基于寄存器的字节码。每个函数的寄存器位于值栈上连续的一段，参数依次占据 r0 起的寄存器，
+ * 其后是局部变量和临时值。INT 与 REAL 使用不同的指令，类型在编译时已经确定。
+ *
+ * 指令的操作数：a、b、c 为寄存器，bx 为常量、全局变量、函数、字符串的编号或跳转目标。
+ * 寄存器的编号只有 16 位，每个函数最多使用 TINY_MAX_REGISTERS 个寄存器
+ */
+#define TINY_MAX_REGISTERS 65536
+
+#define TINY_OPCODES(X)                                     \
+    X(MOV)    /* r[a] = r[b] */                             \
+    X(LOADI)  /* r[a] = (int32_t)bx */                      \
+    X(LOADK)  /* r[a] = k[bx] */                            \
+    X(ZERO)   /* r[a] = 0 */                                \
+    X(GETG)   /* r[a] = g[bx] */                            \
+    X(SETG)   /* g[bx] = r[a] */                            \
+    X(ADDI)   /* r[a] = r[b] + r[c] */                      \
+    X(SUBI)                                                 \
+    X(MULI)                                                 \
+    X(DIVI)                                                 \
+    X(ADDR)                                                 \
+    X(SUBR)                                                 \
+    X(MULR)                                                 \
+    X(DIVR)                                                 \
+    X(EQI)    /* r[a] = r[b] == r[c]，结果为 INT */          \
+    X(NEI)                                                  \
+    X(EQR)                                                  \
+    X(NER)                                                  \
+    X(I2R)    /* r[a] = (REAL)r[b] */                       \
+    X(R2I)    /* r[a] = (INT)r[b] */                        \
+    X(JMP)    /* pc = bx */                                 \
+    X(JZI)    /* if (r[a] == 0) pc = bx */                  \
+    X(JZR)                                                  \
+    X(CALL)   /* r[a] = f[bx](r[a], r[a + 1], ...) */       \
+    X(RET)    /* return r[a] */                             \
+    X(RET0)   /* return 0 */                                \
+    X(READI)  /* READ(r[a], s[bx]) */                       \
+    X(READR)                                                \
+    X(WRITEI) /* WRITE(r[a], s[bx]) */                      \
+    X(WRITER)
+
+#define TINY_OPCODE_ENUM(op) TINY_OP_##op,
+enum tiny_opcode_e
+{
+    TINY_OPCODES(TINY_OPCODE_ENUM)
+    TINY_OP_COUNT
+};
+#undef TINY_OPCODE_ENUM
+
+struct tiny_insn_s
+{
+    uint16_t op;
+    uint16_t a;
+    union {
+        struct
+        {
+            uint16_t b, c;
+        };
+        uint32_t bx;
+    };
+};
+
+struct tiny_function_s
+{
+    int symbol;      // 函数名
+    int nparams;
+    int nregs;       // 参数、局部变量与临时值所需的寄存器总数
+    int ret_type;    // TINY_TYPE_INT 或 TINY_TYPE_REAL
+    int *param_types;
+    bool pure;       // 结果只取决于参数：不读写全局变量，不调用 READ、WRITE，只调用纯函数
+
+    struct tiny_insn_s *code;
+    int code_count, code_size;
+
+    tiny_value_t *consts;
+    int const_count, const_size;
+};
+
+struct tiny_program_s
+{
+    struct tiny_function_s *functions; // 以函数声明的 index 为下标
+    int function_count;
+    int global_count;
+
+    char **strings; // READ 与 WRITE 的文件名，以 '\0' 结尾
+    int string_count, string_size;
+
+    int main; // MAIN 函数的编号，没有时为 -1
+};
+
+typedef struct tiny_insn_s tiny_insn_t;
+typedef struct tiny_function_s tiny_function_t;
+typedef struct tiny_program_s tiny_program_t;
+
+/**
+ * @brief 将通过了名字解析与类型检查的 root 编译为字节码
+ *
+ * 局部变量固定分配在以其声明的 index 为编号的寄存器中，临时值按栈的方式分配在局部变量之后，
+ * 函数调用的参数放在调用者连续的寄存器中，并直接成为被调用者的 r0 起的寄存器。
+ * 编译之后在调用图上求出每个函数是否为纯函数。
+ * 惰性函数体必须先调用 tiny_syntax_materialize。
+ *
+ * @return 0，或 TINY_TOO_MANY_REGISTERS：某个函数的 nregs 超过了 TINY_MAX_REGISTERS，其指令不可用，
+ * 但 program 仍然需要 tiny_program_free
+ */
+int tiny_compile(tiny_program_t *program, const tiny_typecheck_t *check, tiny_ast_t *root);
+
+void tiny_program_free(tiny_program_t *program);
+
+/**
+ * @brief 以文本形式输出字节码
+ */
+void tiny_program_dump(const tiny_program_t *program, const tiny_symbol_table_t *symbols, FILE *stream);
+
+#endif // BYTECODE_H
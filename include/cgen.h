@@ -0,0 +1,20 @@
+#ifndef CGEN_H
+#define CGEN_H
+
+#include "typecheck.h"
+#include <stdio.h>
+
+/**
+ * @brief 将通过了名字解析与类型检查的 root 翻译为 C 源码
+ *
+ * 每个 func 对应一个 C 函数，顶层 vars 对应全局变量，READ 与 WRITE 调用 runtime.h 中的运行时。
+ * 生成的源码需要与 src/runtime.c 一起编译，例如：
+ *
+ *     gcc -O2 -Iinclude program.c src/runtime.c -o program
+ *
+ * 每个表达式的值先保存在一个临时变量中，因此求值顺序与解释执行相同，都是从左到右。
+ * INT 运算按补码回绕，除以 0 时报告错误并退出。
+ */
+void tiny_emit_c(const tiny_typecheck_t *check, tiny_ast_t *root, FILE *out);
+
+#endif // CGEN_H
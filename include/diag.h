@@ -0,0 +1,81 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include "lexical.h"
+#include <stdio.h>
+
+/*
+ * 诊断信息：分析过程中只把错误码、位置与消息参数追加到 tiny_diags_t，不做任何输出；
+ * 全部分析结束后排序，再用行索引一次性输出为文本或 JSON。
+ * 按位置排序后行号只会增加，输出时沿行索引顺序前进，不必为每条诊断重新查找所在的行。
+ */
+
+#define TINY_DIAG_FLUSH_SIZE 65536 // 输出的缓冲区超过这个大小时先写出
+
+/**
+ * 一条诊断，位置是相对源码起点的字节偏移
+ */
+struct tiny_diag_s
+{
+    int code;       // 错误码，消息由 tiny_error_format 给出
+    int start, end; // 出错的范围，报告的位置为 start
+    const char *arg; // 消息中 %s 的内容，指向源码或文法中的字符串，不以 '\0' 结尾
+    int arg_len;
+    int seq; // 加入的顺序，排序时位置相同的诊断保持原来的顺序
+};
+
+struct tiny_diags_s
+{
+    struct tiny_diag_s *items;
+    int count, size;
+};
+
+typedef struct tiny_diag_s tiny_diag_t;
+typedef struct tiny_diags_s tiny_diags_t;
+
+void tiny_diags_init(tiny_diags_t *diags);
+
+void tiny_diags_free(tiny_diags_t *diags);
+
+/**
+ * @brief 清空所有诊断，保留已分配的内存
+ */
+void tiny_diags_reset(tiny_diags_t *diags);
+
+void tiny_diags_add(tiny_diags_t *diags, int code, int start, int end, const char *arg, int arg_len);
+
+/**
+ * @brief 加入 token 处的错误。词法错误的位置为 token 的终点，其余为起点；
+ * TINY_UNEXPECTED_TOKEN 的消息参数为 required_token，其余为 token 的文本
+ * @param base 偏移的起点，与输出时行索引的 code 相同
+ */
+void tiny_diags_add_token(tiny_diags_t *diags, int code, const char *base, const tiny_lex_token_t *token,
+                          const char *required_token);
+
+/**
+ * @brief 按位置排序，位置相同时保持加入的顺序
+ */
+void tiny_diags_sort(tiny_diags_t *diags);
+
+/**
+ * @brief 以文本格式输出，每条诊断为
+ *
+ *     [name:]line:column: error: message
+ *     源码行
+ *     ^
+ *
+ * 整批诊断先拼接在缓冲区中，超过 TINY_DIAG_FLUSH_SIZE 时才写入 out，每条诊断的各行不会与其他输出交错
+ * @param name 不为 NULL 时加在每条诊断之前
+ */
+void tiny_diags_render(const tiny_diags_t *diags, const tiny_line_index_t *lines, const char *name, FILE *out);
+
+/**
+ * @brief 以 JSON Lines 格式输出，每条诊断一行：
+ *
+ *     {"file":..., "line":..., "column":..., "end_line":..., "end_column":..., "code":..., "severity":"error", "message":...}
+ *
+ * 行号与列号从 1 开始，end_line 与 end_column 是范围之后的第一个字符，没有 name 时 file 为 null
+ */
+void tiny_diags_render_json(const tiny_diags_t *diags, const tiny_line_index_t *lines, const char *name, FILE *out);
+
+#endif // DIAG_H
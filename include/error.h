@@ -19,6 +19,27 @@
 #define TINY_EXPECT_COMMA -16
 #define TINY_EXPECT_FUNC_VARS -17
 #define TINY_UNTERMINATED_STRING_OR_CHARACTER -18
+#define TINY_UNDEFINED_NAME -19
+#define TINY_DUPLICATE_NAME -20
+#define TINY_NOT_A_FUNCTION -21
+#define TINY_NOT_A_VARIABLE -22
+#define TINY_TYPE_MISMATCH -23
+#define TINY_ARGUMENT_COUNT -24
+#define TINY_NOT_ASSIGNABLE -25
+#define TINY_DIVISION_BY_ZERO -26
+#define TINY_STACK_OVERFLOW -27
+#define TINY_IO_ERROR -28
+#define TINY_NO_MAIN -29
+#define TINY_INVALID_AST_FILE -30
+#define TINY_INVALID_INDEX_FILE -31
+#define TINY_TOO_MANY_REGISTERS -32
 #define TINY_MAY_FUNC_CALL -100
 
+/**
+ * @brief 语法错误与语义错误的说明，格式同 printf，其中的 %s 为出错的 token 文本，
+ * TINY_UNEXPECTED_TOKEN 的 %s 为期望的 token
+ * @return 没有说明的错误码返回 NULL
+ */
+const char *tiny_error_format(int code);
+
 #endif // ERROR_H
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "typecheck.h"
+
+/**
+ * @brief 在通过了类型检查的 root 上做常量折叠与代数化简，一次后序遍历原地修改语法树
+ *
+ * - 只有一个子节点的 binary 与 assignment 包装节点、表达式中的括号被替换为其中的表达式；
+ * - 运算链开头的常量运算折叠为一个 number 节点，十六进制、八进制字面量按数值参与折叠，
+ *   常量的类型转换直接转换数值；
+ * - x + 0、x - 0、x * 1、x / 1、0 + x、1 * x 化简为 x，REAL 的 x + 0.0 与 0.0 + x 在 x 为 -0.0 时不成立，不化简；
+ * - 条件为常量的 if 替换为被执行的分支，没有被执行的分支时从语句列表中删除。
+ *
+ * 除以 0 不折叠，运行时照常报告错误；运算的求值顺序与副作用都不改变。
+ * 折叠得到的 number 节点没有源码文本，token.s 为 NULL，check->types 随之更新。
+ * 被删除的分支中声明的变量不再有对应的节点，其声明的 node、type 与 func 置为 NULL。
+ *
+ * @return 被删除的节点数
+ */
+int tiny_fold(tiny_typecheck_t *check, tiny_ast_t *root);
+
+#endif // FOLD_H
@@ -0,0 +1,102 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "parser.h"
+#include "scanner.h"
+
+/*
+ * 增量解析。文档按顶层 func/vars 分为若干段，每段有自己的源码副本与语法树，token 指向段内的副本，
+ * 段在文档中的位置改变时 token 不需要修改。编辑时只重新进行词法分析与语法分析与编辑范围相交的段，
+ * 之后的段只平移偏移量。除了移动文本与平移偏移量，耗时只与编辑所在的 func/vars 的大小有关。
+ *
+ * 重新解析的范围末尾处于未结束的注释、字符串或 token 中时（例如插入了多行注释的开头，或删除了 // 注释后的换行），
+ * 范围向后扩展，直到与解析整个文档的结果相同。
+ */
+
+/**
+ * 一次文本编辑：将旧源码中 [offset, offset + removed) 替换为 text[0, inserted)
+ */
+struct tiny_edit_s
+{
+    int offset;
+    int removed;
+    const char *text;
+    int inserted;
+};
+
+/**
+ * 文档中的一段，包含至多一个顶层 func/vars 及其后的空白与注释
+ */
+struct tiny_chunk_s
+{
+    int offset, len;  // 在文档中的范围
+    char *code;       // 这一段源码的副本，以 '\0' 结尾，语法树的 token 指向这里
+    tiny_ast_t *item; // 解析失败或只有空白与注释时为 NULL
+
+    int error;                    // 解析失败时为错误码，此时以下两项有效，否则为 0
+    tiny_lex_token_t error_token; // 出错的 token，error_token.error 不为 0 时是词法错误
+    const char *required;         // TINY_UNEXPECTED_TOKEN 期望的 token
+
+    void *data; // 调用者附加的数据，段被替换或文档释放时通过 free_data 释放
+};
+
+struct tiny_document_s
+{
+    struct trie *parsers;
+    tiny_parser_t *root;
+    tiny_symbol_table_t *symbols; // 标识符与解码后的字符串保存在其中
+
+    char *text; // 整个文档，以 '\0' 结尾
+    int len, size;
+
+    // 连续地覆盖整个文档，至少有一段
+    struct tiny_chunk_s *chunks;
+    int chunk_count, chunk_size;
+
+    void (*free_data)(void *data); // 为 NULL 时 data 不释放
+    int reparsed;                  // 上一次修改重新解析的源码长度
+
+    tiny_lex_t lex;
+    tiny_scanner_t scanner;
+    // 一次解析得到的新段，之后整体替换旧的段
+    struct tiny_chunk_s *fresh;
+    int fresh_count, fresh_size;
+};
+
+typedef struct tiny_edit_s tiny_edit_t;
+typedef struct tiny_chunk_s tiny_chunk_t;
+typedef struct tiny_document_s tiny_document_t;
+
+/**
+ * @brief 初始化空文档
+ * @param parsers prepare_parsers 构造的文法
+ * @param symbols 符号表，不能为 NULL，由调用者释放
+ */
+void tiny_document_init(tiny_document_t *doc, struct trie *parsers, tiny_symbol_table_t *symbols);
+
+void tiny_document_free(tiny_document_t *doc);
+
+/**
+ * @brief 用 text[0, len) 替换整个文档并重新解析
+ */
+void tiny_document_set_text(tiny_document_t *doc, const char *text, int len);
+
+/**
+ * @brief 对文档应用 edit，只重新解析受影响的段，其余段的语法树与源码副本保留
+ *
+ * 编辑位于两段之间时连同前一段一起解析；与之相邻的失败的段也一起解析，它们的错误可能正是由这一次编辑修复的。
+ * 要求 0 <= edit.offset <= edit.offset + edit.removed <= doc->len。
+ */
+void tiny_document_edit(tiny_document_t *doc, tiny_edit_t edit);
+
+/**
+ * @return 包含 offset 的段，即起点不超过 offset 的最后一段
+ */
+int tiny_document_find(const tiny_document_t *doc, int offset);
+
+/**
+ * @return 解析失败的段数，为 0 时所有段的语法树连接起来与解析整个文档得到的相同
+ */
+int tiny_document_failed(const tiny_document_t *doc);
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,191 @@
+#ifndef IR_H
+#define IR_H
+
+#include "typecheck.h"
+#include "runtime.h"
+#include <stdio.h>
+
+/**
+ * SSA 形式的中间表示。每个函数是由基本块组成的控制流图，每条指令定义一个值，值的编号就是指令的编号。
+ * 参数与局部变量只存在于 SSA 值中，全局变量通过 GETG/SETG 访问。
+ * TINY+ 没有循环，控制流图总是无环的，phi 只出现在 IF/ELSE 的汇合处。
+ */
+#define TINY_IR_OPCODES(X)                                    \
+    X(CONST)  /* imm */                                       \
+    X(PARAM)  /* 第 index 个参数 */                            \
+    X(COPY)   /* args[0] */                                   \
+    X(PHI)    /* 依次对应每个前驱 */                            \
+    X(GETG)   /* g[index] */                                  \
+    X(SETG)   /* g[index] = args[0] */                        \
+    X(ADDI)                                                   \
+    X(SUBI)                                                   \
+    X(MULI)                                                   \
+    X(DIVI)                                                   \
+    X(ADDR)                                                   \
+    X(SUBR)                                                   \
+    X(MULR)                                                   \
+    X(DIVR)                                                   \
+    X(EQI)                                                    \
+    X(NEI)                                                    \
+    X(EQR)                                                    \
+    X(NER)                                                    \
+    X(I2R)                                                    \
+    X(R2I)                                                    \
+    X(CALL)   /* f[index](args...) */                         \
+    X(READ)   /* READ 文件 s[index]，结果为读到的值 */          \
+    X(WRITE)  /* WRITE(args[0], s[index]) */                  \
+    X(BR)     /* args[0] != 0 时转到 targets[0]，否则 targets[1] */ \
+    X(JMP)    /* 转到 targets[0] */                            \
+    X(RET)    /* return args[0] */
+
+#define TINY_IR_OPCODE_ENUM(op) TINY_IR_##op,
+enum tiny_ir_opcode_e
+{
+    TINY_IR_OPCODES(TINY_IR_OPCODE_ENUM)
+    TINY_IR_OPCODE_COUNT
+};
+#undef TINY_IR_OPCODE_ENUM
+
+struct tiny_ir_insn_s
+{
+    int op;
+    int type;  // 结果的类型，没有结果时为 TINY_TYPE_VOID，BR 为条件的类型
+    int block; // 所在的基本块
+    int *args;
+    int arg_count;
+    int index;         // PARAM、GETG、SETG、CALL、READ、WRITE 的编号
+    tiny_value_t imm;  // CONST 的值
+    int targets[2];    // BR、JMP 的目标基本块
+    bool removed;
+};
+
+struct tiny_ir_block_s
+{
+    int *insns; // phi 在最前面，最后一条是 BR、JMP 或 RET
+    int insn_count, insn_size;
+    int *preds;
+    int pred_count, pred_size;
+    bool removed;
+};
+
+struct tiny_ir_func_s
+{
+    int symbol;
+    int nparams;
+    int ret_type;
+    int *param_types;
+
+    struct tiny_ir_insn_s *insns;
+    int insn_count, insn_size;
+    struct tiny_ir_block_s *blocks; // 入口为 blocks[0]
+    int block_count, block_size;
+};
+
+struct tiny_ir_module_s
+{
+    struct tiny_ir_func_s *funcs; // 以函数声明的 index 为下标
+    int func_count;
+    int global_count;
+    char **strings; // READ 与 WRITE 的文件名
+    int string_count, string_size;
+    int main;       // MAIN 函数的编号，没有时为 -1
+};
+
+typedef struct tiny_ir_insn_s tiny_ir_insn_t;
+typedef struct tiny_ir_block_s tiny_ir_block_t;
+typedef struct tiny_ir_func_s tiny_ir_func_t;
+typedef struct tiny_ir_module_s tiny_ir_module_t;
+
+/**
+ * @brief 将通过了类型检查的 root 翻译为 SSA 形式的中间表示，变量的读取直接连接到最近的定义，
+ *        在汇合处需要时插入 phi
+ */
+void tiny_ir_build(tiny_ir_module_t *module, const tiny_typecheck_t *check, tiny_ast_t *root);
+
+void tiny_ir_free(tiny_ir_module_t *module);
+
+/**
+ * @brief 以文本形式输出中间表示
+ */
+void tiny_ir_dump(const tiny_ir_module_t *module, const tiny_symbol_table_t *symbols, FILE *stream);
+
+/**
+ * @brief 模块中尚未删除的指令数
+ */
+int tiny_ir_count(const tiny_ir_module_t *module);
+
+int tiny_ir_new_block(tiny_ir_func_t *func);
+
+/**
+ * @brief 在基本块 block 的末尾添加一条指令，block 为 -1 时不加入任何基本块
+ * @return 新指令的编号
+ */
+int tiny_ir_new_insn(tiny_ir_func_t *func, int block, int op, int type);
+
+void tiny_ir_add_arg(tiny_ir_func_t *func, int insn, int value);
+
+void tiny_ir_add_pred(tiny_ir_func_t *func, int block, int pred);
+
+/**
+ * @brief 删除 block 的前驱 pred，同时删除各 phi 中对应的参数
+ */
+void tiny_ir_remove_pred(tiny_ir_func_t *func, int block, int pred);
+
+/**
+ * @brief 基本块的后继，返回个数
+ */
+int tiny_ir_successors(const tiny_ir_func_t *func, int block, int succs[2]);
+
+/**
+ * @brief 从各基本块的指令列表中去掉已删除的指令
+ */
+void tiny_ir_compact(tiny_ir_func_t *func);
+
+/**
+ * @brief 计算从入口可达的基本块的逆后序，返回个数
+ */
+int tiny_ir_reverse_postorder(const tiny_ir_func_t *func, int *order);
+
+/**
+ * @brief 删除从入口不可达的基本块
+ */
+void tiny_ir_remove_unreachable(tiny_ir_func_t *func);
+
+/**
+ * @brief 把对不含调用、指令数不超过 TINY_IR_INLINE_LIMIT 的函数的调用替换为函数体
+ * @return 被内联的调用数
+ */
+#define TINY_IR_INLINE_LIMIT 16
+int tiny_ir_inline(tiny_ir_module_t *module);
+
+/**
+ * @brief 常量传播与折叠，条件为常量的分支改为无条件跳转
+ * @return 被删除或替换的指令数
+ */
+int tiny_ir_propagate_constants(tiny_ir_module_t *module);
+
+/**
+ * @brief 复制传播：用 COPY 的来源与参数都相同的 phi 的参数替换它们的使用
+ * @return 被删除或替换的指令数
+ */
+int tiny_ir_propagate_copies(tiny_ir_module_t *module);
+
+/**
+ * @brief 公共子表达式删除：沿支配树删除与支配它的指令计算相同值的纯指令
+ * @return 被删除或替换的指令数
+ */
+int tiny_ir_eliminate_common(tiny_ir_module_t *module);
+
+/**
+ * @brief 死代码删除：删除结果没有被使用的纯指令，并合并只有一个前驱与后继的基本块
+ * @return 被删除或替换的指令数
+ */
+int tiny_ir_eliminate_dead(tiny_ir_module_t *module);
+
+/**
+ * @brief 依次执行所有优化
+ * @param report 不为 NULL 时输出每个优化的耗时与指令数的变化
+ */
+void tiny_ir_optimize(tiny_ir_module_t *module, FILE *report);
+
+#endif // IR_H
@@ -0,0 +1,75 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+#include <stddef.h>
+
+#define TINY_JIT_THRESHOLD 100   // 函数被调用多少次后编译为机器码
+#define TINY_JIT_MAX_DEPTH 10000 // 机器码之间相互调用的最大深度
+
+struct tiny_jit_s;
+
+/**
+ * 编译后的函数：寄存器从 base 开始，返回值写入 base[0]，
+ * 返回 0 表示成功，否则为 TINY_DIVISION_BY_ZERO、TINY_STACK_OVERFLOW 或 TINY_IO_ERROR
+ */
+typedef int (*tiny_jit_func_t)(tiny_value_t *base, struct tiny_jit_s *jit, int func);
+
+struct tiny_jit_block_s
+{
+    void *code;
+    size_t size;
+};
+
+/**
+ * 模板式 JIT：把字节码逐条翻译为 x86-64 机器码，虚拟寄存器仍然保存在值栈上。
+ * 每个函数有一个调用计数器，达到 TINY_JIT_THRESHOLD 后编译，之后虚拟机与机器码都直接调用编译结果。
+ * 机器码调用尚未编译的函数时回到虚拟机解释执行。虚拟机启用记忆化时，可缓存的纯函数不编译。
+ * 只在 x86-64 Linux 上生成机器码，其他平台上所有函数都解释执行。
+ */
+struct tiny_jit_s
+{
+    tiny_vm_t *vm;
+    int threshold;
+
+    tiny_jit_func_t *natives; // 以函数编号为下标，尚未编译的为 NULL
+    int *counters;            // 调用次数，编译失败的函数为 -1，不再尝试
+
+    int depth;                // 剩余可用的调用深度，由机器码维护
+    tiny_value_t *stack_end;  // 值栈的末尾，由机器码检查
+    tiny_vm_frame_t *frame;   // 机器码回到虚拟机时可以使用的第一个调用帧
+
+    struct tiny_jit_block_s *blocks; // 可执行内存，每个函数一块
+    int block_count;
+};
+
+typedef struct tiny_jit_s tiny_jit_t;
+
+/**
+ * @brief 为虚拟机 vm 启用 JIT
+ * @param threshold 编译的调用次数阈值，0 表示第一次调用时就编译
+ */
+void tiny_jit_init(tiny_jit_t *jit, tiny_vm_t *vm, int threshold);
+
+/**
+ * @brief 释放所有机器码，并让虚拟机回到只解释执行
+ */
+void tiny_jit_free(tiny_jit_t *jit);
+
+/**
+ * @brief 记录一次对函数 func 的调用，调用次数达到阈值时编译它
+ * @return 编译后的机器码，尚未编译或无法编译时为 NULL
+ */
+tiny_jit_func_t tiny_jit_lookup(tiny_jit_t *jit, int func);
+
+/**
+ * @brief 调用函数 func，已编译时执行机器码，否则由虚拟机解释执行。机器码调用未编译的函数时进入此处
+ */
+int tiny_jit_enter(tiny_value_t *base, tiny_jit_t *jit, int func);
+
+/**
+ * @brief 以 args 为参数调用编号为 func 的函数，与 tiny_vm_call 相同，但入口函数也参与计数与编译
+ */
+int tiny_jit_call(tiny_jit_t *jit, int func, const tiny_value_t *args, tiny_value_t *result);
+
+#endif // JIT_H
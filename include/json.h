@@ -0,0 +1,51 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "arena.h"
+#include <stddef.h>
+#include <stdio.h>
+
+#define TINY_JSON_NULL 0
+#define TINY_JSON_FALSE 1
+#define TINY_JSON_TRUE 2
+#define TINY_JSON_NUMBER 3
+#define TINY_JSON_STRING 4
+#define TINY_JSON_ARRAY 5
+#define TINY_JSON_OBJECT 6
+
+#define TINY_JSON_MAX_DEPTH 256 // 超过这个嵌套深度的输入视为错误
+
+/**
+ * 一个 JSON 值，数组的元素与对象的成员都是 child 开始的 sibling 链表
+ */
+struct tiny_json_s
+{
+    int type;
+    const char *key; // 对象成员的名字，以 '\0' 结尾，其余为 NULL
+    const char *string; // 转义序列已经解码，以 '\0' 结尾，但中间也可能含有 '\0'
+    size_t len;
+    double number;
+
+    struct tiny_json_s *child;
+    struct tiny_json_s *sibling;
+};
+
+typedef struct tiny_json_s tiny_json_t;
+
+/**
+ * @brief 解析 s[0, len)，所有节点与字符串都分配在 arena 中
+ * @return 根节点，语法错误时为 NULL
+ */
+tiny_json_t *tiny_json_parse(tiny_arena_t *arena, const char *s, size_t len);
+
+/**
+ * @return 对象 json 中名为 key 的成员，json 不是对象或没有这个成员时为 NULL
+ */
+const tiny_json_t *tiny_json_get(const tiny_json_t *json, const char *key);
+
+/**
+ * @brief 把 s[0, len) 加上引号和必要的转义写入 stream
+ */
+void tiny_json_print_string(FILE *stream, const char *s, size_t len);
+
+#endif // JSON_H
@@ -2,29 +2,81 @@
 #define LEXICAL_H
 
 #include "error.h"
+#include "symbol.h"
+#include <stdint.h>
+
+// token 的种类，由词法分析器确定，语法分析时不必再检查 token 的文本
+#define TINY_TOKEN_NONE 0       // 文件结束、出错或不对应单个 token 的节点
+#define TINY_TOKEN_IDENTIFIER 1 // 标识符与关键字
+#define TINY_TOKEN_INT 2        // 十进制、八进制或十六进制整数
+#define TINY_TOKEN_REAL 3       // 带小数点或指数的实数
+#define TINY_TOKEN_STRING 4
+#define TINY_TOKEN_CHAR 5
+#define TINY_TOKEN_SYMBOL 6
+#define TINY_TOKEN_MALFORMED_NUMBER 7 // 以数字开头但不是合法的数字，由语法分析器报告错误
 
 struct tiny_lex_s {
     const char *code; // 字符串指针
     int cur;
     int len;
-    int line_number;
-    int line_column;
+    tiny_symbol_table_t *symbols; // 如果不为 NULL，标识符在词法分析时即被加入符号表，
+                                  // 含转义序列的字符串解码后保存在其 arena 中
+    tiny_arena_t arena; // 没有符号表时保存解码后的字符串，由 tiny_lex_end 释放
 };
 
+/**
+ * token 只记录在源码中的位置，行列号在需要时通过 tiny_line_index_t 计算
+ */
 struct tiny_lex_token_s {
     int error;
     const char *head, *tail;
     const char *s;
     const char *e;
-    int line_number;
-    int line_column;
+    int kind;   // TINY_TOKEN_*
+    int symbol; // 标识符的 symbol id，其余 token 为 TINY_NO_SYMBOL
+
+    // 字面量在词法分析时解码，之后不再需要重新解析 token 的文本
+    union {
+        int64_t integer; // TINY_TOKEN_INT
+        double real;     // TINY_TOKEN_REAL
+        struct
+        {
+            // 不含转义序列时直接指向源码中引号之间的部分，否则指向解码后以 '\0' 结尾的副本
+            const char *s;
+            int len;
+        } string; // TINY_TOKEN_STRING 与 TINY_TOKEN_CHAR
+    } value;
+};
+
+/**
+ * 源码中每一行的起始偏移，用于将位置换算为行列号
+ */
+struct tiny_line_index_s {
+    const char *code;
+    int len;
+    int base_line;   // code[0] 所在的行号
+    int base_column; // code[0] 之前该行已有的字符数
+    int *starts;
+    int count;
 };
 
 typedef struct tiny_lex_s tiny_lex_t;
 typedef struct tiny_lex_token_s tiny_lex_token_t;
+typedef struct tiny_line_index_s tiny_line_index_t;
 
 void tiny_lex_begin(tiny_lex_t *lex, const char *code);
 
+/**
+ * @brief 释放 lex 自己保存的解码后的字符串，没有符号表时 token 中的字符串此后失效。
+ * 再次调用 tiny_lex_begin 之前也需要调用
+ */
+void tiny_lex_end(tiny_lex_t *lex);
+
+/**
+ * @brief 仅对 code[begin, end) 进行词法分析，用于重新解析源码中的一段
+ */
+void tiny_lex_begin_range(tiny_lex_t *lex, const char *code, int begin, int end);
+
 /**
  * @brief 读取下一个 token
  * @param lex 词法分析器
@@ -33,6 +85,26 @@ void tiny_lex_begin(tiny_lex_t *lex, const char *code);
  */
 int tiny_lex_next(tiny_lex_t *lex, tiny_lex_token_t *token);
 
-tiny_lex_token_t tiny_lex_current_line(tiny_lex_token_t *token);
+/**
+ * @brief 供 tiny_scanner_begin 使用的 reader，ctx 为 tiny_lex_t，token.error 保存 tiny_lex_next 的返回值
+ */
+void tiny_lex_reader(void *ctx, tiny_lex_token_t *token);
+
+/**
+ * @brief 扫描 code[0, len) 中的换行符，建立行起始偏移的索引
+ */
+void tiny_line_index_build(tiny_line_index_t *index, const char *code, int len);
+
+void tiny_line_index_free(tiny_line_index_t *index);
+
+/**
+ * @brief 二分查找 p 所在的行，计算其行号和列号（均从 1 开始）
+ */
+void tiny_line_index_position(const tiny_line_index_t *index, const char *p, int *line_number, int *line_column);
+
+/**
+ * @brief 取得第 line_number 行的内容（不含换行符）
+ */
+tiny_lex_token_t tiny_line_index_line(const tiny_line_index_t *index, int line_number);
 
 #endif // LEXICAL_H
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include "trie.h"
+
+/*
+ * 语言服务器（Language Server Protocol），通过 in 与 out 收发 JSON-RPC 消息，
+ * 每条消息以 "Content-Length: N\r\n\r\n" 开头。支持的请求与通知：
+ *
+ *     initialize, initialized, shutdown, exit
+ *     textDocument/didOpen, didChange（增量或全文）, didClose
+ *     textDocument/publishDiagnostics（服务器发出）
+ *     textDocument/documentSymbol, textDocument/definition
+ *
+ * 文档通过 incremental.h 增量地解析，编辑时只重新解析受影响的顶层 func/vars，语法错误随即发布；
+ * 名字解析与类型检查需要整个文档，在输入停止 TINY_LSP_SEMANTIC_DELAY 毫秒后才进行，其结果再发布一次。
+ */
+
+#define TINY_LSP_SEMANTIC_DELAY 200 // 输入停止多少毫秒后进行语义分析
+#define TINY_LSP_BUF_SIZE 65536     // 输入缓冲区的初始大小
+
+/**
+ * @brief 处理 in 上的消息直到收到 exit 通知或输入结束
+ * @param parsers prepare_parsers 构造的文法
+ * @return 收到 exit 之前已经收到 shutdown 时为 0，否则为 1，可以直接作为进程的退出码
+ */
+int tiny_lsp_serve(struct trie *parsers, int in, int out);
+
+#endif // LSP_H
@@ -0,0 +1,57 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "bytecode.h"
+
+#define TINY_MEMO_SIZE (1 << 16) // 缓存项的个数，必须是 2 的幂
+#define TINY_MEMO_MAX_ARGS 4     // 参数更多的函数不缓存
+
+struct tiny_memo_entry_s
+{
+    int func;       // -1 表示空
+    bool valid;     // 为 false 时调用还没有返回
+    unsigned stamp; // 每次占用时更新，调用返回时据此判断是否已被其他调用占用
+    tiny_value_t args[TINY_MEMO_MAX_ARGS];
+    tiny_value_t result;
+};
+
+/**
+ * 纯函数调用结果的缓存。以函数编号与参数的二进制值为键，直接映射到固定大小的表中，冲突时覆盖旧的结果，
+ * 占用的内存与调用次数无关
+ */
+struct tiny_memo_s
+{
+    const tiny_program_t *program;
+    struct tiny_memo_entry_s *entries;
+    unsigned stamp;
+    long hits, misses;
+};
+
+typedef struct tiny_memo_entry_s tiny_memo_entry_t;
+typedef struct tiny_memo_s tiny_memo_t;
+
+void tiny_memo_init(tiny_memo_t *memo, const tiny_program_t *program);
+
+void tiny_memo_free(tiny_memo_t *memo);
+
+/**
+ * @brief 函数 func 的结果是否可以缓存
+ */
+bool tiny_memo_cacheable(const tiny_memo_t *memo, int func);
+
+/**
+ * @brief 查找 func(args) 的结果
+ *
+ * 命中时把结果写入 result 并返回 -1；否则占用对应的缓存项并返回其编号，
+ * 调用成功返回后用 tiny_memo_store 写入结果，调用出错时不需要处理
+ *
+ * @param stamp 占用缓存项时的标记，传给 tiny_memo_store
+ */
+int tiny_memo_lookup(tiny_memo_t *memo, int func, const tiny_value_t *args, tiny_value_t *result, unsigned *stamp);
+
+/**
+ * @brief 写入缓存项 slot 的结果，该项在调用期间已被其他调用占用时忽略
+ */
+void tiny_memo_store(tiny_memo_t *memo, int slot, unsigned stamp, tiny_value_t result);
+
+#endif // MEMO_H
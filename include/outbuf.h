@@ -0,0 +1,67 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TINY_OUTBUF_SIZE (1 << 20) // 缓冲区大小，写满后才调用一次 write
+
+/**
+ * 用户态的输出缓冲区，直接写文件描述符，不经过 stdio。
+ * 放不下的长数据与缓冲区中已有的内容用一次 writev 一起写出，不再复制
+ */
+struct tiny_outbuf_s
+{
+    int fd;
+    char *data;
+    size_t len;
+    bool error; // 写入失败后不再写出，之后的数据都被丢弃
+};
+
+typedef struct tiny_outbuf_s tiny_outbuf_t;
+
+/**
+ * @brief 创建或截断文件 path 并为其分配缓冲区
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_outbuf_open(tiny_outbuf_t *out, const char *path);
+
+/**
+ * @brief 为已经打开的文件描述符 fd 分配缓冲区，fd 由 tiny_outbuf_close 关闭，失败时也被关闭
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_outbuf_open_fd(tiny_outbuf_t *out, int fd);
+
+/**
+ * @brief 写出缓冲区中的内容并关闭文件
+ * @return 0 或 TINY_IO_ERROR，之前的写入失败也在这里报告
+ */
+int tiny_outbuf_close(tiny_outbuf_t *out);
+
+void tiny_outbuf_flush(tiny_outbuf_t *out);
+
+void tiny_outbuf_write(tiny_outbuf_t *out, const char *s, size_t len);
+
+static inline void tiny_outbuf_putc(tiny_outbuf_t *out, char c)
+{
+    if (out->len == TINY_OUTBUF_SIZE)
+        tiny_outbuf_flush(out);
+    out->data[out->len++] = c;
+}
+
+/**
+ * @brief 写入以 \0 结尾的字符串 s
+ */
+void tiny_outbuf_puts(tiny_outbuf_t *out, const char *s);
+
+/**
+ * @brief 以十进制写入整数 v
+ */
+void tiny_outbuf_int(tiny_outbuf_t *out, long long v);
+
+/**
+ * @brief 按 printf 的格式写入，结果较短时直接格式化到缓冲区中
+ */
+void tiny_outbuf_printf(tiny_outbuf_t *out, const char *format, ...);
+
+#endif // OUTBUF_H
@@ -0,0 +1,60 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include "astbin.h"
+#include "trie.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TINY_CACHE_DEFAULT_LIMIT (256ull << 20) // 缓存目录默认的大小上限，字节
+
+/**
+ * 以源码内容为键的解析结果缓存。每个缓存项是一个 tiny_astbin_write 写入的文件，含 token 表与语法树，
+ * 文件名为源码的 64 位散列，散列的种子是文法指纹，因此文法改变后旧的缓存项不会再被命中。
+ * 命中时只需 mmap 缓存项并与源码比较，不再进行词法与语法分析。
+ *
+ * 多个进程与线程可以同时使用同一个缓存目录：缓存项先写入唯一的临时文件再 rename，读到的总是完整的文件。
+ */
+struct tiny_cache_s
+{
+    const char *dir;
+    uint64_t limit;       // 目录中缓存项的总大小超过上限时，删除最久没有命中的缓存项
+    uint64_t fingerprint; // 文法指纹
+    long hits, misses, stores, evictions;
+};
+
+typedef struct tiny_cache_s tiny_cache_t;
+
+/**
+ * @brief 64 位散列，算法与 XXH64 相同
+ */
+uint64_t tiny_hash64(const void *data, size_t len, uint64_t seed);
+
+/**
+ * @brief 文法 parsers 的指纹，起始产生式 root 与语法树二进制格式的版本也参与计算
+ *
+ * 由所有产生式的名字、结构、token、desc 与错误码计算，
+ * 解析函数以相对于代码中固定位置的偏移参与计算，重新编译后指纹也可能改变。
+ */
+uint64_t tiny_grammar_fingerprint(struct trie *parsers, const char *root);
+
+/**
+ * @brief 使用目录 dir 作为缓存，目录不存在时创建
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_cache_init(tiny_cache_t *cache, const char *dir, uint64_t limit, uint64_t fingerprint);
+
+/**
+ * @brief 查找源码 code[0, len) 的解析结果，命中时映射到 bin 中，由调用者通过 tiny_astbin_close 释放
+ */
+bool tiny_cache_lookup(tiny_cache_t *cache, const char *code, size_t len, tiny_astbin_t *bin);
+
+/**
+ * @brief 保存源码 code[0, len) 的解析结果，之后按大小上限淘汰旧的缓存项
+ * @param tokens 解析时 scanner 缓存的所有 token
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_cache_store(tiny_cache_t *cache, const char *code, size_t len, const tiny_ast_t *root,
+                     tiny_scanner_t *tokens);
+
+#endif // PARSE_CACHE_H
@@ -11,6 +11,8 @@
 #define KLEENE(replica) tiny_make_parser_kleene(replica)
 // 克林闭包，匹配到 terminator，表示 replica*
 #define KLEENE_UNTIL(terminator, replica) tiny_make_parser_kleene_until(terminator, replica)
+// 同 KLEENE_UNTIL；开启错误恢复时 replica 失败则记录错误，由 sync 跳过若干 token 后继续
+#define KLEENE_RECOVER(terminator, replica, sync) tiny_make_parser_kleene_recover(terminator, replica, sync)
 // 或，表示 a | b | c | ... | ...
 #define OR(...) tiny_make_parser_or(PP_NARG(__VA_ARGS__), __VA_ARGS__)
 // 连接，表示 a b c ...
@@ -37,6 +39,15 @@
 #define ERROR(error, parser) tiny_make_parser_error(error, parser)
 // 表示表达式失败时直接导致整个 AST 解析失败
 #define FATAL(error, parser) tiny_make_parser_fatal(error, parser)
+// 惰性匹配 begin ... end 之间的 token（允许嵌套），只记录范围不构造语法树
+#define LAZY(begin, end) tiny_make_parser_lazy(begin, end)
+
+#define TINY_PARSER_MAX_ERRORS 100 // 错误恢复最多记录的错误数，达到后不再恢复，解析在下一个错误处失败
+
+// sync 对跳过的每个 token 的判断
+#define TINY_SYNC_SKIP 0   // 跳过并继续
+#define TINY_SYNC_AFTER 1  // 跳过后停止
+#define TINY_SYNC_BEFORE 2 // 在它之前停止，但第一个 token 总是被跳过，保证每次恢复都有进展
 
 struct tiny_parser_token_seq_s {
     tiny_lex_token_t token;
@@ -54,9 +65,26 @@ struct tiny_parser_result_s {
     const char *required_token;
 };
 
+/**
+ * 错误恢复时记录的一个语法错误，字段与 tiny_parser_result_s 中的相同
+ */
+struct tiny_parser_error_s {
+    int state;
+    tiny_lex_token_t error_token;
+    const char *required_token;
+};
+
+struct tiny_parser_errors_s {
+    struct tiny_parser_error_s *items;
+    int count, size;
+};
+
 struct tiny_parser_ctx_s {
     struct trie *parsers;
     struct tiny_parser_s *current_parser;
+    // 不为 NULL 时开启错误恢复：KLEENE_RECOVER 中失败的部分被替换为 TINY_DESC_ERROR 节点，错误记录在这里，
+    // 解析仍然可能成功，调用者需要检查 count；为 NULL 时在第一个错误处失败
+    struct tiny_parser_errors_s *errors;
 };
 
 struct tiny_parser_s {
@@ -66,16 +94,21 @@ struct tiny_parser_s {
     const char *token;
     int desc;
     int error;
-    bool (*predicate)(const char *s, const char *e);
+    bool (*predicate)(const tiny_lex_token_t *token);
+    int (*sync)(const tiny_lex_token_t *token, int *depth); // 返回 TINY_SYNC_*，depth 从 0 开始，由 sync 自己维护
 };
 
 typedef struct tiny_parser_result_s tiny_parser_result_t;
 typedef struct tiny_parser_ctx_s tiny_parser_ctx_t;
+typedef struct tiny_parser_error_s tiny_parser_error_t;
+typedef struct tiny_parser_errors_s tiny_parser_errors_t;
 typedef struct tiny_parser_s tiny_parser_t;
 
 tiny_parser_t *tiny_make_parser();
 tiny_parser_t *tiny_make_parser_kleene(tiny_parser_t *replica);
 tiny_parser_t *tiny_make_parser_kleene_until(tiny_parser_t *terminator, tiny_parser_t *replica);
+tiny_parser_t *tiny_make_parser_kleene_recover(tiny_parser_t *terminator, tiny_parser_t *replica,
+                                               int (*sync)(const tiny_lex_token_t *token, int *depth));
 tiny_parser_t *tiny_make_parser_or(int n, ...);
 tiny_parser_t *tiny_make_parser_sequence(int n, ...);
 tiny_parser_t *tiny_make_parser_grammar(const char *name);
@@ -83,15 +116,36 @@ tiny_parser_t *tiny_make_parser_optional(tiny_parser_t *optional);
 tiny_parser_t *tiny_make_parser_token(const char *name);
 tiny_parser_t *tiny_make_parser_token_eof();
 tiny_parser_t *tiny_make_parser_token_ignore_case(const char *name);
-tiny_parser_t *tiny_make_parser_token_predicate(bool (*predicate)(const char *, const char *));
+tiny_parser_t *tiny_make_parser_token_predicate(bool (*predicate)(const tiny_lex_token_t *));
 tiny_parser_t *tiny_make_parser_separation(tiny_parser_t *separator, tiny_parser_t *replica);
 tiny_parser_t *tiny_make_parser_eliminate(tiny_parser_t *parser);
 tiny_parser_t *tiny_make_parser_with_desc(int desc, tiny_parser_t *parser);
 tiny_parser_t *tiny_make_parser_error(int error, tiny_parser_t *parser);
 tiny_parser_t *tiny_make_parser_fatal(int error, tiny_parser_t *parser);
+tiny_parser_t *tiny_make_parser_lazy(tiny_parser_t *begin, tiny_parser_t *end);
+
+/**
+ * @brief 释放 parser 及其所有子节点与兄弟节点，token 字符串不释放
+ */
+void tiny_free_parser(tiny_parser_t *parser);
+
+void tiny_parser_errors_init(tiny_parser_errors_t *errors);
+
+void tiny_parser_errors_free(tiny_parser_errors_t *errors);
 
 void tiny_syntax_next_token(tiny_parser_ctx_t *machine, tiny_lex_token_t token);
 
 tiny_parser_result_t tiny_syntax_parse(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner);
 
+/**
+ * @brief 使用产生式 name 解析源码中 [s, e) 范围内的 token，要求恰好匹配到范围末尾
+ * @param parsers 文法
+ * @param symbols 符号表，标识符与解码后的字符串保存在其中，不能为 NULL
+ * @param name 产生式名称
+ * @param token 提供范围所在的源码 head/tail，s 必须是某个 token 的起点
+ * @param tokens 如果不为 NULL，则保存解析过程中读取的 token 链表，由调用者通过 tiny_scanner_end 释放
+ */
+tiny_parser_result_t tiny_syntax_parse_range(struct trie *parsers, tiny_symbol_table_t *symbols, const char *name,
+                                             tiny_lex_token_t token, tiny_scanner_t *tokens);
+
 #endif // PARSER_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef PUSH_PARSER_H
+#define PUSH_PARSER_H
+
+#include "parser.h"
+
+/**
+ * 推送式解析器：源码可以被切分成任意大小的块依次送入，块的边界可以在 token 或注释中间。
+ *
+ * 解析器用一个状态机追踪注释、字符串以及 BEGIN/END 的嵌套层数，每当一个顶层
+ * func/vars 完整到达时就立即解析它，并通过 on_item 交给调用者，随后丢弃已解析的源码。
+ * 因此缓冲区中最多只保留一个顶层 func/vars 与一个输入块。
+ */
+struct tiny_push_parser_s
+{
+    struct trie *parsers;
+    tiny_symbol_table_t *symbols; // 符号表，默认为 NULL，此时使用 own_symbols
+    tiny_symbol_table_t own_symbols; // 每批 func/vars 交给 on_item 之后清空
+    const char *root_name;
+
+    char *buf;
+    int len, size;
+
+    int scan;     // 状态机已经处理到的位置
+    int state;    // 状态机当前所处的状态
+    int quote;    // 字符串或字符的引号
+    bool escape;  // 字符串中上一个字符是否为转义符
+    int depth;    // BEGIN/END 的嵌套层数
+
+    int line_number; // buf 起始处的行号
+    int line_column; // buf 起始处之前该行已读取的字符数
+
+    tiny_parser_result_t result;
+
+    void *arg;
+    void (*on_item)(void *arg, tiny_ast_t *item);
+};
+
+typedef struct tiny_push_parser_s tiny_push_parser_t;
+
+/**
+ * @brief 初始化推送式解析器
+ * @param parsers 文法
+ * @param root_name 解析顶层 func/vars 所用的产生式，"root" 或 "lazy_root"
+ * @param on_item 每解析完一个顶层 func/vars 就调用一次，item 的所有权交给调用者，
+ *                但 item 中的 token 只在回调期间有效
+ */
+void tiny_parse_begin(tiny_push_parser_t *ctx, struct trie *parsers, const char *root_name,
+                      void *arg, void (*on_item)(void *arg, tiny_ast_t *item));
+
+/**
+ * @brief 送入一块源码
+ * @return 0 表示成功，否则为错误码，错误信息保存在 ctx->result 中，此后的输入将被忽略
+ */
+int tiny_parse_feed(tiny_push_parser_t *ctx, const char *bytes, int len);
+
+/**
+ * @brief 表示输入已经结束，解析剩余的源码
+ * @return 0 表示成功，否则为错误码，错误信息保存在 ctx->result 中
+ */
+int tiny_parse_finish(tiny_push_parser_t *ctx);
+
+/**
+ * @brief 为缓冲区中剩余的源码建立行索引，用于计算 ctx->result 中错误的行列号
+ */
+void tiny_parse_line_index(tiny_push_parser_t *ctx, tiny_line_index_t *index);
+
+/**
+ * 释放解析器的缓冲区，此后 ctx->result 中的 token 失效
+ */
+void tiny_parse_end(tiny_push_parser_t *ctx);
+
+#endif // PUSH_PARSER_H
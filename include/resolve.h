@@ -0,0 +1,76 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include "ast.h"
+#include "symbol.h"
+
+#define TINY_DECL_VAR 0     // 全局变量或局部变量
+#define TINY_DECL_PARAM 1   // 函数参数
+#define TINY_DECL_FUNC 2    // 用户定义的函数
+#define TINY_DECL_BUILTIN 3 // 内建函数 READ 和 WRITE
+
+/**
+ * 一个名字的声明
+ */
+struct tiny_decl_s
+{
+    int kind;
+    int symbol;
+    tiny_ast_t *node; // 声明处的 identifier 节点，内建函数为 NULL
+    tiny_ast_t *type; // 变量的类型或函数的返回类型，内建函数为 NULL
+    tiny_ast_t *func; // 参数与局部变量所属的 func 节点，全局的声明为 NULL
+    int scope;        // 所在作用域的编号
+    int index;        // 全局变量、函数各自在全局范围内的编号，参数与局部变量在所属函数内的编号
+    int locals;       // 函数的参数与局部变量总数
+};
+
+/**
+ * 语义错误，token 为出错的名字
+ */
+struct tiny_semantic_error_s
+{
+    int error;
+    tiny_lex_token_t token;
+};
+
+/**
+ * 名字解析的结果
+ */
+struct tiny_resolve_s
+{
+    tiny_symbol_table_t *symbols;
+
+    int node_count;
+    int *decl_of; // 以节点 id 为下标：identifier 与 call 节点所引用的声明，其余节点为 -1
+
+    struct tiny_decl_s *decls;
+    int decl_count, decl_size;
+    int global_count, func_count;
+
+    struct tiny_semantic_error_s *errors;
+    int error_count, error_size;
+};
+
+typedef struct tiny_decl_s tiny_decl_t;
+typedef struct tiny_semantic_error_s tiny_semantic_error_t;
+typedef struct tiny_resolve_s tiny_resolve_t;
+
+/**
+ * @brief 为 root 编号，并将每个名字的使用绑定到其声明
+ *
+ * 全局变量与函数对所有函数可见，因此先声明全部顶层名字再解析函数体；
+ * 函数参数与函数体最外层的 block 共用一个作用域，内层 block 各自开启新的作用域。
+ * 内建函数 READ 与 WRITE 位于全局作用域之外，可以被用户的定义遮蔽。
+ * 惰性函数体不会被解析，需要先调用 tiny_syntax_materialize。
+ *
+ * 每个符号维护一个绑定栈的栈顶，查找名字只需以 symbol id 为下标访问数组，
+ * 与作用域中名字的数量无关。
+ *
+ * @param symbols 符号表，token 中没有 symbol id 的标识符会在此时加入符号表
+ * @return 语义错误的个数
+ */
+int tiny_resolve(tiny_resolve_t *resolve, tiny_symbol_table_t *symbols, tiny_ast_t *root);
+
+void tiny_resolve_free(tiny_resolve_t *resolve);
+
+#endif // RESOLVE_H
@@ -0,0 +1,63 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * 运行时的值，类型由类型检查静态确定，因此不需要保存类型标记
+ */
+union tiny_value_u
+{
+    int64_t i; // INT
+    double r;  // REAL
+};
+
+typedef union tiny_value_u tiny_value_t;
+
+struct tiny_runtime_file_s
+{
+    char *name;
+    FILE *file;
+    bool write;
+};
+
+/**
+ * READ 和 WRITE 使用的运行时：按文件名打开的文件在整个运行期间保持打开，
+ * 多次 READ 同一个文件依次读取其中的数字，多次 WRITE 同一个文件依次写入
+ */
+struct tiny_runtime_s
+{
+    struct tiny_runtime_file_s *files;
+    int count, size;
+};
+
+typedef struct tiny_runtime_s tiny_runtime_t;
+
+void tiny_runtime_init(tiny_runtime_t *rt);
+
+/**
+ * 关闭所有文件
+ */
+void tiny_runtime_free(tiny_runtime_t *rt);
+
+/**
+ * @brief READ(x, name)：从文件 name 中读取下一个数字
+ * @param real 读取 REAL 还是 INT
+ * @return 0 表示成功，否则为 TINY_IO_ERROR
+ */
+int tiny_runtime_read(tiny_runtime_t *rt, const char *name, bool real, tiny_value_t *value);
+
+/**
+ * @brief WRITE(x, name)：向文件 name 写入一个数字，每个数字占一行
+ * @return 0 表示成功，否则为 TINY_IO_ERROR
+ */
+int tiny_runtime_write(tiny_runtime_t *rt, const char *name, bool real, tiny_value_t value);
+
+/**
+ * @brief REAL 转换为 INT：向零取整，超出范围时取最接近的 INT，NaN 转换为 0
+ */
+int64_t tiny_real_to_int(double r);
+
+#endif // RUNTIME_H
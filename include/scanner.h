@@ -15,6 +15,7 @@ struct tiny_scanner_token_s
 struct tiny_scanner_s
 {
     list_entry_t tokens;
+    list_entry_t spare; // tiny_scanner_restart 回收的 token，读取新 token 时优先复用
 
     list_entry_t *cur;
 
@@ -40,4 +41,14 @@ int tiny_scanner_diff(tiny_scanner_t *scanner, tiny_scanner_token_t *token);
 
 void tiny_scanner_begin(tiny_scanner_t *scanner, void *ctx, void (*reader)(void *ctx, tiny_lex_token_t *token));
 
+/**
+ * @brief 回收已缓存的所有 token，之后从 ctx 重新读取，token 的内存留给新的输入复用
+ */
+void tiny_scanner_restart(tiny_scanner_t *scanner, void *ctx);
+
+/**
+ * 释放 scanner 已缓存和回收的所有 token
+ */
+void tiny_scanner_end(tiny_scanner_t *scanner);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 解析服务与客户端之间的协议，通过 Unix 域套接字传输，整数按本机字节序。
+ * 一个连接上可以依次发送多个请求，每个请求得到一个响应：
+ *
+ *     请求  tiny_request_t | name[name_len] | source[source_len]
+ *     响应  tiny_response_t | out[out_len] | err[err_len] | ast[ast_len]
+ *
+ * 没有 TINY_REQUEST_SOURCE 时 name 是服务进程读取的文件路径，source_len 为 0；
+ * 否则源码随请求发送，name 只用于错误信息。
+ * out 与 err 分别是命令行中写入标准输出与标准错误的内容，ast 是 tiny_astbin_write 格式的语法树。
+ */
+
+#define TINY_SERVER_MAGIC 0x594e4954u // "TINY"
+
+#define TINY_REQUEST_SOURCE 1  // 源码随请求发送
+#define TINY_REQUEST_LAZY 2    // 同 --lazy
+#define TINY_REQUEST_SYMBOLS 4 // 同 --symbols
+#define TINY_REQUEST_CHECK 8   // 同 --check
+#define TINY_REQUEST_FOLD 16   // 同 --fold
+#define TINY_REQUEST_AST_BIN 32 // 在响应中返回二进制语法树
+
+#define TINY_REQUEST_MAX_NAME 4096
+#define TINY_REQUEST_MAX_SOURCE (1ull << 32)
+
+struct tiny_request_s
+{
+    uint32_t magic;
+    uint32_t flags; // TINY_REQUEST_*
+    uint32_t name_len;
+    uint32_t reserved;
+    uint64_t source_len;
+};
+
+struct tiny_response_s
+{
+    uint32_t magic;
+    uint32_t failed; // 与命令行的退出码相同，0 表示没有错误
+    uint64_t out_len;
+    uint64_t err_len;
+    uint64_t ast_len;
+};
+
+/**
+ * 一个请求的处理结果，由 tiny_server_handler_s 的 handle 填写，写出后由服务释放
+ */
+struct tiny_server_reply_s
+{
+    bool failed;
+    char *out, *err; // malloc 分配，可以为 NULL
+    size_t out_len, err_len;
+    int ast_fd; // 从开头到末尾的内容作为 ast 返回后关闭，没有时为 -1
+};
+
+/**
+ * 服务处理请求的方式。每个工作线程通过 init 得到自己的 state，在请求之间复用
+ */
+struct tiny_server_handler_s
+{
+    void *(*init)(void *arg);
+    /**
+     * code 为随请求发送的源码，以 '\0' 结尾，可以被修改；没有时为 NULL，name 是要读取的文件路径
+     */
+    void (*handle)(void *state, const struct tiny_request_s *request, const char *name, char *code,
+                   struct tiny_server_reply_s *reply);
+    void (*end)(void *arg, void *state); // 所有工作线程退出后依次在主线程中调用
+    void *arg;
+};
+
+typedef struct tiny_request_s tiny_request_t;
+typedef struct tiny_response_s tiny_response_t;
+typedef struct tiny_server_reply_s tiny_server_reply_t;
+typedef struct tiny_server_handler_s tiny_server_handler_t;
+
+/**
+ * @brief 在 path 上监听，之前残留的套接字文件被删除
+ * @return 套接字，或 TINY_IO_ERROR
+ */
+int tiny_server_listen(const char *path);
+
+/**
+ * @return 连接到 path 的套接字，或 TINY_IO_ERROR
+ */
+int tiny_server_connect(const char *path);
+
+/**
+ * @brief 读满 len 字节
+ * @return 0，TINY_EOF（读到任何数据之前连接已关闭）或 TINY_IO_ERROR
+ */
+int tiny_server_read(int fd, void *data, size_t len);
+
+/**
+ * @brief 写出全部 len 字节
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_server_write(int fd, const void *data, size_t len);
+
+/**
+ * @brief 把文件 file 开头的 len 字节写入 fd，不经过用户态的缓冲区
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_server_sendfile(int fd, int file, uint64_t len);
+
+/**
+ * @brief 在 path 上提供服务，直到收到 SIGINT 或 SIGTERM
+ *
+ * 主线程通过 epoll 等待连接与请求，可读的连接移出 epoll 后放入队列，由工作线程处理其上的一个请求后加回，
+ * 因此空闲的长连接不会占用工作线程。无效的请求与出错的连接直接关闭，不会交给 handler。
+ *
+ * @param nworkers 工作线程数
+ * @return 退出码
+ */
+int tiny_server_run(const char *path, int nworkers, const tiny_server_handler_t *handler);
+
+#endif // SERVER_H
@@ -20,9 +20,15 @@ struct parse_string_literal_result_s
 {
     int ret;
     int column;
+    int len;      // 解码后的字节数
+    bool escaped; // 是否含有转义序列，不含时解码结果与引号之间的源码相同
 };
 
-struct parse_string_literal_result_s parse_string_literal(const char *s, const char *e);
+/**
+ * @brief 检查并解码带引号的字符串或字符字面量 s[0, e)
+ * @param buf 保存解码后的内容，至少 len 字节，为 NULL 时只检查并计算 len
+ */
+struct parse_string_literal_result_s parse_string_literal(const char *s, const char *e, char *buf);
 
 /**
  * 检查 s[0,e) 是否和以 \0 结尾的字符串 t 一致
@@ -0,0 +1,60 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <stdint.h>
+#include "arena.h"
+
+// token 不是标识符，或词法分析时没有提供符号表
+#define TINY_NO_SYMBOL -1
+
+struct tiny_symbol_s
+{
+    const char *name; // 保存在 arena 中，以 '\0' 结尾
+    int len;
+    uint32_t hash;
+};
+
+/**
+ * 符号表：将每个不同的标识符映射为从 0 开始连续编号的 symbol id，
+ * 比较名字只需比较 id，按名字索引的附加信息可以直接用数组保存
+ *
+ * 使用线性探测的开放寻址哈希表，slots 中保存 id + 1，0 表示空槽
+ */
+struct tiny_symbol_table_s
+{
+    tiny_arena_t arena;
+    uint32_t *slots;
+    uint32_t capacity; // slots 的大小，总是 2 的幂
+    struct tiny_symbol_s *symbols;
+    int count, size;
+};
+
+typedef struct tiny_symbol_s tiny_symbol_t;
+typedef struct tiny_symbol_table_s tiny_symbol_table_t;
+
+void tiny_symbol_table_init(tiny_symbol_table_t *table);
+
+void tiny_symbol_table_free(tiny_symbol_table_t *table);
+
+/**
+ * @brief 删除所有符号，保留已分配的内存供下次使用
+ */
+void tiny_symbol_table_reset(tiny_symbol_table_t *table);
+
+/**
+ * @brief 取得 s[0, e) 对应的 symbol id，不存在时新建
+ */
+int tiny_symbol_intern(tiny_symbol_table_t *table, const char *s, const char *e);
+
+/**
+ * @brief 查找 s[0, e) 对应的 symbol id
+ * @return symbol id，不存在时返回 TINY_NO_SYMBOL
+ */
+int tiny_symbol_find(const tiny_symbol_table_t *table, const char *s, const char *e);
+
+/**
+ * @brief 取得 symbol id 对应的名字
+ */
+const char *tiny_symbol_name(const tiny_symbol_table_t *table, int symbol);
+
+#endif // SYMBOL_H
@@ -0,0 +1,224 @@
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+#include "arena.h"
+#include "ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 跨文件的符号索引，记录每个名字的函数定义、全局变量声明与调用位置。索引文件可以直接 mmap 查询：
+ *
+ *     header | file[file_count] | symbol[symbol_count] | postings[postings_size] | strings[string_size]
+ *
+ * 文件按路径排序，符号按名字的字节序排序，符号的编号即其下标，查询时二分查找名字。
+ * 字符串区中的路径与名字之后都有一个 '\0'。
+ * 每个符号的位置按 (kind, file, offset) 排序，依次编码为变长整数：
+ *
+ *     file - 前一个位置的 file | offset | line [| 调用者的符号编号]
+ *
+ * 每种 kind 的第一个位置之前的 file 视为 0；file 与前一个位置相同时 offset 与 line 也是差值。
+ * 文件表保存每个文件内容的散列，重建索引时内容没有改变的文件直接沿用旧索引中的位置，不再解析。
+ * 所有整数都按写入时机器的字节序保存，读取时通过 byte_order 检查。
+ */
+
+#define TINY_INDEX_MAGIC "TINYIDX" // 连同末尾的 \0 共 8 字节
+#define TINY_INDEX_VERSION 1
+#define TINY_INDEX_BYTE_ORDER 0x01020304u
+
+#define TINY_INDEX_FUNC 0 // 函数定义，位置为函数名
+#define TINY_INDEX_VAR 1  // 全局变量声明，位置为变量名
+#define TINY_INDEX_CALL 2 // 调用，位置为被调用的函数名，附带所在函数的符号编号
+#define TINY_INDEX_KINDS 3
+
+struct tiny_index_header_s
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t fingerprint; // 建立索引时的文法指纹，不同时旧索引的内容不能沿用
+    uint64_t file_count;
+    uint64_t file_offset; // 相对文件开头的偏移，8 字节对齐
+    uint64_t symbol_count;
+    uint64_t symbol_offset;
+    uint64_t postings_offset;
+    uint64_t postings_size;
+    uint64_t string_offset;
+    uint64_t string_size;
+};
+
+struct tiny_index_file_s
+{
+    uint64_t hash;        // 文件内容的 tiny_hash64
+    uint64_t path_offset; // 在字符串区中的偏移
+    uint32_t path_len;
+    uint32_t posting_count;
+};
+
+struct tiny_index_symbol_s
+{
+    uint64_t name_offset; // 在字符串区中的偏移
+    uint32_t name_len;
+    uint32_t postings_len;    // 编码后的字节数
+    uint64_t postings_offset; // 在位置区中的偏移
+    uint32_t count[TINY_INDEX_KINDS];
+    uint32_t reserved;
+};
+
+/**
+ * 映射到内存中的索引
+ */
+struct tiny_index_s
+{
+    void *base;
+    size_t size;
+    const struct tiny_index_header_s *header;
+    const struct tiny_index_file_s *files;
+    const struct tiny_index_symbol_s *symbols;
+    const uint8_t *postings;
+    const char *strings;
+};
+
+/**
+ * 一个位置
+ */
+struct tiny_index_posting_s
+{
+    int kind;
+    uint32_t file;
+    uint64_t offset; // 在源文件中的字节偏移
+    uint32_t line;   // 从 1 开始
+    int64_t caller;  // TINY_INDEX_CALL 所在函数的符号编号，其余为 -1
+};
+
+/**
+ * 按顺序解码一个符号某一种 kind 的位置
+ */
+struct tiny_index_iter_s
+{
+    const struct tiny_index_s *index;
+    const uint8_t *p, *e;
+    int kind;
+    uint32_t remaining;
+    bool started;
+    struct tiny_index_posting_s last;
+};
+
+/**
+ * 源文件中的一条记录，名字以 '\0' 结尾
+ */
+struct tiny_index_record_s
+{
+    int kind;
+    const char *name;
+    const char *caller; // TINY_INDEX_CALL 所在的函数，其余为 NULL
+    uint32_t name_len, caller_len;
+    uint64_t offset;
+    uint32_t line;
+};
+
+/**
+ * 一个源文件在索引中的内容，由 tiny_index_collect 从语法树中提取，或由 tiny_index_extract 从旧索引中取出
+ */
+struct tiny_index_source_s
+{
+    const char *path;
+    uint64_t hash;
+    bool known;  // hash 是旧索引中记录的散列
+    bool reused; // 内容与旧索引中相同，记录由 tiny_index_extract 填入
+    tiny_arena_t arena; // 提取的名字
+    struct tiny_index_record_s *records;
+    int count, size;
+};
+
+typedef struct tiny_index_header_s tiny_index_header_t;
+typedef struct tiny_index_file_s tiny_index_file_t;
+typedef struct tiny_index_symbol_s tiny_index_symbol_t;
+typedef struct tiny_index_s tiny_index_t;
+typedef struct tiny_index_posting_s tiny_index_posting_t;
+typedef struct tiny_index_iter_s tiny_index_iter_t;
+typedef struct tiny_index_record_s tiny_index_record_t;
+typedef struct tiny_index_source_s tiny_index_source_t;
+
+void tiny_index_source_init(tiny_index_source_t *source, const char *path);
+
+void tiny_index_source_free(tiny_index_source_t *source);
+
+/**
+ * @brief 提取 root 中所有函数定义、全局变量声明与调用，root 为 "root" 产生式的结果
+ * @param code root 的 token 所指向的源码，用于计算偏移与行号
+ */
+void tiny_index_collect(tiny_index_source_t *source, const tiny_ast_t *root, const char *code, size_t len);
+
+/**
+ * @brief 把 sources[0, count) 写入索引文件 path
+ *
+ * 先写入临时文件再 rename，正在读取旧索引的进程不受影响，旧索引也可以在写入时保持映射。
+ *
+ * @return 0 或 TINY_IO_ERROR
+ */
+int tiny_index_write(const char *path, uint64_t fingerprint, tiny_index_source_t *sources, int count);
+
+/**
+ * @brief 只读映射索引文件 path，只检查文件头与各区的范围，表项中的偏移在访问时检查
+ * @return 0、TINY_IO_ERROR 或 TINY_INVALID_INDEX_FILE
+ */
+int tiny_index_open(tiny_index_t *index, const char *path);
+
+void tiny_index_close(tiny_index_t *index);
+
+/**
+ * @return 名字为 name[0, len) 的符号编号，没有时为 -1
+ */
+int64_t tiny_index_lookup(const tiny_index_t *index, const char *name, size_t len);
+
+/**
+ * @return 路径为 path 的文件编号，没有时为 -1
+ */
+int64_t tiny_index_find_file(const tiny_index_t *index, const char *path);
+
+/**
+ * @brief 符号的名字，以 '\0' 结尾，越界时返回 NULL
+ */
+const char *tiny_index_name(const tiny_index_t *index, uint64_t symbol, size_t *len);
+
+/**
+ * @brief 文件的路径，以 '\0' 结尾，越界时返回 NULL
+ */
+const char *tiny_index_path(const tiny_index_t *index, uint64_t file, size_t *len);
+
+/**
+ * @brief 开始遍历符号 symbol 的 kind 类位置
+ */
+void tiny_index_iter_begin(tiny_index_iter_t *iter, const tiny_index_t *index, uint64_t symbol, int kind);
+
+/**
+ * @return 是否取得了下一个位置，遍历结束或数据损坏时返回 false
+ */
+bool tiny_index_iter_next(tiny_index_iter_t *iter, tiny_index_posting_t *posting);
+
+/**
+ * @brief 一次遍历取出旧索引中所有位置，加入其所在文件的 sources[file]，为 NULL 的文件跳过。
+ * 记录中的名字指向映射的内存，写入新索引之前不能关闭 index
+ */
+void tiny_index_extract(const tiny_index_t *index, tiny_index_source_t **sources);
+
+/**
+ * @brief 解析 sources[0, count)，由 tiny_index_build 的调用者提供。
+ * 内容的散列与 known 时的 hash 相同时只设置 reused，否则记下新的 hash 并由 tiny_index_collect 提取记录；
+ * 出错的文件把 hash 置为 0，下次重新解析
+ * @return 出错的文件数
+ */
+typedef int (*tiny_index_parse_t)(void *arg, tiny_index_source_t *sources, int count);
+
+/**
+ * @brief 由 parse 解析 paths 中的目录与文件，写入符号索引 path。目录递归查找其中的 .tny 文件，
+ * 旧索引存在且 fingerprint 相同时，内容没有改变的文件沿用旧索引中的位置。统计信息写入标准错误
+ * @param fingerprint 文法指纹
+ * @return 出错的文件数，不能写入索引时为 -1
+ */
+int tiny_index_build(const char *path, uint64_t fingerprint, char **paths, int count, tiny_index_parse_t parse,
+                     void *arg);
+
+#endif // SYMINDEX_H
@@ -2,6 +2,7 @@
 #define SYNTAX_DEF_H
 
 #include "trie.h"
+#include "parser.h"
 
 #define TINY_DESC_ELIMINATE 0
 #define TINY_DESC_UNARY 1
@@ -27,7 +28,35 @@
 #define TINY_DESC_EXPR 21
 #define TINY_DESC_MAIN 22
 #define TINY_DESC_CHAR 23
+#define TINY_DESC_LAZY_BLOCK 24
+#define TINY_DESC_CONVERT 25 // 由类型检查插入的类型转换，唯一的子节点为被转换的表达式
+#define TINY_DESC_ERROR 26   // 错误恢复时跳过的 token，token 覆盖其范围，没有子节点
 
 struct trie *prepare_parsers();
 
+/**
+ * @brief 释放 prepare_parsers 构造的文法
+ */
+void free_parsers(struct trie *parsers);
+
+/**
+ * @brief 节点类型在 ast.txt 中的名字，未知的类型为空字符串
+ */
+const char *tiny_desc_name(int desc);
+
+/**
+ * @brief 将惰性模式（lazy_root）下记录的函数体解析为完整的 block 语法树，并就地替换 lazy 节点
+ * @param parsers 文法
+ * @param symbols 符号表，不能为 NULL
+ * @param lazy TINY_DESC_LAZY_BLOCK 节点，如果不是惰性节点则直接返回成功
+ * @return 解析结果，成功时 result.ast 即为 lazy
+ */
+tiny_parser_result_t tiny_syntax_materialize(struct trie *parsers, tiny_symbol_table_t *symbols, tiny_ast_t *lazy);
+
+/**
+ * @brief 对 root 中每个顶层 func 的函数体调用 tiny_syntax_materialize，语义分析之前使用
+ * @return 第一个解析失败的结果，此前的函数体已被替换；全部成功时 result.ast 即为 root
+ */
+tiny_parser_result_t tiny_syntax_materialize_all(struct trie *parsers, tiny_symbol_table_t *symbols, tiny_ast_t *root);
+
 #endif // SYNTAX_DEF_H
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef TINY_H
+#define TINY_H
+
+#include "typecheck.h"
+#include <stddef.h>
+
+/*
+ * 可嵌入的解析接口，编译为 libtiny.a 与 libtiny.so（make lib）。
+ *
+ * 文法只需构造一次，之后可以被任意多个上下文同时只读使用；每个上下文反复解析不同的源码，
+ * 符号表的 arena、scanner 的 token 与源码副本的内存都在两次解析之间复用。
+ * 不使用任何全局状态：不同线程使用各自的上下文即可并行解析，同一个上下文不能被多个线程同时使用。
+ *
+ *     tiny_grammar_t *grammar = tiny_grammar_create();
+ *     tiny_context_t *ctx = tiny_context_create(grammar);
+ *     if (tiny_context_parse(ctx, code, len, TINY_PARSE_CHECK) == 0)
+ *         walk(tiny_context_ast(ctx));
+ *     tiny_context_destroy(ctx);
+ *     tiny_grammar_destroy(grammar);
+ */
+
+#define TINY_PARSE_LAZY 1  // 函数体只记录范围，不构造语法树
+#define TINY_PARSE_CHECK 2 // 解析成功后进行名字解析与类型检查，与 TINY_PARSE_LAZY 同时使用时先解析所有函数体
+#define TINY_PARSE_RECOVER 4 // 跳过出错的语句与声明继续解析，报告所有语法错误并保留含 error 节点的语法树
+
+typedef struct tiny_grammar_s tiny_grammar_t;
+typedef struct tiny_context_s tiny_context_t;
+
+/**
+ * 一个语法错误或语义错误
+ */
+struct tiny_error_s
+{
+    int code;              // error.h 中的错误码
+    int line, column;      // 从 1 开始
+    const char *s, *e;     // 出错的 token 在源码副本中的范围
+    const char *required;  // 语法错误时期望的 token，可能为 NULL
+};
+
+typedef struct tiny_error_s tiny_error_t;
+
+tiny_grammar_t *tiny_grammar_create(void);
+
+/**
+ * @brief 释放文法，使用它的上下文必须已经全部释放
+ */
+void tiny_grammar_destroy(tiny_grammar_t *grammar);
+
+tiny_context_t *tiny_context_create(const tiny_grammar_t *grammar);
+
+void tiny_context_destroy(tiny_context_t *ctx);
+
+/**
+ * @brief 解析 code[0, len)，上一次解析的结果随之失效
+ *
+ * 源码被复制到上下文中，调用返回后 code 可以立即释放；语法树与 token 指向这份副本。
+ *
+ * @param flags TINY_PARSE_* 的组合
+ * @return 0，或第一个错误的错误码
+ */
+int tiny_context_parse(tiny_context_t *ctx, const char *code, size_t len, int flags);
+
+/**
+ * @brief 语法树的根，解析失败时为 NULL；以 TINY_PARSE_RECOVER 解析时可能是含有 TINY_DESC_ERROR 节点的部分语法树
+ */
+const tiny_ast_t *tiny_context_ast(const tiny_context_t *ctx);
+
+/**
+ * @brief 按顺序读取到的所有 token，不含 EOF 与出错的 token
+ */
+const tiny_lex_token_t *tiny_context_tokens(const tiny_context_t *ctx, int *count);
+
+/**
+ * @brief 所有错误，语法错误在前；不使用 TINY_PARSE_RECOVER 时语法错误最多一个
+ */
+const tiny_error_t *tiny_context_errors(const tiny_context_t *ctx, int *count);
+
+/**
+ * @brief 标识符的符号表，token.symbol 是其中的编号
+ */
+const tiny_symbol_table_t *tiny_context_symbols(const tiny_context_t *ctx);
+
+/**
+ * @brief 名字解析与类型检查的结果，只有以 TINY_PARSE_CHECK 解析且没有错误时才不为 NULL
+ */
+const tiny_typecheck_t *tiny_context_typecheck(const tiny_context_t *ctx);
+
+#endif // TINY_H
@@ -0,0 +1,48 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "resolve.h"
+
+#define TINY_TYPE_NONE 0   // 不是表达式
+#define TINY_TYPE_ERROR 1  // 表达式中有错误，已经报告过，不再重复报告
+#define TINY_TYPE_VOID 2   // 内建函数 READ 和 WRITE 的返回值
+#define TINY_TYPE_INT 3
+#define TINY_TYPE_REAL 4
+#define TINY_TYPE_STRING 5 // 字符串与字符字面量
+
+/**
+ * 类型检查的结果
+ */
+struct tiny_typecheck_s
+{
+    tiny_resolve_t *resolve;
+
+    int *types; // 以节点 id 为下标，每个表达式节点的静态类型
+    int type_size;
+
+    struct tiny_semantic_error_s *errors;
+    int error_count, error_size;
+};
+
+typedef struct tiny_typecheck_s tiny_typecheck_t;
+
+/**
+ * @brief 检查 root 中所有表达式的类型，并在 INT 与 REAL 混用处插入 TINY_DESC_CONVERT 节点
+ *
+ * 检查之后每个运算的操作数类型都相同，赋值、参数和返回值的类型都与声明一致，
+ * 执行或生成代码时不需要再根据值的类型分派。
+ * 新插入的节点从 resolve->node_count 开始编号，resolve->decl_of 也随之扩大。
+ *
+ * @param resolve tiny_resolve 对 root 的解析结果
+ * @return 类型错误的个数
+ */
+int tiny_typecheck(tiny_typecheck_t *check, tiny_resolve_t *resolve, tiny_ast_t *root);
+
+void tiny_typecheck_free(tiny_typecheck_t *check);
+
+/**
+ * @brief 变量的类型或函数的返回类型
+ */
+int tiny_decl_type(const tiny_decl_t *decl);
+
+#endif // TYPECHECK_H
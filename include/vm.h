@@ -0,0 +1,67 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+
+#define TINY_VM_STACK_SIZE (1 << 20) // 值栈的大小，以值为单位
+#define TINY_VM_FRAME_SIZE (1 << 16) // 最大调用深度
+
+struct tiny_vm_frame_s
+{
+    const tiny_function_t *func;
+    const tiny_insn_t *pc; // 调用其他函数时保存的返回地址
+    tiny_value_t *base;    // r0 在值栈中的位置
+    int memo_slot;         // 返回时写入结果的缓存项，-1 表示不缓存
+    unsigned memo_stamp;
+};
+
+struct tiny_jit_s;
+struct tiny_memo_s;
+
+/**
+ * 字节码虚拟机。所有函数的寄存器位于一个连续的值栈上，
+ * 调用时被调用者的寄存器紧接在调用者放置参数的位置，不需要复制参数，也不需要为每次调用分配内存
+ */
+struct tiny_vm_s
+{
+    const tiny_program_t *program;
+    tiny_value_t *globals;
+
+    tiny_value_t *stack;
+    int stack_size;
+
+    struct tiny_vm_frame_s *frames;
+    int frame_size;
+
+    tiny_runtime_t runtime;
+
+    struct tiny_jit_s *jit; // 为 NULL 时只解释执行
+    struct tiny_memo_s *memo; // 为 NULL 时不缓存纯函数的结果；可缓存的函数不会被 JIT 编译
+};
+
+typedef struct tiny_vm_frame_s tiny_vm_frame_t;
+typedef struct tiny_vm_s tiny_vm_t;
+
+/**
+ * @brief 为 program 创建虚拟机，全局变量初始化为 0
+ */
+void tiny_vm_init(tiny_vm_t *vm, const tiny_program_t *program);
+
+void tiny_vm_free(tiny_vm_t *vm);
+
+/**
+ * @brief 以 args 为参数调用编号为 func 的函数
+ * @param args 参数，个数为该函数的 nparams
+ * @param result 返回值
+ * @return 0 表示成功，否则为 TINY_DIVISION_BY_ZERO、TINY_STACK_OVERFLOW 或 TINY_IO_ERROR
+ */
+int tiny_vm_call(tiny_vm_t *vm, int func, const tiny_value_t *args, tiny_value_t *result);
+
+/**
+ * @brief 解释执行编号为 func 的函数，其寄存器从 base 开始，参数已经位于 base 起的位置，
+ *        返回值同时写入 base[0]
+ * @param frame 可以使用的第一个调用帧
+ */
+int tiny_vm_execute(tiny_vm_t *vm, int func, tiny_value_t *base, tiny_vm_frame_t *frame, tiny_value_t *result);
+
+#endif // VM_H
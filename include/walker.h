@@ -0,0 +1,41 @@
+#ifndef WALKER_H
+#define WALKER_H
+
+#include "typecheck.h"
+#include "runtime.h"
+
+#define TINY_WALKER_MAX_DEPTH 4096 // 最大调用深度
+
+/**
+ * 直接遍历 AST 的解释器，作为字节码虚拟机的对照
+ */
+struct tiny_walker_s
+{
+    const tiny_typecheck_t *check;
+    tiny_ast_t **funcs; // 以函数声明的 index 为下标的 func 节点
+    tiny_value_t *globals;
+    int depth;
+    tiny_runtime_t runtime;
+};
+
+typedef struct tiny_walker_s tiny_walker_t;
+
+/**
+ * @brief 为通过了类型检查的 root 创建解释器，全局变量初始化为 0
+ */
+void tiny_walker_init(tiny_walker_t *walker, const tiny_typecheck_t *check, tiny_ast_t *root);
+
+void tiny_walker_free(tiny_walker_t *walker);
+
+/**
+ * @brief 以 args 为参数调用编号为 func 的函数
+ * @return 0 表示成功，否则为 TINY_DIVISION_BY_ZERO、TINY_STACK_OVERFLOW 或 TINY_IO_ERROR
+ */
+int tiny_walker_call(tiny_walker_t *walker, int func, const tiny_value_t *args, tiny_value_t *result);
+
+/**
+ * @brief MAIN 函数的编号，没有时为 -1
+ */
+int tiny_walker_main(const tiny_walker_t *walker);
+
+#endif // WALKER_H
@@ -0,0 +1,152 @@
+/*
+ * 符号索引的查询工具：tiny_query INDEX [COMMAND NAME...]
+ *
+ * 索引由 parser --index INDEX DIR... 建立，只读映射后直接查询，不读取源文件。命令：
+ *
+ *     def NAME...    函数定义与全局变量声明的位置
+ *     calls NAME...  调用 NAME 的位置及其所在的函数
+ *     stats          文件数、符号数与各区的大小
+ *
+ * 没有给出命令时从标准输入逐行读取 "COMMAND NAME" 形式的查询，适合连续查询同一个索引。
+ */
+#include "error.h"
+#include "symindex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *kind_names[TINY_INDEX_KINDS] = {"func", "var", "call"};
+
+static void print_postings(const tiny_index_t *index, int64_t symbol, int kind, const char *name)
+{
+    tiny_index_iter_t iter;
+    tiny_index_posting_t posting;
+    tiny_index_iter_begin(&iter, index, symbol, kind);
+    while (tiny_index_iter_next(&iter, &posting))
+    {
+        size_t len;
+        const char *path = tiny_index_path(index, posting.file, &len);
+        printf("%s:%u: ", path ? path : "?", posting.line);
+        if (kind == TINY_INDEX_CALL)
+        {
+            const char *caller = posting.caller >= 0 ? tiny_index_name(index, posting.caller, &len) : NULL;
+            printf("%s called from %s\n", name, caller ? caller : "?");
+        }
+        else
+        {
+            printf("%s %s\n", kind_names[kind], name);
+        }
+    }
+}
+
+/**
+ * @return 是否找到了 name
+ */
+static bool query(const tiny_index_t *index, const char *command, const char *name)
+{
+    int64_t symbol = tiny_index_lookup(index, name, strlen(name));
+    if (symbol < 0)
+    {
+        fprintf(stderr, "%s: not found\n", name);
+        return false;
+    }
+    if (strcmp(command, "def") == 0)
+    {
+        print_postings(index, symbol, TINY_INDEX_FUNC, name);
+        print_postings(index, symbol, TINY_INDEX_VAR, name);
+    }
+    else
+    {
+        print_postings(index, symbol, TINY_INDEX_CALL, name);
+    }
+    return true;
+}
+
+static void print_stats(const tiny_index_t *index)
+{
+    const tiny_index_header_t *header = index->header;
+    uint64_t count[TINY_INDEX_KINDS] = {0};
+    for (uint64_t s = 0; s < header->symbol_count; ++s)
+        for (int kind = 0; kind < TINY_INDEX_KINDS; ++kind)
+            count[kind] += index->symbols[s].count[kind];
+    printf("files: %lu\n", (unsigned long)header->file_count);
+    printf("symbols: %lu\n", (unsigned long)header->symbol_count);
+    printf("postings: %lu func, %lu var, %lu call, %lu bytes\n", (unsigned long)count[TINY_INDEX_FUNC],
+           (unsigned long)count[TINY_INDEX_VAR], (unsigned long)count[TINY_INDEX_CALL],
+           (unsigned long)header->postings_size);
+    printf("size: %lu bytes\n", (unsigned long)index->size);
+}
+
+static bool valid_command(const char *command)
+{
+    return strcmp(command, "def") == 0 || strcmp(command, "calls") == 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s INDEX [def|calls NAME...] [stats]\n", argv[0]);
+        return 2;
+    }
+    tiny_index_t index;
+    int ret = tiny_index_open(&index, argv[1]);
+    if (ret == TINY_INVALID_INDEX_FILE)
+    {
+        fprintf(stderr, "error: %s is not a valid index file\n", argv[1]);
+        return 2;
+    }
+    else if (ret != 0)
+    {
+        perror("cannot open index");
+        return 2;
+    }
+
+    int status = 0;
+    if (argc > 2)
+    {
+        const char *command = argv[2];
+        if (strcmp(command, "stats") == 0)
+        {
+            print_stats(&index);
+        }
+        else if (!valid_command(command))
+        {
+            fprintf(stderr, "unknown command %s\n", command);
+            status = 2;
+        }
+        for (int i = 3; i < argc && status != 2; ++i)
+            if (!query(&index, command, argv[i]))
+                status = 1;
+    }
+    else
+    {
+        char *line = NULL;
+        size_t cap = 0;
+        while (getline(&line, &cap, stdin) > 0)
+        {
+            char *save, *command = strtok_r(line, " \t\r\n", &save);
+            if (!command)
+                continue;
+            if (strcmp(command, "stats") == 0)
+            {
+                print_stats(&index);
+                continue;
+            }
+            if (!valid_command(command))
+            {
+                fprintf(stderr, "unknown command %s\n", command);
+                status = 1;
+                continue;
+            }
+            for (char *name; (name = strtok_r(NULL, " \t\r\n", &save));)
+                if (!query(&index, command, name))
+                    status = 1;
+            // 每个查询的结果立即可见，便于通过管道交互
+            fflush(stdout);
+        }
+        free(line);
+    }
+    tiny_index_close(&index);
+    return status;
+}
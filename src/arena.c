@@ -0,0 +1,76 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+void tiny_arena_init(tiny_arena_t *arena)
+{
+    arena->head = NULL;
+}
+
+void *tiny_arena_alloc(tiny_arena_t *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    struct tiny_arena_block_s *block = arena->head;
+    if (!block || block->used + size > block->size)
+    {
+        // 超过块大小的对象单独分配一块
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(struct tiny_arena_block_s) + block_size);
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *tiny_arena_strndup(tiny_arena_t *arena, const char *s, size_t len)
+{
+    char *str = tiny_arena_alloc(arena, len + 1);
+    memcpy(str, s, len);
+    str[len] = '\0';
+    return str;
+}
+
+void tiny_arena_reset(tiny_arena_t *arena)
+{
+    struct tiny_arena_block_s *largest = NULL;
+    struct tiny_arena_block_s *block = arena->head;
+    while (block)
+    {
+        struct tiny_arena_block_s *next = block->next;
+        if (!largest || block->size > largest->size)
+        {
+            free(largest);
+            largest = block;
+        }
+        else
+        {
+            free(block);
+        }
+        block = next;
+    }
+    if (largest)
+    {
+        largest->next = NULL;
+        largest->used = 0;
+    }
+    arena->head = largest;
+}
+
+void tiny_arena_free(tiny_arena_t *arena)
+{
+    struct tiny_arena_block_s *block = arena->head;
+    while (block)
+    {
+        struct tiny_arena_block_s *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
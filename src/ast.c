@@ -1,4 +1,5 @@
 #include "ast.h"
+#include <stdbool.h>
 #include <stdlib.h>
 
 void tiny_ast_add_child(tiny_ast_t *ast, tiny_ast_t *child)
@@ -11,12 +12,23 @@ void tiny_ast_add_child(tiny_ast_t *ast, tiny_ast_t *child)
     *ptr = child;
 }
 
+tiny_ast_t **tiny_ast_append(tiny_ast_t **tail, tiny_ast_t *child)
+{
+    *tail = child;
+    while (*tail)
+        tail = &((*tail)->sibling);
+    return tail;
+}
+
 tiny_ast_t *tiny_make_ast(int desc)
 {
     tiny_ast_t *ast = malloc(sizeof(tiny_ast_t));
     ast->child = ast->sibling = NULL;
     ast->token.s = ast->token.e = NULL;
+    ast->token.kind = TINY_TOKEN_NONE;
+    ast->token.symbol = TINY_NO_SYMBOL;
     ast->desc = desc;
+    ast->id = 0;
     return ast;
 }
 
@@ -36,3 +48,66 @@ size_t tiny_ast_child_count(tiny_ast_t *ast)
         cnt++;
     return cnt;
 }
+
+int tiny_ast_number(tiny_ast_t *ast, int first)
+{
+    ast->id = first++;
+    for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+        first = tiny_ast_number(cld, first);
+    return first;
+}
+
+const char *tiny_ast_begin(const tiny_ast_t *ast)
+{
+    if (ast->token.s)
+        return ast->token.s;
+    for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+    {
+        const char *s = tiny_ast_begin(cld);
+        if (s)
+            return s;
+    }
+    return NULL;
+}
+
+const char *tiny_ast_end(const tiny_ast_t *ast)
+{
+    if (ast->token.s)
+        return ast->token.e;
+    // 通常最后一个子节点就决定了结束位置，只有它为空节点时才需要遍历所有子节点
+    tiny_ast_t *last = ast->child;
+    while (last && last->sibling)
+        last = last->sibling;
+    const char *e = last ? tiny_ast_end(last) : NULL;
+    if (!e)
+        for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+        {
+            const char *t = tiny_ast_end(cld);
+            if (t)
+                e = t;
+        }
+    return e;
+}
+
+static void move_token(tiny_lex_token_t *token, const char *old_code, const char *new_code, int new_len, int delta)
+{
+    int offset = token->s - old_code + delta;
+    int len = token->e - token->s;
+    // 不含转义序列的字符串字面量直接指向源码，需要一同平移
+    bool in_code = (token->kind == TINY_TOKEN_STRING || token->kind == TINY_TOKEN_CHAR) &&
+                   token->s < token->value.string.s && token->value.string.s < token->e;
+    token->head = new_code;
+    token->tail = new_code + new_len;
+    token->s = new_code + offset;
+    token->e = token->s + len;
+    if (in_code)
+        token->value.string.s = token->s + 1;
+}
+
+void tiny_ast_move(tiny_ast_t *ast, const char *old_code, const char *new_code, int new_len, int delta)
+{
+    if (ast->token.s)
+        move_token(&ast->token, old_code, new_code, new_len, delta);
+    for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+        tiny_ast_move(cld, old_code, new_code, new_len, delta);
+}
@@ -0,0 +1,273 @@
+#include "astbin.h"
+#include "outbuf.h"
+#include "error.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+/**
+ * 按先序把 root 的所有节点放入数组，兄弟节点先于子节点入栈，深度很大的树也不会递归过深
+ * @return 节点数，内存不足时为 -1
+ */
+static int64_t preorder(const tiny_ast_t *root, const tiny_ast_t ***order)
+{
+    int64_t count = 0, size = 1024;
+    int64_t top = 0, stack_size = 1024;
+    const tiny_ast_t **nodes = malloc(size * sizeof(tiny_ast_t *));
+    const tiny_ast_t **stack = malloc(stack_size * sizeof(tiny_ast_t *));
+    if (!nodes || !stack)
+        goto fail;
+
+    stack[top++] = root;
+    while (top > 0)
+    {
+        const tiny_ast_t *ast = stack[--top];
+        if (count == size)
+        {
+            const tiny_ast_t **p = realloc(nodes, (size *= 2) * sizeof(tiny_ast_t *));
+            if (!p)
+                goto fail;
+            nodes = p;
+        }
+        nodes[count++] = ast;
+        if (top + 2 > stack_size)
+        {
+            const tiny_ast_t **p = realloc(stack, (stack_size *= 2) * sizeof(tiny_ast_t *));
+            if (!p)
+                goto fail;
+            stack = p;
+        }
+        // 根的兄弟节点不属于这棵树
+        if (ast->sibling && ast != root)
+            stack[top++] = ast->sibling;
+        if (ast->child)
+            stack[top++] = ast->child;
+    }
+    free(stack);
+    *order = nodes;
+    return count;
+
+fail:
+    free(nodes);
+    free(stack);
+    return -1;
+}
+
+/**
+ * 写入 out 并关闭，out 打开失败时直接返回
+ */
+static int write_astbin(const tiny_ast_t *root, const char *code, size_t len, tiny_scanner_t *tokens,
+                        tiny_outbuf_t *out, int opened)
+{
+    if (opened != 0)
+        return TINY_IO_ERROR;
+
+    const tiny_ast_t **order;
+    int64_t count = preorder(root, &order);
+    if (count < 0 || count > INT32_MAX)
+    {
+        if (count >= 0)
+            free(order);
+        tiny_outbuf_close(out);
+        return TINY_IO_ERROR;
+    }
+
+    // span[i] 为 i 号节点的子树大小，先序中子树是连续的，兄弟节点的下标为 i + span[i]
+    int64_t *span = malloc(count * sizeof(int64_t));
+    if (!span)
+    {
+        free(order);
+        tiny_outbuf_close(out);
+        return TINY_IO_ERROR;
+    }
+    for (int64_t i = count - 1; i >= 0; --i)
+    {
+        span[i] = 1;
+        int64_t j = i + 1;
+        for (const tiny_ast_t *c = order[i]->child; c; c = c->sibling)
+        {
+            span[i] += span[j];
+            j += span[j];
+        }
+    }
+
+    // 不在源码中的 token 文本依次追加在源码之后
+    uint64_t extra = 0;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const tiny_lex_token_t *token = &order[i]->token;
+        if (token->s && (token->s < code || token->e > code + len))
+            extra += token->e - token->s;
+    }
+
+    uint64_t token_count = 0;
+    if (tokens)
+    {
+        for (list_entry_t *entry = list_next(&tokens->tokens); entry != &tokens->tokens; entry = list_next(entry))
+            token_count += le2scannertoken(entry, list)->token.error >= 0;
+    }
+
+    tiny_astbin_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TINY_ASTBIN_MAGIC, sizeof(TINY_ASTBIN_MAGIC));
+    header.version = TINY_ASTBIN_VERSION;
+    header.byte_order = TINY_ASTBIN_BYTE_ORDER;
+    header.node_size = sizeof(tiny_astbin_node_t);
+    header.token_size = sizeof(tiny_astbin_token_t);
+    header.node_count = count;
+    header.node_offset = ALIGN8(sizeof(header));
+    header.token_count = token_count;
+    header.token_offset = header.node_offset + count * sizeof(tiny_astbin_node_t);
+    header.string_offset = header.token_offset + token_count * sizeof(tiny_astbin_token_t);
+    header.string_size = len + extra;
+    header.source_size = len;
+
+    tiny_outbuf_write(out, (const char *)&header, sizeof(header));
+    for (uint64_t i = sizeof(header); i < header.node_offset; ++i)
+        tiny_outbuf_putc(out, 0);
+
+    uint64_t tail = len;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const tiny_ast_t *ast = order[i];
+        tiny_astbin_node_t node;
+        memset(&node, 0, sizeof(node));
+        node.desc = ast->desc;
+        node.kind = ast->token.kind;
+        node.child = ast->child ? (int32_t)(i + 1) : -1;
+        node.sibling = ast->sibling && i > 0 ? (int32_t)(i + span[i]) : -1;
+        if (!ast->token.s)
+        {
+            node.flags = TINY_ASTBIN_NO_TEXT;
+        }
+        else if (ast->token.s >= code && ast->token.e <= code + len)
+        {
+            node.offset = ast->token.s - code;
+            node.length = ast->token.e - ast->token.s;
+        }
+        else
+        {
+            node.offset = tail;
+            node.length = ast->token.e - ast->token.s;
+            tail += node.length;
+        }
+        if (ast->token.kind == TINY_TOKEN_INT)
+            node.value.integer = ast->token.value.integer;
+        else if (ast->token.kind == TINY_TOKEN_REAL)
+            node.value.real = ast->token.value.real;
+        tiny_outbuf_write(out, (const char *)&node, sizeof(node));
+    }
+
+    if (tokens)
+    {
+        for (list_entry_t *entry = list_next(&tokens->tokens); entry != &tokens->tokens; entry = list_next(entry))
+        {
+            const tiny_lex_token_t *token = &le2scannertoken(entry, list)->token;
+            if (token->error < 0)
+                continue;
+            tiny_astbin_token_t record = {
+                .offset = token->s - code,
+                .length = token->e - token->s,
+                .kind = token->kind};
+            tiny_outbuf_write(out, (const char *)&record, sizeof(record));
+        }
+    }
+
+    tiny_outbuf_write(out, code, len);
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const tiny_lex_token_t *token = &order[i]->token;
+        if (token->s && (token->s < code || token->e > code + len))
+            tiny_outbuf_write(out, token->s, token->e - token->s);
+    }
+
+    free(span);
+    free(order);
+    return tiny_outbuf_close(out);
+}
+
+int tiny_astbin_write(const tiny_ast_t *root, const char *code, size_t len, tiny_scanner_t *tokens, const char *path)
+{
+    tiny_outbuf_t out;
+    return write_astbin(root, code, len, tokens, &out, tiny_outbuf_open(&out, path));
+}
+
+int tiny_astbin_write_fd(const tiny_ast_t *root, const char *code, size_t len, tiny_scanner_t *tokens, int fd)
+{
+    // 缓冲区关闭时会关闭文件描述符，写入复制的描述符，fd 保持打开
+    int copy = dup(fd);
+    if (copy < 0)
+        return TINY_IO_ERROR;
+    tiny_outbuf_t out;
+    return write_astbin(root, code, len, tokens, &out, tiny_outbuf_open_fd(&out, copy));
+}
+
+int tiny_astbin_open(tiny_astbin_t *bin, const char *path)
+{
+    memset(bin, 0, sizeof(*bin));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return TINY_IO_ERROR;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return TINY_IO_ERROR;
+    }
+    if ((size_t)st.st_size < sizeof(tiny_astbin_header_t))
+    {
+        close(fd);
+        return TINY_INVALID_AST_FILE;
+    }
+    // 映射在关闭文件后仍然有效
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return TINY_IO_ERROR;
+
+    const tiny_astbin_header_t *header = base;
+    uint64_t size = st.st_size;
+    bool valid = memcmp(header->magic, TINY_ASTBIN_MAGIC, sizeof(TINY_ASTBIN_MAGIC)) == 0 &&
+                 header->version == TINY_ASTBIN_VERSION &&
+                 header->byte_order == TINY_ASTBIN_BYTE_ORDER &&
+                 header->node_size == sizeof(tiny_astbin_node_t) &&
+                 header->token_size == sizeof(tiny_astbin_token_t) &&
+                 header->node_count <= INT32_MAX &&
+                 header->node_offset % 8 == 0 &&
+                 header->node_offset >= sizeof(tiny_astbin_header_t) &&
+                 header->node_offset <= size &&
+                 header->node_count <= (size - header->node_offset) / sizeof(tiny_astbin_node_t) &&
+                 header->token_offset % 8 == 0 &&
+                 header->token_offset >= header->node_offset + header->node_count * sizeof(tiny_astbin_node_t) &&
+                 header->token_offset <= size &&
+                 header->token_count <= (size - header->token_offset) / sizeof(tiny_astbin_token_t) &&
+                 header->string_offset >= header->token_offset + header->token_count * sizeof(tiny_astbin_token_t) &&
+                 header->string_offset <= size &&
+                 header->string_size <= size - header->string_offset &&
+                 header->source_size <= header->string_size;
+    if (!valid)
+    {
+        munmap(base, st.st_size);
+        return TINY_INVALID_AST_FILE;
+    }
+
+    bin->base = base;
+    bin->size = st.st_size;
+    bin->header = header;
+    bin->nodes = (const tiny_astbin_node_t *)((const char *)base + header->node_offset);
+    bin->tokens = (const tiny_astbin_token_t *)((const char *)base + header->token_offset);
+    bin->strings = (const char *)base + header->string_offset;
+    return 0;
+}
+
+void tiny_astbin_close(tiny_astbin_t *bin)
+{
+    if (bin->base)
+        munmap(bin->base, bin->size);
+    memset(bin, 0, sizeof(*bin));
+}
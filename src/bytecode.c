@@ -0,0 +1,534 @@
+#include "bytecode.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct compiler_s
+{
+    const tiny_typecheck_t *check;
+    const tiny_resolve_t *resolve;
+    tiny_program_t *program;
+
+    tiny_function_t *func;
+    int nlocals; // 参数与局部变量占用的寄存器数
+    int top;     // 下一个空闲的临时寄存器
+};
+
+static int emit(struct compiler_s *c, int op, int a, int b, int cc)
+{
+    tiny_function_t *func = c->func;
+    if (func->code_count == func->code_size)
+    {
+        func->code_size = func->code_size ? func->code_size * 2 : 16;
+        func->code = realloc(func->code, func->code_size * sizeof(tiny_insn_t));
+    }
+    tiny_insn_t *insn = &func->code[func->code_count];
+    insn->op = op;
+    insn->a = a;
+    insn->b = b;
+    insn->c = cc;
+    return func->code_count++;
+}
+
+static int emit_bx(struct compiler_s *c, int op, int a, uint32_t bx)
+{
+    int pc = emit(c, op, a, 0, 0);
+    c->func->code[pc].bx = bx;
+    return pc;
+}
+
+static int add_const(struct compiler_s *c, tiny_value_t value)
+{
+    tiny_function_t *func = c->func;
+    for (int i = 0; i < func->const_count; ++i)
+        if (func->consts[i].i == value.i)
+            return i;
+    if (func->const_count == func->const_size)
+    {
+        func->const_size = func->const_size ? func->const_size * 2 : 8;
+        func->consts = realloc(func->consts, func->const_size * sizeof(tiny_value_t));
+    }
+    func->consts[func->const_count] = value;
+    return func->const_count++;
+}
+
+static int add_string(struct compiler_s *c, tiny_ast_t *literal)
+{
+    tiny_program_t *program = c->program;
+    const char *s = literal->token.value.string.s;
+    int len = literal->token.value.string.len;
+    for (int i = 0; i < program->string_count; ++i)
+        if (strncmp(program->strings[i], s, len) == 0 && program->strings[i][len] == '\0')
+            return i;
+    if (program->string_count == program->string_size)
+    {
+        program->string_size = program->string_size ? program->string_size * 2 : 8;
+        program->strings = realloc(program->strings, program->string_size * sizeof(char *));
+    }
+    char *str = malloc(len + 1);
+    memcpy(str, s, len);
+    str[len] = '\0';
+    program->strings[program->string_count] = str;
+    return program->string_count++;
+}
+
+static int alloc_reg(struct compiler_s *c)
+{
+    int reg = c->top++;
+    if (c->top > c->func->nregs)
+        c->func->nregs = c->top;
+    return reg;
+}
+
+/**
+ * 结果应当保存在 dst 中，dst 为 -1 时分配一个临时寄存器
+ */
+static int target(struct compiler_s *c, int dst)
+{
+    return dst >= 0 ? dst : alloc_reg(c);
+}
+
+static int move_to(struct compiler_s *c, int reg, int dst)
+{
+    if (dst >= 0 && dst != reg)
+    {
+        emit(c, TINY_OP_MOV, dst, reg, 0);
+        return dst;
+    }
+    return reg;
+}
+
+static int type_of(struct compiler_s *c, tiny_ast_t *ast)
+{
+    return c->check->types[ast->id];
+}
+
+static const tiny_decl_t *decl_of(struct compiler_s *c, tiny_ast_t *ast)
+{
+    return &c->resolve->decls[c->resolve->decl_of[ast->id]];
+}
+
+/**
+ * 参数和局部变量保存在寄存器中，全局变量保存在全局变量表中
+ */
+static bool is_local(const tiny_decl_t *decl)
+{
+    return decl->func != NULL;
+}
+
+/**
+ * 去掉只有一个子节点的 binary 与 assignment，得到作为赋值目标的 identifier
+ */
+static tiny_ast_t *strip(tiny_ast_t *ast)
+{
+    while ((ast->desc == TINY_DESC_BINARY || ast->desc == TINY_DESC_ASSIGN) && !ast->child->sibling)
+        ast = ast->child;
+    return ast;
+}
+
+static void store(struct compiler_s *c, const tiny_decl_t *decl, int reg)
+{
+    if (is_local(decl))
+        move_to(c, reg, decl->index);
+    else
+        emit_bx(c, TINY_OP_SETG, reg, decl->index);
+}
+
+static int compile_expr(struct compiler_s *c, tiny_ast_t *expr, int dst);
+
+/**
+ * 表达式中是否有赋值或函数调用
+ */
+static bool has_side_effects(tiny_ast_t *ast)
+{
+    if (ast->desc == TINY_DESC_CALL || (ast->desc == TINY_DESC_ASSIGN && ast->child->sibling))
+        return true;
+    for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+        if (has_side_effects(cld))
+            return true;
+    return false;
+}
+
+static int binary_op(tiny_ast_t *op, bool real)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    if (strsecmp(s, e, "+"))
+        return real ? TINY_OP_ADDR : TINY_OP_ADDI;
+    if (strsecmp(s, e, "-"))
+        return real ? TINY_OP_SUBR : TINY_OP_SUBI;
+    if (strsecmp(s, e, "*"))
+        return real ? TINY_OP_MULR : TINY_OP_MULI;
+    if (strsecmp(s, e, "/"))
+        return real ? TINY_OP_DIVR : TINY_OP_DIVI;
+    if (strsecmp(s, e, "=="))
+        return real ? TINY_OP_EQR : TINY_OP_EQI;
+    return real ? TINY_OP_NER : TINY_OP_NEI;
+}
+
+/**
+ * binary -> operand (op operand)*，中间结果保存在临时寄存器中，只有最后一次运算写入 dst，
+ * 因此 dst 为某个操作数所在的寄存器时也不会提前覆盖它
+ */
+static int compile_binary(struct compiler_s *c, tiny_ast_t *node, int dst)
+{
+    if (!node->child->sibling)
+        return compile_expr(c, node->child, dst);
+
+    int mark = c->top;
+    int running = compile_expr(c, node->child, -1);
+    // 左操作数是局部变量时直接使用其寄存器，但右边的操作数可能修改它，此时先复制一份
+    if (running < c->nlocals && has_side_effects(node->child->sibling->sibling))
+    {
+        int copy = alloc_reg(c);
+        emit(c, TINY_OP_MOV, copy, running, 0);
+        running = copy;
+        mark = c->top;
+    }
+    for (tiny_ast_t *op = node->child->sibling; op; op = op->sibling->sibling)
+    {
+        tiny_ast_t *rhs = op->sibling;
+        int reg = compile_expr(c, rhs, -1);
+        c->top = mark;
+        int result = rhs->sibling ? alloc_reg(c) : target(c, dst);
+        emit(c, binary_op(op, type_of(c, rhs) == TINY_TYPE_REAL), result, running, reg);
+        running = result;
+    }
+    return running;
+}
+
+/**
+ * assignment -> target ':=' ... ':=' value，从右到左依次赋值
+ */
+static int compile_assign(struct compiler_s *c, tiny_ast_t *target_node, int dst)
+{
+    if (!target_node->sibling)
+        return compile_expr(c, target_node, dst);
+
+    const tiny_decl_t *decl = decl_of(c, strip(target_node));
+    tiny_ast_t *value = target_node->sibling->sibling;
+    if (is_local(decl))
+    {
+        compile_assign(c, value, decl->index);
+        return move_to(c, decl->index, dst);
+    }
+    int reg = compile_assign(c, value, dst);
+    emit_bx(c, TINY_OP_SETG, reg, decl->index);
+    return reg;
+}
+
+/**
+ * call -> identifier '(' actual_params ')'
+ */
+static int compile_call(struct compiler_s *c, tiny_ast_t *call, int dst)
+{
+    const tiny_decl_t *decl = decl_of(c, call);
+    tiny_ast_t *args = call->child->sibling->sibling;
+    int mark = c->top;
+
+    if (decl->kind == TINY_DECL_BUILTIN) // READ(variable, file) 与 WRITE(expression, file)
+    {
+        tiny_ast_t *value = args->child, *file = strip(value->sibling->sibling);
+        bool real = type_of(c, value) == TINY_TYPE_REAL;
+        int s = add_string(c, file);
+        if (strsecmp(call->child->token.s, call->child->token.e, "READ"))
+        {
+            const tiny_decl_t *var = decl_of(c, strip(value));
+            int reg = is_local(var) ? var->index : alloc_reg(c);
+            emit_bx(c, real ? TINY_OP_READR : TINY_OP_READI, reg, s);
+            store(c, var, reg);
+        }
+        else
+        {
+            int reg = compile_expr(c, value, -1);
+            emit_bx(c, real ? TINY_OP_WRITER : TINY_OP_WRITEI, reg, s);
+        }
+        c->top = mark;
+        return target(c, dst);
+    }
+
+    // 参数依次放在从 base 开始的寄存器中，成为被调用者的 r0, r1, ...
+    int base = c->top;
+    int argc = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+    {
+        c->top = base + argc;
+        compile_expr(c, arg, base + argc);
+        c->top = base + ++argc;
+        if (c->top > c->func->nregs)
+            c->func->nregs = c->top;
+        if (!arg->sibling)
+            break;
+    }
+    c->top = base;
+    alloc_reg(c); // 返回值保存在 r[base] 中
+    emit_bx(c, TINY_OP_CALL, base, decl->index);
+    if (dst >= 0)
+    {
+        c->top = mark;
+        return move_to(c, base, dst);
+    }
+    return base;
+}
+
+static int compile_expr(struct compiler_s *c, tiny_ast_t *expr, int dst)
+{
+    switch (expr->desc)
+    {
+    case TINY_DESC_NUMBER:
+    {
+        int reg = target(c, dst);
+        tiny_value_t value;
+        if (expr->token.kind == TINY_TOKEN_INT)
+        {
+            value.i = expr->token.value.integer;
+            if (value.i >= INT32_MIN && value.i <= INT32_MAX)
+            {
+                emit_bx(c, TINY_OP_LOADI, reg, (uint32_t)(int32_t)value.i);
+                return reg;
+            }
+        }
+        else
+        {
+            value.r = expr->token.value.real;
+        }
+        emit_bx(c, TINY_OP_LOADK, reg, add_const(c, value));
+        return reg;
+    }
+    case TINY_DESC_IDENTIFIER:
+    {
+        const tiny_decl_t *decl = decl_of(c, expr);
+        if (is_local(decl))
+            return move_to(c, decl->index, dst);
+        int reg = target(c, dst);
+        emit_bx(c, TINY_OP_GETG, reg, decl->index);
+        return reg;
+    }
+    case TINY_DESC_CONVERT:
+    {
+        int mark = c->top;
+        int src = compile_expr(c, expr->child, -1);
+        c->top = mark;
+        int reg = target(c, dst);
+        emit(c, type_of(c, expr) == TINY_TYPE_REAL ? TINY_OP_I2R : TINY_OP_R2I, reg, src, 0);
+        return reg;
+    }
+    case TINY_DESC_BINARY:
+        return compile_binary(c, expr, dst);
+    case TINY_DESC_ASSIGN:
+        return compile_assign(c, expr->child, dst);
+    case TINY_DESC_CALL:
+        return compile_call(c, expr, dst);
+    default: // '(' expression ')'
+        return compile_expr(c, expr->child->sibling, dst);
+    }
+}
+
+static void compile_statement(struct compiler_s *c, tiny_ast_t *stmt);
+
+static void compile_block(struct compiler_s *c, tiny_ast_t *block)
+{
+    for (tiny_ast_t *stmt = block->child->sibling->child; stmt; stmt = stmt->sibling)
+        compile_statement(c, stmt);
+}
+
+static void compile_statement(struct compiler_s *c, tiny_ast_t *stmt)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+        compile_block(c, stmt);
+        break;
+    case TINY_DESC_DECL: // 局部变量在声明处初始化为 0
+        for (tiny_ast_t *id = stmt->child->sibling->child; id; id = id->sibling)
+            if (id->desc == TINY_DESC_IDENTIFIER)
+                emit(c, TINY_OP_ZERO, decl_of(c, id)->index, 0, 0);
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+    {
+        tiny_ast_t *cond = stmt->child->sibling->sibling;
+        tiny_ast_t *then = cond->sibling->sibling;
+        int reg = compile_expr(c, cond, -1);
+        int jump = emit_bx(c, type_of(c, cond) == TINY_TYPE_REAL ? TINY_OP_JZR : TINY_OP_JZI, reg, 0);
+        c->top = c->nlocals;
+        compile_statement(c, then);
+        if (then->sibling->child)
+        {
+            int skip = emit_bx(c, TINY_OP_JMP, 0, 0);
+            c->func->code[jump].bx = c->func->code_count;
+            compile_statement(c, then->sibling->child->child->sibling);
+            c->func->code[skip].bx = c->func->code_count;
+        }
+        else
+        {
+            c->func->code[jump].bx = c->func->code_count;
+        }
+        break;
+    }
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+        emit(c, TINY_OP_RET, compile_expr(c, stmt->child->sibling, -1), 0, 0);
+        break;
+    default: // expression ';'
+        compile_expr(c, stmt->child, -1);
+        break;
+    }
+    c->top = c->nlocals;
+}
+
+/**
+ * func -> type ['MAIN'] identifier '(' formal_params ')' block
+ */
+static void compile_func(struct compiler_s *c, tiny_ast_t *func)
+{
+    tiny_ast_t *name = func->child->sibling->sibling;
+    tiny_ast_t *params = name->sibling->sibling;
+    const tiny_decl_t *decl = decl_of(c, name);
+
+    tiny_function_t *f = &c->program->functions[decl->index];
+    f->symbol = decl->symbol;
+    f->ret_type = tiny_decl_type(decl);
+    f->nparams = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+            f->nparams++;
+    f->param_types = malloc((f->nparams + 1) * sizeof(int));
+    int i = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+            f->param_types[i++] = tiny_decl_type(decl_of(c, param->child->sibling));
+
+    c->func = f;
+    c->nlocals = c->top = f->nregs = decl->locals;
+    compile_block(c, params->sibling->sibling);
+    emit(c, TINY_OP_RET0, 0, 0, 0);
+
+    if (func->child->sibling->child) // MAIN
+        c->program->main = decl->index;
+}
+
+/**
+ * 先假定所有函数都是纯函数，去掉直接有副作用的函数，再反复去掉调用了非纯函数的函数，直到不再变化。
+ * 相互递归且没有其他副作用的函数保持为纯函数。
+ */
+static void analyze_purity(tiny_program_t *program)
+{
+    for (int i = 0; i < program->function_count; ++i)
+    {
+        tiny_function_t *f = &program->functions[i];
+        f->pure = true;
+        for (int pc = 0; pc < f->code_count && f->pure; ++pc)
+        {
+            int op = f->code[pc].op;
+            f->pure = op != TINY_OP_GETG && op != TINY_OP_SETG && (op < TINY_OP_READI || op > TINY_OP_WRITER);
+        }
+    }
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (int i = 0; i < program->function_count; ++i)
+        {
+            tiny_function_t *f = &program->functions[i];
+            for (int pc = 0; pc < f->code_count && f->pure; ++pc)
+                if (f->code[pc].op == TINY_OP_CALL && !program->functions[f->code[pc].bx].pure)
+                    f->pure = false, changed = true;
+        }
+    }
+}
+
+int tiny_compile(tiny_program_t *program, const tiny_typecheck_t *check, tiny_ast_t *root)
+{
+    memset(program, 0, sizeof(tiny_program_t));
+    program->main = -1;
+    program->function_count = check->resolve->func_count;
+    program->global_count = check->resolve->global_count;
+    program->functions = calloc(program->function_count > 0 ? program->function_count : 1, sizeof(tiny_function_t));
+
+    struct compiler_s c = {.check = check, .resolve = check->resolve, .program = program};
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+            compile_func(&c, item);
+    // 寄存器超出 16 位的操作数时指令中的编号已被截断，整个程序都不能执行
+    for (int i = 0; i < program->function_count; ++i)
+        if (program->functions[i].nregs > TINY_MAX_REGISTERS)
+            return TINY_TOO_MANY_REGISTERS;
+    analyze_purity(program);
+    return 0;
+}
+
+void tiny_program_free(tiny_program_t *program)
+{
+    for (int i = 0; i < program->function_count; ++i)
+    {
+        free(program->functions[i].param_types);
+        free(program->functions[i].code);
+        free(program->functions[i].consts);
+    }
+    free(program->functions);
+    for (int i = 0; i < program->string_count; ++i)
+        free(program->strings[i]);
+    free(program->strings);
+    memset(program, 0, sizeof(tiny_program_t));
+}
+
+void tiny_program_dump(const tiny_program_t *program, const tiny_symbol_table_t *symbols, FILE *stream)
+{
+#define TINY_OPCODE_NAME(op) #op,
+    static const char *NAMES[] = {TINY_OPCODES(TINY_OPCODE_NAME)};
+#undef TINY_OPCODE_NAME
+
+    for (int i = 0; i < program->function_count; ++i)
+    {
+        const tiny_function_t *f = &program->functions[i];
+        fprintf(stream, "func %s: params %d, registers %d%s%s\n", tiny_symbol_name(symbols, f->symbol),
+                f->nparams, f->nregs, f->pure ? ", pure" : "", i == program->main ? ", main" : "");
+        for (int pc = 0; pc < f->code_count; ++pc)
+        {
+            const tiny_insn_t *insn = &f->code[pc];
+            fprintf(stream, "  %4d  %-6s", pc, NAMES[insn->op]);
+            switch (insn->op)
+            {
+            case TINY_OP_LOADI:
+                fprintf(stream, " r%d, %d\n", insn->a, (int32_t)insn->bx);
+                break;
+            case TINY_OP_LOADK:
+                fprintf(stream, " r%d, k%u\n", insn->a, insn->bx);
+                break;
+            case TINY_OP_GETG:
+            case TINY_OP_SETG:
+                fprintf(stream, " r%d, g%u\n", insn->a, insn->bx);
+                break;
+            case TINY_OP_JMP:
+                fprintf(stream, " %u\n", insn->bx);
+                break;
+            case TINY_OP_JZI:
+            case TINY_OP_JZR:
+                fprintf(stream, " r%d, %u\n", insn->a, insn->bx);
+                break;
+            case TINY_OP_CALL:
+                fprintf(stream, " r%d, %s\n", insn->a, tiny_symbol_name(symbols, program->functions[insn->bx].symbol));
+                break;
+            case TINY_OP_READI:
+            case TINY_OP_READR:
+            case TINY_OP_WRITEI:
+            case TINY_OP_WRITER:
+                fprintf(stream, " r%d, \"%s\"\n", insn->a, program->strings[insn->bx]);
+                break;
+            case TINY_OP_RET0:
+                fprintf(stream, "\n");
+                break;
+            case TINY_OP_ZERO:
+            case TINY_OP_RET:
+                fprintf(stream, " r%d\n", insn->a);
+                break;
+            case TINY_OP_MOV:
+            case TINY_OP_I2R:
+            case TINY_OP_R2I:
+                fprintf(stream, " r%d, r%d\n", insn->a, insn->b);
+                break;
+            default:
+                fprintf(stream, " r%d, r%d, r%d\n", insn->a, insn->b, insn->c);
+                break;
+            }
+        }
+    }
+}
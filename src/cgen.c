@@ -0,0 +1,457 @@
+#include "cgen.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct cgen_s
+{
+    const tiny_typecheck_t *check;
+    const tiny_resolve_t *resolve;
+    FILE *out;
+    int temp;   // 当前函数中下一个临时变量的编号
+    int indent;
+};
+
+/**
+ * 生成的源码的开头：INT 运算与 READ、WRITE 的包装
+ */
+static const char *PRELUDE =
+    "#include <stdbool.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <math.h>\n"
+    "#include \"runtime.h\"\n"
+    "\n"
+    "static tiny_runtime_t tiny_c_runtime;\n"
+    "\n"
+    "static void tiny_c_fail(const char *message)\n"
+    "{\n"
+    "    fprintf(stderr, \"runtime error: %s\\n\", message);\n"
+    "    tiny_runtime_free(&tiny_c_runtime);\n"
+    "    exit(1);\n"
+    "}\n"
+    "\n"
+    "static inline int64_t tiny_c_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }\n"
+    "static inline int64_t tiny_c_sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }\n"
+    "static inline int64_t tiny_c_mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }\n"
+    "\n"
+    "static inline int64_t tiny_c_div(int64_t a, int64_t b)\n"
+    "{\n"
+    "    if (b == 0)\n"
+    "        tiny_c_fail(\"division by zero\");\n"
+    "    return b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static void tiny_c_read(const char *name, bool real, tiny_value_t *value)\n"
+    "{\n"
+    "    if (tiny_runtime_read(&tiny_c_runtime, name, real, value))\n"
+    "        tiny_c_fail(\"cannot read or write file\");\n"
+    "}\n"
+    "\n"
+    "static void tiny_c_write(const char *name, bool real, tiny_value_t value)\n"
+    "{\n"
+    "    if (tiny_runtime_write(&tiny_c_runtime, name, real, value))\n"
+    "        tiny_c_fail(\"cannot read or write file\");\n"
+    "}\n";
+
+static int type_of(struct cgen_s *c, tiny_ast_t *ast)
+{
+    return c->check->types[ast->id];
+}
+
+static const tiny_decl_t *decl_of(struct cgen_s *c, tiny_ast_t *ast)
+{
+    return &c->resolve->decls[c->resolve->decl_of[ast->id]];
+}
+
+static const char *ctype(int type)
+{
+    return type == TINY_TYPE_REAL ? "double" : "int64_t";
+}
+
+static tiny_ast_t *strip(tiny_ast_t *ast)
+{
+    while ((ast->desc == TINY_DESC_BINARY || ast->desc == TINY_DESC_ASSIGN) && !ast->child->sibling)
+        ast = ast->child;
+    return ast;
+}
+
+/**
+ * 输出声明的 C 名字。函数与全局变量加前缀以避开 C 的关键字，
+ * 参数与局部变量再加上编号，内层 block 中遮蔽外层的同名变量不会冲突
+ */
+static void print_name(struct cgen_s *c, const tiny_decl_t *decl)
+{
+    const char *name = tiny_symbol_name(c->resolve->symbols, decl->symbol);
+    if (decl->kind == TINY_DECL_FUNC)
+        fprintf(c->out, "f_%s", name);
+    else if (decl->func)
+        fprintf(c->out, "v%d_%s", decl->index, name);
+    else
+        fprintf(c->out, "g_%s", name);
+}
+
+static void print_indent(struct cgen_s *c)
+{
+    for (int i = 0; i < c->indent; ++i)
+        fputs("    ", c->out);
+}
+
+/**
+ * 开始一行 "T tN = "，返回 N
+ */
+static int begin_temp(struct cgen_s *c, int type)
+{
+    print_indent(c);
+    fprintf(c->out, "%s t%d = ", ctype(type), c->temp);
+    return c->temp++;
+}
+
+static void print_string(struct cgen_s *c, tiny_ast_t *literal)
+{
+    int len = literal->token.value.string.len;
+    const char *buf = literal->token.value.string.s;
+
+    fputc('"', c->out);
+    for (int i = 0; i < len; ++i)
+    {
+        unsigned char ch = buf[i];
+        if (ch == '"' || ch == '\\')
+            fprintf(c->out, "\\%c", ch);
+        else if (ch >= 0x20 && ch < 0x7F && ch != '?')
+            fputc(ch, c->out);
+        else
+            fprintf(c->out, "\\%03o", ch);
+    }
+    fputc('"', c->out);
+}
+
+static void print_real(struct cgen_s *c, double r)
+{
+    if (isinf(r))
+    {
+        fputs("HUGE_VAL", c->out);
+        return;
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.17g", r);
+    fputs(buf, c->out);
+    if (!strpbrk(buf, ".e"))
+        fputs(".0", c->out);
+}
+
+static int gen_expr(struct cgen_s *c, tiny_ast_t *expr);
+
+static int gen_binary(struct cgen_s *c, tiny_ast_t *node)
+{
+    int running = gen_expr(c, node->child);
+    for (tiny_ast_t *op = node->child->sibling; op; op = op->sibling->sibling)
+    {
+        tiny_ast_t *rhs = op->sibling;
+        int value = gen_expr(c, rhs);
+        const char *s = op->token.s, *e = op->token.e;
+        bool compare = strsecmp(s, e, "==") || strsecmp(s, e, "!=");
+        int type = compare ? TINY_TYPE_INT : type_of(c, rhs);
+        int result = begin_temp(c, type);
+        if (compare || type_of(c, rhs) == TINY_TYPE_REAL)
+            fprintf(c->out, "t%d %.*s t%d;\n", running, (int)(e - s), s, value);
+        else
+        {
+            const char *func = strsecmp(s, e, "+")   ? "add"
+                               : strsecmp(s, e, "-") ? "sub"
+                               : strsecmp(s, e, "*") ? "mul"
+                                                     : "div";
+            fprintf(c->out, "tiny_c_%s(t%d, t%d);\n", func, running, value);
+        }
+        running = result;
+    }
+    return running;
+}
+
+/**
+ * assignment -> target ':=' ... ':=' value，从右到左依次赋值，结果为最右边的值
+ */
+static int gen_assign(struct cgen_s *c, tiny_ast_t *target)
+{
+    if (!target->sibling)
+        return gen_expr(c, target);
+    int value = gen_assign(c, target->sibling->sibling);
+    print_indent(c);
+    print_name(c, decl_of(c, strip(target)));
+    fprintf(c->out, " = t%d;\n", value);
+    return value;
+}
+
+static int gen_call(struct cgen_s *c, tiny_ast_t *call)
+{
+    const tiny_decl_t *decl = decl_of(c, call);
+    tiny_ast_t *args = call->child->sibling->sibling;
+
+    if (decl->kind == TINY_DECL_BUILTIN) // READ(variable, file) 与 WRITE(expression, file)
+    {
+        tiny_ast_t *value = args->child, *file = strip(value->sibling->sibling);
+        bool real = type_of(c, value) == TINY_TYPE_REAL;
+        if (strsecmp(call->child->token.s, call->child->token.e, "READ"))
+        {
+            int temp = c->temp++;
+            print_indent(c);
+            fprintf(c->out, "tiny_value_t t%d;\n", temp);
+            print_indent(c);
+            fputs("tiny_c_read(", c->out);
+            print_string(c, file);
+            fprintf(c->out, ", %s, &t%d);\n", real ? "true" : "false", temp);
+            print_indent(c);
+            print_name(c, decl_of(c, strip(value)));
+            fprintf(c->out, " = t%d.%c;\n", temp, real ? 'r' : 'i');
+        }
+        else
+        {
+            int temp = gen_expr(c, value);
+            print_indent(c);
+            fputs("tiny_c_write(", c->out);
+            print_string(c, file);
+            fprintf(c->out, ", %s, (tiny_value_t){.%c = t%d});\n", real ? "true" : "false", real ? 'r' : 'i', temp);
+        }
+        return -1;
+    }
+
+    int argc = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+        if (argc++, !arg->sibling)
+            break;
+    // 参数求值时还会分配其他临时变量，各参数的编号不连续
+    int *temps = malloc((argc + 1) * sizeof(int));
+    int i = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+        if (temps[i++] = gen_expr(c, arg), !arg->sibling)
+            break;
+
+    int result = begin_temp(c, tiny_decl_type(decl));
+    print_name(c, decl);
+    fputc('(', c->out);
+    for (i = 0; i < argc; ++i)
+        fprintf(c->out, i ? ", t%d" : "t%d", temps[i]);
+    fputs(");\n", c->out);
+    free(temps);
+    return result;
+}
+
+/**
+ * 生成计算 expr 的语句，返回保存结果的临时变量编号，READ 与 WRITE 没有结果，返回 -1
+ */
+static int gen_expr(struct cgen_s *c, tiny_ast_t *expr)
+{
+    int temp;
+    switch (expr->desc)
+    {
+    case TINY_DESC_NUMBER:
+        temp = begin_temp(c, type_of(c, expr));
+        if (expr->token.kind == TINY_TOKEN_INT)
+            fprintf(c->out, "INT64_C(%" PRId64 ")", expr->token.value.integer);
+        else
+            print_real(c, expr->token.value.real);
+        fputs(";\n", c->out);
+        return temp;
+    case TINY_DESC_IDENTIFIER:
+        temp = begin_temp(c, type_of(c, expr));
+        print_name(c, decl_of(c, expr));
+        fputs(";\n", c->out);
+        return temp;
+    case TINY_DESC_CONVERT:
+    {
+        int value = gen_expr(c, expr->child);
+        temp = begin_temp(c, type_of(c, expr));
+        if (type_of(c, expr) == TINY_TYPE_REAL)
+            fprintf(c->out, "(double)t%d;\n", value);
+        else
+            fprintf(c->out, "tiny_real_to_int(t%d);\n", value);
+        return temp;
+    }
+    case TINY_DESC_BINARY:
+        return gen_binary(c, expr);
+    case TINY_DESC_ASSIGN:
+        return gen_assign(c, expr->child);
+    case TINY_DESC_CALL:
+        return gen_call(c, expr);
+    default: // '(' expression ')'
+        return gen_expr(c, expr->child->sibling);
+    }
+}
+
+static void gen_statement(struct cgen_s *c, tiny_ast_t *stmt);
+
+static void gen_block(struct cgen_s *c, tiny_ast_t *block)
+{
+    for (tiny_ast_t *stmt = block->child->sibling->child; stmt; stmt = stmt->sibling)
+        gen_statement(c, stmt);
+}
+
+/**
+ * 作为 if 分支的语句总是放在花括号中
+ */
+static void gen_branch(struct cgen_s *c, tiny_ast_t *stmt)
+{
+    fputs("{\n", c->out);
+    c->indent++;
+    gen_statement(c, stmt);
+    c->indent--;
+    print_indent(c);
+    fputc('}', c->out);
+}
+
+static void gen_statement(struct cgen_s *c, tiny_ast_t *stmt)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+        gen_block(c, stmt);
+        break;
+    case TINY_DESC_DECL: // 局部变量在声明处初始化为 0
+        for (tiny_ast_t *id = stmt->child->sibling->child; id; id = id->sibling)
+            if (id->desc == TINY_DESC_IDENTIFIER)
+            {
+                print_indent(c);
+                print_name(c, decl_of(c, id));
+                fputs(" = 0;\n", c->out);
+            }
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+    {
+        tiny_ast_t *cond = stmt->child->sibling->sibling;
+        tiny_ast_t *then = cond->sibling->sibling;
+        int value = gen_expr(c, cond);
+        print_indent(c);
+        fprintf(c->out, "if (t%d != 0)\n", value);
+        print_indent(c);
+        gen_branch(c, then);
+        if (then->sibling->child)
+        {
+            fputs("\n", c->out);
+            print_indent(c);
+            fputs("else\n", c->out);
+            print_indent(c);
+            gen_branch(c, then->sibling->child->child->sibling);
+        }
+        fputs("\n", c->out);
+        break;
+    }
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+    {
+        int value = gen_expr(c, stmt->child->sibling);
+        print_indent(c);
+        fprintf(c->out, "return t%d;\n", value);
+        break;
+    }
+    default: // expression ';'
+    {
+        int value = gen_expr(c, stmt->child);
+        if (value >= 0)
+        {
+            print_indent(c);
+            fprintf(c->out, "(void)t%d;\n", value);
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * 输出函数头 "static T f_name(T1 v0_a, T2 v1_b)"
+ */
+static void print_signature(struct cgen_s *c, tiny_ast_t *func)
+{
+    tiny_ast_t *name = func->child->sibling->sibling;
+    tiny_ast_t *params = name->sibling->sibling;
+    const tiny_decl_t *decl = decl_of(c, name);
+    fprintf(c->out, "static %s ", ctype(tiny_decl_type(decl)));
+    print_name(c, decl);
+    fputc('(', c->out);
+    bool first = true;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+        {
+            const tiny_decl_t *p = decl_of(c, param->child->sibling);
+            fprintf(c->out, first ? "%s " : ", %s ", ctype(tiny_decl_type(p)));
+            print_name(c, p);
+            first = false;
+        }
+    if (first)
+        fputs("void", c->out);
+    fputc(')', c->out);
+}
+
+static void gen_func(struct cgen_s *c, tiny_ast_t *func)
+{
+    print_signature(c, func);
+    fputs("\n{\n", c->out);
+    c->indent = 1;
+    c->temp = 0;
+
+    // 局部变量都在函数开头定义，编号保证了它们的名字互不相同
+    for (int i = 0; i < c->resolve->decl_count; ++i)
+    {
+        const tiny_decl_t *decl = &c->resolve->decls[i];
+        if (decl->kind == TINY_DECL_VAR && decl->func == func)
+        {
+            print_indent(c);
+            fprintf(c->out, "%s ", ctype(tiny_decl_type(decl)));
+            print_name(c, decl);
+            fputs(" = 0;\n", c->out);
+        }
+    }
+
+    tiny_ast_t *params = func->child->sibling->sibling->sibling->sibling;
+    gen_block(c, params->sibling->sibling);
+    fputs("    return 0;\n}\n\n", c->out);
+}
+
+void tiny_emit_c(const tiny_typecheck_t *check, tiny_ast_t *root, FILE *out)
+{
+    struct cgen_s c = {.check = check, .resolve = check->resolve, .out = out};
+    fputs(PRELUDE, out);
+    fputc('\n', out);
+
+    // vars -> type identifier (',' identifier)* ';'
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_DECL)
+            for (tiny_ast_t *id = item->child->sibling->child; id; id = id->sibling)
+                if (id->desc == TINY_DESC_IDENTIFIER)
+                {
+                    fprintf(out, "static %s ", ctype(tiny_decl_type(decl_of(&c, id))));
+                    print_name(&c, decl_of(&c, id));
+                    fputs(";\n", out);
+                }
+    fputc('\n', out);
+
+    // 函数可以在定义之前调用，先声明所有函数
+    const tiny_decl_t *main_decl = NULL;
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+        {
+            print_signature(&c, item);
+            fputs(";\n", out);
+            if (item->child->sibling->child)
+                main_decl = decl_of(&c, item->child->sibling->sibling);
+        }
+    fputc('\n', out);
+
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+            gen_func(&c, item);
+
+    fputs("int main(void)\n{\n", out);
+    if (main_decl)
+    {
+        fputs("    tiny_runtime_init(&tiny_c_runtime);\n    ", out);
+        print_name(&c, main_decl);
+        fputs("();\n    tiny_runtime_free(&tiny_c_runtime);\n    return 0;\n}\n", out);
+    }
+    else
+    {
+        fputs("    fprintf(stderr, \"error: no MAIN function\\n\");\n    return 1;\n}\n", out);
+    }
+}
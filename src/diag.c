@@ -0,0 +1,212 @@
+#include "diag.h"
+#include "error.h"
+#include "json.h"
+#include <stdlib.h>
+#include <string.h>
+
+void tiny_diags_init(tiny_diags_t *diags)
+{
+    diags->items = NULL;
+    diags->count = diags->size = 0;
+}
+
+void tiny_diags_free(tiny_diags_t *diags)
+{
+    free(diags->items);
+    tiny_diags_init(diags);
+}
+
+void tiny_diags_reset(tiny_diags_t *diags)
+{
+    diags->count = 0;
+}
+
+void tiny_diags_add(tiny_diags_t *diags, int code, int start, int end, const char *arg, int arg_len)
+{
+    if (diags->count == diags->size)
+    {
+        diags->size = diags->size ? diags->size * 2 : 16;
+        diags->items = realloc(diags->items, diags->size * sizeof(tiny_diag_t));
+    }
+    tiny_diag_t *diag = &diags->items[diags->count];
+    diag->code = code;
+    diag->start = start;
+    diag->end = end < start ? start : end;
+    diag->arg = arg ? arg : "";
+    diag->arg_len = arg ? arg_len : 0;
+    diag->seq = diags->count++;
+}
+
+void tiny_diags_add_token(tiny_diags_t *diags, int code, const char *base, const tiny_lex_token_t *token,
+                          const char *required_token)
+{
+    // 词法错误的位置由 e 表示，语法错误的位置为 token 的起点
+    int start = (token->error ? token->e : token->s) - base;
+    int end = token->e - base;
+    if (code == TINY_UNEXPECTED_TOKEN)
+        tiny_diags_add(diags, code, start, end, required_token, required_token ? strlen(required_token) : 0);
+    else
+        tiny_diags_add(diags, code, start, end, token->s, token->e - token->s);
+}
+
+static int compare_diags(const void *a, const void *b)
+{
+    const tiny_diag_t *x = a, *y = b;
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+void tiny_diags_sort(tiny_diags_t *diags)
+{
+    qsort(diags->items, diags->count, sizeof(tiny_diag_t), compare_diags);
+}
+
+/**
+ * 从第 *cursor 行开始向后查找 offset 所在的行；offset 在 *cursor 行之前时退回二分查找
+ */
+static void locate(const tiny_line_index_t *lines, int offset, int *cursor, int *line_number, int *line_column)
+{
+    int l = *cursor;
+    if (lines->starts[l] > offset)
+    {
+        tiny_line_index_position(lines, lines->code + offset, line_number, line_column);
+        *cursor = *line_number - lines->base_line;
+        return;
+    }
+    while (l + 1 < lines->count && lines->starts[l + 1] <= offset)
+        ++l;
+    *cursor = l;
+    *line_number = lines->base_line + l;
+    *line_column = offset - lines->starts[l] + 1 + (l == 0 ? lines->base_column : 0);
+}
+
+/**
+ * 输出的缓冲区，超过 TINY_DIAG_FLUSH_SIZE 时才写入 stream。
+ * stream 为 NULL 时只在内存中拼接，从不写出
+ */
+struct writer_s
+{
+    FILE *stream;
+    char *data;
+    size_t len, size;
+};
+
+static void writer_flush(struct writer_s *w)
+{
+    if (w->len > 0 && w->stream)
+        fwrite(w->data, sizeof(char), w->len, w->stream);
+    w->len = 0;
+}
+
+static char *writer_reserve(struct writer_s *w, size_t len)
+{
+    if (w->stream && w->len >= TINY_DIAG_FLUSH_SIZE)
+        writer_flush(w);
+    if (w->len + len > w->size)
+    {
+        while (w->len + len > w->size)
+            w->size = w->size ? w->size * 2 : TINY_DIAG_FLUSH_SIZE;
+        w->data = realloc(w->data, w->size);
+    }
+    char *p = w->data + w->len;
+    w->len += len;
+    return p;
+}
+
+static void writer_write(struct writer_s *w, const char *s, size_t len)
+{
+    memcpy(writer_reserve(w, len), s, len);
+}
+
+static void writer_puts(struct writer_s *w, const char *s)
+{
+    writer_write(w, s, strlen(s));
+}
+
+/**
+ * 把 diag 的消息写入 w，格式中只有 %s 一种转换
+ */
+static void write_message(struct writer_s *w, const tiny_diag_t *diag)
+{
+    const char *format = tiny_error_format(diag->code);
+    if (!format)
+    {
+        char message[32];
+        writer_write(w, message, snprintf(message, sizeof(message), "error %d", diag->code));
+        return;
+    }
+    const char *arg = strstr(format, "%s");
+    if (!arg)
+    {
+        writer_puts(w, format);
+        return;
+    }
+    writer_write(w, format, arg - format);
+    writer_write(w, diag->arg, diag->arg_len);
+    writer_puts(w, arg + 2);
+}
+
+void tiny_diags_render(const tiny_diags_t *diags, const tiny_line_index_t *lines, const char *name, FILE *out)
+{
+    struct writer_s w = {out, NULL, 0, 0};
+    int cursor = 0;
+    char number[64];
+    for (int i = 0; i < diags->count; ++i)
+    {
+        const tiny_diag_t *diag = &diags->items[i];
+        int line_number, line_column;
+        locate(lines, diag->start, &cursor, &line_number, &line_column);
+        if (name)
+        {
+            writer_puts(&w, name);
+            writer_write(&w, ":", 1);
+        }
+        writer_write(&w, number, snprintf(number, sizeof(number), "%d:%d: error: ", line_number, line_column));
+        write_message(&w, diag);
+        writer_write(&w, "\n", 1);
+        tiny_lex_token_t line = tiny_line_index_line(lines, line_number);
+        writer_write(&w, line.s, line.e - line.s);
+        writer_write(&w, "\n", 1);
+        if (line_column > 1)
+            memset(writer_reserve(&w, line_column - 1), ' ', line_column - 1);
+        writer_write(&w, "^\n", 2);
+    }
+    writer_flush(&w);
+    free(w.data);
+}
+
+void tiny_diags_render_json(const tiny_diags_t *diags, const tiny_line_index_t *lines, const char *name, FILE *out)
+{
+    // 转义由 tiny_json_print_string 完成，先写入内存再一次写出
+    char *data = NULL;
+    size_t len = 0;
+    FILE *stream = open_memstream(&data, &len);
+    struct writer_s message = {NULL, NULL, 0, 0};
+    int cursor = 0;
+    for (int i = 0; i < diags->count; ++i)
+    {
+        const tiny_diag_t *diag = &diags->items[i];
+        int line_number, line_column, end_line, end_column;
+        locate(lines, diag->start, &cursor, &line_number, &line_column);
+        int end_cursor = cursor;
+        locate(lines, diag->end, &end_cursor, &end_line, &end_column);
+
+        fputs("{\"file\":", stream);
+        if (name)
+            tiny_json_print_string(stream, name, strlen(name));
+        else
+            fputs("null", stream);
+        fprintf(stream, ",\"line\":%d,\"column\":%d,\"end_line\":%d,\"end_column\":%d,\"code\":%d", line_number,
+                line_column, end_line, end_column, diag->code);
+        fputs(",\"severity\":\"error\",\"message\":", stream);
+        message.len = 0;
+        write_message(&message, diag);
+        tiny_json_print_string(stream, message.data, message.len);
+        fputs("}\n", stream);
+    }
+    fclose(stream);
+    fwrite(data, sizeof(char), len, out);
+    free(data);
+    free(message.data);
+}
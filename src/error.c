@@ -0,0 +1,59 @@
+#include "error.h"
+#include <stddef.h>
+
+const char *tiny_error_format(int code)
+{
+    switch (code)
+    {
+    case TINY_UNEXPECTED_EOF:
+        return "Unexpected EOF";
+    case TINY_UNEXPECTED_TOKEN:
+        return "Unexpected token, required \"%s\"";
+    case TINY_INVALID_STRING:
+        return "Invalid string literal";
+    case TINY_INVALID_STRING_X_NO_FOLLOWING_HEX_DIGITS:
+        return "\\x used with no following hex digits";
+    case TINY_INVALID_NUMBER:
+        return "Invalid number literal";
+    case TINY_EXPECT_SEMICOLON:
+        return "Expect ';', but found '%s'";
+    case TINY_EXPECT_LEFT_PARENTHESIS:
+        return "Expect '(', but found '%s'";
+    case TINY_EXPECT_RIGHT_PARENTHESIS:
+        return "Expect ')', but found '%s'";
+    case TINY_EXPECT_BEGIN:
+        return "Expect 'BEGIN', but found '%s'";
+    case TINY_EXPECT_END:
+        return "Expect 'END', but found '%s'";
+    case TINY_EXPECT_IDENTIFIER:
+        return "Expect an identifier, but found '%s'";
+    case TINY_EXPECT_STATEMENT:
+    case TINY_EXPECT_EXPRESSION:
+    case TINY_EXPECT_TYPE:
+        return "Expect a statement, but found '%s'";
+    case TINY_EXPECT_COMMA:
+        return "Expect ',', but found '%s'";
+    case TINY_EXPECT_FUNC_VARS:
+        return "Expect function or variable declaration";
+    case TINY_MAY_FUNC_CALL:
+        return "Unexpected token '%s', maybe you want a func call?";
+    case TINY_UNTERMINATED_STRING_OR_CHARACTER:
+        return "Unterminated string or character";
+    case TINY_UNDEFINED_NAME:
+        return "Use of undeclared identifier '%s'";
+    case TINY_DUPLICATE_NAME:
+        return "Redefinition of '%s'";
+    case TINY_NOT_A_FUNCTION:
+        return "'%s' is not a function";
+    case TINY_NOT_A_VARIABLE:
+        return "'%s' is a function, not a variable";
+    case TINY_TYPE_MISMATCH:
+        return "Incompatible types at '%s'";
+    case TINY_ARGUMENT_COUNT:
+        return "Wrong number of arguments in call to '%s'";
+    case TINY_NOT_ASSIGNABLE:
+        return "Expression starting at '%s' is not assignable";
+    default:
+        return NULL;
+    }
+}
@@ -0,0 +1,388 @@
+#include "fold.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include "runtime.h"
+#include <stdlib.h>
+
+struct fold_s
+{
+    tiny_typecheck_t *check;
+    int eliminated;
+};
+
+static int type_of(struct fold_s *f, tiny_ast_t *ast)
+{
+    return f->check->types[ast->id];
+}
+
+static tiny_value_t value_of(tiny_ast_t *number)
+{
+    tiny_value_t value;
+    if (number->token.kind == TINY_TOKEN_INT)
+        value.i = number->token.value.integer;
+    else
+        value.r = number->token.value.real;
+    return value;
+}
+
+/**
+ * 把 number 节点的值改为折叠的结果，原来的源码文本不再适用
+ */
+static void set_value(struct fold_s *f, tiny_ast_t *number, int type, tiny_value_t value)
+{
+    number->token.s = number->token.e = NULL;
+    if (type == TINY_TYPE_REAL)
+    {
+        number->token.kind = TINY_TOKEN_REAL;
+        number->token.value.real = value.r;
+    }
+    else
+    {
+        number->token.kind = TINY_TOKEN_INT;
+        number->token.value.integer = value.i;
+    }
+    f->check->types[number->id] = type;
+}
+
+static int count_nodes(tiny_ast_t *ast)
+{
+    int count = 1;
+    for (tiny_ast_t *child = ast->child; child; child = child->sibling)
+        count += count_nodes(child);
+    return count;
+}
+
+/**
+ * 子树中声明的变量随子树一起删除
+ */
+static void forget_decls(struct fold_s *f, tiny_ast_t *ast)
+{
+    if (ast->desc == TINY_DESC_DECL)
+    {
+        tiny_resolve_t *resolve = f->check->resolve;
+        for (tiny_ast_t *id = ast->child->sibling->child; id; id = id->sibling)
+            if (id->desc == TINY_DESC_IDENTIFIER && resolve->decl_of[id->id] >= 0)
+            {
+                tiny_decl_t *decl = &resolve->decls[resolve->decl_of[id->id]];
+                decl->node = decl->type = decl->func = NULL;
+            }
+        return;
+    }
+    for (tiny_ast_t *child = ast->child; child; child = child->sibling)
+        forget_decls(f, child);
+}
+
+/**
+ * 删除已经从树中摘下的子树
+ */
+static void discard(struct fold_s *f, tiny_ast_t *ast)
+{
+    ast->sibling = NULL;
+    f->eliminated += count_nodes(ast);
+    forget_decls(f, ast);
+    tiny_free_ast(ast);
+}
+
+/**
+ * 从兄弟链表中摘下 *link
+ */
+static tiny_ast_t *detach(tiny_ast_t **link)
+{
+    tiny_ast_t *ast = *link;
+    *link = ast->sibling;
+    ast->sibling = NULL;
+    return ast;
+}
+
+/**
+ * 用 replacement 替换 *link 处的节点，返回被替换的节点
+ */
+static tiny_ast_t *replace(tiny_ast_t **link, tiny_ast_t *replacement)
+{
+    tiny_ast_t *old = *link;
+    replacement->sibling = old->sibling;
+    old->sibling = NULL;
+    *link = replacement;
+    return old;
+}
+
+/**
+ * 用唯一的子节点替换 *link 处的包装节点
+ */
+static void unwrap(struct fold_s *f, tiny_ast_t **link)
+{
+    tiny_ast_t *wrapper = replace(link, (*link)->child);
+    wrapper->child = NULL;
+    discard(f, wrapper);
+}
+
+/**
+ * 计算 a op b，不能在编译时计算时返回 false
+ */
+static bool evaluate(tiny_ast_t *op, bool real, tiny_value_t a, tiny_value_t b, tiny_value_t *result)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    if (strsecmp(s, e, "+"))
+    {
+        if (real)
+            result->r = a.r + b.r;
+        else
+            result->i = (int64_t)((uint64_t)a.i + (uint64_t)b.i);
+    }
+    else if (strsecmp(s, e, "-"))
+    {
+        if (real)
+            result->r = a.r - b.r;
+        else
+            result->i = (int64_t)((uint64_t)a.i - (uint64_t)b.i);
+    }
+    else if (strsecmp(s, e, "*"))
+    {
+        if (real)
+            result->r = a.r * b.r;
+        else
+            result->i = (int64_t)((uint64_t)a.i * (uint64_t)b.i);
+    }
+    else if (strsecmp(s, e, "/"))
+    {
+        if (real)
+            result->r = a.r / b.r;
+        else if (b.i == 0) // 留到运行时报告
+            return false;
+        else
+            result->i = b.i == -1 ? (int64_t)(0 - (uint64_t)a.i) : a.i / b.i;
+    }
+    else if (strsecmp(s, e, "=="))
+        result->i = real ? a.r == b.r : a.i == b.i;
+    else
+        result->i = real ? a.r != b.r : a.i != b.i;
+    return true;
+}
+
+static bool is_value(bool real, tiny_value_t value, int n)
+{
+    return real ? value.r == n : value.i == n;
+}
+
+/**
+ * x op c 可以化简为 x
+ */
+static bool right_identity(tiny_ast_t *op, bool real, tiny_value_t c)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    if (strsecmp(s, e, "+"))
+        return !real && c.i == 0;
+    if (strsecmp(s, e, "-"))
+        return is_value(real, c, 0);
+    if (strsecmp(s, e, "*") || strsecmp(s, e, "/"))
+        return is_value(real, c, 1);
+    return false;
+}
+
+/**
+ * c op x 可以化简为 x
+ */
+static bool left_identity(tiny_ast_t *op, bool real, tiny_value_t c)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    if (strsecmp(s, e, "+"))
+        return !real && c.i == 0;
+    if (strsecmp(s, e, "*"))
+        return is_value(real, c, 1);
+    return false;
+}
+
+static bool is_arithmetic(tiny_ast_t *op)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    return strsecmp(s, e, "+") || strsecmp(s, e, "-") || strsecmp(s, e, "*") || strsecmp(s, e, "/");
+}
+
+static void fold_expr(struct fold_s *f, tiny_ast_t **link);
+
+/**
+ * binary -> operand (op operand)*，从左到右结合。
+ * 只有链的开头才是前面所有运算的结果，因此常量折叠与左单位元只在开头进行，右单位元可以出现在任何位置。
+ */
+static void fold_binary(struct fold_s *f, tiny_ast_t **link)
+{
+    tiny_ast_t *expr = *link;
+    fold_expr(f, &expr->child);
+    tiny_ast_t **lhs_link = &expr->child;
+    for (tiny_ast_t *op = (*lhs_link)->sibling; op; op = (*lhs_link)->sibling)
+    {
+        tiny_ast_t **rhs_link = &op->sibling;
+        fold_expr(f, rhs_link);
+        tiny_ast_t *lhs = *lhs_link, *rhs = *rhs_link;
+        bool real = type_of(f, rhs) == TINY_TYPE_REAL;
+        bool head = lhs_link == &expr->child;
+        tiny_value_t result;
+
+        if (head && lhs->desc == TINY_DESC_NUMBER && rhs->desc == TINY_DESC_NUMBER &&
+            evaluate(op, real, value_of(lhs), value_of(rhs), &result))
+        {
+            set_value(f, lhs, is_arithmetic(op) ? type_of(f, rhs) : TINY_TYPE_INT, result);
+            discard(f, detach(&lhs->sibling));
+            discard(f, detach(&lhs->sibling));
+        }
+        else if (rhs->desc == TINY_DESC_NUMBER && right_identity(op, real, value_of(rhs)))
+        {
+            discard(f, detach(&lhs->sibling));
+            discard(f, detach(&lhs->sibling));
+        }
+        else if (head && lhs->desc == TINY_DESC_NUMBER && left_identity(op, real, value_of(lhs)))
+        {
+            discard(f, detach(lhs_link));
+            discard(f, detach(lhs_link));
+        }
+        else
+        {
+            lhs_link = rhs_link;
+        }
+    }
+    if (!expr->child->sibling)
+        unwrap(f, link);
+}
+
+static void fold_expr(struct fold_s *f, tiny_ast_t **link)
+{
+    tiny_ast_t *expr = *link;
+    switch (expr->desc)
+    {
+    case TINY_DESC_BINARY:
+        if (expr->child->sibling)
+        {
+            fold_binary(f, link);
+            break;
+        }
+        // fallthrough
+    case TINY_DESC_ASSIGN:
+        // assignment -> binary (':=' binary)*，只有一个 binary 时是包装节点
+        for (tiny_ast_t **operand = &expr->child; *operand; operand = &(*operand)->sibling->sibling)
+        {
+            fold_expr(f, operand);
+            if (!(*operand)->sibling)
+                break;
+        }
+        if (!expr->child->sibling)
+            unwrap(f, link);
+        break;
+    case TINY_DESC_CONVERT:
+    {
+        fold_expr(f, &expr->child);
+        tiny_ast_t *operand = expr->child;
+        if (operand->desc != TINY_DESC_NUMBER)
+            break;
+        int type = type_of(f, expr);
+        tiny_value_t value = value_of(operand);
+        if (type == TINY_TYPE_REAL)
+            value.r = (double)value.i;
+        else
+            value.i = tiny_real_to_int(value.r);
+        set_value(f, operand, type, value);
+        unwrap(f, link);
+        break;
+    }
+    case TINY_DESC_CALL: // call -> identifier '(' actual_params ')'
+    {
+        tiny_ast_t *args = expr->child->sibling->sibling;
+        for (tiny_ast_t **arg = &args->child; *arg; arg = &(*arg)->sibling->sibling)
+        {
+            fold_expr(f, arg);
+            if (!(*arg)->sibling)
+                break;
+        }
+        break;
+    }
+    case TINY_DESC_ELIMINATE: // '(' expression ')'
+    {
+        fold_expr(f, &expr->child->sibling);
+        tiny_ast_t *inner = detach(&expr->child->sibling);
+        discard(f, replace(link, inner));
+        break;
+    }
+    }
+}
+
+static bool fold_statement(struct fold_s *f, tiny_ast_t **link, bool in_list);
+
+static void fold_list(struct fold_s *f, tiny_ast_t **link)
+{
+    while (*link)
+        if (fold_statement(f, link, true))
+            link = &(*link)->sibling;
+}
+
+/**
+ * if -> 'if' '(' expression ')' statement ['else' statement]
+ */
+static bool fold_if(struct fold_s *f, tiny_ast_t **link, bool in_list)
+{
+    tiny_ast_t *stmt = *link;
+    tiny_ast_t *lparen = stmt->child->sibling;
+    fold_expr(f, &lparen->sibling);
+    tiny_ast_t *cond = lparen->sibling;
+    tiny_ast_t **then_link = &cond->sibling->sibling;
+    tiny_ast_t *optional = (*then_link)->sibling;
+    tiny_ast_t **else_link = optional->child ? &optional->child->child->sibling : NULL;
+
+    tiny_ast_t **taken = NULL;
+    if (cond->desc == TINY_DESC_NUMBER)
+    {
+        tiny_value_t value = value_of(cond);
+        taken = (cond->token.kind == TINY_TOKEN_REAL ? value.r != 0 : value.i != 0) ? then_link : else_link;
+    }
+
+    if (cond->desc != TINY_DESC_NUMBER || (!taken && !in_list))
+    {
+        // 嵌套在另一个 if 中时没有可以代替它的语句，保留
+        fold_statement(f, then_link, false);
+        if (else_link)
+            fold_statement(f, else_link, false);
+        return true;
+    }
+    if (!taken)
+    {
+        discard(f, detach(link));
+        return false;
+    }
+    fold_statement(f, taken, false);
+    discard(f, replace(link, detach(taken)));
+    return true;
+}
+
+/**
+ * @param in_list 位于语句列表中，可以整个删除
+ * @return 折叠之后 *link 处仍有语句
+ */
+static bool fold_statement(struct fold_s *f, tiny_ast_t **link, bool in_list)
+{
+    tiny_ast_t *stmt = *link;
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK: // block -> 'BEGIN' statement* 'END'
+        fold_list(f, &stmt->child->sibling->child);
+        break;
+    case TINY_DESC_IF:
+        return fold_if(f, link, in_list);
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+        fold_expr(f, &stmt->child->sibling);
+        break;
+    case TINY_DESC_ELIMINATE: // expression ';'
+        fold_expr(f, &stmt->child);
+        break;
+    }
+    return true;
+}
+
+int tiny_fold(tiny_typecheck_t *check, tiny_ast_t *root)
+{
+    struct fold_s f = {.check = check};
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC) // func -> type ['MAIN'] identifier '(' formal_params ')' block
+        {
+            tiny_ast_t **body = &item->child->sibling->sibling->sibling->sibling->sibling->sibling;
+            fold_statement(&f, body, false);
+        }
+    return f.eliminated;
+}
@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+#include "incremental.h"
+#include "error.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+void tiny_document_init(tiny_document_t *doc, struct trie *parsers, tiny_symbol_table_t *symbols)
+{
+    memset(doc, 0, sizeof(tiny_document_t));
+    doc->parsers = parsers;
+    doc->root = trie_search(parsers, "root");
+    doc->symbols = symbols;
+    tiny_scanner_begin(&doc->scanner, &doc->lex, tiny_lex_reader);
+    tiny_document_set_text(doc, "", 0);
+}
+
+static tiny_chunk_t *push_chunk(tiny_document_t *doc)
+{
+    if (doc->fresh_count == doc->fresh_size)
+    {
+        doc->fresh_size = doc->fresh_size ? doc->fresh_size * 2 : 16;
+        doc->fresh = realloc(doc->fresh, doc->fresh_size * sizeof(tiny_chunk_t));
+    }
+    tiny_chunk_t *chunk = &doc->fresh[doc->fresh_count++];
+    memset(chunk, 0, sizeof(tiny_chunk_t));
+    return chunk;
+}
+
+static void free_chunk(tiny_document_t *doc, tiny_chunk_t *chunk)
+{
+    tiny_free_ast(chunk->item);
+    free(chunk->code);
+    if (doc->free_data)
+        doc->free_data(chunk->data);
+}
+
+static void drop_fresh(tiny_document_t *doc)
+{
+    for (int i = 0; i < doc->fresh_count; ++i)
+        free_chunk(doc, &doc->fresh[i]);
+    doc->fresh_count = 0;
+}
+
+void tiny_document_free(tiny_document_t *doc)
+{
+    for (int i = 0; i < doc->chunk_count; ++i)
+        free_chunk(doc, &doc->chunks[i]);
+    free(doc->chunks);
+    free(doc->fresh);
+    tiny_scanner_end(&doc->scanner);
+    tiny_lex_end(&doc->lex);
+    free(doc->text);
+}
+
+int tiny_document_find(const tiny_document_t *doc, int offset)
+{
+    int l = 0, r = doc->chunk_count - 1;
+    while (l < r)
+    {
+        int mid = (l + r + 1) / 2;
+        if (doc->chunks[mid].offset <= offset)
+            l = mid;
+        else
+            r = mid - 1;
+    }
+    return l;
+}
+
+int tiny_document_failed(const tiny_document_t *doc)
+{
+    int count = 0;
+    for (int i = 0; i < doc->chunk_count; ++i)
+        count += doc->chunks[i].error != 0;
+    return count;
+}
+
+/**
+ * 解析之后，code[0, len) 的末尾是否处于未结束的注释、字符串或 token 中，
+ * 即与之后的源码连在一起进行词法分析时结果可能不同
+ */
+static bool open_end(tiny_document_t *doc, const char *code, int len)
+{
+    // 已经读取的最后一个 token，词法错误出现在末尾时是未结束的注释、字符串或数字
+    const char *last = code;
+    for (list_entry_t *entry = list_prev(&doc->scanner.tokens); entry != &doc->scanner.tokens;
+         entry = list_prev(entry))
+    {
+        const tiny_lex_token_t *token = &le2scannertoken(entry, list)->token;
+        if (token->error == TINY_EOF)
+            continue;
+        if (token->error != 0)
+            return token->e >= code + len - 1;
+        last = token->e;
+        break;
+    }
+    // 解析失败时余下的部分还没有读取
+    doc->lex.symbols = NULL;
+    tiny_lex_token_t token;
+    int ret;
+    while ((ret = tiny_lex_next(&doc->lex, &token)) == 0)
+        last = token.e;
+    if (ret != TINY_EOF)
+        return token.e >= code + len - 1;
+
+    // 最后一个 token 之后只有空白与注释，紧挨着末尾的 token 可能与下一段的第一个 token 连在一起
+    const char *p = last, *e = code + len;
+    if (p == e)
+        return p != code;
+    while (p < e)
+    {
+        if (isspace((unsigned char)*p))
+            ++p;
+        else if (p[1] == '*')
+        {
+            p = memmem(p + 2, e - p - 2, "*/", 2);
+            if (!p)
+                return true;
+            p += 2;
+        }
+        else
+        {
+            p = memchr(p, '\n', e - p);
+            if (!p)
+                return true;
+            ++p;
+        }
+    }
+    return false;
+}
+
+/**
+ * 解析 code[0, len)，即文档中从 offset 开始的一段，按顶层 func/vars 拆分后加入 doc->fresh。
+ * 每个 func/vars 连同其后的空白复制到单独的源码中，code 由此接管并释放
+ * @return 末尾是否处于未结束的注释、字符串或 token 中
+ */
+static bool parse_region(tiny_document_t *doc, char *code, int len, int offset)
+{
+    tiny_lex_end(&doc->lex);
+    tiny_lex_begin(&doc->lex, code);
+    doc->lex.symbols = doc->symbols;
+    tiny_scanner_restart(&doc->scanner, &doc->lex);
+    tiny_parser_ctx_t ctx;
+    ctx.parsers = doc->parsers;
+    ctx.current_parser = doc->root;
+    ctx.errors = NULL;
+    tiny_parser_result_t result = tiny_syntax_parse(ctx, &doc->scanner);
+    doc->reparsed += len;
+    bool open = open_end(doc, code, len);
+
+    if (result.state != 0)
+    {
+        tiny_chunk_t *chunk = push_chunk(doc);
+        chunk->offset = offset;
+        chunk->len = len;
+        chunk->code = code;
+        chunk->error = result.state;
+        chunk->error_token = result.error_token;
+        chunk->required = result.required_token;
+        return open;
+    }
+
+    tiny_ast_t *item = result.ast->child;
+    result.ast->child = NULL;
+    tiny_free_ast(result.ast);
+    if (!item || !item->sibling)
+    {
+        tiny_chunk_t *chunk = push_chunk(doc);
+        chunk->offset = offset;
+        chunk->len = len;
+        chunk->code = code;
+        chunk->item = item;
+        return open;
+    }
+    // 第一段从 0 开始，之后每一段从其 func/vars 的第一个 token 开始
+    for (int begin = 0; item;)
+    {
+        tiny_ast_t *next = item->sibling;
+        item->sibling = NULL;
+        int end = next ? tiny_ast_begin(next) - code : len;
+        tiny_chunk_t *chunk = push_chunk(doc);
+        chunk->offset = offset + begin;
+        chunk->len = end - begin;
+        chunk->code = malloc(chunk->len + 1);
+        memcpy(chunk->code, code + begin, chunk->len);
+        chunk->code[chunk->len] = '\0';
+        tiny_ast_move(item, code, chunk->code, chunk->len, -begin);
+        chunk->item = item;
+        begin = end;
+        item = next;
+    }
+    free(code);
+    return open;
+}
+
+/**
+ * 用 doc->fresh 替换第 i 到 j 段，之后的段平移 delta
+ */
+static void replace_chunks(tiny_document_t *doc, int i, int j, int delta)
+{
+    for (int k = i; k <= j; ++k)
+        free_chunk(doc, &doc->chunks[k]);
+    int n = doc->fresh_count, count = doc->chunk_count - (j - i + 1) + n;
+    if (count > doc->chunk_size)
+    {
+        doc->chunk_size = count * 2;
+        doc->chunks = realloc(doc->chunks, doc->chunk_size * sizeof(tiny_chunk_t));
+    }
+    memmove(&doc->chunks[i + n], &doc->chunks[j + 1], (doc->chunk_count - j - 1) * sizeof(tiny_chunk_t));
+    memcpy(&doc->chunks[i], doc->fresh, n * sizeof(tiny_chunk_t));
+    doc->chunk_count = count;
+    for (int k = i + n; k < count; ++k)
+        doc->chunks[k].offset += delta;
+    doc->fresh_count = 0;
+}
+
+void tiny_document_set_text(tiny_document_t *doc, const char *text, int len)
+{
+    if (doc->size < len + 1)
+    {
+        doc->size = len + 1;
+        doc->text = realloc(doc->text, doc->size);
+    }
+    memcpy(doc->text, text, len);
+    doc->text[len] = '\0';
+    doc->len = len;
+
+    doc->reparsed = 0;
+    parse_region(doc, strndup(text, len), len, 0);
+    replace_chunks(doc, 0, doc->chunk_count - 1, 0);
+}
+
+void tiny_document_edit(tiny_document_t *doc, tiny_edit_t edit)
+{
+    int s = edit.offset, e = edit.offset + edit.removed, delta = edit.inserted - edit.removed;
+    int i = tiny_document_find(doc, s), j = tiny_document_find(doc, e);
+    while (i > 0 && doc->chunks[i].offset == s)
+        i--;
+    while (i > 0 && doc->chunks[i - 1].error)
+        i--;
+    while (j + 1 < doc->chunk_count && doc->chunks[j + 1].error)
+        j++;
+
+    if (doc->size < doc->len + delta + 1)
+    {
+        doc->size = (doc->len + delta + 1) * 2;
+        doc->text = realloc(doc->text, doc->size);
+    }
+    memmove(doc->text + e + delta, doc->text + e, doc->len - e + 1);
+    memcpy(doc->text + s, edit.text, edit.inserted);
+    doc->len += delta;
+
+    // 末尾没有结束时与之后的段一起重新解析，每次多解析的段数加倍
+    int begin = doc->chunks[i].offset;
+    doc->reparsed = 0;
+    for (int step = 1;; step *= 2)
+    {
+        int end = doc->chunks[j].offset + doc->chunks[j].len + delta;
+        if (!parse_region(doc, strndup(doc->text + begin, end - begin), end - begin, begin) ||
+            j == doc->chunk_count - 1)
+            break;
+        drop_fresh(doc);
+        j = j + step < doc->chunk_count - 1 ? j + step : doc->chunk_count - 1;
+    }
+    replace_chunks(doc, i, j, delta);
+}
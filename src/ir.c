@@ -0,0 +1,721 @@
+#include "ir.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+int tiny_ir_new_block(tiny_ir_func_t *func)
+{
+    if (func->block_count == func->block_size)
+    {
+        func->block_size = func->block_size ? func->block_size * 2 : 8;
+        func->blocks = realloc(func->blocks, func->block_size * sizeof(tiny_ir_block_t));
+    }
+    memset(&func->blocks[func->block_count], 0, sizeof(tiny_ir_block_t));
+    return func->block_count++;
+}
+
+static void append_insn(tiny_ir_func_t *func, int block, int insn)
+{
+    tiny_ir_block_t *b = &func->blocks[block];
+    if (b->insn_count == b->insn_size)
+    {
+        b->insn_size = b->insn_size ? b->insn_size * 2 : 8;
+        b->insns = realloc(b->insns, b->insn_size * sizeof(int));
+    }
+    b->insns[b->insn_count++] = insn;
+    func->insns[insn].block = block;
+}
+
+int tiny_ir_new_insn(tiny_ir_func_t *func, int block, int op, int type)
+{
+    if (func->insn_count == func->insn_size)
+    {
+        func->insn_size = func->insn_size ? func->insn_size * 2 : 32;
+        func->insns = realloc(func->insns, func->insn_size * sizeof(tiny_ir_insn_t));
+    }
+    int id = func->insn_count++;
+    tiny_ir_insn_t *insn = &func->insns[id];
+    memset(insn, 0, sizeof(tiny_ir_insn_t));
+    insn->op = op;
+    insn->type = type;
+    insn->block = -1;
+    insn->targets[0] = insn->targets[1] = -1;
+    if (block >= 0)
+        append_insn(func, block, id);
+    return id;
+}
+
+void tiny_ir_add_arg(tiny_ir_func_t *func, int insn, int value)
+{
+    tiny_ir_insn_t *i = &func->insns[insn];
+    i->args = realloc(i->args, (i->arg_count + 1) * sizeof(int));
+    i->args[i->arg_count++] = value;
+}
+
+void tiny_ir_add_pred(tiny_ir_func_t *func, int block, int pred)
+{
+    tiny_ir_block_t *b = &func->blocks[block];
+    if (b->pred_count == b->pred_size)
+    {
+        b->pred_size = b->pred_size ? b->pred_size * 2 : 2;
+        b->preds = realloc(b->preds, b->pred_size * sizeof(int));
+    }
+    b->preds[b->pred_count++] = pred;
+}
+
+void tiny_ir_remove_pred(tiny_ir_func_t *func, int block, int pred)
+{
+    tiny_ir_block_t *b = &func->blocks[block];
+    int k = 0;
+    while (k < b->pred_count && b->preds[k] != pred)
+        k++;
+    if (k == b->pred_count)
+        return;
+    memmove(b->preds + k, b->preds + k + 1, (b->pred_count - k - 1) * sizeof(int));
+    b->pred_count--;
+    for (int i = 0; i < b->insn_count; ++i)
+    {
+        tiny_ir_insn_t *insn = &func->insns[b->insns[i]];
+        if (insn->op != TINY_IR_PHI || insn->removed)
+            continue;
+        memmove(insn->args + k, insn->args + k + 1, (insn->arg_count - k - 1) * sizeof(int));
+        insn->arg_count--;
+    }
+}
+
+int tiny_ir_successors(const tiny_ir_func_t *func, int block, int succs[2])
+{
+    const tiny_ir_block_t *b = &func->blocks[block];
+    for (int i = b->insn_count - 1; i >= 0; --i)
+    {
+        const tiny_ir_insn_t *insn = &func->insns[b->insns[i]];
+        if (insn->removed)
+            continue;
+        if (insn->op == TINY_IR_BR)
+        {
+            succs[0] = insn->targets[0];
+            succs[1] = insn->targets[1];
+            return 2;
+        }
+        if (insn->op == TINY_IR_JMP)
+        {
+            succs[0] = insn->targets[0];
+            return 1;
+        }
+        break;
+    }
+    return 0;
+}
+
+void tiny_ir_compact(tiny_ir_func_t *func)
+{
+    for (int i = 0; i < func->block_count; ++i)
+    {
+        tiny_ir_block_t *b = &func->blocks[i];
+        int n = 0;
+        for (int j = 0; j < b->insn_count; ++j)
+            if (!func->insns[b->insns[j]].removed)
+                b->insns[n++] = b->insns[j];
+        b->insn_count = n;
+    }
+}
+
+static void postorder(const tiny_ir_func_t *func, int block, bool *visited, int *order, int *count)
+{
+    visited[block] = true;
+    int succs[2];
+    int n = tiny_ir_successors(func, block, succs);
+    for (int i = 0; i < n; ++i)
+        if (!visited[succs[i]])
+            postorder(func, succs[i], visited, order, count);
+    order[(*count)++] = block;
+}
+
+int tiny_ir_reverse_postorder(const tiny_ir_func_t *func, int *order)
+{
+    bool *visited = calloc(func->block_count, sizeof(bool));
+    int count = 0;
+    postorder(func, 0, visited, order, &count);
+    for (int i = 0, j = count - 1; i < j; ++i, --j)
+    {
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    free(visited);
+    return count;
+}
+
+void tiny_ir_remove_unreachable(tiny_ir_func_t *func)
+{
+    int *order = malloc(func->block_count * sizeof(int));
+    bool *reachable = calloc(func->block_count, sizeof(bool));
+    int count = tiny_ir_reverse_postorder(func, order);
+    for (int i = 0; i < count; ++i)
+        reachable[order[i]] = true;
+    for (int i = 0; i < func->block_count; ++i)
+    {
+        if (reachable[i] || func->blocks[i].removed)
+            continue;
+        int succs[2];
+        int n = tiny_ir_successors(func, i, succs);
+        for (int j = 0; j < n; ++j)
+            if (reachable[succs[j]])
+                tiny_ir_remove_pred(func, succs[j], i);
+        func->blocks[i].removed = true;
+        for (int j = 0; j < func->blocks[i].insn_count; ++j)
+            func->insns[func->blocks[i].insns[j]].removed = true;
+        func->blocks[i].insn_count = 0;
+    }
+    free(order);
+    free(reachable);
+}
+
+int tiny_ir_count(const tiny_ir_module_t *module)
+{
+    int count = 0;
+    for (int i = 0; i < module->func_count; ++i)
+        for (int j = 0; j < module->funcs[i].block_count; ++j)
+        {
+            const tiny_ir_block_t *b = &module->funcs[i].blocks[j];
+            for (int k = 0; k < b->insn_count; ++k)
+                count += !module->funcs[i].insns[b->insns[k]].removed;
+        }
+    return count;
+}
+
+/**
+ * 从 AST 构造 SSA：每个基本块记录各局部变量当前的定义，
+ * 读取一个在本块中没有定义的变量时到前驱中查找，前驱不止一个且定义不同时插入 phi。
+ * 没有循环，创建基本块时它的前驱都已经确定，不会出现未完成的 phi。
+ */
+struct builder_s
+{
+    const tiny_typecheck_t *check;
+    const tiny_resolve_t *resolve;
+    tiny_ir_module_t *module;
+    tiny_ir_func_t *func;
+    int nlocals;
+    int **defs; // 以基本块为下标，各局部变量当前的定义，-1 表示本块中没有定义
+    int defs_size;
+    int current; // 当前基本块，-1 表示之后的代码不可达
+};
+
+static int new_block(struct builder_s *b)
+{
+    int block = tiny_ir_new_block(b->func);
+    if (block >= b->defs_size)
+    {
+        b->defs_size = b->defs_size ? b->defs_size * 2 : 8;
+        b->defs = realloc(b->defs, b->defs_size * sizeof(int *));
+    }
+    b->defs[block] = malloc((b->nlocals + 1) * sizeof(int));
+    for (int i = 0; i < b->nlocals; ++i)
+        b->defs[block][i] = -1;
+    return block;
+}
+
+static int type_of(struct builder_s *b, tiny_ast_t *ast)
+{
+    return b->check->types[ast->id];
+}
+
+static const tiny_decl_t *decl_of(struct builder_s *b, tiny_ast_t *ast)
+{
+    return &b->resolve->decls[b->resolve->decl_of[ast->id]];
+}
+
+static tiny_ast_t *strip(tiny_ast_t *ast)
+{
+    while ((ast->desc == TINY_DESC_BINARY || ast->desc == TINY_DESC_ASSIGN) && !ast->child->sibling)
+        ast = ast->child;
+    return ast;
+}
+
+static int emit_const(struct builder_s *b, int type, tiny_value_t value)
+{
+    int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_CONST, type);
+    b->func->insns[insn].imm = value;
+    return insn;
+}
+
+/**
+ * 在 block 开头的 phi 之后插入一条指令，block 可能已经结束
+ */
+static int insert_front(struct builder_s *b, int block, int op, int type)
+{
+    tiny_ir_func_t *func = b->func;
+    int insn = tiny_ir_new_insn(func, block, op, type);
+    tiny_ir_block_t *blk = &func->blocks[block];
+    int pos = 0;
+    while (pos < blk->insn_count - 1 && func->insns[blk->insns[pos]].op == TINY_IR_PHI)
+        pos++;
+    memmove(blk->insns + pos + 1, blk->insns + pos, (blk->insn_count - 1 - pos) * sizeof(int));
+    blk->insns[pos] = insn;
+    return insn;
+}
+
+static int read_variable(struct builder_s *b, const tiny_decl_t *decl, int block)
+{
+    int var = decl->index;
+    if (b->defs[block][var] >= 0)
+        return b->defs[block][var];
+
+    tiny_ir_block_t *blk = &b->func->blocks[block];
+    int value;
+    if (blk->pred_count == 0) // 只有在声明之前读取时才会出现，按 0 处理
+    {
+        value = insert_front(b, block, TINY_IR_CONST, tiny_decl_type(decl));
+        b->func->insns[value].imm.i = 0;
+    }
+    else if (blk->pred_count == 1)
+    {
+        value = read_variable(b, decl, blk->preds[0]);
+    }
+    else
+    {
+        int count = blk->pred_count;
+        int *values = malloc(count * sizeof(int));
+        bool same = true;
+        for (int i = 0; i < count; ++i)
+        {
+            values[i] = read_variable(b, decl, b->func->blocks[block].preds[i]);
+            same = same && values[i] == values[0];
+        }
+        if (same)
+            value = values[0];
+        else
+        {
+            value = insert_front(b, block, TINY_IR_PHI, tiny_decl_type(decl));
+            for (int i = 0; i < count; ++i)
+                tiny_ir_add_arg(b->func, value, values[i]);
+        }
+        free(values);
+    }
+    b->defs[block][var] = value;
+    return value;
+}
+
+static int add_string(tiny_ir_module_t *module, tiny_ast_t *literal)
+{
+    int len = literal->token.value.string.len;
+    char *str = malloc(len + 1);
+    memcpy(str, literal->token.value.string.s, len);
+    str[len] = '\0';
+    for (int i = 0; i < module->string_count; ++i)
+        if (strcmp(module->strings[i], str) == 0)
+        {
+            free(str);
+            return i;
+        }
+    if (module->string_count == module->string_size)
+    {
+        module->string_size = module->string_size ? module->string_size * 2 : 8;
+        module->strings = realloc(module->strings, module->string_size * sizeof(char *));
+    }
+    module->strings[module->string_count] = str;
+    return module->string_count++;
+}
+
+static void store(struct builder_s *b, const tiny_decl_t *decl, int value)
+{
+    if (decl->func)
+    {
+        b->defs[b->current][decl->index] = value;
+        return;
+    }
+    int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_SETG, TINY_TYPE_VOID);
+    b->func->insns[insn].index = decl->index;
+    tiny_ir_add_arg(b->func, insn, value);
+}
+
+static int binary_op(tiny_ast_t *op, bool real)
+{
+    const char *s = op->token.s, *e = op->token.e;
+    if (strsecmp(s, e, "+"))
+        return real ? TINY_IR_ADDR : TINY_IR_ADDI;
+    if (strsecmp(s, e, "-"))
+        return real ? TINY_IR_SUBR : TINY_IR_SUBI;
+    if (strsecmp(s, e, "*"))
+        return real ? TINY_IR_MULR : TINY_IR_MULI;
+    if (strsecmp(s, e, "/"))
+        return real ? TINY_IR_DIVR : TINY_IR_DIVI;
+    if (strsecmp(s, e, "=="))
+        return real ? TINY_IR_EQR : TINY_IR_EQI;
+    return real ? TINY_IR_NER : TINY_IR_NEI;
+}
+
+static int build_expr(struct builder_s *b, tiny_ast_t *expr);
+
+static int build_assign(struct builder_s *b, tiny_ast_t *target)
+{
+    if (!target->sibling)
+        return build_expr(b, target);
+    int value = build_assign(b, target->sibling->sibling);
+    store(b, decl_of(b, strip(target)), value);
+    return value;
+}
+
+static int build_call(struct builder_s *b, tiny_ast_t *call)
+{
+    const tiny_decl_t *decl = decl_of(b, call);
+    tiny_ast_t *args = call->child->sibling->sibling;
+
+    if (decl->kind == TINY_DECL_BUILTIN) // READ(variable, file) 与 WRITE(expression, file)
+    {
+        tiny_ast_t *value = args->child, *file = strip(value->sibling->sibling);
+        int s = add_string(b->module, file);
+        if (strsecmp(call->child->token.s, call->child->token.e, "READ"))
+        {
+            int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_READ, type_of(b, value));
+            b->func->insns[insn].index = s;
+            store(b, decl_of(b, strip(value)), insn);
+        }
+        else
+        {
+            int v = build_expr(b, value);
+            int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_WRITE, TINY_TYPE_VOID);
+            b->func->insns[insn].index = s;
+            tiny_ir_add_arg(b->func, insn, v);
+        }
+        return -1;
+    }
+
+    int argc = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+        if (argc++, !arg->sibling)
+            break;
+    int *values = malloc((argc + 1) * sizeof(int));
+    int i = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+        if (values[i++] = build_expr(b, arg), !arg->sibling)
+            break;
+    int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_CALL, tiny_decl_type(decl));
+    b->func->insns[insn].index = decl->index;
+    for (i = 0; i < argc; ++i)
+        tiny_ir_add_arg(b->func, insn, values[i]);
+    free(values);
+    return insn;
+}
+
+static int build_expr(struct builder_s *b, tiny_ast_t *expr)
+{
+    switch (expr->desc)
+    {
+    case TINY_DESC_NUMBER:
+    {
+        tiny_value_t value;
+        if (expr->token.kind == TINY_TOKEN_INT)
+            value.i = expr->token.value.integer;
+        else
+            value.r = expr->token.value.real;
+        return emit_const(b, type_of(b, expr), value);
+    }
+    case TINY_DESC_IDENTIFIER:
+    {
+        const tiny_decl_t *decl = decl_of(b, expr);
+        if (decl->func)
+            return read_variable(b, decl, b->current);
+        int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_GETG, tiny_decl_type(decl));
+        b->func->insns[insn].index = decl->index;
+        return insn;
+    }
+    case TINY_DESC_CONVERT:
+    {
+        int value = build_expr(b, expr->child);
+        int real = type_of(b, expr) == TINY_TYPE_REAL;
+        int insn = tiny_ir_new_insn(b->func, b->current, real ? TINY_IR_I2R : TINY_IR_R2I, type_of(b, expr));
+        tiny_ir_add_arg(b->func, insn, value);
+        return insn;
+    }
+    case TINY_DESC_BINARY:
+    {
+        int running = build_expr(b, expr->child);
+        for (tiny_ast_t *op = expr->child->sibling; op; op = op->sibling->sibling)
+        {
+            tiny_ast_t *rhs = op->sibling;
+            int value = build_expr(b, rhs);
+            int code = binary_op(op, type_of(b, rhs) == TINY_TYPE_REAL);
+            int type = code >= TINY_IR_EQI && code <= TINY_IR_NER ? TINY_TYPE_INT : type_of(b, rhs);
+            int insn = tiny_ir_new_insn(b->func, b->current, code, type);
+            tiny_ir_add_arg(b->func, insn, running);
+            tiny_ir_add_arg(b->func, insn, value);
+            running = insn;
+        }
+        return running;
+    }
+    case TINY_DESC_ASSIGN:
+        return build_assign(b, expr->child);
+    case TINY_DESC_CALL:
+        return build_call(b, expr);
+    default: // '(' expression ')'
+        return build_expr(b, expr->child->sibling);
+    }
+}
+
+static void jump(struct builder_s *b, int from, int to)
+{
+    int insn = tiny_ir_new_insn(b->func, from, TINY_IR_JMP, TINY_TYPE_VOID);
+    b->func->insns[insn].targets[0] = to;
+}
+
+static void build_statement(struct builder_s *b, tiny_ast_t *stmt);
+
+static void build_block(struct builder_s *b, tiny_ast_t *block)
+{
+    for (tiny_ast_t *stmt = block->child->sibling->child; stmt && b->current >= 0; stmt = stmt->sibling)
+        build_statement(b, stmt);
+}
+
+static void build_if(struct builder_s *b, tiny_ast_t *stmt)
+{
+    tiny_ast_t *cond = stmt->child->sibling->sibling;
+    tiny_ast_t *then = cond->sibling->sibling;
+    tiny_ast_t *otherwise = then->sibling->child ? then->sibling->child->child->sibling : NULL;
+
+    int value = build_expr(b, cond);
+    int head = b->current;
+    int br = tiny_ir_new_insn(b->func, head, TINY_IR_BR, type_of(b, cond));
+    tiny_ir_add_arg(b->func, br, value);
+
+    int then_block = new_block(b);
+    tiny_ir_add_pred(b->func, then_block, head);
+    b->func->insns[br].targets[0] = then_block;
+    b->current = then_block;
+    build_statement(b, then);
+    int then_end = b->current;
+
+    int else_end = head;
+    if (otherwise)
+    {
+        int else_block = new_block(b);
+        tiny_ir_add_pred(b->func, else_block, head);
+        b->func->insns[br].targets[1] = else_block;
+        b->current = else_block;
+        build_statement(b, otherwise);
+        else_end = b->current;
+    }
+
+    if (then_end < 0 && else_end < 0)
+    {
+        b->current = -1;
+        return;
+    }
+    int merge = new_block(b);
+    if (then_end >= 0)
+    {
+        tiny_ir_add_pred(b->func, merge, then_end);
+        jump(b, then_end, merge);
+    }
+    if (else_end >= 0)
+    {
+        tiny_ir_add_pred(b->func, merge, else_end);
+        if (otherwise)
+            jump(b, else_end, merge);
+        else
+            b->func->insns[br].targets[1] = merge;
+    }
+    b->current = merge;
+}
+
+static void build_statement(struct builder_s *b, tiny_ast_t *stmt)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+        build_block(b, stmt);
+        break;
+    case TINY_DESC_DECL: // 局部变量在声明处初始化为 0
+        for (tiny_ast_t *id = stmt->child->sibling->child; id; id = id->sibling)
+            if (id->desc == TINY_DESC_IDENTIFIER)
+            {
+                const tiny_decl_t *decl = decl_of(b, id);
+                store(b, decl, emit_const(b, tiny_decl_type(decl), (tiny_value_t){.i = 0}));
+            }
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+        build_if(b, stmt);
+        break;
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+    {
+        int value = build_expr(b, stmt->child->sibling);
+        int insn = tiny_ir_new_insn(b->func, b->current, TINY_IR_RET, TINY_TYPE_VOID);
+        tiny_ir_add_arg(b->func, insn, value);
+        b->current = -1;
+        break;
+    }
+    default: // expression ';'
+        build_expr(b, stmt->child);
+        break;
+    }
+}
+
+/**
+ * func -> type ['MAIN'] identifier '(' formal_params ')' block
+ */
+static void build_func(struct builder_s *b, tiny_ast_t *func)
+{
+    tiny_ast_t *name = func->child->sibling->sibling;
+    tiny_ast_t *params = name->sibling->sibling;
+    const tiny_decl_t *decl = decl_of(b, name);
+
+    tiny_ir_func_t *f = &b->module->funcs[decl->index];
+    f->symbol = decl->symbol;
+    f->ret_type = tiny_decl_type(decl);
+    b->func = f;
+    b->nlocals = decl->locals;
+    b->current = new_block(b);
+
+    f->nparams = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+            f->nparams++;
+    f->param_types = malloc((f->nparams + 1) * sizeof(int));
+    int i = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+        {
+            const tiny_decl_t *p = decl_of(b, param->child->sibling);
+            int insn = tiny_ir_new_insn(f, b->current, TINY_IR_PARAM, tiny_decl_type(p));
+            f->insns[insn].index = i;
+            f->param_types[i++] = tiny_decl_type(p);
+            store(b, p, insn);
+        }
+
+    build_block(b, params->sibling->sibling);
+    if (b->current >= 0)
+    {
+        int zero = emit_const(b, f->ret_type, (tiny_value_t){.i = 0});
+        int insn = tiny_ir_new_insn(f, b->current, TINY_IR_RET, TINY_TYPE_VOID);
+        tiny_ir_add_arg(f, insn, zero);
+    }
+
+    if (func->child->sibling->child) // MAIN
+        b->module->main = decl->index;
+    for (i = 0; i < f->block_count; ++i)
+        free(b->defs[i]);
+}
+
+void tiny_ir_build(tiny_ir_module_t *module, const tiny_typecheck_t *check, tiny_ast_t *root)
+{
+    memset(module, 0, sizeof(tiny_ir_module_t));
+    module->main = -1;
+    module->func_count = check->resolve->func_count;
+    module->global_count = check->resolve->global_count;
+    module->funcs = calloc(module->func_count > 0 ? module->func_count : 1, sizeof(tiny_ir_func_t));
+
+    struct builder_s b = {.check = check, .resolve = check->resolve, .module = module};
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+            build_func(&b, item);
+    free(b.defs);
+}
+
+void tiny_ir_free(tiny_ir_module_t *module)
+{
+    for (int i = 0; i < module->func_count; ++i)
+    {
+        tiny_ir_func_t *f = &module->funcs[i];
+        for (int j = 0; j < f->insn_count; ++j)
+            free(f->insns[j].args);
+        for (int j = 0; j < f->block_count; ++j)
+        {
+            free(f->blocks[j].insns);
+            free(f->blocks[j].preds);
+        }
+        free(f->insns);
+        free(f->blocks);
+        free(f->param_types);
+    }
+    free(module->funcs);
+    for (int i = 0; i < module->string_count; ++i)
+        free(module->strings[i]);
+    free(module->strings);
+    memset(module, 0, sizeof(tiny_ir_module_t));
+}
+
+static const char *type_name(int type)
+{
+    return type == TINY_TYPE_REAL ? "REAL" : type == TINY_TYPE_INT ? "INT" : "VOID";
+}
+
+void tiny_ir_dump(const tiny_ir_module_t *module, const tiny_symbol_table_t *symbols, FILE *stream)
+{
+#define TINY_IR_OPCODE_NAME(op) #op,
+    static const char *NAMES[] = {TINY_IR_OPCODES(TINY_IR_OPCODE_NAME)};
+#undef TINY_IR_OPCODE_NAME
+
+    for (int i = 0; i < module->func_count; ++i)
+    {
+        const tiny_ir_func_t *f = &module->funcs[i];
+        fprintf(stream, "func %s(", tiny_symbol_name(symbols, f->symbol));
+        for (int p = 0; p < f->nparams; ++p)
+            fprintf(stream, p ? ", %s" : "%s", type_name(f->param_types[p]));
+        fprintf(stream, ") %s%s\n", type_name(f->ret_type), i == module->main ? " MAIN" : "");
+
+        int *order = malloc((f->block_count + 1) * sizeof(int));
+        int count = tiny_ir_reverse_postorder(f, order);
+        for (int j = 0; j < count; ++j)
+        {
+            const tiny_ir_block_t *b = &f->blocks[order[j]];
+            fprintf(stream, "b%d:", order[j]);
+            if (b->pred_count)
+            {
+                fputs("  ; preds", stream);
+                for (int p = 0; p < b->pred_count; ++p)
+                    fprintf(stream, " b%d", b->preds[p]);
+            }
+            fputc('\n', stream);
+            for (int k = 0; k < b->insn_count; ++k)
+            {
+                int id = b->insns[k];
+                const tiny_ir_insn_t *insn = &f->insns[id];
+                if (insn->removed)
+                    continue;
+                fputs("    ", stream);
+                if (insn->type != TINY_TYPE_VOID && insn->op != TINY_IR_BR)
+                    fprintf(stream, "v%d = ", id);
+                fprintf(stream, "%s", NAMES[insn->op]);
+                switch (insn->op)
+                {
+                case TINY_IR_CONST:
+                    if (insn->type == TINY_TYPE_REAL)
+                        fprintf(stream, " %.17g", insn->imm.r);
+                    else
+                        fprintf(stream, " %" PRId64, insn->imm.i);
+                    break;
+                case TINY_IR_PARAM:
+                    fprintf(stream, " %d", insn->index);
+                    break;
+                case TINY_IR_GETG:
+                case TINY_IR_SETG:
+                    fprintf(stream, " g%d", insn->index);
+                    break;
+                case TINY_IR_CALL:
+                    fprintf(stream, " %s", tiny_symbol_name(symbols, module->funcs[insn->index].symbol));
+                    break;
+                case TINY_IR_READ:
+                case TINY_IR_WRITE:
+                    fprintf(stream, " \"%s\"", module->strings[insn->index]);
+                    break;
+                }
+                for (int a = 0; a < insn->arg_count; ++a)
+                    fprintf(stream, "%s v%d", a || insn->op == TINY_IR_SETG || insn->op == TINY_IR_CALL ||
+                                                      insn->op == TINY_IR_WRITE
+                                                  ? ","
+                                                  : "",
+                            insn->args[a]);
+                if (insn->op == TINY_IR_BR)
+                    fprintf(stream, ", b%d, b%d", insn->targets[0], insn->targets[1]);
+                else if (insn->op == TINY_IR_JMP)
+                    fprintf(stream, " b%d", insn->targets[0]);
+                if (insn->type != TINY_TYPE_VOID && insn->op != TINY_IR_BR)
+                    fprintf(stream, " : %s", type_name(insn->type));
+                fputc('\n', stream);
+            }
+        }
+        free(order);
+    }
+}
@@ -0,0 +1,724 @@
+#include "ir.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static bool is_pure(int op)
+{
+    return op == TINY_IR_CONST || (op >= TINY_IR_ADDI && op <= TINY_IR_R2I);
+}
+
+static bool is_commutative(int op)
+{
+    return op == TINY_IR_ADDI || op == TINY_IR_MULI || op == TINY_IR_ADDR || op == TINY_IR_MULR ||
+           op == TINY_IR_EQI || op == TINY_IR_NEI || op == TINY_IR_EQR || op == TINY_IR_NER;
+}
+
+/**
+ * 替换表：repl[v] 不为 -1 时 v 的使用都改为 repl[v]，可以连续替换
+ */
+static int find(const int *repl, int value)
+{
+    while (repl[value] >= 0)
+        value = repl[value];
+    return value;
+}
+
+static void remap_args(tiny_ir_func_t *func, const int *repl, int insn)
+{
+    tiny_ir_insn_t *i = &func->insns[insn];
+    for (int k = 0; k < i->arg_count; ++k)
+        i->args[k] = find(repl, i->args[k]);
+}
+
+static void remap_all(tiny_ir_func_t *func, const int *repl)
+{
+    for (int i = 0; i < func->insn_count; ++i)
+        if (!func->insns[i].removed)
+            remap_args(func, repl, i);
+}
+
+static int *new_repl(const tiny_ir_func_t *func)
+{
+    int *repl = malloc((func->insn_count + 1) * sizeof(int));
+    for (int i = 0; i < func->insn_count; ++i)
+        repl[i] = -1;
+    return repl;
+}
+
+static void replace_pred(tiny_ir_func_t *func, int block, int from, int to)
+{
+    tiny_ir_block_t *b = &func->blocks[block];
+    for (int i = 0; i < b->pred_count; ++i)
+        if (b->preds[i] == from)
+            b->preds[i] = to;
+}
+
+static int live_count(const tiny_ir_func_t *func)
+{
+    int count = 0;
+    for (int i = 0; i < func->block_count; ++i)
+        for (int j = 0; j < func->blocks[i].insn_count; ++j)
+            count += !func->insns[func->blocks[i].insns[j]].removed;
+    return count;
+}
+
+static bool has_call(const tiny_ir_func_t *func)
+{
+    for (int i = 0; i < func->block_count; ++i)
+        for (int j = 0; j < func->blocks[i].insn_count; ++j)
+        {
+            const tiny_ir_insn_t *insn = &func->insns[func->blocks[i].insns[j]];
+            if (!insn->removed && insn->op == TINY_IR_CALL)
+                return true;
+        }
+    return false;
+}
+
+/**
+ * 把 caller 中基本块 block 第 pos 条指令处对 callee 的调用替换为 callee 的函数体：
+ * 调用之后的指令移到新的基本块 rest，callee 的基本块复制一份，PARAM 改为实参的 COPY，RET 改为跳转到 rest，
+ * 调用指令本身移到 rest 的开头，改为返回值的 COPY 或 phi，因此对调用结果的使用不需要修改。
+ */
+static void inline_call(tiny_ir_func_t *caller, int block, int pos, const tiny_ir_func_t *callee)
+{
+    int call = caller->blocks[block].insns[pos];
+    int rest = tiny_ir_new_block(caller);
+    tiny_ir_block_t *b = &caller->blocks[block], *r = &caller->blocks[rest];
+    for (int i = pos + 1; i < b->insn_count; ++i)
+    {
+        if (r->insn_count == r->insn_size)
+        {
+            r->insn_size = r->insn_size ? r->insn_size * 2 : 8;
+            r->insns = realloc(r->insns, r->insn_size * sizeof(int));
+        }
+        r->insns[r->insn_count++] = b->insns[i];
+        caller->insns[b->insns[i]].block = rest;
+    }
+    b->insn_count = pos;
+    int succs[2];
+    int n = tiny_ir_successors(caller, rest, succs);
+    for (int i = 0; i < n; ++i)
+        replace_pred(caller, succs[i], block, rest);
+
+    int *block_map = malloc((callee->block_count + 1) * sizeof(int));
+    int *insn_map = malloc((callee->insn_count + 1) * sizeof(int));
+    for (int i = 0; i < callee->block_count; ++i)
+        block_map[i] = callee->blocks[i].removed ? -1 : tiny_ir_new_block(caller);
+    for (int i = 0; i < callee->insn_count; ++i)
+        insn_map[i] = callee->insns[i].removed ? -1 : tiny_ir_new_insn(caller, -1, callee->insns[i].op, callee->insns[i].type);
+
+    int *returns = malloc((callee->block_count + 1) * sizeof(int));
+    int *values = malloc((callee->block_count + 1) * sizeof(int));
+    int return_count = 0;
+    for (int i = 0; i < callee->block_count; ++i)
+    {
+        const tiny_ir_block_t *src = &callee->blocks[i];
+        if (src->removed)
+            continue;
+        int dst = block_map[i];
+        for (int p = 0; p < src->pred_count; ++p)
+            tiny_ir_add_pred(caller, dst, block_map[src->preds[p]]);
+        for (int j = 0; j < src->insn_count; ++j)
+        {
+            const tiny_ir_insn_t *from = &callee->insns[src->insns[j]];
+            if (from->removed)
+                continue;
+            int id = insn_map[src->insns[j]];
+            tiny_ir_insn_t *to = &caller->insns[id];
+            to->index = from->index;
+            to->imm = from->imm;
+            to->targets[0] = from->targets[0] >= 0 ? block_map[from->targets[0]] : -1;
+            to->targets[1] = from->targets[1] >= 0 ? block_map[from->targets[1]] : -1;
+            if (from->op == TINY_IR_PARAM)
+            {
+                to->op = TINY_IR_COPY;
+                tiny_ir_add_arg(caller, id, caller->insns[call].args[from->index]);
+            }
+            else if (from->op == TINY_IR_RET)
+            {
+                returns[return_count] = dst;
+                values[return_count++] = insn_map[from->args[0]];
+                to->op = TINY_IR_JMP;
+                to->type = TINY_TYPE_VOID;
+                to->targets[0] = rest;
+            }
+            else
+            {
+                for (int k = 0; k < from->arg_count; ++k)
+                    tiny_ir_add_arg(caller, id, insn_map[from->args[k]]);
+            }
+            tiny_ir_block_t *d = &caller->blocks[dst];
+            if (d->insn_count == d->insn_size)
+            {
+                d->insn_size = d->insn_size ? d->insn_size * 2 : 8;
+                d->insns = realloc(d->insns, d->insn_size * sizeof(int));
+            }
+            d->insns[d->insn_count++] = id;
+            caller->insns[id].block = dst;
+        }
+    }
+
+    int jump = tiny_ir_new_insn(caller, block, TINY_IR_JMP, TINY_TYPE_VOID);
+    caller->insns[jump].targets[0] = block_map[0];
+    tiny_ir_add_pred(caller, block_map[0], block);
+
+    tiny_ir_insn_t *result = &caller->insns[call];
+    result->op = return_count == 1 ? TINY_IR_COPY : TINY_IR_PHI;
+    result->arg_count = 0;
+    for (int i = 0; i < return_count; ++i)
+    {
+        tiny_ir_add_pred(caller, rest, returns[i]);
+        tiny_ir_add_arg(caller, call, values[i]);
+    }
+    r = &caller->blocks[rest];
+    if (r->insn_count == r->insn_size)
+    {
+        r->insn_size = r->insn_size ? r->insn_size * 2 : 8;
+        r->insns = realloc(r->insns, r->insn_size * sizeof(int));
+    }
+    memmove(r->insns + 1, r->insns, r->insn_count * sizeof(int));
+    r->insns[0] = call;
+    r->insn_count++;
+    caller->insns[call].block = rest;
+
+    free(block_map);
+    free(insn_map);
+    free(returns);
+    free(values);
+}
+
+int tiny_ir_inline(tiny_ir_module_t *module)
+{
+    bool *small = calloc(module->func_count + 1, sizeof(bool));
+    for (int i = 0; i < module->func_count; ++i)
+        small[i] = module->funcs[i].block_count > 0 && !has_call(&module->funcs[i]) &&
+                   live_count(&module->funcs[i]) <= TINY_IR_INLINE_LIMIT;
+
+    int count = 0;
+    for (int f = 0; f < module->func_count; ++f)
+    {
+        tiny_ir_func_t *caller = &module->funcs[f];
+        // 内联产生的基本块追加在末尾，随后也会被扫描
+        for (int b = 0; b < caller->block_count; ++b)
+            for (int i = 0; i < caller->blocks[b].insn_count; ++i)
+            {
+                const tiny_ir_insn_t *insn = &caller->insns[caller->blocks[b].insns[i]];
+                if (insn->removed || insn->op != TINY_IR_CALL || insn->index == f || !small[insn->index])
+                    continue;
+                inline_call(caller, b, i, &module->funcs[insn->index]);
+                count++;
+                break;
+            }
+    }
+    free(small);
+    return count;
+}
+
+/**
+ * 计算 insn 的参数都是常量时的结果，无法计算时返回 false
+ */
+static bool fold(const tiny_ir_func_t *func, const tiny_ir_insn_t *insn, tiny_value_t *result)
+{
+    if (insn->op < TINY_IR_ADDI || insn->op > TINY_IR_R2I)
+        return false;
+    for (int k = 0; k < insn->arg_count; ++k)
+        if (func->insns[insn->args[k]].op != TINY_IR_CONST)
+            return false;
+    tiny_value_t a = func->insns[insn->args[0]].imm;
+    tiny_value_t b = insn->arg_count > 1 ? func->insns[insn->args[1]].imm : a;
+    switch (insn->op)
+    {
+    case TINY_IR_ADDI:
+        result->i = (int64_t)((uint64_t)a.i + (uint64_t)b.i);
+        break;
+    case TINY_IR_SUBI:
+        result->i = (int64_t)((uint64_t)a.i - (uint64_t)b.i);
+        break;
+    case TINY_IR_MULI:
+        result->i = (int64_t)((uint64_t)a.i * (uint64_t)b.i);
+        break;
+    case TINY_IR_DIVI: // 除以 0 留到运行时报告
+        if (b.i == 0)
+            return false;
+        result->i = b.i == -1 ? (int64_t)(0 - (uint64_t)a.i) : a.i / b.i;
+        break;
+    case TINY_IR_ADDR:
+        result->r = a.r + b.r;
+        break;
+    case TINY_IR_SUBR:
+        result->r = a.r - b.r;
+        break;
+    case TINY_IR_MULR:
+        result->r = a.r * b.r;
+        break;
+    case TINY_IR_DIVR:
+        result->r = a.r / b.r;
+        break;
+    case TINY_IR_EQI:
+        result->i = a.i == b.i;
+        break;
+    case TINY_IR_NEI:
+        result->i = a.i != b.i;
+        break;
+    case TINY_IR_EQR:
+        result->i = a.r == b.r;
+        break;
+    case TINY_IR_NER:
+        result->i = a.r != b.r;
+        break;
+    case TINY_IR_I2R:
+        result->r = (double)a.i;
+        break;
+    default: // R2I
+        result->i = tiny_real_to_int(a.r);
+        break;
+    }
+    return true;
+}
+
+/**
+ * 参数全部相同，或者全部是相同的常量时，phi 可以用第一个参数代替
+ */
+static bool phi_trivial(const tiny_ir_func_t *func, const tiny_ir_insn_t *phi, bool constants)
+{
+    if (phi->arg_count == 0)
+        return false;
+    const tiny_ir_insn_t *first = &func->insns[phi->args[0]];
+    for (int k = 1; k < phi->arg_count; ++k)
+    {
+        if (phi->args[k] == phi->args[0])
+            continue;
+        const tiny_ir_insn_t *arg = &func->insns[phi->args[k]];
+        if (!constants || first->op != TINY_IR_CONST || arg->op != TINY_IR_CONST || arg->imm.i != first->imm.i)
+            return false;
+    }
+    return true;
+}
+
+static int propagate_constants(tiny_ir_func_t *func)
+{
+    int count = 0;
+    int *repl = new_repl(func);
+    int *order = malloc((func->block_count + 1) * sizeof(int));
+    int n = tiny_ir_reverse_postorder(func, order);
+    // 没有循环，按逆后序访问时每个值的定义都先于它的使用
+    for (int o = 0; o < n; ++o)
+    {
+        tiny_ir_block_t *b = &func->blocks[order[o]];
+        for (int j = 0; j < b->insn_count; ++j)
+        {
+            int id = b->insns[j];
+            tiny_ir_insn_t *insn = &func->insns[id];
+            if (insn->removed)
+                continue;
+            remap_args(func, repl, id);
+            tiny_value_t value;
+            if ((insn->op == TINY_IR_COPY && func->insns[insn->args[0]].op == TINY_IR_CONST) ||
+                (insn->op == TINY_IR_PHI && phi_trivial(func, insn, true)))
+            {
+                repl[id] = insn->args[0];
+                insn->removed = true;
+                count++;
+            }
+            else if (fold(func, insn, &value))
+            {
+                insn->op = TINY_IR_CONST;
+                insn->imm = value;
+                insn->arg_count = 0;
+                count++;
+            }
+            else if (insn->op == TINY_IR_BR && func->insns[insn->args[0]].op == TINY_IR_CONST)
+            {
+                tiny_value_t cond = func->insns[insn->args[0]].imm;
+                bool taken = insn->type == TINY_TYPE_REAL ? cond.r != 0 : cond.i != 0;
+                int target = insn->targets[taken ? 0 : 1], other = insn->targets[taken ? 1 : 0];
+                if (other != target)
+                    tiny_ir_remove_pred(func, other, order[o]);
+                insn->op = TINY_IR_JMP;
+                insn->type = TINY_TYPE_VOID;
+                insn->arg_count = 0;
+                insn->targets[0] = target;
+                insn->targets[1] = -1;
+                count++;
+            }
+        }
+    }
+    tiny_ir_remove_unreachable(func);
+    remap_all(func, repl);
+    tiny_ir_compact(func);
+    free(order);
+    free(repl);
+    return count;
+}
+
+int tiny_ir_propagate_constants(tiny_ir_module_t *module)
+{
+    int count = 0;
+    for (int i = 0; i < module->func_count; ++i)
+        count += propagate_constants(&module->funcs[i]);
+    return count;
+}
+
+int tiny_ir_propagate_copies(tiny_ir_module_t *module)
+{
+    int count = 0;
+    for (int f = 0; f < module->func_count; ++f)
+    {
+        tiny_ir_func_t *func = &module->funcs[f];
+        int *repl = new_repl(func);
+        int *order = malloc((func->block_count + 1) * sizeof(int));
+        int n = tiny_ir_reverse_postorder(func, order);
+        for (int o = 0; o < n; ++o)
+        {
+            const tiny_ir_block_t *b = &func->blocks[order[o]];
+            for (int j = 0; j < b->insn_count; ++j)
+            {
+                int id = b->insns[j];
+                tiny_ir_insn_t *insn = &func->insns[id];
+                if (insn->removed)
+                    continue;
+                remap_args(func, repl, id);
+                if (insn->op == TINY_IR_COPY || (insn->op == TINY_IR_PHI && phi_trivial(func, insn, false)))
+                {
+                    repl[id] = insn->args[0];
+                    insn->removed = true;
+                    count++;
+                }
+            }
+        }
+        remap_all(func, repl);
+        tiny_ir_compact(func);
+        free(order);
+        free(repl);
+    }
+    return count;
+}
+
+/**
+ * 支配树上的公共子表达式删除。可用的表达式保存在以指令为结点的链式哈希表中，
+ * 进入子树时插入到链表头部，离开时按相反的顺序弹出，表中始终只有支配当前基本块的指令。
+ */
+#define CSE_BUCKETS 256
+
+struct cse_s
+{
+    tiny_ir_func_t *func;
+    int *repl;
+    int *idom;
+    int *children, *child_start; // 支配树，children[child_start[b]..child_start[b + 1]) 是 b 的子结点
+    int heads[CSE_BUCKETS];
+    int *next;
+    int count;
+};
+
+static unsigned cse_hash(const tiny_ir_insn_t *insn)
+{
+    unsigned h = (unsigned)insn->op * 31u + (unsigned)insn->type;
+    if (insn->op == TINY_IR_CONST)
+        h = h * 31u + (unsigned)insn->imm.i + (unsigned)(insn->imm.i >> 32);
+    for (int k = 0; k < insn->arg_count; ++k)
+        h = h * 31u + (unsigned)insn->args[k];
+    return h % CSE_BUCKETS;
+}
+
+static bool cse_equal(const tiny_ir_insn_t *a, const tiny_ir_insn_t *b)
+{
+    if (a->op != b->op || a->type != b->type || a->arg_count != b->arg_count)
+        return false;
+    if (a->op == TINY_IR_CONST && a->imm.i != b->imm.i)
+        return false;
+    for (int k = 0; k < a->arg_count; ++k)
+        if (a->args[k] != b->args[k])
+            return false;
+    return true;
+}
+
+static void cse_walk(struct cse_s *cse, int block)
+{
+    tiny_ir_func_t *func = cse->func;
+    const tiny_ir_block_t *b = &func->blocks[block];
+    int *pushed = malloc((b->insn_count + 1) * sizeof(int));
+    int push_count = 0;
+    for (int j = 0; j < b->insn_count; ++j)
+    {
+        int id = b->insns[j];
+        tiny_ir_insn_t *insn = &func->insns[id];
+        if (insn->removed)
+            continue;
+        remap_args(func, cse->repl, id);
+        if (!is_pure(insn->op))
+            continue;
+        if (is_commutative(insn->op) && insn->args[0] > insn->args[1])
+        {
+            int t = insn->args[0];
+            insn->args[0] = insn->args[1];
+            insn->args[1] = t;
+        }
+        unsigned h = cse_hash(insn);
+        int found = cse->heads[h];
+        while (found >= 0 && !cse_equal(&func->insns[found], insn))
+            found = cse->next[found];
+        if (found >= 0)
+        {
+            cse->repl[id] = found;
+            insn->removed = true;
+            cse->count++;
+            continue;
+        }
+        cse->next[id] = cse->heads[h];
+        cse->heads[h] = id;
+        pushed[push_count++] = id;
+    }
+    for (int c = cse->child_start[block]; c < cse->child_start[block + 1]; ++c)
+        cse_walk(cse, cse->children[c]);
+    while (push_count > 0)
+    {
+        int id = pushed[--push_count];
+        cse->heads[cse_hash(&func->insns[id])] = cse->next[id];
+    }
+    free(pushed);
+}
+
+/**
+ * Cooper、Harvey 与 Kennedy 的迭代算法，order 是逆后序
+ */
+static void dominators(const tiny_ir_func_t *func, const int *order, int n, int *idom)
+{
+    int *rank = malloc((func->block_count + 1) * sizeof(int));
+    for (int i = 0; i < func->block_count; ++i)
+        idom[i] = rank[i] = -1;
+    for (int i = 0; i < n; ++i)
+        rank[order[i]] = i;
+    idom[order[0]] = order[0];
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (int i = 1; i < n; ++i)
+        {
+            const tiny_ir_block_t *b = &func->blocks[order[i]];
+            int dom = -1;
+            for (int p = 0; p < b->pred_count; ++p)
+            {
+                int pred = b->preds[p];
+                if (rank[pred] < 0 || idom[pred] < 0)
+                    continue;
+                if (dom < 0)
+                {
+                    dom = pred;
+                    continue;
+                }
+                int x = pred, y = dom;
+                while (x != y)
+                {
+                    while (rank[x] > rank[y])
+                        x = idom[x];
+                    while (rank[y] > rank[x])
+                        y = idom[y];
+                }
+                dom = x;
+            }
+            if (idom[order[i]] != dom)
+            {
+                idom[order[i]] = dom;
+                changed = true;
+            }
+        }
+    }
+    free(rank);
+}
+
+int tiny_ir_eliminate_common(tiny_ir_module_t *module)
+{
+    int count = 0;
+    for (int f = 0; f < module->func_count; ++f)
+    {
+        tiny_ir_func_t *func = &module->funcs[f];
+        if (func->block_count == 0)
+            continue;
+        int *order = malloc((func->block_count + 1) * sizeof(int));
+        int n = tiny_ir_reverse_postorder(func, order);
+        struct cse_s cse = {.func = func, .repl = new_repl(func)};
+        cse.idom = malloc((func->block_count + 1) * sizeof(int));
+        dominators(func, order, n, cse.idom);
+
+        // 按逆后序把每个基本块加入其直接支配者的子结点
+        cse.child_start = calloc(func->block_count + 2, sizeof(int));
+        cse.children = malloc((func->block_count + 1) * sizeof(int));
+        for (int i = 1; i < n; ++i)
+            cse.child_start[cse.idom[order[i]] + 2]++;
+        for (int i = 0; i < func->block_count; ++i)
+            cse.child_start[i + 2] += cse.child_start[i + 1];
+        for (int i = 1; i < n; ++i)
+            cse.children[cse.child_start[cse.idom[order[i]] + 1]++] = order[i];
+
+        cse.next = malloc((func->insn_count + 1) * sizeof(int));
+        for (int i = 0; i < CSE_BUCKETS; ++i)
+            cse.heads[i] = -1;
+        cse_walk(&cse, order[0]);
+        // phi 的参数来自前驱，前驱不一定在支配树中先被访问
+        remap_all(func, cse.repl);
+        tiny_ir_compact(func);
+        count += cse.count;
+
+        free(cse.next);
+        free(cse.children);
+        free(cse.child_start);
+        free(cse.idom);
+        free(cse.repl);
+        free(order);
+    }
+    return count;
+}
+
+/**
+ * 有副作用或者决定控制流的指令，无论结果是否被使用都要保留
+ */
+static bool is_root(const tiny_ir_func_t *func, const tiny_ir_insn_t *insn)
+{
+    if (insn->op == TINY_IR_DIVI)
+    {
+        const tiny_ir_insn_t *divisor = &func->insns[insn->args[1]];
+        return divisor->op != TINY_IR_CONST || divisor->imm.i == 0;
+    }
+    return !is_pure(insn->op) && insn->op != TINY_IR_PARAM && insn->op != TINY_IR_COPY &&
+           insn->op != TINY_IR_PHI && insn->op != TINY_IR_GETG;
+}
+
+/**
+ * 基本块以 JMP 结束，且目标只有这一个前驱时，把目标合并进来
+ */
+static int merge_blocks(tiny_ir_func_t *func)
+{
+    int count = 0;
+    int *repl = new_repl(func);
+    for (int i = 0; i < func->block_count; ++i)
+    {
+        tiny_ir_block_t *b = &func->blocks[i];
+        while (!b->removed && b->insn_count > 0)
+        {
+            int jump = b->insns[b->insn_count - 1];
+            int target = func->insns[jump].targets[0];
+            if (func->insns[jump].op != TINY_IR_JMP || target == 0 || target == i ||
+                func->blocks[target].pred_count != 1)
+                break;
+            tiny_ir_block_t *t = &func->blocks[target];
+            func->insns[jump].removed = true;
+            b->insn_count--;
+            count++;
+            for (int j = 0; j < t->insn_count; ++j)
+            {
+                int id = t->insns[j];
+                tiny_ir_insn_t *insn = &func->insns[id];
+                if (insn->removed)
+                    continue;
+                if (insn->op == TINY_IR_PHI)
+                {
+                    repl[id] = insn->args[0];
+                    insn->removed = true;
+                    count++;
+                    continue;
+                }
+                if (b->insn_count == b->insn_size)
+                {
+                    b->insn_size = b->insn_size ? b->insn_size * 2 : 8;
+                    b->insns = realloc(b->insns, b->insn_size * sizeof(int));
+                }
+                b->insns[b->insn_count++] = id;
+                insn->block = i;
+            }
+            int succs[2];
+            int n = tiny_ir_successors(func, target, succs);
+            for (int s = 0; s < n; ++s)
+                replace_pred(func, succs[s], target, i);
+            t->removed = true;
+            t->insn_count = 0;
+        }
+    }
+    remap_all(func, repl);
+    free(repl);
+    return count;
+}
+
+int tiny_ir_eliminate_dead(tiny_ir_module_t *module)
+{
+    int count = 0;
+    for (int f = 0; f < module->func_count; ++f)
+    {
+        tiny_ir_func_t *func = &module->funcs[f];
+        bool *live = calloc(func->insn_count + 1, sizeof(bool));
+        int *work = malloc((func->insn_count + 1) * sizeof(int));
+        int top = 0;
+        for (int b = 0; b < func->block_count; ++b)
+            for (int j = 0; j < func->blocks[b].insn_count; ++j)
+            {
+                int id = func->blocks[b].insns[j];
+                if (!func->insns[id].removed && is_root(func, &func->insns[id]))
+                {
+                    live[id] = true;
+                    work[top++] = id;
+                }
+            }
+        while (top > 0)
+        {
+            const tiny_ir_insn_t *insn = &func->insns[work[--top]];
+            for (int k = 0; k < insn->arg_count; ++k)
+                if (!live[insn->args[k]])
+                {
+                    live[insn->args[k]] = true;
+                    work[top++] = insn->args[k];
+                }
+        }
+        for (int b = 0; b < func->block_count; ++b)
+            for (int j = 0; j < func->blocks[b].insn_count; ++j)
+            {
+                int id = func->blocks[b].insns[j];
+                if (!func->insns[id].removed && !live[id])
+                {
+                    func->insns[id].removed = true;
+                    count++;
+                }
+            }
+        tiny_ir_compact(func);
+        count += merge_blocks(func);
+        tiny_ir_compact(func);
+        free(live);
+        free(work);
+    }
+    return count;
+}
+
+static double elapsed_ms(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void tiny_ir_optimize(tiny_ir_module_t *module, FILE *report)
+{
+    static const struct
+    {
+        const char *name;
+        int (*run)(tiny_ir_module_t *module);
+    } PASSES[] = {
+        {"inline", tiny_ir_inline},
+        {"constant propagation", tiny_ir_propagate_constants},
+        {"copy propagation", tiny_ir_propagate_copies},
+        {"common subexpression", tiny_ir_eliminate_common},
+        {"constant propagation", tiny_ir_propagate_constants},
+        {"dead code", tiny_ir_eliminate_dead},
+    };
+
+    for (size_t i = 0; i < sizeof(PASSES) / sizeof(PASSES[0]); ++i)
+    {
+        int before = report ? tiny_ir_count(module) : 0;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int changed = PASSES[i].run(module);
+        double ms = elapsed_ms(&start);
+        if (report)
+            fprintf(report, "%-22s %8.3f ms  %5d changed  %6d -> %d insns\n", PASSES[i].name, ms, changed, before,
+                    tiny_ir_count(module));
+    }
+}
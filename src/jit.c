@@ -0,0 +1,520 @@
+#include "jit.h"
+#include "error.h"
+#include "memo.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define TINY_JIT_ENABLED 1
+#else
+#define TINY_JIT_ENABLED 0
+#endif
+
+void tiny_jit_init(tiny_jit_t *jit, tiny_vm_t *vm, int threshold)
+{
+    int count = vm->program->function_count > 0 ? vm->program->function_count : 1;
+    jit->vm = vm;
+    jit->threshold = threshold;
+    jit->natives = calloc(count, sizeof(tiny_jit_func_t));
+    jit->counters = calloc(count, sizeof(int));
+    jit->depth = TINY_JIT_MAX_DEPTH;
+    jit->stack_end = vm->stack + vm->stack_size;
+    jit->frame = vm->frames;
+    jit->blocks = NULL;
+    jit->block_count = 0;
+    vm->jit = jit;
+}
+
+void tiny_jit_free(tiny_jit_t *jit)
+{
+#if TINY_JIT_ENABLED
+    for (int i = 0; i < jit->block_count; ++i)
+        munmap(jit->blocks[i].code, jit->blocks[i].size);
+#endif
+    free(jit->blocks);
+    free(jit->natives);
+    free(jit->counters);
+    jit->vm->jit = NULL;
+}
+
+#if TINY_JIT_ENABLED
+
+// 跳转目标：非负数为字节码的 pc，负数为函数末尾的公共出口
+#define LABEL_EXIT -1
+#define LABEL_OVERFLOW -2
+#define LABEL_DIVISION_BY_ZERO -3
+
+struct fixup_s
+{
+    int pos;    // rel32 在机器码中的位置
+    int target;
+};
+
+struct emitter_s
+{
+    uint8_t *buf;
+    int len, size;
+    int *offsets; // 每条字节码对应的机器码位置
+    int labels[4]; // 以 -target 为下标的公共出口位置
+    struct fixup_s *fixups;
+    int fixup_count, fixup_size;
+};
+
+static void emit_bytes(struct emitter_s *e, const void *bytes, int n)
+{
+    while (e->len + n > e->size)
+    {
+        e->size = e->size ? e->size * 2 : 256;
+        e->buf = realloc(e->buf, e->size);
+    }
+    memcpy(e->buf + e->len, bytes, n);
+    e->len += n;
+}
+
+#define EMIT(e, ...)                                           \
+    do                                                         \
+    {                                                          \
+        static const uint8_t bytes_[] = {__VA_ARGS__};         \
+        emit_bytes((e), bytes_, sizeof(bytes_));               \
+    } while (0)
+
+static void emit32(struct emitter_s *e, int32_t v)
+{
+    emit_bytes(e, &v, 4);
+}
+
+static void emit64(struct emitter_s *e, uint64_t v)
+{
+    emit_bytes(e, &v, 8);
+}
+
+/**
+ * 发出指向 target 的 rel32，在函数生成完毕后回填
+ */
+static void emit_rel32(struct emitter_s *e, int target)
+{
+    if (e->fixup_count == e->fixup_size)
+    {
+        e->fixup_size = e->fixup_size ? e->fixup_size * 2 : 32;
+        e->fixups = realloc(e->fixups, e->fixup_size * sizeof(struct fixup_s));
+    }
+    e->fixups[e->fixup_count].pos = e->len;
+    e->fixups[e->fixup_count].target = target;
+    e->fixup_count++;
+    emit32(e, 0);
+}
+
+// 虚拟寄存器 r[i] 位于 [rbx + 8 * i]，r12 保存 jit
+
+static void load_rax(struct emitter_s *e, int reg) // mov rax, [rbx + disp32]
+{
+    EMIT(e, 0x48, 0x8B, 0x83);
+    emit32(e, reg * 8);
+}
+
+static void load_rcx(struct emitter_s *e, int reg) // mov rcx, [rbx + disp32]
+{
+    EMIT(e, 0x48, 0x8B, 0x8B);
+    emit32(e, reg * 8);
+}
+
+static void store_rax(struct emitter_s *e, int reg) // mov [rbx + disp32], rax
+{
+    EMIT(e, 0x48, 0x89, 0x83);
+    emit32(e, reg * 8);
+}
+
+static void store_rdx(struct emitter_s *e, int reg) // mov [rbx + disp32], rdx
+{
+    EMIT(e, 0x48, 0x89, 0x93);
+    emit32(e, reg * 8);
+}
+
+static void load_xmm0(struct emitter_s *e, int reg) // movsd xmm0, [rbx + disp32]
+{
+    EMIT(e, 0xF2, 0x0F, 0x10, 0x83);
+    emit32(e, reg * 8);
+}
+
+static void load_xmm1(struct emitter_s *e, int reg) // movsd xmm1, [rbx + disp32]
+{
+    EMIT(e, 0xF2, 0x0F, 0x10, 0x8B);
+    emit32(e, reg * 8);
+}
+
+static void store_xmm0(struct emitter_s *e, int reg) // movsd [rbx + disp32], xmm0
+{
+    EMIT(e, 0xF2, 0x0F, 0x11, 0x83);
+    emit32(e, reg * 8);
+}
+
+static void store_imm32(struct emitter_s *e, int reg, int32_t v) // mov qword [rbx + disp32], imm32
+{
+    EMIT(e, 0x48, 0xC7, 0x83);
+    emit32(e, reg * 8);
+    emit32(e, v);
+}
+
+static void mov_rax_imm64(struct emitter_s *e, uint64_t v)
+{
+    EMIT(e, 0x48, 0xB8);
+    emit64(e, v);
+}
+
+static void mov_rdx_imm64(struct emitter_s *e, uint64_t v)
+{
+    EMIT(e, 0x48, 0xBA);
+    emit64(e, v);
+}
+
+static void mov_rsi_imm64(struct emitter_s *e, uint64_t v)
+{
+    EMIT(e, 0x48, 0xBE);
+    emit64(e, v);
+}
+
+/**
+ * 调用 C 函数，返回值非 0 时以它作为错误码退出
+ */
+static void call_checked(struct emitter_s *e, const void *func)
+{
+    mov_rax_imm64(e, (uint64_t)(uintptr_t)func);
+    EMIT(e, 0xFF, 0xD0);       // call rax
+    EMIT(e, 0x85, 0xC0);       // test eax, eax
+    EMIT(e, 0x0F, 0x85);       // jnz exit
+    emit_rel32(e, LABEL_EXIT);
+}
+
+static int jit_read(tiny_jit_t *jit, const char *name, int real, tiny_value_t *value)
+{
+    return tiny_runtime_read(&jit->vm->runtime, name, real, value);
+}
+
+static int jit_write(tiny_jit_t *jit, const char *name, int real, const tiny_value_t *value)
+{
+    return tiny_runtime_write(&jit->vm->runtime, name, real, *value);
+}
+
+static void emit_io(struct emitter_s *e, const tiny_insn_t *insn, const char *name, int real, const void *func)
+{
+    EMIT(e, 0x4C, 0x89, 0xE7); // mov rdi, r12
+    mov_rsi_imm64(e, (uint64_t)(uintptr_t)name);
+    EMIT(e, 0xBA);             // mov edx, imm32
+    emit32(e, real);
+    EMIT(e, 0x48, 0x8D, 0x8B); // lea rcx, [rbx + disp32]
+    emit32(e, insn->a * 8);
+    call_checked(e, func);
+}
+
+static void emit_insn(tiny_jit_t *jit, struct emitter_s *e, const tiny_function_t *f, const tiny_insn_t *insn)
+{
+    const tiny_program_t *program = jit->vm->program;
+    switch (insn->op)
+    {
+    case TINY_OP_MOV:
+        load_rax(e, insn->b);
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_LOADI:
+        store_imm32(e, insn->a, (int32_t)insn->bx);
+        break;
+    case TINY_OP_LOADK:
+        mov_rax_imm64(e, (uint64_t)f->consts[insn->bx].i);
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_ZERO:
+        store_imm32(e, insn->a, 0);
+        break;
+    case TINY_OP_GETG:
+        mov_rdx_imm64(e, (uint64_t)(uintptr_t)&jit->vm->globals[insn->bx]);
+        EMIT(e, 0x48, 0x8B, 0x02); // mov rax, [rdx]
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_SETG:
+        load_rax(e, insn->a);
+        mov_rdx_imm64(e, (uint64_t)(uintptr_t)&jit->vm->globals[insn->bx]);
+        EMIT(e, 0x48, 0x89, 0x02); // mov [rdx], rax
+        break;
+    case TINY_OP_ADDI:
+    case TINY_OP_SUBI:
+    case TINY_OP_MULI:
+        load_rax(e, insn->b);
+        load_rcx(e, insn->c);
+        if (insn->op == TINY_OP_ADDI)
+            EMIT(e, 0x48, 0x01, 0xC8); // add rax, rcx
+        else if (insn->op == TINY_OP_SUBI)
+            EMIT(e, 0x48, 0x29, 0xC8); // sub rax, rcx
+        else
+            EMIT(e, 0x48, 0x0F, 0xAF, 0xC1); // imul rax, rcx
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_DIVI:
+        load_rax(e, insn->b);
+        load_rcx(e, insn->c);
+        EMIT(e, 0x48, 0x85, 0xC9);       // test rcx, rcx
+        EMIT(e, 0x0F, 0x84);             // jz division_by_zero
+        emit_rel32(e, LABEL_DIVISION_BY_ZERO);
+        EMIT(e, 0x48, 0x83, 0xF9, 0xFF); // cmp rcx, -1
+        EMIT(e, 0x75, 0x05);             // jne 1f
+        EMIT(e, 0x48, 0xF7, 0xD8);       // neg rax，避免 INT64_MIN / -1 触发异常
+        EMIT(e, 0xEB, 0x05);             // jmp 2f
+        EMIT(e, 0x48, 0x99);             // 1: cqo
+        EMIT(e, 0x48, 0xF7, 0xF9);       // idiv rcx
+        store_rax(e, insn->a);           // 2:
+        break;
+    case TINY_OP_ADDR:
+    case TINY_OP_SUBR:
+    case TINY_OP_MULR:
+    case TINY_OP_DIVR:
+    {
+        static const uint8_t ops[] = {0x58, 0x5C, 0x59, 0x5E}; // addsd, subsd, mulsd, divsd
+        uint8_t code[] = {0xF2, 0x0F, ops[insn->op - TINY_OP_ADDR], 0xC1};
+        load_xmm0(e, insn->b);
+        load_xmm1(e, insn->c);
+        emit_bytes(e, code, sizeof(code)); // op xmm0, xmm1
+        store_xmm0(e, insn->a);
+        break;
+    }
+    case TINY_OP_EQI:
+    case TINY_OP_NEI:
+        load_rax(e, insn->b);
+        load_rcx(e, insn->c);
+        EMIT(e, 0x31, 0xD2);       // xor edx, edx
+        EMIT(e, 0x48, 0x39, 0xC8); // cmp rax, rcx
+        if (insn->op == TINY_OP_EQI)
+            EMIT(e, 0x0F, 0x94, 0xC2); // sete dl
+        else
+            EMIT(e, 0x0F, 0x95, 0xC2); // setne dl
+        store_rdx(e, insn->a);
+        break;
+    case TINY_OP_EQR:
+    case TINY_OP_NER:
+        // NaN 使 ZF 与 PF 同时置位，相等还要求 PF 为 0
+        load_xmm0(e, insn->b);
+        load_xmm1(e, insn->c);
+        EMIT(e, 0x31, 0xC0);             // xor eax, eax
+        EMIT(e, 0x31, 0xD2);             // xor edx, edx
+        EMIT(e, 0x66, 0x0F, 0x2E, 0xC1); // ucomisd xmm0, xmm1
+        if (insn->op == TINY_OP_EQR)
+        {
+            EMIT(e, 0x0F, 0x94, 0xC0); // sete al
+            EMIT(e, 0x0F, 0x9B, 0xC2); // setnp dl
+            EMIT(e, 0x21, 0xD0);       // and eax, edx
+        }
+        else
+        {
+            EMIT(e, 0x0F, 0x95, 0xC0); // setne al
+            EMIT(e, 0x0F, 0x9A, 0xC2); // setp dl
+            EMIT(e, 0x09, 0xD0);       // or eax, edx
+        }
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_I2R:
+        load_rax(e, insn->b);
+        EMIT(e, 0xF2, 0x48, 0x0F, 0x2A, 0xC0); // cvtsi2sd xmm0, rax
+        store_xmm0(e, insn->a);
+        break;
+    case TINY_OP_R2I:
+        load_xmm0(e, insn->b);
+        mov_rax_imm64(e, (uint64_t)(uintptr_t)tiny_real_to_int);
+        EMIT(e, 0xFF, 0xD0); // call rax
+        store_rax(e, insn->a);
+        break;
+    case TINY_OP_JMP:
+        EMIT(e, 0xE9);
+        emit_rel32(e, insn->bx);
+        break;
+    case TINY_OP_JZI:
+        load_rax(e, insn->a);
+        EMIT(e, 0x48, 0x85, 0xC0); // test rax, rax
+        EMIT(e, 0x0F, 0x84);       // jz target
+        emit_rel32(e, insn->bx);
+        break;
+    case TINY_OP_JZR:
+        load_xmm0(e, insn->a);
+        EMIT(e, 0x66, 0x0F, 0x57, 0xC9); // xorpd xmm1, xmm1
+        EMIT(e, 0x66, 0x0F, 0x2E, 0xC1); // ucomisd xmm0, xmm1
+        EMIT(e, 0x7A, 0x06);             // jp 1f，NaN 不等于 0
+        EMIT(e, 0x0F, 0x84);             // jz target
+        emit_rel32(e, insn->bx);
+        break;
+    case TINY_OP_CALL:
+        // 已编译的函数直接调用，否则经过 tiny_jit_enter
+        EMIT(e, 0x48, 0x8D, 0xBB); // lea rdi, [rbx + disp32]
+        emit32(e, insn->a * 8);
+        EMIT(e, 0x4C, 0x89, 0xE6); // mov rsi, r12
+        EMIT(e, 0xBA);             // mov edx, imm32
+        emit32(e, insn->bx);
+        mov_rax_imm64(e, (uint64_t)(uintptr_t)&jit->natives[insn->bx]);
+        EMIT(e, 0x48, 0x8B, 0x00); // mov rax, [rax]
+        EMIT(e, 0x48, 0x85, 0xC0); // test rax, rax
+        EMIT(e, 0x75, 0x0A);       // jnz 1f
+        mov_rax_imm64(e, (uint64_t)(uintptr_t)tiny_jit_enter);
+        EMIT(e, 0xFF, 0xD0);       // 1: call rax
+        EMIT(e, 0x85, 0xC0);       // test eax, eax
+        EMIT(e, 0x0F, 0x85);       // jnz exit
+        emit_rel32(e, LABEL_EXIT);
+        break;
+    case TINY_OP_RET:
+        load_rax(e, insn->a);
+        EMIT(e, 0x48, 0x89, 0x03); // mov [rbx], rax
+        EMIT(e, 0x31, 0xC0);       // xor eax, eax
+        EMIT(e, 0xE9);             // jmp exit
+        emit_rel32(e, LABEL_EXIT);
+        break;
+    case TINY_OP_RET0:
+        EMIT(e, 0x48, 0xC7, 0x03, 0x00, 0x00, 0x00, 0x00); // mov qword [rbx], 0
+        EMIT(e, 0x31, 0xC0);                               // xor eax, eax
+        EMIT(e, 0xE9);                                     // jmp exit
+        emit_rel32(e, LABEL_EXIT);
+        break;
+    case TINY_OP_READI:
+    case TINY_OP_READR:
+        emit_io(e, insn, program->strings[insn->bx], insn->op == TINY_OP_READR, jit_read);
+        break;
+    case TINY_OP_WRITEI:
+    case TINY_OP_WRITER:
+        emit_io(e, insn, program->strings[insn->bx], insn->op == TINY_OP_WRITER, jit_write);
+        break;
+    }
+}
+
+/**
+ * 生成函数 func 的机器码：
+ *
+ *     push rbx; push r12; push r13     保存寄存器，并使调用 C 函数时栈按 16 字节对齐
+ *     mov rbx, rdi; mov r12, rsi       rbx 为虚拟寄存器的起点，r12 为 jit
+ *     检查调用深度与值栈
+ *     ...                              逐条翻译的字节码
+ *   exit:
+ *     恢复调用深度与寄存器，eax 为错误码
+ */
+static tiny_jit_func_t compile(tiny_jit_t *jit, int func)
+{
+    const tiny_function_t *f = &jit->vm->program->functions[func];
+    struct emitter_s e = {0};
+    e.offsets = malloc((f->code_count + 1) * sizeof(int));
+
+    EMIT(&e, 0x53, 0x41, 0x54, 0x41, 0x55); // push rbx; push r12; push r13
+    EMIT(&e, 0x48, 0x89, 0xFB);             // mov rbx, rdi
+    EMIT(&e, 0x49, 0x89, 0xF4);             // mov r12, rsi
+    EMIT(&e, 0x41, 0xFF, 0x8C, 0x24);       // dec dword [r12 + depth]
+    emit32(&e, offsetof(tiny_jit_t, depth));
+    EMIT(&e, 0x0F, 0x84);                   // jz overflow
+    emit_rel32(&e, LABEL_OVERFLOW);
+    EMIT(&e, 0x48, 0x8D, 0x83);             // lea rax, [rbx + nregs * 8]
+    emit32(&e, f->nregs * 8);
+    EMIT(&e, 0x49, 0x3B, 0x84, 0x24);       // cmp rax, [r12 + stack_end]
+    emit32(&e, offsetof(tiny_jit_t, stack_end));
+    EMIT(&e, 0x0F, 0x87);                   // ja overflow
+    emit_rel32(&e, LABEL_OVERFLOW);
+
+    for (int pc = 0; pc < f->code_count; ++pc)
+    {
+        e.offsets[pc] = e.len;
+        emit_insn(jit, &e, f, &f->code[pc]);
+    }
+    e.offsets[f->code_count] = e.len;
+
+    e.labels[-LABEL_DIVISION_BY_ZERO] = e.len;
+    EMIT(&e, 0xB8); // mov eax, TINY_DIVISION_BY_ZERO
+    emit32(&e, TINY_DIVISION_BY_ZERO);
+    EMIT(&e, 0xE9);
+    emit_rel32(&e, LABEL_EXIT);
+    e.labels[-LABEL_OVERFLOW] = e.len;
+    EMIT(&e, 0xB8); // mov eax, TINY_STACK_OVERFLOW
+    emit32(&e, TINY_STACK_OVERFLOW);
+    e.labels[-LABEL_EXIT] = e.len;
+    EMIT(&e, 0x41, 0xFF, 0x84, 0x24); // inc dword [r12 + depth]
+    emit32(&e, offsetof(tiny_jit_t, depth));
+    EMIT(&e, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3); // pop r13; pop r12; pop rbx; ret
+
+    for (int i = 0; i < e.fixup_count; ++i)
+    {
+        int target = e.fixups[i].target;
+        int offset = target >= 0 ? e.offsets[target] : e.labels[-target];
+        int32_t rel = offset - (e.fixups[i].pos + 4);
+        memcpy(e.buf + e.fixups[i].pos, &rel, 4);
+    }
+
+    // 写入后再改为只读可执行，内存不会同时可写与可执行
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = (e.len + page - 1) / page * page;
+    void *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code != MAP_FAILED)
+    {
+        memcpy(code, e.buf, e.len);
+        if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(code, size);
+            code = MAP_FAILED;
+        }
+    }
+    free(e.buf);
+    free(e.offsets);
+    free(e.fixups);
+    if (code == MAP_FAILED)
+        return NULL;
+
+    jit->blocks = realloc(jit->blocks, (jit->block_count + 1) * sizeof(struct tiny_jit_block_s));
+    jit->blocks[jit->block_count].code = code;
+    jit->blocks[jit->block_count].size = size;
+    jit->block_count++;
+    return (tiny_jit_func_t)code;
+}
+
+#else
+
+static tiny_jit_func_t compile(tiny_jit_t *jit, int func)
+{
+    return NULL;
+}
+
+#endif
+
+tiny_jit_func_t tiny_jit_lookup(tiny_jit_t *jit, int func)
+{
+    if (jit->natives[func])
+        return jit->natives[func];
+    if (jit->counters[func] < 0 || ++jit->counters[func] <= jit->threshold)
+        return NULL;
+    // 机器码之间的调用不经过缓存，可缓存的函数一直由虚拟机解释执行，否则记忆化在编译后失效
+    if (jit->vm->memo && tiny_memo_cacheable(jit->vm->memo, func))
+    {
+        jit->counters[func] = -1;
+        return NULL;
+    }
+    tiny_jit_func_t native = compile(jit, func);
+    if (!native)
+        jit->counters[func] = -1;
+    jit->natives[func] = native;
+    return native;
+}
+
+int tiny_jit_enter(tiny_value_t *base, tiny_jit_t *jit, int func)
+{
+    tiny_jit_func_t native = tiny_jit_lookup(jit, func);
+    if (native)
+        return native(base, jit, func);
+
+    // 解释执行期间可能再次进入机器码并修改 jit->frame
+    tiny_vm_frame_t *frame = jit->frame;
+    tiny_value_t result;
+    int ret = tiny_vm_execute(jit->vm, func, base, frame, &result);
+    jit->frame = frame;
+    return ret;
+}
+
+int tiny_jit_call(tiny_jit_t *jit, int func, const tiny_value_t *args, tiny_value_t *result)
+{
+    tiny_vm_t *vm = jit->vm;
+    int nparams = vm->program->functions[func].nparams;
+    if (nparams > 0)
+        memcpy(vm->stack, args, nparams * sizeof(tiny_value_t));
+    jit->frame = vm->frames;
+    int ret = tiny_jit_enter(vm->stack, jit, func);
+    *result = vm->stack[0];
+    return ret;
+}
@@ -0,0 +1,265 @@
+#include "json.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct json_parser_s
+{
+    tiny_arena_t *arena;
+    const char *p, *e;
+    int depth;
+};
+
+static void skip_space(struct json_parser_s *j)
+{
+    while (j->p < j->e && (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r'))
+        j->p++;
+}
+
+static bool consume(struct json_parser_s *j, const char *word)
+{
+    size_t len = strlen(word);
+    if ((size_t)(j->e - j->p) < len || memcmp(j->p, word, len) != 0)
+        return false;
+    j->p += len;
+    return true;
+}
+
+static int hex4(const char *p)
+{
+    int v = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        char c = p[i];
+        int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0)
+            return -1;
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+static char *put_utf8(char *out, unsigned cp)
+{
+    if (cp < 0x80)
+    {
+        *out++ = cp;
+    }
+    else if (cp < 0x800)
+    {
+        *out++ = 0xc0 | (cp >> 6);
+        *out++ = 0x80 | (cp & 0x3f);
+    }
+    else if (cp < 0x10000)
+    {
+        *out++ = 0xe0 | (cp >> 12);
+        *out++ = 0x80 | ((cp >> 6) & 0x3f);
+        *out++ = 0x80 | (cp & 0x3f);
+    }
+    else
+    {
+        *out++ = 0xf0 | (cp >> 18);
+        *out++ = 0x80 | ((cp >> 12) & 0x3f);
+        *out++ = 0x80 | ((cp >> 6) & 0x3f);
+        *out++ = 0x80 | (cp & 0x3f);
+    }
+    return out;
+}
+
+/**
+ * 解析 j->p 处的字符串，解码后的长度不会超过源码中的长度
+ */
+static bool parse_string(struct json_parser_s *j, const char **string, size_t *len)
+{
+    if (j->p >= j->e || *j->p != '"')
+        return false;
+    const char *s = ++j->p;
+    while (j->p < j->e && *j->p != '"')
+        j->p += *j->p == '\\' ? 2 : 1;
+    if (j->p >= j->e)
+        return false;
+    const char *e = j->p++;
+
+    char *buf = tiny_arena_alloc(j->arena, e - s + 1), *out = buf;
+    while (s < e)
+    {
+        if (*s != '\\')
+        {
+            *out++ = *s++;
+            continue;
+        }
+        s++;
+        static const char ESCAPES[] = "\"\\/bfnrt", DECODED[] = "\"\\/\b\f\n\r\t";
+        const char *escape = *s ? strchr(ESCAPES, *s) : NULL;
+        if (escape)
+        {
+            *out++ = DECODED[escape - ESCAPES];
+            s++;
+            continue;
+        }
+        int cp = *s == 'u' && e - s >= 5 ? hex4(s + 1) : -1;
+        if (cp < 0)
+            return false;
+        s += 5;
+        // 代理对合并为一个码点
+        if (cp >= 0xd800 && cp < 0xdc00 && e - s >= 6 && s[0] == '\\' && s[1] == 'u')
+        {
+            int low = hex4(s + 2);
+            if (low >= 0xdc00 && low < 0xe000)
+            {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                s += 6;
+            }
+        }
+        out = put_utf8(out, cp);
+    }
+    *out = '\0';
+    *string = buf;
+    *len = out - buf;
+    return true;
+}
+
+static tiny_json_t *parse_value(struct json_parser_s *j);
+
+static tiny_json_t *make_json(struct json_parser_s *j, int type)
+{
+    tiny_json_t *json = tiny_arena_alloc(j->arena, sizeof(tiny_json_t));
+    memset(json, 0, sizeof(tiny_json_t));
+    json->type = type;
+    return json;
+}
+
+/**
+ * 解析数组或对象中以 close 结束的元素列表
+ */
+static tiny_json_t *parse_list(struct json_parser_s *j, int type, char close)
+{
+    tiny_json_t *json = make_json(j, type);
+    tiny_json_t **tail = &json->child;
+    j->p++;
+    skip_space(j);
+    if (j->p < j->e && *j->p == close)
+    {
+        j->p++;
+        return json;
+    }
+    while (true)
+    {
+        const char *key = NULL;
+        size_t key_len;
+        if (type == TINY_JSON_OBJECT)
+        {
+            skip_space(j);
+            if (!parse_string(j, &key, &key_len))
+                return NULL;
+            skip_space(j);
+            if (j->p >= j->e || *j->p++ != ':')
+                return NULL;
+        }
+        tiny_json_t *item = parse_value(j);
+        if (!item)
+            return NULL;
+        item->key = key;
+        *tail = item;
+        tail = &item->sibling;
+        skip_space(j);
+        if (j->p >= j->e)
+            return NULL;
+        if (*j->p == close)
+        {
+            j->p++;
+            return json;
+        }
+        if (*j->p++ != ',')
+            return NULL;
+    }
+}
+
+static tiny_json_t *parse_value(struct json_parser_s *j)
+{
+    skip_space(j);
+    if (j->p >= j->e)
+        return NULL;
+    tiny_json_t *json = NULL;
+    switch (*j->p)
+    {
+    case '{':
+    case '[':
+        if (j->depth >= TINY_JSON_MAX_DEPTH)
+            return NULL;
+        j->depth++;
+        json = *j->p == '{' ? parse_list(j, TINY_JSON_OBJECT, '}') : parse_list(j, TINY_JSON_ARRAY, ']');
+        j->depth--;
+        return json;
+    case '"':
+        json = make_json(j, TINY_JSON_STRING);
+        return parse_string(j, &json->string, &json->len) ? json : NULL;
+    case 't':
+        return consume(j, "true") ? make_json(j, TINY_JSON_TRUE) : NULL;
+    case 'f':
+        return consume(j, "false") ? make_json(j, TINY_JSON_FALSE) : NULL;
+    case 'n':
+        return consume(j, "null") ? make_json(j, TINY_JSON_NULL) : NULL;
+    default:
+    {
+        // strtod 需要以 '\0' 结尾的输入，数字不会很长
+        char buf[64];
+        size_t n = 0;
+        while (j->p + n < j->e && n + 1 < sizeof(buf) && strchr("+-0123456789.eE", j->p[n]))
+            n++;
+        memcpy(buf, j->p, n);
+        buf[n] = '\0';
+        char *end;
+        double number = strtod(buf, &end);
+        if (n == 0 || end != buf + n)
+            return NULL;
+        j->p += n;
+        json = make_json(j, TINY_JSON_NUMBER);
+        json->number = number;
+        return json;
+    }
+    }
+}
+
+tiny_json_t *tiny_json_parse(tiny_arena_t *arena, const char *s, size_t len)
+{
+    struct json_parser_s j = {arena, s, s + len, 0};
+    tiny_json_t *json = parse_value(&j);
+    skip_space(&j);
+    return j.p == j.e ? json : NULL;
+}
+
+const tiny_json_t *tiny_json_get(const tiny_json_t *json, const char *key)
+{
+    if (!json || json->type != TINY_JSON_OBJECT)
+        return NULL;
+    for (const tiny_json_t *item = json->child; item; item = item->sibling)
+        if (strcmp(item->key, key) == 0)
+            return item;
+    return NULL;
+}
+
+void tiny_json_print_string(FILE *stream, const char *s, size_t len)
+{
+    putc('"', stream);
+    for (const char *e = s + len; s < e; ++s)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            putc('\\', stream);
+            putc(c, stream);
+        }
+        else if (c == '\n')
+            fputs("\\n", stream);
+        else if (c == '\r')
+            fputs("\\r", stream);
+        else if (c == '\t')
+            fputs("\\t", stream);
+        else if (c < 0x20)
+            fprintf(stream, "\\u%04x", c);
+        else
+            putc(c, stream);
+    }
+    putc('"', stream);
+}
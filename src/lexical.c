@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdio.h>
 #include "string_util.h"
 
 void tiny_lex_begin(tiny_lex_t *lex, const char *code)
@@ -9,16 +10,27 @@ void tiny_lex_begin(tiny_lex_t *lex, const char *code)
     lex->code = code;
     lex->cur = 0;
     lex->len = strlen(code);
-    lex->line_number = 1;
-    lex->line_column = 0;
+    lex->symbols = NULL;
+    tiny_arena_init(&lex->arena);
+}
+
+void tiny_lex_end(tiny_lex_t *lex)
+{
+    tiny_arena_free(&lex->arena);
+}
+
+void tiny_lex_begin_range(tiny_lex_t *lex, const char *code, int begin, int end)
+{
+    lex->code = code;
+    lex->cur = begin;
+    lex->len = end;
+    lex->symbols = NULL;
+    tiny_arena_init(&lex->arena);
 }
 
 static int tiny_lex_next_char(tiny_lex_t *lex)
 {
-    int ch = lex->cur < lex->len ? (lex->line_column++, lex->code[lex->cur++]) : TINY_EOF;
-    if (ch == '\n')
-        lex->line_number++, lex->line_column = 0;
-    return ch;
+    return lex->cur < lex->len ? lex->code[lex->cur++] : TINY_EOF;
 }
 
 static int tiny_lex_peek_char(tiny_lex_t *lex, int offset)
@@ -26,38 +38,218 @@ static int tiny_lex_peek_char(tiny_lex_t *lex, int offset)
     return lex->cur + offset < lex->len ? lex->code[lex->cur + offset] : TINY_EOF;
 }
 
-tiny_lex_token_t tiny_lex_current_line(tiny_lex_token_t *token)
+/**
+ * 查找 [s, e) 中第一个多行注释结束符，返回其中 '*' 的位置，找不到时返回 NULL
+ */
+static const char *find_comment_end(const char *s, const char *e)
+{
+    while (s + 1 < e && (s = memchr(s, '*', e - s - 1)))
+    {
+        if (s[1] == '/')
+            return s;
+        s++;
+    }
+    return NULL;
+}
+
+void tiny_line_index_build(tiny_line_index_t *index, const char *code, int len)
 {
+    int size = 64;
+    index->code = code;
+    index->len = len;
+    index->base_line = 1;
+    index->base_column = 0;
+    index->starts = malloc(size * sizeof(int));
+    index->starts[0] = 0;
+    index->count = 1;
+
+    // memchr 一次比较多个字节，比逐字符统计换行快得多
+    const char *e = code + len;
+    for (const char *p = code; p < e && (p = memchr(p, '\n', e - p)); ++p)
+    {
+        if (index->count == size)
+            index->starts = realloc(index->starts, (size *= 2) * sizeof(int));
+        index->starts[index->count++] = p + 1 - code;
+    }
+}
+
+void tiny_line_index_free(tiny_line_index_t *index)
+{
+    free(index->starts);
+    index->starts = NULL;
+    index->count = 0;
+}
+
+void tiny_line_index_position(const tiny_line_index_t *index, const char *p, int *line_number, int *line_column)
+{
+    int offset = p - index->code;
+    int l = 0, r = index->count - 1;
+    while (l < r)
+    {
+        int mid = (l + r + 1) / 2;
+        if (index->starts[mid] <= offset)
+            l = mid;
+        else
+            r = mid - 1;
+    }
+    *line_number = index->base_line + l;
+    *line_column = offset - index->starts[l] + 1 + (l == 0 ? index->base_column : 0);
+}
+
+tiny_lex_token_t tiny_line_index_line(const tiny_line_index_t *index, int line_number)
+{
+    int l = line_number - index->base_line;
     tiny_lex_token_t line;
-    const char *s = token->s, *e = token->e;
-    while (s > token->head && *(s - 1) != '\n')
-        s--;
-    while (e + 1 < token->tail && *(e + 1) != '\n')
-        e++;
-    line.s = s;
-    line.e = e;
+    line.error = 0;
+    line.kind = TINY_TOKEN_NONE;
+    line.symbol = TINY_NO_SYMBOL;
+    line.head = index->code;
+    line.tail = index->code + index->len;
+    line.s = index->code + index->starts[l];
+    line.e = l + 1 < index->count ? index->code + index->starts[l + 1] - 1 : index->code + index->len;
     return line;
 }
 
+/**
+ * 解析 [s, e) 中的整数，进制为 base，超出 int64 范围时失败
+ */
+static bool decode_integer(const char *s, const char *e, int base, int64_t *value)
+{
+    uint64_t v = 0;
+    if (s >= e)
+        return false;
+    for (; s < e; ++s)
+    {
+        int d = isdigit(*s) ? *s - '0' : tolower(*s) - 'a' + 10;
+        if (!is_hex_digit(*s) || d >= base || v > ((uint64_t)INT64_MAX - d) / base)
+            return false;
+        v = v * base + d;
+    }
+    *value = v;
+    return true;
+}
+
+/**
+ * 解析 [s, e) 中的实数，格式已经检查过
+ *
+ * 有效数字不超过 19 位、尾数不超过 2^53 且 10 的幂次不超过 22 时，尾数和 10 的幂次都能被 double
+ * 精确表示，一次乘法或除法就能得到正确舍入的结果（Clinger 快速路径），其余情况交给 strtod
+ */
+static double decode_real(const char *s, const char *e)
+{
+    static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    uint64_t w = 0;
+    int digits = 0, exp10 = 0;
+    bool exact = true, dot = false;
+    const char *p;
+    for (p = s; p < e && (isdigit(*p) || *p == '.'); ++p)
+    {
+        if (*p == '.')
+        {
+            dot = true;
+            continue;
+        }
+        if (digits < 19)
+        {
+            w = w * 10 + (*p - '0');
+            if (w)
+                digits++;
+            if (dot)
+                exp10--;
+        }
+        else
+        {
+            if (*p != '0')
+                exact = false;
+            if (!dot)
+                exp10++;
+        }
+    }
+    if (p < e) // 指数部分
+    {
+        bool negative = *++p == '-';
+        if (*p == '+' || *p == '-')
+            p++;
+        int exp = 0;
+        for (; p < e; ++p)
+            if (exp < 100000)
+                exp = exp * 10 + (*p - '0');
+        exp10 += negative ? -exp : exp;
+    }
+
+    if (exact && w <= (1ULL << 53) && -22 <= exp10 && exp10 <= 22)
+        return exp10 < 0 ? w / POW10[-exp10] : w * POW10[exp10];
+
+    char buf[64];
+    char *str = e - s < (int)sizeof(buf) ? buf : malloc(e - s + 1);
+    memcpy(str, s, e - s);
+    str[e - s] = '\0';
+    double value = strtod(str, NULL);
+    if (str != buf)
+        free(str);
+    return value;
+}
+
+/**
+ * 确定以数字开头的 token 的种类并解码其值
+ */
+static void decode_number(tiny_lex_token_t *token)
+{
+    const char *s = token->s, *e = token->e;
+    token->kind = TINY_TOKEN_MALFORMED_NUMBER;
+    if (s + 1 < e && s[0] == '0' && tolower(s[1]) == 'x') // 十六进制整数
+    {
+        if (decode_integer(s + 2, e, 16, &token->value.integer))
+            token->kind = TINY_TOKEN_INT;
+        return;
+    }
+
+    const char *p = s;
+    while (p < e && isdigit(*p))
+        p++;
+    if (p == e) // 整数，以 0 开头时为八进制
+    {
+        if (decode_integer(*s == '0' && e - s > 1 ? s + 1 : s, e, *s == '0' ? 8 : 10, &token->value.integer))
+            token->kind = TINY_TOKEN_INT;
+        return;
+    }
+
+    if (*p == '.') // 小数点后可以没有数字
+        for (p++; p < e && isdigit(*p); p++)
+            ;
+    if (p < e && *p == 'e') // 指数部分已经由词法分析器检查过
+        for (p++; p < e && (isdigit(*p) || *p == '+' || *p == '-'); p++)
+            ;
+    if (p == e) // 多个小数点等情况不是合法的实数
+    {
+        token->kind = TINY_TOKEN_REAL;
+        token->value.real = decode_real(s, e);
+    }
+}
+
 int tiny_lex_next(tiny_lex_t *lex, tiny_lex_token_t *token)
 {
     int errcode = 0;
     token->head = lex->code;
     token->tail = lex->code + lex->len;
     token->error = 0;
+    token->kind = TINY_TOKEN_NONE;
+    token->symbol = TINY_NO_SYMBOL;
 
-    int c = tiny_lex_next_char(lex);
-    while (isspace(c))
-        c = tiny_lex_next_char(lex);
-
-    token->line_column = lex->line_column;
-    token->line_number = lex->line_number;
+    // 注释被跳过后继续读取下一个 token，用循环代替递归，避免连续的注释耗尽栈空间
+    while (true)
+    {
+        int c = tiny_lex_next_char(lex);
+        while (isspace(c))
+            c = tiny_lex_next_char(lex);
 
-    if (c == TINY_EOF)
-        return TINY_EOF;
+        if (c == TINY_EOF)
+        {
+            token->e = token->s = lex->code + lex->cur;
+            return TINY_EOF;
+        }
 
-    if (c != TINY_EOF)
-    {
         token->e = token->s = lex->code + (lex->cur - 1);
         if (c == '"' || c == '\'')
         {
@@ -84,13 +276,26 @@ int tiny_lex_next(tiny_lex_t *lex, tiny_lex_token_t *token)
                 }
             }
 
-            struct parse_string_literal_result_s ret = parse_string_literal(token->s, lex->code + lex->cur);
+            struct parse_string_literal_result_s ret = parse_string_literal(token->s, lex->code + lex->cur, NULL);
             if (ret.ret != 0)
             {
                 // 更新 token 的错误点
                 errcode = ret.ret;
                 goto fail;
             }
+
+            token->kind = cur == '"' ? TINY_TOKEN_STRING : TINY_TOKEN_CHAR;
+            token->value.string.len = ret.len;
+            if (!ret.escaped) // 不含转义序列时不复制
+                token->value.string.s = token->s + 1;
+            else
+            {
+                tiny_arena_t *arena = lex->symbols ? &lex->symbols->arena : &lex->arena;
+                char *buf = tiny_arena_alloc(arena, ret.len + 1);
+                parse_string_literal(token->s, lex->code + lex->cur, buf);
+                buf[ret.len] = '\0';
+                token->value.string.s = buf;
+            }
         }
         else if (isdigit(c))
         {
@@ -131,57 +336,57 @@ int tiny_lex_next(tiny_lex_t *lex, tiny_lex_token_t *token)
                         tiny_lex_next_char(lex);
                 }
             }
+            token->e = lex->code + lex->cur;
+            decode_number(token);
         }
         else if (!is_name_char(c)) // 符号
         {
             int len = is_symbol(c, tiny_lex_peek_char(lex, 0), tiny_lex_peek_char(lex, 1));
             while (--len > 0)
                 tiny_lex_next_char(lex);
+            token->kind = TINY_TOKEN_SYMBOL;
         }
         else // 标识符
         {
             while (c = tiny_lex_peek_char(lex, 0), is_name_char(c))
                 tiny_lex_next_char(lex);
+            token->kind = TINY_TOKEN_IDENTIFIER;
+            if (lex->symbols)
+                token->symbol = tiny_symbol_intern(lex->symbols, token->s, lex->code + lex->cur);
         }
-    }
 
-    token->e = lex->code + lex->cur;
-    if (strsecmp(token->s, token->e, "/*")) // 多行注释
-    {
-        while (tiny_lex_peek_char(lex, 0) != TINY_EOF && tiny_lex_peek_char(lex, 1) != TINY_EOF &&
-               (tiny_lex_peek_char(lex, 0) != '*' || tiny_lex_peek_char(lex, 1) != '/'))
+        token->e = lex->code + lex->cur;
+        if (strsecmp(token->s, token->e, "/*")) // 多行注释
         {
-            tiny_lex_next_char(lex);
+            const char *end = find_comment_end(token->e, lex->code + lex->len);
+            if (!end)
+            {
+                // 更新 token 的错误点
+                lex->cur = lex->len;
+                errcode = TINY_UNEXPECTED_EOF;
+                goto fail;
+            }
+            lex->cur = end + 2 - lex->code;
+            continue;
         }
 
-        if (tiny_lex_peek_char(lex, 0) == '*')
-        {
-            tiny_lex_next_char(lex);
-            tiny_lex_next_char(lex);
-        }
-        else
+        if (strsecmp(token->s, token->e, "//")) // 单行注释
         {
-            // 更新 token 的错误点
-            errcode = TINY_UNEXPECTED_EOF;
-            goto fail;
+            const char *end = memchr(token->e, '\n', lex->len - lex->cur);
+            lex->cur = end ? end + 1 - lex->code : lex->len;
+            continue;
         }
 
-        return tiny_lex_next(lex, token);
+        return 0;
     }
 
-    if (strsecmp(token->s, token->e, "//")) // 单行注释
-    {
-        while (c != TINY_EOF && c != '\n')
-            c = tiny_lex_next_char(lex);
-
-        return tiny_lex_next(lex, token);
-    }
-
-    return 0;
-
 fail:
+    // 词法错误的位置由 e 表示
     token->e = lex->code + (lex->cur - 1);
-    token->line_column = lex->line_column;
-    token->line_number = lex->line_number;
     return errcode;
 }
+
+void tiny_lex_reader(void *ctx, tiny_lex_token_t *token)
+{
+    token->error = tiny_lex_next(ctx, token);
+}
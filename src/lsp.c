@@ -0,0 +1,872 @@
+#define _GNU_SOURCE
+#include "lsp.h"
+#include "error.h"
+#include "incremental.h"
+#include "json.h"
+#include "syntax_def.h"
+#include "typecheck.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define JSONRPC_PARSE_ERROR -32700
+#define JSONRPC_METHOD_NOT_FOUND -32601
+#define JSONRPC_INVALID_PARAMS -32602
+
+#define SYMBOL_KIND_FUNCTION 12
+#define SYMBOL_KIND_VARIABLE 13
+
+/**
+ * 一个错误，位置为所在段源码中的偏移
+ */
+struct diag_s
+{
+    int error;
+    int s, e;             // 出错的 token
+    bool lexical;         // 词法错误的位置为 e，范围为空
+    const char *required; // TINY_UNEXPECTED_TOKEN 期望的 token
+};
+
+/**
+ * 上一次语义分析在一段中发现的错误，保存在段的 data 中
+ */
+struct diags_s
+{
+    struct diag_s *items;
+    int count, size;
+};
+
+/**
+ * 段的源码副本到段的映射，按 code 排序，用于找到语义错误中的 token 所在的段
+ */
+struct chunk_head_s
+{
+    const char *code;
+    int index;
+};
+
+struct document_s
+{
+    char *uri;
+    tiny_document_t source; // 文本与按顶层 func/vars 划分的段
+    tiny_line_index_t lines;
+    bool lines_valid;
+
+    tiny_symbol_table_t symbols;
+    bool analyzed; // resolve、check 与 heads 对应当前的语法树
+    bool pending;  // 修改之后还没有发布语义分析的结果
+    tiny_resolve_t resolve;
+    tiny_typecheck_t check;
+    struct chunk_head_s *heads;
+    int head_size;
+};
+
+struct lsp_s
+{
+    struct trie *parsers;
+    int in, out;
+
+    char *buf; // 已经读入但尚未处理的输入为 buf[start, len)
+    size_t start, len, size;
+    tiny_arena_t arena; // 当前消息的 JSON
+
+    struct document_s **docs;
+    int doc_count, doc_size;
+
+    bool shutdown, exit;
+};
+
+static void free_diags(void *data)
+{
+    struct diags_s *diags = data;
+    if (diags)
+        free(diags->items);
+    free(diags);
+}
+
+static struct diag_s *push_diag(tiny_chunk_t *chunk)
+{
+    if (!chunk->data)
+        chunk->data = calloc(1, sizeof(struct diags_s));
+    struct diags_s *diags = chunk->data;
+    if (diags->count == diags->size)
+    {
+        diags->size = diags->size ? diags->size * 2 : 4;
+        diags->items = realloc(diags->items, diags->size * sizeof(struct diag_s));
+    }
+    return &diags->items[diags->count++];
+}
+
+// ---------------------------------------------------------------- 文档
+
+static struct document_s *create_document(struct trie *parsers, const char *uri, size_t len)
+{
+    struct document_s *doc = calloc(1, sizeof(struct document_s));
+    doc->uri = strndup(uri, len);
+    tiny_symbol_table_init(&doc->symbols);
+    tiny_document_init(&doc->source, parsers, &doc->symbols);
+    doc->source.free_data = free_diags;
+    return doc;
+}
+
+/**
+ * 丢弃语义分析的结果，语法树在此之后可以修改
+ */
+static void invalidate(struct document_s *doc)
+{
+    if (doc->analyzed)
+    {
+        tiny_typecheck_free(&doc->check);
+        tiny_resolve_free(&doc->resolve);
+        doc->analyzed = false;
+    }
+    doc->pending = true;
+}
+
+static void free_document(struct document_s *doc)
+{
+    invalidate(doc);
+    tiny_document_free(&doc->source);
+    free(doc->heads);
+    if (doc->lines_valid)
+        tiny_line_index_free(&doc->lines);
+    tiny_symbol_table_free(&doc->symbols);
+    free(doc->uri);
+    free(doc);
+}
+
+static const tiny_line_index_t *document_lines(struct document_s *doc)
+{
+    if (!doc->lines_valid)
+    {
+        tiny_line_index_build(&doc->lines, doc->source.text, doc->source.len);
+        doc->lines_valid = true;
+    }
+    return &doc->lines;
+}
+
+/**
+ * UTF-8 序列的第一个字节决定其长度，码点超过 U+FFFF 时在 UTF-16 中占两个单元
+ */
+static int utf8_length(unsigned char c, int *units)
+{
+    *units = c >= 0xf0 ? 2 : 1;
+    return c < 0xc0 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+}
+
+/**
+ * 协议中的列号以 UTF-16 单元计数
+ */
+static int offset_of(struct document_s *doc, int line, int character)
+{
+    const tiny_line_index_t *lines = document_lines(doc);
+    if (line < 0)
+        return 0;
+    if (line >= lines->count)
+        return doc->source.len;
+    const char *text = doc->source.text;
+    const char *p = text + lines->starts[line], *e = text + doc->source.len;
+    while (character > 0 && p < e && *p != '\n')
+    {
+        int units, n = utf8_length(*p, &units);
+        p += n < e - p ? n : e - p;
+        character -= units;
+    }
+    return p - text;
+}
+
+static void print_position(FILE *stream, struct document_s *doc, int offset)
+{
+    int line, column;
+    const char *at = doc->source.text + offset;
+    tiny_line_index_position(document_lines(doc), at, &line, &column);
+    const char *p = at - (column - 1);
+    int character = 0;
+    while (p < at)
+    {
+        int units;
+        p += utf8_length(*p, &units);
+        character += units;
+    }
+    fprintf(stream, "{\"line\":%d,\"character\":%d}", line - 1, character);
+}
+
+static void print_range(FILE *stream, struct document_s *doc, int s, int e)
+{
+    fputs("{\"start\":", stream);
+    print_position(stream, doc, s);
+    fputs(",\"end\":", stream);
+    print_position(stream, doc, e);
+    fputs("}", stream);
+}
+
+/**
+ * 输出 chunk 中 [s, e) 在文档中的范围
+ */
+static void print_chunk_range(FILE *stream, struct document_s *doc, const tiny_chunk_t *chunk, const char *s,
+                              const char *e)
+{
+    print_range(stream, doc, chunk->offset + (s - chunk->code), chunk->offset + (e - chunk->code));
+}
+
+// ---------------------------------------------------------------- 解析
+
+/**
+ * 文本修改之后行号索引与语义分析的结果都失效
+ */
+static void changed(struct document_s *doc)
+{
+    invalidate(doc);
+    if (doc->lines_valid)
+        tiny_line_index_free(&doc->lines);
+    doc->lines_valid = false;
+}
+
+static void set_text(struct document_s *doc, const char *text, int len)
+{
+    changed(doc);
+    tiny_document_set_text(&doc->source, text, len);
+}
+
+/**
+ * 把文档中 [s, e) 替换为 text[0, len)，只重新解析受影响的段
+ */
+static void apply_change(struct document_s *doc, int s, int e, const char *text, int len)
+{
+    changed(doc);
+    tiny_edit_t edit = {s, e - s, text, len};
+    tiny_document_edit(&doc->source, edit);
+}
+
+/**
+ * 段的语法错误，位置为所在段源码中的偏移
+ */
+static struct diag_s syntax_diag(const tiny_chunk_t *chunk)
+{
+    struct diag_s diag;
+    diag.error = chunk->error;
+    diag.s = chunk->error_token.s - chunk->code;
+    diag.e = chunk->error_token.e - chunk->code;
+    diag.lexical = chunk->error_token.error != 0;
+    diag.required = chunk->required;
+    return diag;
+}
+
+// ---------------------------------------------------------------- 语义分析
+
+static int compare_heads(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)((const struct chunk_head_s *)a)->code;
+    uintptr_t y = (uintptr_t)((const struct chunk_head_s *)b)->code;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @return token 所在的段，token.head 是其所在段的源码副本
+ */
+static tiny_chunk_t *chunk_of(struct document_s *doc, const tiny_lex_token_t *token)
+{
+    struct chunk_head_s key = {token->head, 0};
+    struct chunk_head_s *head = bsearch(&key, doc->heads, doc->source.chunk_count, sizeof(key), compare_heads);
+    return head ? &doc->source.chunks[head->index] : NULL;
+}
+
+static void add_semantic_errors(struct document_s *doc, const tiny_semantic_error_t *errors, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        tiny_chunk_t *chunk = chunk_of(doc, &errors[i].token);
+        if (!chunk)
+            continue;
+        struct diag_s *diag = push_diag(chunk);
+        diag->error = errors[i].error;
+        diag->s = errors[i].token.s - chunk->code;
+        diag->e = errors[i].token.e - chunk->code;
+        diag->lexical = false;
+        diag->required = NULL;
+    }
+}
+
+/**
+ * 去掉类型检查插入的 TINY_DESC_CONVERT 节点，恢复解析得到的语法树，以便下一次重新检查
+ */
+static void remove_converts(tiny_ast_t **link)
+{
+    for (; *link; link = &(*link)->sibling)
+    {
+        while ((*link)->desc == TINY_DESC_CONVERT)
+        {
+            tiny_ast_t *conv = *link;
+            *link = conv->child;
+            conv->child->sibling = conv->sibling;
+            conv->child = conv->sibling = NULL;
+            tiny_free_ast(conv);
+        }
+        remove_converts(&(*link)->child);
+    }
+}
+
+/**
+ * 把所有段的 func/vars 临时连接到同一个 root 下进行名字解析与类型检查。
+ * 有语法错误时仍然解析其余的段以支持跳转，但其中的语义错误不可信，不予记录
+ */
+static void analyze(struct document_s *doc)
+{
+    if (doc->analyzed)
+        return;
+    tiny_ast_t *root = tiny_make_ast(TINY_DESC_ROOT);
+    tiny_ast_t **tail = &root->child;
+    tiny_chunk_t *chunks = doc->source.chunks;
+    int count = doc->source.chunk_count;
+    for (int i = 0; i < count; ++i)
+        if (chunks[i].item)
+            tail = tiny_ast_append(tail, chunks[i].item);
+    tiny_resolve(&doc->resolve, &doc->symbols, root);
+    tiny_typecheck(&doc->check, &doc->resolve, root);
+    doc->analyzed = true;
+
+    if (doc->head_size < count)
+    {
+        doc->head_size = count * 2;
+        doc->heads = realloc(doc->heads, doc->head_size * sizeof(struct chunk_head_s));
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        doc->heads[i].code = chunks[i].code;
+        doc->heads[i].index = i;
+        if (chunks[i].data)
+            ((struct diags_s *)chunks[i].data)->count = 0;
+    }
+    qsort(doc->heads, count, sizeof(struct chunk_head_s), compare_heads);
+    if (tiny_document_failed(&doc->source) == 0)
+    {
+        add_semantic_errors(doc, doc->resolve.errors, doc->resolve.error_count);
+        add_semantic_errors(doc, doc->check.errors, doc->check.error_count);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        tiny_ast_t *item = chunks[i].item;
+        if (item)
+        {
+            remove_converts(&item->child);
+            item->sibling = NULL;
+        }
+    }
+    root->child = NULL;
+    tiny_free_ast(root);
+}
+
+/**
+ * @return 包含 p 的最内层的名字引用
+ */
+static tiny_ast_t *find_reference(const tiny_resolve_t *resolve, tiny_ast_t *ast, const char *p)
+{
+    tiny_ast_t *found = NULL;
+    for (; ast; ast = ast->sibling)
+    {
+        if (ast->token.s && ast->token.s <= p && p <= ast->token.e && ast->id < resolve->node_count &&
+            resolve->decl_of[ast->id] >= 0)
+            found = ast;
+        tiny_ast_t *inner = find_reference(resolve, ast->child, p);
+        if (inner)
+            found = inner;
+    }
+    return found;
+}
+
+// ---------------------------------------------------------------- 消息
+
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return TINY_IO_ERROR;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * 消息的正文先写入内存，得到长度之后再与头部一起发出
+ */
+struct message_s
+{
+    FILE *stream;
+    char *data;
+    size_t len;
+};
+
+static FILE *begin_message(struct message_s *msg)
+{
+    msg->stream = open_memstream(&msg->data, &msg->len);
+    fputs("{\"jsonrpc\":\"2.0\",", msg->stream);
+    return msg->stream;
+}
+
+static void send_message(struct lsp_s *lsp, struct message_s *msg)
+{
+    fputs("}", msg->stream);
+    fclose(msg->stream);
+    char header[64];
+    int n = sprintf(header, "Content-Length: %zu\r\n\r\n", msg->len);
+    if (write_all(lsp->out, header, n) != 0 || write_all(lsp->out, msg->data, msg->len) != 0)
+        lsp->exit = true;
+    free(msg->data);
+}
+
+static void print_id(FILE *stream, const tiny_json_t *id)
+{
+    if (id && id->type == TINY_JSON_STRING)
+        tiny_json_print_string(stream, id->string, id->len);
+    else if (id && id->type == TINY_JSON_NUMBER)
+        fprintf(stream, "%.17g", id->number);
+    else
+        fputs("null", stream);
+}
+
+static FILE *begin_response(struct message_s *msg, const tiny_json_t *id)
+{
+    FILE *stream = begin_message(msg);
+    fputs("\"id\":", stream);
+    print_id(stream, id);
+    fputs(",\"result\":", stream);
+    return stream;
+}
+
+static void send_error(struct lsp_s *lsp, const tiny_json_t *id, int code, const char *message)
+{
+    struct message_s msg;
+    FILE *stream = begin_message(&msg);
+    fputs("\"id\":", stream);
+    print_id(stream, id);
+    fprintf(stream, ",\"error\":{\"code\":%d,\"message\":", code);
+    tiny_json_print_string(stream, message, strlen(message));
+    fputs("}", stream);
+    send_message(lsp, &msg);
+}
+
+static void print_diag(FILE *stream, struct document_s *doc, const tiny_chunk_t *chunk, const struct diag_s *diag,
+                       bool *first)
+{
+    const char *format = tiny_error_format(diag->error);
+    char *text = diag->error == TINY_UNEXPECTED_TOKEN && diag->required
+                     ? strdup(diag->required)
+                     : strndup(chunk->code + diag->s, diag->e - diag->s);
+    char *message = NULL;
+    if (!format || asprintf(&message, format, text) < 0)
+        message = NULL;
+
+    fputs(*first ? "{\"range\":" : ",{\"range\":", stream);
+    *first = false;
+    if (diag->lexical)
+        print_chunk_range(stream, doc, chunk, chunk->code + diag->e, chunk->code + diag->e);
+    else
+        print_chunk_range(stream, doc, chunk, chunk->code + diag->s, chunk->code + diag->e);
+    fprintf(stream, ",\"severity\":1,\"code\":%d,\"source\":\"tiny\",\"message\":", diag->error);
+    if (message)
+        tiny_json_print_string(stream, message, strlen(message));
+    else
+        fprintf(stream, "\"error %d\"", diag->error);
+    fputs("}", stream);
+    free(message);
+    free(text);
+}
+
+/**
+ * 发布所有语法错误；没有语法错误时再加上最近一次语义分析发现的、所在的段没有被修改过的错误
+ */
+static void publish_diagnostics(struct lsp_s *lsp, struct document_s *doc)
+{
+    struct message_s msg;
+    FILE *stream = begin_message(&msg);
+    fputs("\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":", stream);
+    tiny_json_print_string(stream, doc->uri, strlen(doc->uri));
+    fputs(",\"diagnostics\":[", stream);
+    bool first = true, semantic = tiny_document_failed(&doc->source) == 0;
+    for (int i = 0; i < doc->source.chunk_count; ++i)
+    {
+        const tiny_chunk_t *chunk = &doc->source.chunks[i];
+        const struct diags_s *diags = chunk->data;
+        if (chunk->error)
+        {
+            struct diag_s diag = syntax_diag(chunk);
+            print_diag(stream, doc, chunk, &diag, &first);
+        }
+        else if (semantic && diags)
+            for (int k = 0; k < diags->count; ++k)
+                print_diag(stream, doc, chunk, &diags->items[k], &first);
+    }
+    fputs("]}", stream);
+    send_message(lsp, &msg);
+}
+
+static void publish_empty(struct lsp_s *lsp, const char *uri)
+{
+    struct message_s msg;
+    FILE *stream = begin_message(&msg);
+    fputs("\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":", stream);
+    tiny_json_print_string(stream, uri, strlen(uri));
+    fputs(",\"diagnostics\":[]}", stream);
+    send_message(lsp, &msg);
+}
+
+/**
+ * 输入停止一段时间之后，为修改过的文档进行语义分析并发布结果。有语法错误时语义错误不可信，
+ * 语法错误在修改时已经发布过，不需要再分析
+ */
+static void publish_semantic(struct lsp_s *lsp)
+{
+    for (int i = 0; i < lsp->doc_count; ++i)
+    {
+        struct document_s *doc = lsp->docs[i];
+        if (!doc->pending)
+            continue;
+        doc->pending = false;
+        if (tiny_document_failed(&doc->source) == 0)
+        {
+            analyze(doc);
+            publish_diagnostics(lsp, doc);
+        }
+    }
+}
+
+static bool has_pending(const struct lsp_s *lsp)
+{
+    for (int i = 0; i < lsp->doc_count; ++i)
+        if (lsp->docs[i]->pending)
+            return true;
+    return false;
+}
+
+// ---------------------------------------------------------------- 请求
+
+static int json_int(const tiny_json_t *json)
+{
+    return json && json->type == TINY_JSON_NUMBER ? (int)json->number : 0;
+}
+
+static struct document_s *find_document(struct lsp_s *lsp, const tiny_json_t *params)
+{
+    const tiny_json_t *uri = tiny_json_get(tiny_json_get(params, "textDocument"), "uri");
+    if (!uri || uri->type != TINY_JSON_STRING)
+        return NULL;
+    for (int i = 0; i < lsp->doc_count; ++i)
+        if (strcmp(lsp->docs[i]->uri, uri->string) == 0)
+            return lsp->docs[i];
+    return NULL;
+}
+
+static int document_offset(struct document_s *doc, const tiny_json_t *position)
+{
+    return offset_of(doc, json_int(tiny_json_get(position, "line")), json_int(tiny_json_get(position, "character")));
+}
+
+static void handle_initialize(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)params;
+    struct message_s msg;
+    FILE *stream = begin_response(&msg, id);
+    fputs("{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+          "\"documentSymbolProvider\":true,\"definitionProvider\":true},"
+          "\"serverInfo\":{\"name\":\"tiny\"}}",
+          stream);
+    send_message(lsp, &msg);
+}
+
+static void handle_shutdown(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)params;
+    lsp->shutdown = true;
+    struct message_s msg;
+    fputs("null", begin_response(&msg, id));
+    send_message(lsp, &msg);
+}
+
+static void handle_exit(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)id, (void)params;
+    lsp->exit = true;
+}
+
+static void handle_did_open(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)id;
+    const tiny_json_t *item = tiny_json_get(params, "textDocument");
+    const tiny_json_t *uri = tiny_json_get(item, "uri"), *text = tiny_json_get(item, "text");
+    if (!uri || uri->type != TINY_JSON_STRING || !text || text->type != TINY_JSON_STRING)
+        return;
+    struct document_s *doc = find_document(lsp, params);
+    if (!doc)
+    {
+        if (lsp->doc_count == lsp->doc_size)
+        {
+            lsp->doc_size = lsp->doc_size ? lsp->doc_size * 2 : 4;
+            lsp->docs = realloc(lsp->docs, lsp->doc_size * sizeof(struct document_s *));
+        }
+        doc = lsp->docs[lsp->doc_count++] = create_document(lsp->parsers, uri->string, uri->len);
+    }
+    set_text(doc, text->string, text->len);
+    publish_diagnostics(lsp, doc);
+}
+
+static void handle_did_change(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)id;
+    struct document_s *doc = find_document(lsp, params);
+    const tiny_json_t *changes = tiny_json_get(params, "contentChanges");
+    if (!doc || !changes || changes->type != TINY_JSON_ARRAY)
+        return;
+    // 每个修改中的位置都是相对于应用了之前的修改之后的文档
+    for (const tiny_json_t *change = changes->child; change; change = change->sibling)
+    {
+        const tiny_json_t *range = tiny_json_get(change, "range"), *text = tiny_json_get(change, "text");
+        if (!text || text->type != TINY_JSON_STRING)
+            continue;
+        if (!range)
+        {
+            set_text(doc, text->string, text->len);
+            continue;
+        }
+        int s = document_offset(doc, tiny_json_get(range, "start"));
+        int e = document_offset(doc, tiny_json_get(range, "end"));
+        if (s > e)
+            s = e;
+        apply_change(doc, s, e, text->string, text->len);
+    }
+    publish_diagnostics(lsp, doc);
+}
+
+static void handle_did_close(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    (void)id;
+    struct document_s *doc = find_document(lsp, params);
+    if (!doc)
+        return;
+    publish_empty(lsp, doc->uri);
+    for (int i = 0; i < lsp->doc_count; ++i)
+        if (lsp->docs[i] == doc)
+            lsp->docs[i] = lsp->docs[--lsp->doc_count];
+    free_document(doc);
+}
+
+static void print_symbol(FILE *stream, struct document_s *doc, const tiny_chunk_t *chunk, const tiny_ast_t *item,
+                         const tiny_ast_t *name, int kind, bool *first)
+{
+    fputs(*first ? "{\"name\":" : ",{\"name\":", stream);
+    *first = false;
+    tiny_json_print_string(stream, name->token.s, name->token.e - name->token.s);
+    fprintf(stream, ",\"kind\":%d,\"range\":", kind);
+    print_chunk_range(stream, doc, chunk, tiny_ast_begin(item), tiny_ast_end(item));
+    fputs(",\"selectionRange\":", stream);
+    print_chunk_range(stream, doc, chunk, name->token.s, name->token.e);
+    fputs("}", stream);
+}
+
+static void handle_document_symbol(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    struct document_s *doc = find_document(lsp, params);
+    if (!doc)
+    {
+        send_error(lsp, id, JSONRPC_INVALID_PARAMS, "unknown document");
+        return;
+    }
+    struct message_s msg;
+    FILE *stream = begin_response(&msg, id);
+    fputs("[", stream);
+    bool first = true;
+    for (int i = 0; i < doc->source.chunk_count; ++i)
+    {
+        const tiny_chunk_t *chunk = &doc->source.chunks[i];
+        const tiny_ast_t *item = chunk->item;
+        if (!item)
+            continue;
+        const tiny_ast_t *type = item->child;
+        if (item->desc == TINY_DESC_FUNC) // func -> type [main] identifier ...
+            print_symbol(stream, doc, chunk, item, type->sibling->sibling, SYMBOL_KIND_FUNCTION, &first);
+        else if (item->desc == TINY_DESC_DECL) // vars -> type identifier (',' identifier)* ';'
+            for (const tiny_ast_t *name = type->sibling->child; name; name = name->sibling)
+                if (name->desc == TINY_DESC_IDENTIFIER)
+                    print_symbol(stream, doc, chunk, item, name, SYMBOL_KIND_VARIABLE, &first);
+    }
+    fputs("]", stream);
+    send_message(lsp, &msg);
+}
+
+static void handle_definition(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params)
+{
+    struct document_s *doc = find_document(lsp, params);
+    if (!doc)
+    {
+        send_error(lsp, id, JSONRPC_INVALID_PARAMS, "unknown document");
+        return;
+    }
+    int offset = document_offset(doc, tiny_json_get(params, "position"));
+    tiny_chunk_t *chunk = &doc->source.chunks[tiny_document_find(&doc->source, offset)];
+    const tiny_decl_t *decl = NULL;
+    if (chunk->item)
+    {
+        analyze(doc);
+        tiny_ast_t *ref = find_reference(&doc->resolve, chunk->item, chunk->code + (offset - chunk->offset));
+        if (ref)
+            decl = &doc->resolve.decls[doc->resolve.decl_of[ref->id]];
+    }
+
+    struct message_s msg;
+    FILE *stream = begin_response(&msg, id);
+    tiny_chunk_t *target = decl && decl->node ? chunk_of(doc, &decl->node->token) : NULL;
+    if (target)
+    {
+        fputs("{\"uri\":", stream);
+        tiny_json_print_string(stream, doc->uri, strlen(doc->uri));
+        fputs(",\"range\":", stream);
+        print_chunk_range(stream, doc, target, decl->node->token.s, decl->node->token.e);
+        fputs("}", stream);
+    }
+    else
+    {
+        fputs("null", stream);
+    }
+    send_message(lsp, &msg);
+}
+
+/**
+ * 没有 id 的是通知，不需要响应
+ */
+static const struct
+{
+    const char *method;
+    void (*handler)(struct lsp_s *lsp, const tiny_json_t *id, const tiny_json_t *params);
+} HANDLERS[] = {
+    {"initialize", handle_initialize},
+    {"shutdown", handle_shutdown},
+    {"exit", handle_exit},
+    {"textDocument/didOpen", handle_did_open},
+    {"textDocument/didChange", handle_did_change},
+    {"textDocument/didClose", handle_did_close},
+    {"textDocument/documentSymbol", handle_document_symbol},
+    {"textDocument/definition", handle_definition},
+};
+
+static void handle_message(struct lsp_s *lsp, const char *body, size_t len)
+{
+    tiny_arena_reset(&lsp->arena);
+    tiny_json_t *message = tiny_json_parse(&lsp->arena, body, len);
+    if (!message)
+    {
+        send_error(lsp, NULL, JSONRPC_PARSE_ERROR, "invalid JSON");
+        return;
+    }
+    const tiny_json_t *method = tiny_json_get(message, "method");
+    const tiny_json_t *id = tiny_json_get(message, "id");
+    // 客户端对服务器请求的响应没有 method，服务器不发出请求，忽略即可
+    if (!method || method->type != TINY_JSON_STRING)
+        return;
+    for (size_t i = 0; i < sizeof(HANDLERS) / sizeof(HANDLERS[0]); ++i)
+        if (strcmp(method->string, HANDLERS[i].method) == 0)
+        {
+            HANDLERS[i].handler(lsp, id, tiny_json_get(message, "params"));
+            return;
+        }
+    if (id)
+        send_error(lsp, id, JSONRPC_METHOD_NOT_FOUND, "method not found");
+}
+
+/**
+ * 从缓冲区中取出一条完整的消息
+ */
+static bool next_message(struct lsp_s *lsp, const char **body, size_t *len)
+{
+    const char *s = lsp->buf + lsp->start, *e = lsp->buf + lsp->len;
+    const char *end = memmem(s, e - s, "\r\n\r\n", 4);
+    if (!end)
+        return false;
+    size_t length = 0;
+    for (const char *line = s; line && line < end;)
+    {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            length = strtoul(line + 15, NULL, 10);
+        line = memchr(line, '\n', end - line);
+        line = line ? line + 1 : NULL;
+    }
+    if ((size_t)(e - end - 4) < length)
+        return false;
+    *body = end + 4;
+    *len = length;
+    lsp->start = end + 4 + length - lsp->buf;
+    return true;
+}
+
+/**
+ * @param timeout 等待输入的毫秒数，-1 表示一直等待
+ * @return 1 表示读到一条消息，0 表示超时，-1 表示输入结束
+ */
+static int read_message(struct lsp_s *lsp, int timeout, const char **body, size_t *len)
+{
+    while (!next_message(lsp, body, len))
+    {
+        if (timeout >= 0)
+        {
+            struct pollfd fd = {lsp->in, POLLIN, 0};
+            int ret = poll(&fd, 1, timeout);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret == 0)
+                return 0;
+        }
+        // 之前的消息已经处理完，把剩余的部分移到开头
+        memmove(lsp->buf, lsp->buf + lsp->start, lsp->len - lsp->start);
+        lsp->len -= lsp->start;
+        lsp->start = 0;
+        if (lsp->len == lsp->size)
+            lsp->buf = realloc(lsp->buf, lsp->size *= 2);
+        ssize_t n = read(lsp->in, lsp->buf + lsp->len, lsp->size - lsp->len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        lsp->len += n;
+    }
+    return 1;
+}
+
+int tiny_lsp_serve(struct trie *parsers, int in, int out)
+{
+    struct lsp_s lsp;
+    memset(&lsp, 0, sizeof(lsp));
+    lsp.parsers = parsers;
+    lsp.in = in;
+    lsp.out = out;
+    lsp.size = TINY_LSP_BUF_SIZE;
+    lsp.buf = malloc(lsp.size);
+    tiny_arena_init(&lsp.arena);
+
+    while (!lsp.exit)
+    {
+        const char *body;
+        size_t len;
+        int ret = read_message(&lsp, has_pending(&lsp) ? TINY_LSP_SEMANTIC_DELAY : -1, &body, &len);
+        if (ret < 0)
+            break;
+        if (ret == 0)
+            publish_semantic(&lsp);
+        else
+            handle_message(&lsp, body, len);
+    }
+
+    for (int i = 0; i < lsp.doc_count; ++i)
+        free_document(lsp.docs[i]);
+    free(lsp.docs);
+    tiny_arena_free(&lsp.arena);
+    free(lsp.buf);
+    return lsp.shutdown && lsp.exit ? 0 : 1;
+}
@@ -1,29 +1,53 @@
+#define _GNU_SOURCE // memfd_create
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "scanner.h"
 #include "lexical.h"
 #include "parser.h"
 #include "syntax_def.h"
+#include "push_parser.h"
+#include "resolve.h"
+#include "typecheck.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "jit.h"
+#include "walker.h"
+#include "cgen.h"
+#include "ir.h"
+#include "fold.h"
+#include "memo.h"
+#include "outbuf.h"
+#include "astbin.h"
+#include "parse_cache.h"
+#include "server.h"
+#include "lsp.h"
+#include "symindex.h"
+#include "diag.h"
+#include "error.h"
 
 #define BUF_SIZE 1024
+#define SERVER_DEFAULT_THREADS 4
 
 char *read_all(FILE *stream)
 {
     size_t len;
     size_t content_len = 0;
-    size_t content_size = BUF_SIZE;
+    size_t content_size = BUF_SIZE + 1;
     char *content = malloc(content_size);
     if (!content)
     {
         perror("not enough memory");
         exit(2);
     }
-    // TODO: 需要处理 buf 大小不足的问题
     while (len = fread(content + content_len, sizeof(char), BUF_SIZE, stream))
     {
         content_len += len;
-        while (content_size - (content_len + 1) < BUF_SIZE)
+        // 保证下一次 fread 和末尾的 '\0' 都有足够的空间
+        while (content_size < content_len + BUF_SIZE + 1)
         {
             content = realloc(content, content_size *= 2);
             if (!content)
@@ -40,269 +64,1174 @@ char *read_all(FILE *stream)
 
 static void print_token(tiny_lex_token_t token, FILE *stream)
 {
-    for (const char *c = token.s; c != token.e; ++c)
-        fputc(*c, stream);
+    fwrite(token.s, sizeof(char), token.e - token.s, stream);
 }
 
-static void print_error_message(tiny_lex_token_t *token, const char *message)
-{
-    fprintf(stderr, "%d:%d: error: ", token->line_number, token->line_column);
-    char t = *((char *)token->e);
-    *((char *)token->e) = 0;
-    fprintf(stderr, message, token->s);
-    *((char *)token->e) = t;
-    putchar('\n');
-    print_token(tiny_lex_current_line(token), stderr);
-    putchar('\n');
-    for (int i = 1; i < token->line_column; ++i)
-        putchar(' ');
-    putchar('^');
-    putchar('\n');
+/**
+ * 一个源文件的输出目标。处理单个文件时为 stdout 与 stderr，批处理时为内存中的缓冲区，
+ * 全部文件处理完后按文件的顺序输出
+ */
+struct report_s
+{
+    FILE *out, *err; // 错误信息连同出错的源码行与位置标记都写入 err
+    const char *name; // 不为 NULL 时加在每条错误信息之前
+    bool json;        // 错误信息以 JSON Lines 格式输出，每条一行
+};
+
+/**
+ * 排序后按 report 的格式输出 diags 中的所有诊断
+ */
+static void report_diags(const struct report_s *report, const tiny_line_index_t *lines, tiny_diags_t *diags)
+{
+    tiny_diags_sort(diags);
+    if (report->json)
+        tiny_diags_render_json(diags, lines, report->name, report->err);
+    else
+        tiny_diags_render(diags, lines, report->name, report->err);
 }
 
-static void error(tiny_lex_token_t *token, const char *required_token, int ret)
+/**
+ * 输出 token 处的一个错误
+ */
+static void error(const struct report_s *report, const tiny_line_index_t *lines, tiny_lex_token_t *token,
+                  const char *required_token, int ret)
 {
-    if (ret == TINY_UNEXPECTED_EOF)
+    tiny_diags_t diags;
+    tiny_diags_init(&diags);
+    tiny_diags_add_token(&diags, ret, lines->code, token, required_token);
+    report_diags(report, lines, &diags);
+    tiny_diags_free(&diags);
+}
+
+/**
+ * 解析结束后遍历 scanner 缓存的 token，每行输出一个，不输出 EOF 与出错的 token
+ */
+static void dump_tokens(tiny_scanner_t *scanner, tiny_outbuf_t *out)
+{
+    for (list_entry_t *entry = list_next(&scanner->tokens); entry != &scanner->tokens; entry = list_next(entry))
     {
-        print_error_message(token, "Unexpected EOF");
-        return;
+        tiny_lex_token_t *token = &le2scannertoken(entry, list)->token;
+        if (token->error < 0)
+            continue;
+        tiny_outbuf_write(out, token->s, token->e - token->s);
+        tiny_outbuf_putc(out, '\n');
     }
-    else if (ret == TINY_UNEXPECTED_TOKEN)
+}
+
+/**
+ * 每行输出一个节点：缩进、节点类型与 token，子节点多缩进一级。
+ * 只对子节点递归，兄弟节点在循环中输出，递归深度等于树的深度
+ */
+void print_ast(tiny_ast_t *ast, int indent, tiny_outbuf_t *out)
+{
+    for (; ast; ast = ast->sibling)
     {
-        char message[1024];
-        sprintf(message, "Unexpected token, required \"%s\"", required_token);
-        print_error_message(token, message);
-        return;
+        for (int i = 0; i < indent; ++i)
+            tiny_outbuf_write(out, "  ", 2);
+        tiny_outbuf_puts(out, tiny_desc_name(ast->desc));
+        tiny_outbuf_putc(out, ' ');
+        if (ast->desc == TINY_DESC_NUMBER && !ast->token.s) // 常量折叠的结果没有源码文本
+        {
+            if (ast->token.kind == TINY_TOKEN_INT)
+                tiny_outbuf_int(out, (long long)ast->token.value.integer);
+            else
+                tiny_outbuf_printf(out, "%.17g", ast->token.value.real);
+        }
+        else if (ast->desc != TINY_DESC_LAZY_BLOCK) // 惰性函数体的 token 覆盖整个函数体，不输出
+            tiny_outbuf_write(out, ast->token.s, ast->token.e - ast->token.s);
+        tiny_outbuf_putc(out, '\n');
+        if (ast->child)
+            print_ast(ast->child, indent + 1, out);
     }
-    else if (ret == TINY_INVALID_STRING)
+}
+
+/**
+ * 按 print_ast 的格式输出 tiny_astbin_write 写入的语法树，两者的结果应当完全相同
+ */
+static void print_astbin(const tiny_astbin_t *bin, const tiny_astbin_node_t *node, int indent, tiny_outbuf_t *out)
+{
+    for (; node; node = tiny_astbin_sibling(bin, node))
     {
-        print_error_message(token, "Invalid string literal");
-        return;
+        for (int i = 0; i < indent; ++i)
+            tiny_outbuf_write(out, "  ", 2);
+        tiny_outbuf_puts(out, tiny_desc_name(node->desc));
+        tiny_outbuf_putc(out, ' ');
+        if (node->desc == TINY_DESC_NUMBER && (node->flags & TINY_ASTBIN_NO_TEXT))
+        {
+            if (node->kind == TINY_TOKEN_INT)
+                tiny_outbuf_int(out, (long long)node->value.integer);
+            else
+                tiny_outbuf_printf(out, "%.17g", node->value.real);
+        }
+        else if (node->desc != TINY_DESC_LAZY_BLOCK)
+        {
+            size_t len;
+            const char *text = tiny_astbin_text(bin, node, &len);
+            tiny_outbuf_write(out, text, len);
+        }
+        tiny_outbuf_putc(out, '\n');
+        print_astbin(bin, tiny_astbin_child(bin, node), indent + 1, out);
     }
-    else if (ret == TINY_INVALID_STRING_X_NO_FOLLOWING_HEX_DIGITS)
+}
+
+/**
+ * 二进制语法树的输出目标：path 不为 NULL 时写入该文件，否则 fd 不为 -1 时写入该文件描述符，都没有时不输出
+ */
+struct bin_output_s
+{
+    const char *path;
+    int fd;
+};
+
+/**
+ * 输出语法树：文本格式写入 astfile，另外按 bin 以二进制格式输出
+ */
+static void output_ast(const struct report_s *report, tiny_ast_t *root, const char *code, tiny_outbuf_t *astfile,
+                       const struct bin_output_s *bin)
+{
+    if (astfile)
+        print_ast(root, 0, astfile);
+    if (bin->path && tiny_astbin_write(root, code, strlen(code), NULL, bin->path) != 0)
+        fprintf(report->err, "cannot write %s\n", bin->path);
+    else if (!bin->path && bin->fd != -1 && tiny_astbin_write_fd(root, code, strlen(code), NULL, bin->fd) != 0)
+        fprintf(report->err, "cannot write binary AST\n");
+}
+
+/**
+ * 输出函数签名和全局变量，函数体保持惰性不解析
+ * func -> type [main] identifier '(' formal_params ')' block
+ * vars -> type identifier (',' identifier)* ';'
+ */
+static void print_symbols(tiny_ast_t *item, FILE *stream)
+{
+    for (; item; item = item->sibling)
     {
-        print_error_message(token, "\\x used with no following hex digits");
-        return;
+        tiny_ast_t *type = item->child;
+        if (item->desc == TINY_DESC_FUNC)
+        {
+            tiny_ast_t *name = type->sibling->sibling;
+            tiny_ast_t *params = name->sibling->sibling;
+            fprintf(stream, "func ");
+            print_token(type->token, stream);
+            fprintf(stream, " ");
+            print_token(name->token, stream);
+            fprintf(stream, "(");
+            for (tiny_ast_t *param = params->child; param; param = param->sibling)
+            {
+                if (param->child) // formal_param -> type identifier
+                {
+                    print_token(param->child->token, stream);
+                    fprintf(stream, " ");
+                    print_token(param->child->sibling->token, stream);
+                }
+                else // ','
+                {
+                    fprintf(stream, ", ");
+                }
+            }
+            fprintf(stream, ")\n");
+        }
+        else if (item->desc == TINY_DESC_DECL)
+        {
+            fprintf(stream, "vars ");
+            print_token(type->token, stream);
+            fprintf(stream, " ");
+            for (tiny_ast_t *id = type->sibling->child; id; id = id->sibling)
+                print_token(id->token, stream);
+            fprintf(stream, "\n");
+        }
     }
-    else if (ret == TINY_INVALID_NUMBER)
+}
+
+struct stream_output_s
+{
+    tiny_outbuf_t *ast; // 为 NULL 时不输出语法树
+    bool symbols;
+};
+
+static void print_item(void *arg, tiny_ast_t *item)
+{
+    struct stream_output_s *output = arg;
+    if (output->symbols)
+        print_symbols(item, stdout);
+    else if (output->ast)
+        print_ast(item, 1, output->ast);
+    tiny_free_ast(item);
+}
+
+/**
+ * 分块读取源码并交给推送式解析器，每解析完一个顶层 func/vars 就立即输出
+ */
+static void parse_stream(const struct report_s *report, FILE *code_file, tiny_outbuf_t *astfile,
+                         tiny_symbol_table_t *table, bool lazy, bool symbols)
+{
+    struct stream_output_s output = {
+        .ast = astfile,
+        .symbols = symbols};
+    if (!symbols && astfile)
+        tiny_outbuf_puts(astfile, "root \n");
+
+    tiny_push_parser_t ctx;
+    tiny_parse_begin(&ctx, prepare_parsers(), lazy ? "lazy_root" : "root", &output, print_item);
+    ctx.symbols = table;
+
+    char buf[BUF_SIZE];
+    size_t len;
+    int ret = 0;
+    while (ret == 0 && (len = fread(buf, sizeof(char), BUF_SIZE, code_file)))
+        ret = tiny_parse_feed(&ctx, buf, len);
+    if (ret == 0)
+        ret = tiny_parse_finish(&ctx);
+    if (ret != 0)
     {
-        print_error_message(token, "Invalid number literal");
-        return;
+        tiny_line_index_t lines;
+        tiny_parse_line_index(&ctx, &lines);
+        error(report, &lines, &ctx.result.error_token, ctx.result.required_token, ret);
+        tiny_line_index_free(&lines);
     }
-    else if (ret == TINY_EXPECT_SEMICOLON)
+    tiny_parse_end(&ctx);
+}
+
+/**
+ * 输出错误恢复时记录的所有语法错误，解析最终失败时再加上使其失败的错误
+ */
+static void print_syntax_errors(const struct report_s *report, const char *code, size_t len,
+                                const tiny_parser_errors_t *errors, const tiny_parser_result_t *result)
+{
+    tiny_diags_t diags;
+    tiny_diags_init(&diags);
+    for (int i = 0; i < errors->count; ++i)
+        tiny_diags_add_token(&diags, errors->items[i].state, code, &errors->items[i].error_token,
+                             errors->items[i].required_token);
+    if (result->state != 0)
+        tiny_diags_add_token(&diags, result->state, code, &result->error_token, result->required_token);
+    // 只有在需要报告错误时才建立行索引
+    tiny_line_index_t lines;
+    tiny_line_index_build(&lines, code, len);
+    report_diags(report, &lines, &diags);
+    tiny_line_index_free(&lines);
+    tiny_diags_free(&diags);
+}
+
+/**
+ * 名字解析与类型检查的错误合在一起，按位置排序后输出
+ */
+static void print_semantic_errors(const struct report_s *report, const char *code, const tiny_resolve_t *resolve,
+                                  const tiny_typecheck_t *check)
+{
+    tiny_diags_t diags;
+    tiny_diags_init(&diags);
+    for (int i = 0; i < resolve->error_count; ++i)
+        tiny_diags_add_token(&diags, resolve->errors[i].error, code, &resolve->errors[i].token, NULL);
+    for (int i = 0; i < check->error_count; ++i)
+        tiny_diags_add_token(&diags, check->errors[i].error, code, &check->errors[i].token, NULL);
+    tiny_line_index_t lines;
+    tiny_line_index_build(&lines, code, strlen(code));
+    report_diags(report, &lines, &diags);
+    tiny_line_index_free(&lines);
+    tiny_diags_free(&diags);
+}
+
+#define RUN_NONE 0   // 只做语义检查
+#define RUN_VM 1     // 编译为字节码并执行
+#define RUN_WALKER 2 // 直接遍历 AST 执行
+#define RUN_DUMP 3   // 编译为字节码并输出
+#define RUN_JIT 4    // 编译为字节码执行，频繁调用的函数再编译为机器码
+#define RUN_EMIT_C 5 // 翻译为 C 源码并输出
+#define RUN_IR 6     // 翻译为 SSA 中间表示，优化后输出，各优化的耗时输出到 stderr
+#define RUN_IR_O0 7  // 翻译为 SSA 中间表示，不优化直接输出
+
+/**
+ * 报告寄存器超过 TINY_MAX_REGISTERS 的函数
+ */
+static void print_compile_error(const tiny_program_t *program, const tiny_symbol_table_t *symbols)
+{
+    for (int i = 0; i < program->function_count; ++i)
+        if (program->functions[i].nregs > TINY_MAX_REGISTERS)
+            fprintf(stderr, "error: function '%s' needs %d registers, at most %d are supported\n",
+                    tiny_symbol_name(symbols, program->functions[i].symbol), program->functions[i].nregs,
+                    TINY_MAX_REGISTERS);
+}
+
+/**
+ * 执行 MAIN 函数，报告运行时错误
+ * @param memo 虚拟机缓存纯函数的调用结果，并在 stderr 报告命中次数
+ */
+static void run_program(const tiny_typecheck_t *check, tiny_ast_t *root, int run, bool memo)
+{
+    tiny_value_t result;
+    int ret;
+    if (run == RUN_EMIT_C)
     {
-        print_error_message(token, "Expect ';', but found '%s'");
+        tiny_emit_c(check, root, stdout);
         return;
     }
-    else if (ret == TINY_EXPECT_LEFT_PARENTHESIS)
+    else if (run == RUN_IR || run == RUN_IR_O0)
     {
-        print_error_message(token, "Expect '(', but found '%s'");
+        tiny_ir_module_t module;
+        tiny_ir_build(&module, check, root);
+        if (run == RUN_IR)
+            tiny_ir_optimize(&module, stderr);
+        tiny_ir_dump(&module, check->resolve->symbols, stdout);
+        tiny_ir_free(&module);
         return;
     }
-    else if (ret == TINY_EXPECT_RIGHT_PARENTHESIS)
+    else if (run == RUN_DUMP)
     {
-        print_error_message(token, "Expect ')', but found '%s'");
+        tiny_program_t program;
+        if (tiny_compile(&program, check, root) == 0)
+            tiny_program_dump(&program, check->resolve->symbols, stdout);
+        else
+            print_compile_error(&program, check->resolve->symbols);
+        tiny_program_free(&program);
         return;
     }
-    else if (ret == TINY_EXPECT_BEGIN)
+    else if (run == RUN_VM || run == RUN_JIT)
     {
-        print_error_message(token, "Expect 'BEGIN', but found '%s'");
-        return;
+        tiny_program_t program;
+        if (tiny_compile(&program, check, root) != 0)
+        {
+            print_compile_error(&program, check->resolve->symbols);
+            tiny_program_free(&program);
+            return;
+        }
+        tiny_vm_t vm;
+        tiny_vm_init(&vm, &program);
+        tiny_memo_t cache;
+        if (memo)
+        {
+            tiny_memo_init(&cache, &program);
+            vm.memo = &cache;
+        }
+        tiny_jit_t jit;
+        if (run == RUN_JIT)
+            tiny_jit_init(&jit, &vm, TINY_JIT_THRESHOLD);
+        if (program.main < 0)
+            ret = TINY_NO_MAIN;
+        else if (run == RUN_JIT)
+            ret = tiny_jit_call(&jit, program.main, NULL, &result);
+        else
+            ret = tiny_vm_call(&vm, program.main, NULL, &result);
+        if (run == RUN_JIT)
+            tiny_jit_free(&jit);
+        if (memo)
+        {
+            int pure = 0;
+            for (int i = 0; i < program.function_count; ++i)
+                pure += tiny_memo_cacheable(&cache, i);
+            fprintf(stderr, "memo: %d cacheable functions, %ld hits, %ld misses\n", pure, cache.hits, cache.misses);
+            tiny_memo_free(&cache);
+        }
+        tiny_vm_free(&vm);
+        tiny_program_free(&program);
     }
-    else if (ret == TINY_EXPECT_END)
+    else
     {
-        print_error_message(token, "Expect 'END', but found '%s'");
-        return;
+        tiny_walker_t walker;
+        tiny_walker_init(&walker, check, root);
+        int main_func = tiny_walker_main(&walker);
+        ret = main_func < 0 ? TINY_NO_MAIN : tiny_walker_call(&walker, main_func, NULL, &result);
+        tiny_walker_free(&walker);
     }
-    else if (ret == TINY_EXPECT_IDENTIFIER)
+
+    if (ret == TINY_NO_MAIN)
+        fprintf(stderr, "error: no MAIN function\n");
+    else if (ret == TINY_DIVISION_BY_ZERO)
+        fprintf(stderr, "runtime error: division by zero\n");
+    else if (ret == TINY_STACK_OVERFLOW)
+        fprintf(stderr, "runtime error: stack overflow\n");
+    else if (ret == TINY_IO_ERROR)
+        fprintf(stderr, "runtime error: cannot read or write file\n");
+}
+
+/**
+ * 进行名字解析与类型检查，报告所有语义错误。没有错误时，run 为 RUN_NONE 则输出插入了类型转换的语法树，
+ * 否则执行 MAIN 函数
+ * @param astfile 为 NULL 时不输出语法树
+ * @param bin 见 output_ast
+ * @param fold 输出或执行之前先做常量折叠，并报告删除的节点数
+ * @param memo 见 run_program
+ * @return 是否没有语义错误
+ */
+static bool check_semantics(const struct report_s *report, const char *code, tiny_symbol_table_t *table,
+                            tiny_ast_t *root, tiny_outbuf_t *astfile, const struct bin_output_s *bin, int run,
+                            bool fold, bool memo)
+{
+    tiny_resolve_t resolve;
+    tiny_typecheck_t check;
+    tiny_resolve(&resolve, table, root);
+    tiny_typecheck(&check, &resolve, root);
+    if (resolve.error_count || check.error_count)
     {
-        print_error_message(token, "Expect an identifier, but found '%s'");
-        return;
+        print_semantic_errors(report, code, &resolve, &check);
+        tiny_typecheck_free(&check);
+        tiny_resolve_free(&resolve);
+        return false;
     }
-    else if (ret == TINY_EXPECT_STATEMENT)
+    if (fold)
+        fprintf(report->err, "fold: %d nodes eliminated\n", tiny_fold(&check, root));
+    if (run != RUN_NONE)
     {
-        print_error_message(token, "Expect a statement, but found '%s'");
-        return;
+        run_program(&check, root, run, memo);
     }
-    else if (ret == TINY_EXPECT_EXPRESSION)
+    else
     {
-        print_error_message(token, "Expect a statement, but found '%s'");
-        return;
+        output_ast(report, root, code, astfile, bin);
     }
-    else if (ret == TINY_EXPECT_TYPE)
+    tiny_typecheck_free(&check);
+    tiny_resolve_free(&resolve);
+    return true;
+}
+
+/**
+ * 命令行选项，处理每个文件时只读
+ */
+struct options_s
+{
+    bool lazy, symbols, check, fold, memo;
+    bool json; // 错误信息以 JSON Lines 格式输出
+    int run;
+    const char *cache_dir;
+};
+
+/**
+ * 一个源文件及其输出。输出文件名为 NULL 时不输出
+ */
+struct job_s
+{
+    const char *path; // "-" 表示标准输入
+    const char *ast_path, *tokens_path;
+    struct bin_output_s bin;
+    struct report_s report;
+    char *out_data, *err_data; // 批处理时 report 写入的内存
+    size_t out_len, err_len;
+    tiny_index_source_t *index; // 建立索引时提取的内容，不为 NULL 时不输出
+    bool ok;
+};
+
+/**
+ * 解析源码 code 并按选项输出。grammar 只读，可以被多个线程同时使用；
+ * table 与 cache 属于调用的线程，table 在使用前被清空
+ * @param code 以 '\0' 结尾
+ * @return 是否没有错误
+ */
+static bool process_code(const struct options_s *opt, struct trie *grammar, tiny_symbol_table_t *table,
+                         tiny_cache_t *cache, struct job_s *job, char *code)
+{
+    const struct report_s *report = &job->report;
+    size_t len = strlen(code);
+
+    if (job->index)
     {
-        print_error_message(token, "Expect a statement, but found '%s'");
-        return;
+        // 内容与旧索引中记录的相同时不再解析
+        uint64_t hash = tiny_hash64(code, len, 0);
+        if (job->index->known && job->index->hash == hash)
+        {
+            job->index->reused = true;
+            return true;
+        }
+        job->index->hash = hash;
     }
-    else if (ret == TINY_EXPECT_COMMA)
+
+    tiny_outbuf_t astbuf, tokenbuf;
+    tiny_outbuf_t *astfile = NULL, *tokenfile = NULL;
+    if (job->ast_path)
     {
-        print_error_message(token, "Expect ',', but found '%s'");
-        return;
+        if (tiny_outbuf_open(&astbuf, job->ast_path) != 0)
+            fprintf(report->err, "cannot open %s\n", job->ast_path);
+        else
+            astfile = &astbuf;
     }
-    else if (ret == TINY_EXPECT_FUNC_VARS)
+    if (job->tokens_path)
     {
-        print_error_message(token, "Expect function or variable declaration");
-        return;
+        if (tiny_outbuf_open(&tokenbuf, job->tokens_path) != 0)
+            fprintf(report->err, "cannot open %s\n", job->tokens_path);
+        else
+            tokenfile = &tokenbuf;
     }
-    else if (ret == TINY_MAY_FUNC_CALL)
+
+    bool ok = true;
+    tiny_astbin_t cached;
+    if (cache && tiny_cache_lookup(cache, code, len, &cached))
     {
-        print_error_message(token, "Unexpected token '%s', maybe you want a func call?");
-        return;
+        // 命中时直接从缓存项输出，不进行词法与语法分析
+        if (tokenfile)
+        {
+            for (uint64_t i = 0; i < cached.header->token_count; ++i)
+            {
+                size_t token_len;
+                const char *text = tiny_astbin_token_text(&cached, i, &token_len);
+                tiny_outbuf_write(tokenfile, text, token_len);
+                tiny_outbuf_putc(tokenfile, '\n');
+            }
+        }
+        if (astfile)
+            print_astbin(&cached, tiny_astbin_node(&cached, 0), 0, astfile);
+        tiny_astbin_close(&cached);
     }
-    else if (ret == TINY_UNTERMINATED_STRING_OR_CHARACTER)
+    else
     {
-        print_error_message(token, "Unterminated string or character");
-        return;
+        // 所有标识符在词法分析时被加入同一个符号表
+        tiny_symbol_table_reset(table);
+        tiny_lex_t lex;
+        tiny_lex_begin(&lex, code);
+        lex.symbols = table;
+
+        tiny_scanner_t scanner;
+        tiny_scanner_begin(&scanner, &lex, tiny_lex_reader);
+
+        // 语法错误被跳过后继续解析，一次报告所有错误
+        tiny_parser_errors_t errors;
+        tiny_parser_errors_init(&errors);
+        tiny_parser_ctx_t ctx;
+        ctx.parsers = grammar;
+        ctx.current_parser = trie_search(grammar, opt->lazy ? "lazy_root" : "root");
+        ctx.errors = &errors;
+        tiny_parser_result_t result = tiny_syntax_parse(ctx, &scanner);
+        bool parsed = result.state == 0 && errors.count == 0;
+        if (parsed && job->index)
+        {
+            tiny_index_collect(job->index, result.ast, code, len);
+        }
+        else if (parsed && opt->symbols)
+        {
+            print_symbols(result.ast->child, report->out);
+        }
+        else if (parsed && opt->check)
+        {
+            // 惰性模式下先解析所有函数体，语义检查需要完整的语法树
+            tiny_parser_result_t bodies = tiny_syntax_materialize_all(grammar, table, result.ast);
+            if (bodies.state != 0)
+            {
+                print_syntax_errors(report, code, len, &errors, &bodies);
+                ok = false;
+            }
+            else
+            {
+                ok = check_semantics(report, code, table, result.ast, astfile, &job->bin, opt->run, opt->fold,
+                                     opt->memo);
+            }
+        }
+        else if (parsed)
+        {
+            output_ast(report, result.ast, code, astfile, &job->bin);
+            if (cache && tiny_cache_store(cache, code, len, result.ast, &scanner) != 0)
+                fprintf(report->err, "cannot write cache entry\n");
+        }
+        else
+        {
+            print_syntax_errors(report, code, len, &errors, &result);
+            // 恢复后的语法树含有 error 节点，只写入 ast.txt
+            if (result.state == 0 && astfile && !opt->symbols)
+                print_ast(result.ast, 0, astfile);
+            ok = false;
+        }
+
+        if (tokenfile)
+            dump_tokens(&scanner, tokenfile);
+        if (result.state == 0)
+            tiny_free_ast(result.ast);
+        tiny_parser_errors_free(&errors);
+        tiny_scanner_end(&scanner);
+        tiny_lex_end(&lex);
     }
+
+    if (tokenfile && tiny_outbuf_close(tokenfile) != 0)
+        fprintf(report->err, "cannot write %s\n", job->tokens_path);
+    if (astfile && tiny_outbuf_close(astfile) != 0)
+        fprintf(report->err, "cannot write %s\n", job->ast_path);
+    return ok;
 }
 
-void lex_reader(void *ctx, tiny_lex_token_t *token)
+/**
+ * 读取 job->path 后由 process_code 处理
+ */
+static bool process_file(const struct options_s *opt, struct trie *grammar, tiny_symbol_table_t *table,
+                         tiny_cache_t *cache, struct job_s *job)
 {
-    static FILE *tokens = NULL;
-    if (!tokens)
-        tokens = fopen("tokens.txt", "w");
+    FILE *code_file = strcmp(job->path, "-") == 0 ? stdin : fopen(job->path, "r");
+    if (!code_file)
+    {
+        fprintf(job->report.err, "%s: file not found\n", job->path);
+        return false;
+    }
+    char *code = read_all(code_file);
+    if (code_file != stdin)
+        fclose(code_file);
+    bool ok = process_code(opt, grammar, table, cache, job, code);
+    free(code);
+    return ok;
+}
+
+/**
+ * 批处理的工作线程。每个线程的任务是 jobs 中一段连续的下标 [lo, hi)，从 lo 端依次处理；
+ * 自己的任务做完后从其他线程的 hi 端取走剩余任务的一半
+ */
+struct worker_s
+{
+    pthread_t thread;
+    pthread_mutex_t lock; // 保护 lo 与 hi
+    int lo, hi;
+    tiny_symbol_table_t table; // 处理每个文件前清空，内存在文件之间复用
+    tiny_cache_t cache;
+    bool use_cache;
+    struct pool_s *pool;
+    int index;
+};
+
+struct pool_s
+{
+    const struct options_s *opt;
+    struct trie *grammar;
+    struct job_s *jobs;
+    struct worker_s *workers;
+    int nworkers;
+};
+
+/**
+ * @return 下一个任务的下标，所有线程都没有剩余任务时返回 -1
+ */
+static int next_job(struct worker_s *self)
+{
+    pthread_mutex_lock(&self->lock);
+    int job = self->lo < self->hi ? self->lo++ : -1;
+    pthread_mutex_unlock(&self->lock);
+    if (job >= 0)
+        return job;
+
+    // 任务只会减少，依次检查所有线程都没有取到任务时说明已经全部分配
+    struct pool_s *pool = self->pool;
+    for (int k = 1; k < pool->nworkers; ++k)
+    {
+        struct worker_s *victim = &pool->workers[(self->index + k) % pool->nworkers];
+        pthread_mutex_lock(&victim->lock);
+        int lo = victim->lo + (victim->hi - victim->lo) / 2, hi = victim->hi;
+        victim->hi = lo;
+        pthread_mutex_unlock(&victim->lock);
+        if (lo < hi)
+        {
+            pthread_mutex_lock(&self->lock);
+            self->lo = lo + 1;
+            self->hi = hi;
+            pthread_mutex_unlock(&self->lock);
+            return lo;
+        }
+    }
+    return -1;
+}
 
-    int ret = tiny_lex_next(ctx, token);
-    token->error = ret;
-    if (ret >= 0)
+static void *worker_main(void *arg)
+{
+    struct worker_s *self = arg;
+    struct pool_s *pool = self->pool;
+    int index;
+    while ((index = next_job(self)) >= 0)
     {
-        print_token(*token, tokens);
-        fputc('\n', tokens);
+        struct job_s *job = &pool->jobs[index];
+        job->report.out = open_memstream(&job->out_data, &job->out_len);
+        job->report.err = open_memstream(&job->err_data, &job->err_len);
+        job->ok = process_file(pool->opt, pool->grammar, &self->table, self->use_cache ? &self->cache : NULL, job);
+        fclose(job->report.out);
+        fclose(job->report.err);
     }
-    else if (ret == TINY_EOF)
+    return NULL;
+}
+
+/**
+ * 读取标准输入中的文件列表，每行一个路径，忽略空行
+ */
+static int read_file_list(char ***paths)
+{
+    int count = 0, size = 16;
+    *paths = malloc(size * sizeof(char *));
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, stdin)) > 0)
     {
-        return;
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+            line[--n] = '\0';
+        if (n == 0)
+            continue;
+        if (count == size)
+            *paths = realloc(*paths, (size *= 2) * sizeof(char *));
+        (*paths)[count++] = strdup(line);
+    }
+    free(line);
+    return count;
+}
+
+static char *concat(const char *a, const char *b)
+{
+    char *s = malloc(strlen(a) + strlen(b) + 1);
+    strcpy(s, a);
+    strcat(s, b);
+    return s;
+}
+
+/**
+ * 用 nworkers 个线程处理 jobs 中的所有任务，每个任务的输出写入自己的 out_data 与 err_data
+ * @param total 累计各线程的缓存统计
+ */
+static void run_pool(const struct options_s *opt, struct trie *grammar, struct job_s *jobs, int count, int nworkers,
+                     uint64_t cache_limit, uint64_t fingerprint, tiny_cache_t *total)
+{
+    if (nworkers > count)
+        nworkers = count > 0 ? count : 1;
+    struct pool_s pool = {opt, grammar, jobs, calloc(nworkers, sizeof(struct worker_s)), nworkers};
+    for (int w = 0; w < nworkers; ++w)
+    {
+        struct worker_s *worker = &pool.workers[w];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->lo = (int)((long long)count * w / nworkers);
+        worker->hi = (int)((long long)count * (w + 1) / nworkers);
+        tiny_symbol_table_init(&worker->table);
+        worker->use_cache = opt->cache_dir &&
+                            tiny_cache_init(&worker->cache, opt->cache_dir, cache_limit, fingerprint) == 0;
+        worker->pool = &pool;
+        worker->index = w;
+    }
+    for (int w = 0; w < nworkers; ++w)
+        pthread_create(&pool.workers[w].thread, NULL, worker_main, &pool.workers[w]);
+
+    // 其他线程可能还在窃取已结束线程的任务，全部结束后才能销毁锁
+    for (int w = 0; w < nworkers; ++w)
+        pthread_join(pool.workers[w].thread, NULL);
+    for (int w = 0; w < nworkers; ++w)
+    {
+        struct worker_s *worker = &pool.workers[w];
+        if (worker->use_cache)
+        {
+            total->hits += worker->cache.hits;
+            total->misses += worker->cache.misses;
+            total->stores += worker->cache.stores;
+            total->evictions += worker->cache.evictions;
+        }
+        tiny_symbol_table_free(&worker->table);
+        pthread_mutex_destroy(&worker->lock);
+    }
+    free(pool.workers);
+}
+
+/**
+ * 用 nworkers 个线程处理 paths 中的所有文件，文法只构造一次。
+ * 每个文件的输出写入 <path>.tokens.txt、<path>.ast.txt 与 <path>.ast.bin，
+ * 错误信息带有文件名，全部处理完后按 paths 的顺序输出，与线程的调度无关
+ * @return 出错的文件数
+ */
+static int process_batch(const struct options_s *opt, struct trie *grammar, char **paths, int count, int nworkers,
+                         bool dump_tokens_file, bool dump_ast_file, bool ast_bin, uint64_t cache_limit,
+                         uint64_t fingerprint)
+{
+    struct job_s *jobs = calloc(count, sizeof(struct job_s));
+    for (int i = 0; i < count; ++i)
+    {
+        jobs[i].path = paths[i];
+        jobs[i].tokens_path = dump_tokens_file ? concat(paths[i], ".tokens.txt") : NULL;
+        jobs[i].ast_path = dump_ast_file ? concat(paths[i], ".ast.txt") : NULL;
+        jobs[i].bin.path = ast_bin ? concat(paths[i], ".ast.bin") : NULL;
+        jobs[i].bin.fd = -1;
+        jobs[i].report.name = paths[i];
+        jobs[i].report.json = opt->json;
+    }
+
+    tiny_cache_t total = {0};
+    run_pool(opt, grammar, jobs, count, nworkers, cache_limit, fingerprint, &total);
+
+    int failed = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        fwrite(jobs[i].out_data, sizeof(char), jobs[i].out_len, stdout);
+        fwrite(jobs[i].err_data, sizeof(char), jobs[i].err_len, stderr);
+        failed += !jobs[i].ok;
+        free(jobs[i].out_data);
+        free(jobs[i].err_data);
+        free((char *)jobs[i].tokens_path);
+        free((char *)jobs[i].ast_path);
+        free((char *)jobs[i].bin.path);
+    }
+    fprintf(stderr, "jobs: %d files, %d failed\n", count, failed);
+    if (opt->cache_dir)
+        fprintf(stderr, "cache: %ld hits, %ld misses, %ld stores, %ld evictions\n", total.hits, total.misses,
+                total.stores, total.evictions);
+    free(jobs);
+    return failed;
+}
+
+struct index_s
+{
+    struct trie *grammar;
+    int nworkers;
+    bool json;
+};
+
+/**
+ * 建立索引时用 nworkers 个线程解析源文件
+ */
+static int parse_sources(void *arg, tiny_index_source_t *sources, int count)
+{
+    struct index_s *index = arg;
+    struct job_s *jobs = calloc(count ? count : 1, sizeof(struct job_s));
+    for (int i = 0; i < count; ++i)
+    {
+        jobs[i].path = sources[i].path;
+        jobs[i].bin.fd = -1;
+        jobs[i].report.name = sources[i].path;
+        jobs[i].report.json = index->json;
+        jobs[i].index = &sources[i];
+    }
+
+    // 只需要完整的语法树，不输出也不使用解析缓存
+    struct options_s opt = {.run = RUN_NONE};
+    tiny_cache_t total = {0};
+    run_pool(&opt, index->grammar, jobs, count, index->nworkers, 0, 0, &total);
+
+    int failed = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        fwrite(jobs[i].err_data, sizeof(char), jobs[i].err_len, stderr);
+        free(jobs[i].out_data);
+        free(jobs[i].err_data);
+        if (!jobs[i].ok)
+        {
+            sources[i].hash = 0;
+            failed++;
+        }
+    }
+    free(jobs);
+    return failed;
+}
+
+/**
+ * 用 nworkers 个线程解析 paths 中的目录与文件，写入符号索引 index_path
+ * @return 出错的文件数，不能写入索引时为 -1
+ */
+static int build_index(struct trie *grammar, const char *index_path, char **paths, int count, int nworkers,
+                       bool json)
+{
+    struct index_s index = {grammar, nworkers, json};
+    return tiny_index_build(index_path, tiny_grammar_fingerprint(grammar, "root"), paths, count, parse_sources,
+                            &index);
+}
+
+/**
+ * 服务模式。文法只构造一次，每个工作线程的符号表与解析缓存在请求之间复用
+ */
+struct server_s
+{
+    const struct options_s *opt;
+    struct trie *grammar;
+    uint64_t cache_limit;
+    tiny_cache_t total; // 累计各线程的缓存统计
+};
+
+struct server_worker_s
+{
+    tiny_symbol_table_t table;
+    tiny_cache_t cache[2]; // 以 lazy 为下标，两种起始产生式的文法指纹不同
+    bool use_cache[2];
+    struct server_s *server;
+};
+
+static void *server_init(void *arg)
+{
+    struct server_s *server = arg;
+    struct server_worker_s *self = calloc(1, sizeof(struct server_worker_s));
+    tiny_symbol_table_init(&self->table);
+    for (int lazy = 0; lazy < 2; ++lazy)
+        self->use_cache[lazy] =
+            server->opt->cache_dir &&
+            tiny_cache_init(&self->cache[lazy], server->opt->cache_dir, server->cache_limit,
+                            tiny_grammar_fingerprint(server->grammar, lazy ? "lazy_root" : "root")) == 0;
+    self->server = server;
+    return self;
+}
+
+static void server_handle(void *state, const tiny_request_t *request, const char *name, char *code,
+                          tiny_server_reply_t *reply)
+{
+    struct server_worker_s *self = state;
+
+    // 请求只能选择解析与检查的方式，不能执行程序，也不写入文本格式的 token 与语法树
+    struct options_s opt = {.run = RUN_NONE};
+    opt.symbols = (request->flags & TINY_REQUEST_SYMBOLS) != 0;
+    opt.lazy = opt.symbols || (request->flags & TINY_REQUEST_LAZY);
+    opt.fold = (request->flags & TINY_REQUEST_FOLD) != 0;
+    opt.check = opt.fold || (request->flags & TINY_REQUEST_CHECK);
+    bool ast_bin = (request->flags & TINY_REQUEST_AST_BIN) && !opt.symbols;
+    bool use_cache = self->use_cache[opt.lazy] && !opt.check && !opt.symbols && !ast_bin;
+
+    struct job_s job = {.path = name, .bin = {NULL, -1}};
+    job.report.name = name;
+    job.report.out = open_memstream(&job.out_data, &job.out_len);
+    job.report.err = open_memstream(&job.err_data, &job.err_len);
+    if (ast_bin)
+        job.bin.fd = memfd_create("ast.bin", MFD_CLOEXEC);
+
+    tiny_cache_t *cache = use_cache ? &self->cache[opt.lazy] : NULL;
+    if (code)
+    {
+        job.ok = process_code(&opt, self->server->grammar, &self->table, cache, &job, code);
+    }
+    else if (strcmp(name, "-") == 0) // 服务进程的标准输入不属于客户端
+    {
+        fprintf(job.report.err, "-: file not found\n");
+        job.ok = false;
     }
     else
     {
-        // error(token, "", ret);
+        job.ok = process_file(&opt, self->server->grammar, &self->table, cache, &job);
     }
+    fclose(job.report.out);
+    fclose(job.report.err);
+
+    reply->failed = !job.ok;
+    reply->out = job.out_data;
+    reply->err = job.err_data;
+    reply->out_len = job.out_len;
+    reply->err_len = job.err_len;
+    reply->ast_fd = job.bin.fd;
 }
 
-void print_ast(tiny_ast_t *ast, int indent, FILE *stream)
-{
-    for (int i = 0; i < indent; ++i)
-        fprintf(stream, "  ");
-    switch (ast->desc)
-    {
-    case TINY_DESC_ELIMINATE:
-        fprintf(stream, "-");
-        break;
-    case TINY_DESC_UNARY:
-        fprintf(stream, "unary");
-        break;
-    case TINY_DESC_BINARY:
-        fprintf(stream, "binary");
-        break;
-    case TINY_DESC_IF:
-        fprintf(stream, "if");
-        break;
-    case TINY_DESC_WHILE:
-        fprintf(stream, "while");
-        break;
-    case TINY_DESC_FOR:
-        fprintf(stream, "for");
-        break;
-    case TINY_DESC_FUNC:
-        fprintf(stream, "func");
-        break;
-    case TINY_DESC_NUMBER:
-        fprintf(stream, "number");
-        break;
-    case TINY_DESC_CALL:
-        fprintf(stream, "call");
-        break;
-    case TINY_DESC_DECL:
-        fprintf(stream, "vars");
-        break;
-    case TINY_DESC_ASSIGN:
-        fprintf(stream, "assignment");
-        break;
-    case TINY_DESC_ROOT:
-        fprintf(stream, "root");
-        break;
-    case TINY_DESC_TYPE:
-        fprintf(stream, "type ");
-        break;
-    case TINY_DESC_IDENTIFIER:
-        fprintf(stream, "id");
-        break;
-    case TINY_DESC_FORMAL_PARAMS:
-        fprintf(stream, "formal_params");
-        break;
-    case TINY_DESC_FORMAL_PARAM:
-        fprintf(stream, "formal_param");
-        break;
-    case TINY_DESC_BLOCK:
-        fprintf(stream, "block");
-        break;
-    case TINY_DESC_STATEMENT:
-        fprintf(stream, "statement");
-        break;
-    case TINY_DESC_STRING:
-        fprintf(stream, "string");
-        break;
-    case TINY_DESC_ACTUAL_PARAMS:
-        fprintf(stream, "params");
-        break;
-    case TINY_DESC_RETURN:
-        fprintf(stream, "return");
-        break;
-    case TINY_DESC_EXPR:
-        fprintf(stream, "expression");
-        break;
-    case TINY_DESC_MAIN:
-        fprintf(stream, "main");
-        break;
-    case TINY_DESC_CHAR:
-        fprintf(stream, "char");
-        break;
-    }
-    fprintf(stream, " ");
-    print_token(ast->token, stream);
-    fprintf(stream, "\n");
-    if (ast->child)
-        print_ast(ast->child, indent + 1, stream);
-    if (ast->sibling)
-        print_ast(ast->sibling, indent, stream);
+static void server_end(void *arg, void *state)
+{
+    struct server_s *server = arg;
+    struct server_worker_s *self = state;
+    for (int lazy = 0; lazy < 2; ++lazy)
+    {
+        if (!self->use_cache[lazy])
+            continue;
+        server->total.hits += self->cache[lazy].hits;
+        server->total.misses += self->cache[lazy].misses;
+        server->total.stores += self->cache[lazy].stores;
+        server->total.evictions += self->cache[lazy].evictions;
+    }
+    tiny_symbol_table_free(&self->table);
+    free(self);
+}
+
+/**
+ * 在 Unix 域套接字 socket_path 上提供解析服务，直到收到 SIGINT 或 SIGTERM
+ * @return 退出码
+ */
+static int serve(const struct options_s *opt, struct trie *grammar, const char *socket_path, int nworkers,
+                 uint64_t cache_limit)
+{
+    struct server_s server = {.opt = opt, .grammar = grammar, .cache_limit = cache_limit};
+    tiny_server_handler_t handler = {server_init, server_handle, server_end, &server};
+    int ret = tiny_server_run(socket_path, nworkers, &handler);
+    if (ret == 0 && opt->cache_dir)
+        fprintf(stderr, "cache: %ld hits, %ld misses, %ld stores, %ld evictions\n", server.total.hits,
+                server.total.misses, server.total.stores, server.total.evictions);
+    return ret;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc <= 1)
+    struct options_s opt = {.run = RUN_NONE};
+    bool stream = false;
+    bool dump_tokens_file = true, dump_ast_file = true, ast_bin = false, load_ast = false;
+    uint64_t cache_limit = TINY_CACHE_DEFAULT_LIMIT;
+    int jobs = 0;
+    const char *serve_path = NULL;
+    bool lsp = false;
+    const char *index_path = NULL;
+    char **paths = malloc(argc * sizeof(char *));
+    int path_count = 0;
+    for (int i = 1; i < argc; ++i)
     {
-        perror("you should specify code file path");
-        exit(1);
+        if (strcmp(argv[i], "--lazy") == 0)
+            opt.lazy = true;
+        else if (strcmp(argv[i], "--symbols") == 0)
+            opt.lazy = opt.symbols = true;
+        else if (strcmp(argv[i], "--stream") == 0)
+            stream = true;
+        else if (strcmp(argv[i], "--check") == 0)
+            opt.check = true;
+        else if (strcmp(argv[i], "--fold") == 0)
+            opt.check = opt.fold = true;
+        else if (strcmp(argv[i], "--no-tokens") == 0)
+            dump_tokens_file = false;
+        else if (strcmp(argv[i], "--no-ast") == 0)
+            dump_ast_file = false;
+        else if (strcmp(argv[i], "--ast-bin") == 0)
+            ast_bin = true;
+        else if (strcmp(argv[i], "--load-ast") == 0)
+            load_ast = true;
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            opt.cache_dir = argv[++i];
+        else if (strcmp(argv[i], "--cache-limit") == 0 && i + 1 < argc) // 单位为 MB
+            cache_limit = strtoull(argv[++i], NULL, 10) << 20;
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+            serve_path = argv[++i];
+        else if (strcmp(argv[i], "--json-diagnostics") == 0)
+            opt.json = true;
+        else if (strcmp(argv[i], "--lsp") == 0)
+            lsp = true;
+        else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc)
+            index_path = argv[++i];
+        else if (strcmp(argv[i], "--memo") == 0)
+            opt.memo = true;
+        else if (strcmp(argv[i], "--run") == 0)
+            opt.check = true, opt.run = RUN_VM;
+        else if (strcmp(argv[i], "--walk") == 0)
+            opt.check = true, opt.run = RUN_WALKER;
+        else if (strcmp(argv[i], "--jit") == 0)
+            opt.check = true, opt.run = RUN_JIT;
+        else if (strcmp(argv[i], "--emit-c") == 0)
+            opt.check = true, opt.run = RUN_EMIT_C;
+        else if (strcmp(argv[i], "--bytecode") == 0)
+            opt.check = true, opt.run = RUN_DUMP;
+        else if (strcmp(argv[i], "--ir") == 0)
+            opt.check = true, opt.run = RUN_IR;
+        else if (strcmp(argv[i], "--ir-O0") == 0)
+            opt.check = true, opt.run = RUN_IR_O0;
+        else
+            paths[path_count++] = argv[i];
     }
+    // 执行需要完整的函数体，且不输出 tokens.txt 与 ast.txt
+    if (opt.run != RUN_NONE)
+        opt.lazy = opt.symbols = stream = dump_tokens_file = dump_ast_file = false;
+    // 只输出符号时没有语法树，推送式解析不经过 scanner，没有 token 可输出
+    if (opt.symbols)
+        dump_ast_file = false;
+    if (stream)
+        dump_tokens_file = false;
+    // 缓存只保存 token 与语法树，语义检查、执行与 ast.bin 仍然需要完整的解析
+    if (opt.check || opt.symbols || stream || ast_bin)
+        opt.cache_dir = NULL;
 
-    FILE *code_file = fopen(argv[1], "r");
-    FILE *astfile = fopen("ast.txt", "w");
-    if (!code_file)
+    struct trie *grammar = prepare_parsers();
+    const char *root_name = opt.lazy ? "lazy_root" : "root";
+
+    // 语言服务器：通过标准输入与标准输出与编辑器通信
+    if (lsp)
     {
-        perror("file not found");
-        exit(2);
+        free(paths);
+        return tiny_lsp_serve(grammar, STDIN_FILENO, STDOUT_FILENO);
     }
 
-    char *code = read_all(code_file);
+    // 建立符号索引：其余参数为目录或文件，--jobs 为线程数，默认为处理器数
+    if (index_path)
+    {
+        if (jobs <= 0)
+            jobs = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+        int failed = build_index(grammar, index_path, paths, path_count, jobs, opt.json);
+        free(paths);
+        return failed == 0 ? 0 : failed < 0 ? 2 : 1;
+    }
 
-    tiny_lex_t lex;
-    tiny_lex_begin(&lex, code);
+    // 服务模式：--jobs 为工作线程数，每个请求自己选择解析的方式
+    if (serve_path)
+    {
+        free(paths);
+        return serve(&opt, grammar, serve_path, jobs > 0 ? jobs : SERVER_DEFAULT_THREADS, cache_limit);
+    }
 
-    tiny_scanner_t scanner;
-    tiny_scanner_begin(&scanner, &lex, lex_reader);
+    // 批处理：没有给出文件时从标准输入读取文件列表
+    if (jobs > 0)
+    {
+        if (opt.run != RUN_NONE || stream || load_ast)
+        {
+            fprintf(stderr, "error: --jobs cannot be used to run programs or with --stream and --load-ast\n");
+            exit(1);
+        }
+        char **list = paths;
+        int count = path_count;
+        if (count == 0)
+            count = read_file_list(&list);
+        int failed = process_batch(&opt, grammar, list, count, jobs, dump_tokens_file, dump_ast_file, ast_bin,
+                                   cache_limit, tiny_grammar_fingerprint(grammar, root_name));
+        if (list != paths)
+        {
+            for (int i = 0; i < count; ++i)
+                free(list[i]);
+            free(list);
+        }
+        free(paths);
+        return failed ? 1 : 0;
+    }
 
-    tiny_parser_ctx_t ctx;
-    ctx.parsers = prepare_parsers();
-    ctx.current_parser = trie_search(ctx.parsers, "root");
-    tiny_parser_result_t result = tiny_syntax_parse(ctx, &scanner);
-    if (result.state == 0)
+    const char *code_path = path_count > 0 ? paths[path_count - 1] : NULL;
+    free(paths);
+    if (!code_path)
     {
-        print_ast(result.ast, 0, astfile);
+        perror("you should specify code file path");
+        exit(1);
     }
-    else
+
+    // code_path 为 tiny_astbin_write 写入的文件，读取后以文本格式写入 ast.txt
+    if (load_ast)
+    {
+        tiny_astbin_t bin;
+        tiny_outbuf_t out;
+        int ret = tiny_astbin_open(&bin, code_path);
+        if (ret == TINY_INVALID_AST_FILE)
+        {
+            fprintf(stderr, "error: %s is not a valid AST file\n", code_path);
+            exit(2);
+        }
+        else if (ret != 0 || tiny_outbuf_open(&out, "ast.txt") != 0)
+        {
+            perror("cannot open file");
+            exit(2);
+        }
+        print_astbin(&bin, tiny_astbin_node(&bin, 0), 0, &out);
+        if (tiny_outbuf_close(&out) != 0)
+            perror("cannot write ast.txt");
+        tiny_astbin_close(&bin);
+        return 0;
+    }
+
+    if (stream)
+    {
+        // "-" 表示从标准输入读取源码
+        FILE *code_file = strcmp(code_path, "-") == 0 ? stdin : fopen(code_path, "r");
+        if (!code_file)
+        {
+            perror("file not found");
+            exit(2);
+        }
+        tiny_outbuf_t astbuf;
+        tiny_outbuf_t *astfile = NULL;
+        if (dump_ast_file)
+        {
+            if (tiny_outbuf_open(&astbuf, "ast.txt") != 0)
+                perror("cannot open ast.txt");
+            else
+                astfile = &astbuf;
+        }
+        tiny_symbol_table_t table;
+        tiny_symbol_table_init(&table);
+        struct report_s report = {stdout, stderr, NULL, opt.json};
+        parse_stream(&report, code_file, astfile, &table, opt.lazy, opt.symbols);
+        if (astfile && tiny_outbuf_close(astfile) != 0)
+            perror("cannot write ast.txt");
+        tiny_symbol_table_free(&table);
+        return 0;
+    }
+
+    struct job_s job = {
+        .path = code_path,
+        .tokens_path = dump_tokens_file ? "tokens.txt" : NULL,
+        .ast_path = dump_ast_file ? "ast.txt" : NULL,
+        .bin = {ast_bin ? "ast.bin" : NULL, -1},
+        .report = {stdout, stderr, NULL, opt.json}};
+    tiny_cache_t cache;
+    if (opt.cache_dir &&
+        tiny_cache_init(&cache, opt.cache_dir, cache_limit, tiny_grammar_fingerprint(grammar, root_name)) != 0)
     {
-        error(&result.error_token, result.required_token, result.state);
+        perror("cannot open cache directory");
+        opt.cache_dir = NULL;
     }
-    
+    tiny_symbol_table_t table;
+    tiny_symbol_table_init(&table);
+    process_file(&opt, grammar, &table, opt.cache_dir ? &cache : NULL, &job);
+    if (opt.cache_dir)
+        fprintf(stderr, "cache: %ld hits, %ld misses, %ld stores, %ld evictions\n", cache.hits, cache.misses,
+                cache.stores, cache.evictions);
+    tiny_symbol_table_free(&table);
     return 0;
 }
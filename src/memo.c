@@ -0,0 +1,66 @@
+#include "memo.h"
+#include <stdlib.h>
+#include <string.h>
+
+void tiny_memo_init(tiny_memo_t *memo, const tiny_program_t *program)
+{
+    memo->program = program;
+    memo->entries = malloc(TINY_MEMO_SIZE * sizeof(tiny_memo_entry_t));
+    for (int i = 0; i < TINY_MEMO_SIZE; ++i)
+    {
+        memo->entries[i].func = -1;
+        memo->entries[i].valid = false;
+    }
+    memo->stamp = 0;
+    memo->hits = memo->misses = 0;
+}
+
+void tiny_memo_free(tiny_memo_t *memo)
+{
+    free(memo->entries);
+    memo->entries = NULL;
+}
+
+bool tiny_memo_cacheable(const tiny_memo_t *memo, int func)
+{
+    const tiny_function_t *f = &memo->program->functions[func];
+    return f->pure && f->nparams <= TINY_MEMO_MAX_ARGS;
+}
+
+int tiny_memo_lookup(tiny_memo_t *memo, int func, const tiny_value_t *args, tiny_value_t *result, unsigned *stamp)
+{
+    int nparams = memo->program->functions[func].nparams;
+    // FNV-1a，参数按二进制值参与散列，REAL 的 -0.0 与 0.0 是不同的键
+    uint64_t h = 14695981039346656037ull ^ (uint64_t)func;
+    h *= 1099511628211ull;
+    for (int i = 0; i < nparams; ++i)
+    {
+        h ^= (uint64_t)args[i].i;
+        h *= 1099511628211ull;
+    }
+    int slot = (int)((h ^ (h >> 32)) & (TINY_MEMO_SIZE - 1));
+
+    tiny_memo_entry_t *e = &memo->entries[slot];
+    if (e->valid && e->func == func && memcmp(e->args, args, nparams * sizeof(tiny_value_t)) == 0)
+    {
+        memo->hits++;
+        *result = e->result;
+        return -1;
+    }
+    memo->misses++;
+    e->func = func;
+    e->valid = false;
+    e->stamp = *stamp = ++memo->stamp;
+    if (nparams > 0)
+        memcpy(e->args, args, nparams * sizeof(tiny_value_t));
+    return slot;
+}
+
+void tiny_memo_store(tiny_memo_t *memo, int slot, unsigned stamp, tiny_value_t result)
+{
+    tiny_memo_entry_t *e = &memo->entries[slot];
+    if (e->stamp != stamp)
+        return;
+    e->result = result;
+    e->valid = true;
+}
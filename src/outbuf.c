@@ -0,0 +1,159 @@
+#include "outbuf.h"
+#include "error.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+int tiny_outbuf_open(tiny_outbuf_t *out, const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        out->fd = -1;
+        out->data = NULL;
+        return TINY_IO_ERROR;
+    }
+    return tiny_outbuf_open_fd(out, fd);
+}
+
+int tiny_outbuf_open_fd(tiny_outbuf_t *out, int fd)
+{
+    out->len = 0;
+    out->error = false;
+    out->fd = fd;
+    out->data = malloc(TINY_OUTBUF_SIZE);
+    if (!out->data)
+    {
+        close(out->fd);
+        out->fd = -1;
+        return TINY_IO_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * 依次写出 iov 中的所有数据，处理被信号中断与只写出一部分的情况
+ */
+static void write_all(tiny_outbuf_t *out, struct iovec *iov, int count)
+{
+    while (count > 0 && !out->error)
+    {
+        ssize_t n = writev(out->fd, iov, count);
+        if (n < 0)
+        {
+            if (errno != EINTR)
+                out->error = true;
+            continue;
+        }
+        // 跳过已经完整写出的部分
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov, --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+void tiny_outbuf_flush(tiny_outbuf_t *out)
+{
+    if (out->len > 0)
+    {
+        struct iovec iov = {out->data, out->len};
+        write_all(out, &iov, 1);
+    }
+    out->len = 0;
+}
+
+void tiny_outbuf_write(tiny_outbuf_t *out, const char *s, size_t len)
+{
+    if (len <= TINY_OUTBUF_SIZE - out->len)
+    {
+        memcpy(out->data + out->len, s, len);
+        out->len += len;
+        return;
+    }
+    if (len < TINY_OUTBUF_SIZE)
+    {
+        tiny_outbuf_flush(out);
+        memcpy(out->data, s, len);
+        out->len = len;
+        return;
+    }
+    // 比缓冲区还大的数据不复制，和缓冲区中已有的内容一起写出
+    struct iovec iov[2] = {{out->data, out->len}, {(char *)s, len}};
+    write_all(out, iov, 2);
+    out->len = 0;
+}
+
+void tiny_outbuf_puts(tiny_outbuf_t *out, const char *s)
+{
+    tiny_outbuf_write(out, s, strlen(s));
+}
+
+void tiny_outbuf_int(tiny_outbuf_t *out, long long v)
+{
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    // 取负数的绝对值可能溢出，按无符号数转换
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    do
+    {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (v < 0)
+        *--p = '-';
+    tiny_outbuf_write(out, p, buf + sizeof(buf) - p);
+}
+
+void tiny_outbuf_printf(tiny_outbuf_t *out, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t room = TINY_OUTBUF_SIZE - out->len;
+    int n = vsnprintf(out->data + out->len, room, format, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if ((size_t)n < room)
+    {
+        out->len += n;
+        return;
+    }
+
+    // 剩余空间不够时格式化到临时内存中
+    char *s = malloc(n + 1);
+    if (!s)
+    {
+        out->error = true;
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(s, n + 1, format, args);
+    va_end(args);
+    tiny_outbuf_write(out, s, n);
+    free(s);
+}
+
+int tiny_outbuf_close(tiny_outbuf_t *out)
+{
+    if (out->fd < 0)
+        return TINY_IO_ERROR;
+    tiny_outbuf_flush(out);
+    if (close(out->fd) != 0)
+        out->error = true;
+    out->fd = -1;
+    free(out->data);
+    out->data = NULL;
+    return out->error ? TINY_IO_ERROR : 0;
+}
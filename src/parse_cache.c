@@ -0,0 +1,317 @@
+#include "parse_cache.h"
+#include "parser.h"
+#include "error.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t tiny_hash64(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32)
+    {
+        // 4 路并行处理 32 字节的块
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        do
+        {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    }
+    else
+    {
+        h = seed + PRIME64_5;
+    }
+    h += len;
+
+    for (; end - p >= 8; p += 8)
+    {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4)
+    {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= *p * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t hash_string(const char *s, uint64_t seed)
+{
+    return s ? tiny_hash64(s, strlen(s) + 1, seed) : tiny_hash64("", 0, seed);
+}
+
+/**
+ * 函数指针的地址随加载位置变化，以相对于 tiny_make_parser 的偏移代替
+ */
+static uint64_t code_offset(void (*f)(void))
+{
+    return f ? (uint64_t)((uintptr_t)f - (uintptr_t)tiny_make_parser) : 0;
+}
+
+static uint64_t hash_parser(const tiny_parser_t *parser, uint64_t h)
+{
+    for (; parser; parser = parser->sibling)
+    {
+        uint64_t fields[5] = {
+            code_offset((void (*)(void))parser->parser),
+            code_offset((void (*)(void))parser->predicate),
+            (uint64_t)parser->desc,
+            (uint64_t)parser->error,
+            parser->child != NULL};
+        h = tiny_hash64(fields, sizeof(fields), h);
+        h = hash_string(parser->token, h);
+        // 子节点与兄弟节点分开计算，结构不同的文法不会得到相同的序列
+        h = hash_parser(parser->child, h);
+    }
+    return tiny_hash64("", 0, h);
+}
+
+static int hash_production(const char *key, void *data, void *arg)
+{
+    uint64_t *h = arg;
+    *h = hash_string(key, *h);
+    *h = hash_parser(data, *h);
+    return 0;
+}
+
+uint64_t tiny_grammar_fingerprint(struct trie *parsers, const char *root)
+{
+    uint64_t h = hash_string(root, TINY_ASTBIN_VERSION);
+    trie_visit(parsers, "", hash_production, &h);
+    return h;
+}
+
+int tiny_cache_init(tiny_cache_t *cache, const char *dir, uint64_t limit, uint64_t fingerprint)
+{
+    cache->dir = dir;
+    cache->limit = limit;
+    cache->fingerprint = fingerprint;
+    cache->hits = cache->misses = cache->stores = cache->evictions = 0;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+        return TINY_IO_ERROR;
+    return 0;
+}
+
+static void entry_path(const tiny_cache_t *cache, const char *code, size_t len, char *path, size_t size)
+{
+    uint64_t h = tiny_hash64(code, len, cache->fingerprint);
+    snprintf(path, size, "%s/%016llx.ast", cache->dir, (unsigned long long)h);
+}
+
+bool tiny_cache_lookup(tiny_cache_t *cache, const char *code, size_t len, tiny_astbin_t *bin)
+{
+    char path[4096];
+    entry_path(cache, code, len, path, sizeof(path));
+    if (tiny_astbin_open(bin, path) != 0)
+    {
+        cache->misses++;
+        return false;
+    }
+    // 散列冲突时源码不同，按未命中处理，之后保存时覆盖
+    if (bin->header->source_size != len || memcmp(bin->strings, code, len) != 0)
+    {
+        tiny_astbin_close(bin);
+        cache->misses++;
+        return false;
+    }
+    // 以修改时间记录最近一次命中，淘汰时据此排序
+    utimensat(AT_FDCWD, path, NULL, 0);
+    cache->hits++;
+    return true;
+}
+
+struct cache_entry_s
+{
+    char *name;
+    off_t size;
+    struct timespec mtime;
+};
+
+static int compare_mtime(const void *a, const void *b)
+{
+    const struct cache_entry_s *x = a, *y = b;
+    if (x->mtime.tv_sec != y->mtime.tv_sec)
+        return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec)
+        return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static bool is_entry_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".ast") == 0;
+}
+
+/**
+ * 缓存项的总大小超过上限时，从最久没有命中的开始删除。
+ * 修改时间不早于 since 的缓存项是本线程或其他线程刚写入的，不删除
+ */
+static void evict(tiny_cache_t *cache, const struct timespec *since)
+{
+    DIR *dir = opendir(cache->dir);
+    if (!dir)
+        return;
+    struct cache_entry_s *entries = NULL;
+    int count = 0, size = 0;
+    uint64_t total = 0;
+    char path[4096];
+    struct dirent *d;
+    while ((d = readdir(dir)))
+    {
+        struct stat st;
+        if (!is_entry_name(d->d_name))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, d->d_name);
+        if (stat(path, &st) != 0)
+            continue;
+        total += st.st_size;
+        if (st.st_mtim.tv_sec > since->tv_sec ||
+            (st.st_mtim.tv_sec == since->tv_sec && st.st_mtim.tv_nsec >= since->tv_nsec))
+            continue;
+        if (count == size)
+        {
+            size = size ? size * 2 : 64;
+            struct cache_entry_s *p = realloc(entries, size * sizeof(*entries));
+            if (!p)
+                break;
+            entries = p;
+        }
+        entries[count].name = strdup(d->d_name);
+        entries[count].size = st.st_size;
+        entries[count].mtime = st.st_mtim;
+        count++;
+    }
+    closedir(dir);
+
+    if (total > cache->limit)
+    {
+        qsort(entries, count, sizeof(*entries), compare_mtime);
+        for (int i = 0; i < count && total > cache->limit; ++i)
+        {
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[i].name);
+            if (unlink(path) == 0)
+            {
+                total -= entries[i].size;
+                cache->evictions++;
+            }
+        }
+    }
+    for (int i = 0; i < count; ++i)
+        free(entries[i].name);
+    free(entries);
+}
+
+/**
+ * 缓存项 path 是否已经保存了源码 code[0, len)
+ */
+static bool has_entry(const char *path, const char *code, size_t len)
+{
+    tiny_astbin_t bin;
+    if (tiny_astbin_open(&bin, path) != 0)
+        return false;
+    bool same = bin.header->source_size == len && memcmp(bin.strings, code, len) == 0;
+    tiny_astbin_close(&bin);
+    return same;
+}
+
+int tiny_cache_store(tiny_cache_t *cache, const char *code, size_t len, const tiny_ast_t *root,
+                     tiny_scanner_t *tokens)
+{
+    char path[4096], temp[4096 + 32];
+    entry_path(cache, code, len, path, sizeof(path));
+    struct timespec since;
+    clock_gettime(CLOCK_REALTIME, &since);
+
+    // 同一进程中的多个线程可能同时保存相同的源码，临时文件名由 mkstemps 保证唯一
+    snprintf(temp, sizeof(temp), "%s.XXXXXX.tmp", path);
+    int fd = mkstemps(temp, 4);
+    if (fd < 0)
+        return TINY_IO_ERROR;
+    fchmod(fd, 0644);
+    int ret = tiny_astbin_write_fd(root, code, len, tokens, fd);
+    if (close(fd) != 0)
+        ret = TINY_IO_ERROR;
+    if (ret != 0 || rename(temp, path) != 0)
+    {
+        unlink(temp);
+        // 其他线程或进程已经保存了相同的内容
+        if (ret != 0 || !has_entry(path, code, len))
+            return TINY_IO_ERROR;
+    }
+    cache->stores++;
+    evict(cache, &since);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include "syntax_def.h"
 #include <ctype.h>
 #include <stdarg.h>
 #include "string_util.h"
@@ -20,19 +21,51 @@ tiny_parser_t *tiny_make_parser()
     parser->sibling = parser->child = NULL;
     parser->token = NULL;
     parser->predicate = NULL;
+    parser->sync = NULL;
     parser->desc = 0;
     parser->error = 0;
     return parser;
 }
 
-static tiny_parser_ctx_t make_context(struct trie *parsers, tiny_parser_t *current_parser)
+static tiny_parser_ctx_t make_context(tiny_parser_ctx_t parent, tiny_parser_t *current_parser)
 {
     tiny_parser_ctx_t ctx = {
-        .parsers = parsers,
-        .current_parser = current_parser};
+        .parsers = parent.parsers,
+        .current_parser = current_parser,
+        .errors = parent.errors};
     return ctx;
 }
 
+void tiny_parser_errors_init(tiny_parser_errors_t *errors)
+{
+    errors->items = NULL;
+    errors->count = errors->size = 0;
+}
+
+void tiny_parser_errors_free(tiny_parser_errors_t *errors)
+{
+    free(errors->items);
+    tiny_parser_errors_init(errors);
+}
+
+/**
+ * @return 当前已记录的错误数，回溯时用于丢弃之后记录的错误
+ */
+static int error_mark(tiny_parser_ctx_t ctx)
+{
+    return ctx.errors ? ctx.errors->count : 0;
+}
+
+/**
+ * 回溯到 save；mark 之后记录的错误属于没有被采用的分支，一并丢弃
+ */
+static void backtrack(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner, tiny_scanner_token_t *save, int mark)
+{
+    tiny_scanner_reset(scanner, save);
+    if (ctx.errors)
+        ctx.errors->count = mark;
+}
+
 static tiny_parser_result_t make_success_result(tiny_ast_t *ast)
 {
     tiny_parser_result_t result;
@@ -57,29 +90,45 @@ static tiny_parser_result_t make_failure_result(tiny_lex_token_t token, const ch
 static tiny_parser_result_t parser_kleene(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
+    tiny_ast_t **tail = &ast->child;
 
     while (true)
     {
         tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+        int mark = error_mark(ctx);
         tiny_parser_result_t next = tiny_syntax_parse(
-            make_context(ctx.parsers, ctx.current_parser->child),
+            make_context(ctx, ctx.current_parser->child),
             scanner);
 
         if (next.state == STATE_SUCCESS)
         {
             // 解析成功，添加子 AST
-            tiny_ast_add_child(ast, next.ast);
+            tail = tiny_ast_append(tail, next.ast);
         }
         else
         {
             if (next.fatal)
+            {
+                tiny_free_ast(ast);
                 return next;
-            tiny_scanner_reset(scanner, save);
+            }
+            backtrack(ctx, scanner, save, mark);
             return make_success_result(ast);
         }
     }
 }
 
+void tiny_free_parser(tiny_parser_t *parser)
+{
+    while (parser)
+    {
+        tiny_parser_t *sibling = parser->sibling;
+        tiny_free_parser(parser->child);
+        free(parser);
+        parser = sibling;
+    }
+}
+
 tiny_parser_t *tiny_make_parser_kleene(tiny_parser_t *single)
 {
     tiny_parser_t *ret = tiny_make_parser();
@@ -88,38 +137,102 @@ tiny_parser_t *tiny_make_parser_kleene(tiny_parser_t *single)
     return ret;
 }
 
+/**
+ * 错误恢复：记录 error，从 save 开始按 sync 跳过 token，返回覆盖跳过范围的 TINY_DESC_ERROR 节点。
+ * 没有开启错误恢复或 save 处已经没有 token 时返回 NULL，此时扫描器仍然位于 save
+ */
+static tiny_ast_t *recover(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner, tiny_scanner_token_t *save,
+                           const tiny_parser_result_t *error)
+{
+    tiny_parser_errors_t *errors = ctx.errors;
+    if (!errors || !ctx.current_parser->sync)
+        return NULL;
+
+    tiny_scanner_reset(scanner, save);
+    tiny_lex_token_t first = tiny_scanner_next(scanner);
+    if (first.error)
+    {
+        tiny_scanner_reset(scanner, save);
+        return NULL;
+    }
+    int depth = 0;
+    tiny_lex_token_t last = first;
+    if (ctx.current_parser->sync(&first, &depth) != TINY_SYNC_AFTER)
+    {
+        while (true)
+        {
+            tiny_scanner_token_t *before = tiny_scanner_now(scanner);
+            tiny_lex_token_t token = tiny_scanner_next(scanner);
+            // 词法错误与 EOF 留给之后的解析报告
+            int action = token.error ? TINY_SYNC_BEFORE : ctx.current_parser->sync(&token, &depth);
+            if (action == TINY_SYNC_BEFORE)
+            {
+                tiny_scanner_reset(scanner, before);
+                break;
+            }
+            last = token;
+            if (action == TINY_SYNC_AFTER)
+                break;
+        }
+    }
+
+    if (errors->count == errors->size)
+    {
+        errors->size = errors->size ? errors->size * 2 : 16;
+        errors->items = realloc(errors->items, errors->size * sizeof(tiny_parser_error_t));
+    }
+    tiny_parser_error_t *item = &errors->items[errors->count++];
+    item->state = error->state;
+    item->error_token = error->error_token;
+    item->required_token = error->required_token;
+
+    // 错误节点的 token 覆盖所有跳过的 token
+    tiny_ast_t *ast = tiny_make_ast(TINY_DESC_ERROR);
+    ast->token = first;
+    ast->token.e = last.e;
+    ast->token.kind = TINY_TOKEN_NONE;
+    ast->token.symbol = TINY_NO_SYMBOL;
+    return ast;
+}
+
 static tiny_parser_result_t parser_kleene_until(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
-    tiny_parser_result_t one = make_success_result(NULL);
+    tiny_ast_t **tail = &ast->child;
 
     while (true)
     {
-        tiny_scanner_token_t *save = tiny_scanner_now(scanner);
-        tiny_parser_result_t next = tiny_syntax_parse(
-            make_context(ctx.parsers, ctx.current_parser->child),
-            scanner);
-
-        if (next.state == STATE_SUCCESS)
+        tiny_parser_result_t one = make_success_result(NULL);
+        tiny_scanner_token_t *save;
+        while (true)
         {
-            // 解析成功，添加子 AST
-            tiny_ast_add_child(ast, next.ast);
-        }
-        else
-        {
-            if (next.fatal)
-                return next;
-            one = next;
-            tiny_scanner_reset(scanner, save);
-            break;
+            save = tiny_scanner_now(scanner);
+            int mark = error_mark(ctx);
+            tiny_parser_result_t next = tiny_syntax_parse(
+                make_context(ctx, ctx.current_parser->child),
+                scanner);
+
+            if (next.state == STATE_SUCCESS)
+            {
+                // 解析成功，添加子 AST
+                tail = tiny_ast_append(tail, next.ast);
+            }
+            else
+            {
+                if (next.fatal)
+                {
+                    tiny_free_ast(ast);
+                    return next;
+                }
+                one = next;
+                backtrack(ctx, scanner, save, mark);
+                break;
+            }
         }
-    }
 
-    // 检查 terminator 是否存在
-    {
-        tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+        // 检查 terminator 是否存在
         tiny_parser_result_t next = tiny_syntax_parse(
-            make_context(ctx.parsers, ctx.current_parser->child->sibling),
+            make_context(ctx, ctx.current_parser->child->sibling),
             scanner);
 
         if (next.state == STATE_SUCCESS)
@@ -128,15 +241,25 @@ static tiny_parser_result_t parser_kleene_until(tiny_parser_ctx_t ctx, tiny_scan
             tiny_scanner_reset(scanner, save);
             return make_success_result(ast);
         }
-        else
+        if (next.fatal)
         {
-            if (next.fatal)
-                return next;
-            if (one.state != STATE_SUCCESS)
-                return one;
-            else
-                return next;
+            tiny_free_ast(ast);
+            return next;
+        }
+        if (one.state != STATE_SUCCESS)
+            next = one;
+
+        // 错误数达到上限后不再恢复，并且不再回溯，以免丢弃已经记录的错误
+        if (ctx.errors && ctx.current_parser->sync && ctx.errors->count >= TINY_PARSER_MAX_ERRORS)
+            next.fatal = true;
+        // 跳过出错的部分后继续匹配 replica
+        tiny_ast_t *error = next.fatal ? NULL : recover(ctx, scanner, save, &next);
+        if (!error)
+        {
+            tiny_free_ast(ast);
+            return next;
         }
+        tail = tiny_ast_append(tail, error);
     }
 }
 
@@ -149,15 +272,24 @@ tiny_parser_t *tiny_make_parser_kleene_until(tiny_parser_t *terminator, tiny_par
     return ret;
 }
 
+tiny_parser_t *tiny_make_parser_kleene_recover(tiny_parser_t *terminator, tiny_parser_t *replica,
+                                               int (*sync)(const tiny_lex_token_t *token, int *depth))
+{
+    tiny_parser_t *ret = tiny_make_parser_kleene_until(terminator, replica);
+    ret->sync = sync;
+    return ret;
+}
+
 static tiny_parser_result_t parser_or(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_parser_result_t one;
     int diff = -1;
     tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+    int mark = error_mark(ctx);
     for (tiny_parser_t *cld = ctx.current_parser->child; cld; cld = cld->sibling)
     {
         tiny_parser_result_t next = tiny_syntax_parse(
-            make_context(ctx.parsers, cld),
+            make_context(ctx, cld),
             scanner);
 
         if (next.state == STATE_SUCCESS)
@@ -176,7 +308,7 @@ static tiny_parser_result_t parser_or(tiny_parser_ctx_t ctx, tiny_scanner_t *sca
                 diff = mydiff;
                 one = next;
             }
-            tiny_scanner_reset(scanner, save);
+            backtrack(ctx, scanner, save, mark);
         }
     }
     return one;
@@ -205,7 +337,7 @@ static tiny_parser_result_t parser_sequence(tiny_parser_ctx_t ctx, tiny_scanner_
     for (tiny_parser_t *cld = ctx.current_parser->child; cld; cld = cld->sibling)
     {
         tiny_parser_result_t next = tiny_syntax_parse(
-            make_context(ctx.parsers, cld),
+            make_context(ctx, cld),
             scanner);
 
         if (next.state == STATE_SUCCESS)
@@ -220,9 +352,12 @@ static tiny_parser_result_t parser_sequence(tiny_parser_ctx_t ctx, tiny_scanner_
     }
     if (tiny_ast_child_count(ast) <= 1)
     {
-        if (ast->desc != 0 && ast->child)
-            ast->child->desc = ast->desc;
-        return make_success_result(ast->child);
+        tiny_ast_t *child = ast->child;
+        if (ast->desc != 0 && child)
+            child->desc = ast->desc;
+        ast->child = NULL;
+        tiny_free_ast(ast);
+        return make_success_result(child);
     }
     else
     {
@@ -248,9 +383,7 @@ tiny_parser_t *tiny_make_parser_sequence(int n, ...)
 
 static tiny_parser_result_t parser_grammar(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
-    tiny_parser_ctx_t subctx = {
-        .parsers = ctx.parsers,
-        .current_parser = trie_search(ctx.parsers, ctx.current_parser->token)};
+    tiny_parser_ctx_t subctx = make_context(ctx, trie_search(ctx.parsers, ctx.current_parser->token));
 
     assert(subctx.current_parser != NULL);
     return tiny_syntax_parse(subctx, scanner);
@@ -267,17 +400,21 @@ tiny_parser_t *tiny_make_parser_grammar(const char *name)
 static tiny_parser_result_t parser_optional(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+    int mark = error_mark(ctx);
     tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
     tiny_parser_result_t result = tiny_syntax_parse(
-        make_context(ctx.parsers, ctx.current_parser->child),
+        make_context(ctx, ctx.current_parser->child),
         scanner);
 
     if (result.state == STATE_SUCCESS)
         tiny_ast_add_child(ast, result.ast);
     else if (result.fatal)
+    {
+        tiny_free_ast(ast);
         return result;
+    }
     else
-        tiny_scanner_reset(scanner, save);
+        backtrack(ctx, scanner, save, mark);
 
     return make_success_result(ast);
 }
@@ -395,7 +532,7 @@ static tiny_parser_result_t parser_token_predicate(tiny_parser_ctx_t ctx, tiny_s
         return result;
     }
 
-    if (ctx.current_parser->predicate(token.s, token.e))
+    if (ctx.current_parser->predicate(&token))
     {
         tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
         ast->token = token;
@@ -407,7 +544,7 @@ static tiny_parser_result_t parser_token_predicate(tiny_parser_ctx_t ctx, tiny_s
     }
 }
 
-tiny_parser_t *tiny_make_parser_token_predicate(bool (*predicate)(const char *, const char *e))
+tiny_parser_t *tiny_make_parser_token_predicate(bool (*predicate)(const tiny_lex_token_t *))
 {
     tiny_parser_t *ret = tiny_make_parser();
     ret->parser = parser_token_predicate;
@@ -418,28 +555,33 @@ tiny_parser_t *tiny_make_parser_token_predicate(bool (*predicate)(const char *,
 static tiny_parser_result_t parser_separation(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
+    tiny_ast_t **tail = &ast->child;
     bool first = true;
 
     while (true)
     {
         {
             tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+            int mark = error_mark(ctx);
             tiny_parser_result_t next = tiny_syntax_parse(
-                make_context(ctx.parsers, ctx.current_parser->child),
+                make_context(ctx, ctx.current_parser->child),
                 scanner);
 
             if (next.state == STATE_SUCCESS)
             {
                 // 解析成功，添加子 AST
-                tiny_ast_add_child(ast, next.ast);
+                tail = tiny_ast_append(tail, next.ast);
             }
             else
             {
                 if (next.fatal)
+                {
+                    tiny_free_ast(ast);
                     return next;
+                }
                 if (first)
                 {
-                    tiny_scanner_reset(scanner, save);
+                    backtrack(ctx, scanner, save, mark);
                     return make_success_result(ast);
                 }
                 else
@@ -452,19 +594,23 @@ static tiny_parser_result_t parser_separation(tiny_parser_ctx_t ctx, tiny_scanne
 
         {
             tiny_scanner_token_t *save = tiny_scanner_now(scanner);
+            int mark = error_mark(ctx);
             tiny_parser_result_t next = tiny_syntax_parse(
-                make_context(ctx.parsers, ctx.current_parser->child->sibling),
+                make_context(ctx, ctx.current_parser->child->sibling),
                 scanner);
 
             if (next.state == STATE_SUCCESS)
             {
-                tiny_ast_add_child(ast, next.ast);
+                tail = tiny_ast_append(tail, next.ast);
             }
             else
             {
                 if (next.fatal)
+                {
+                    tiny_free_ast(ast);
                     return next;
-                tiny_scanner_reset(scanner, save);
+                }
+                backtrack(ctx, scanner, save, mark);
                 return make_success_result(ast);
             }
         }
@@ -485,7 +631,7 @@ tiny_parser_t *tiny_make_parser_separation(tiny_parser_t *separator, tiny_parser
 static tiny_parser_result_t parser_eliminate(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_parser_result_t result = tiny_syntax_parse(
-        make_context(ctx.parsers, ctx.current_parser->child),
+        make_context(ctx, ctx.current_parser->child),
         scanner);
     if (result.ast)
     {
@@ -506,7 +652,7 @@ tiny_parser_t *tiny_make_parser_eliminate(tiny_parser_t *parser)
 static tiny_parser_result_t parser_with_desc(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_parser_result_t result = tiny_syntax_parse(
-        make_context(ctx.parsers, ctx.current_parser->child),
+        make_context(ctx, ctx.current_parser->child),
         scanner);
     if (result.ast)
         result.ast->desc = ctx.current_parser->desc;
@@ -525,7 +671,7 @@ tiny_parser_t *tiny_make_parser_with_desc(int desc, tiny_parser_t *parser)
 static tiny_parser_result_t parser_error(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_parser_result_t result = tiny_syntax_parse(
-        make_context(ctx.parsers, ctx.current_parser->child),
+        make_context(ctx, ctx.current_parser->child),
         scanner);
     if (result.state == STATE_ERROR)
     {
@@ -548,7 +694,7 @@ tiny_parser_t *tiny_make_parser_error(int error, tiny_parser_t *parser)
 static tiny_parser_result_t parser_fatal(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
 {
     tiny_parser_result_t result = tiny_syntax_parse(
-        make_context(ctx.parsers, ctx.current_parser->child),
+        make_context(ctx, ctx.current_parser->child),
         scanner);
     if (result.state != STATE_SUCCESS)
         result.fatal = true;
@@ -570,3 +716,93 @@ tiny_parser_t *tiny_make_parser_fatal(int error, tiny_parser_t *parser)
     ret->child = parser;
     return ret;
 }
+
+static tiny_parser_result_t parser_lazy(tiny_parser_ctx_t ctx, tiny_scanner_t *scanner)
+{
+    const char *begin = ctx.current_parser->child->token;
+    const char *end = ctx.current_parser->child->sibling->token;
+
+    tiny_lex_token_t first = tiny_scanner_next(scanner);
+    if (first.error)
+    {
+        tiny_parser_result_t result = make_failure_result(first, begin, first.error == TINY_EOF ? TINY_UNEXPECTED_EOF : first.error);
+        result.fatal = first.error != TINY_EOF;
+        return result;
+    }
+    if (!strsecmp(first.s, first.e, begin))
+        return make_failure_result(first, begin, TINY_UNEXPECTED_TOKEN);
+
+    // 只根据 begin/end 的嵌套层数跳过函数体，不调用 statement 等产生式
+    tiny_lex_token_t last;
+    int depth = 1;
+    while (depth > 0)
+    {
+        last = tiny_scanner_next(scanner);
+        if (last.error)
+        {
+            tiny_parser_result_t result = make_failure_result(last, end, last.error == TINY_EOF ? TINY_UNEXPECTED_EOF : last.error);
+            result.fatal = last.error != TINY_EOF;
+            return result;
+        }
+        if (strsecmp(last.s, last.e, begin))
+            depth++;
+        else if (strsecmp(last.s, last.e, end))
+            depth--;
+    }
+
+    // 惰性节点的 token 覆盖从 begin 到 end 的整个范围
+    tiny_ast_t *ast = tiny_make_ast(ctx.current_parser->desc);
+    ast->token = first;
+    ast->token.e = last.e;
+    ast->token.kind = TINY_TOKEN_NONE;
+    ast->token.symbol = TINY_NO_SYMBOL;
+    return make_success_result(ast);
+}
+
+tiny_parser_t *tiny_make_parser_lazy(tiny_parser_t *begin, tiny_parser_t *end)
+{
+    tiny_parser_t *ret = tiny_make_parser();
+    ret->parser = parser_lazy;
+    ret->child = begin;
+    begin->sibling = end;
+    return ret;
+}
+
+tiny_parser_result_t tiny_syntax_parse_range(struct trie *parsers, tiny_symbol_table_t *symbols, const char *name,
+                                             tiny_lex_token_t token, tiny_scanner_t *tokens)
+{
+    tiny_lex_t lex;
+    tiny_lex_begin_range(&lex, token.head, token.s - token.head, token.e - token.head);
+    lex.symbols = symbols;
+
+    tiny_scanner_t scanner;
+    tiny_scanner_begin(&scanner, &lex, tiny_lex_reader);
+
+    tiny_parser_ctx_t ctx = {.parsers = parsers, .current_parser = trie_search(parsers, name), .errors = NULL};
+    tiny_parser_result_t result = tiny_syntax_parse(ctx, &scanner);
+
+    if (result.state == STATE_SUCCESS)
+    {
+        // 范围内必须没有剩余的 token
+        tiny_lex_token_t rest = tiny_scanner_next(&scanner);
+        if (rest.error != TINY_EOF)
+        {
+            tiny_free_ast(result.ast);
+            result = make_failure_result(rest, "EOF", rest.error ? rest.error : TINY_UNEXPECTED_TOKEN);
+        }
+    }
+
+    if (tokens)
+    {
+        // 将 token 链表转交给调用者，此后 tokens 不能再读取新的 token
+        tiny_scanner_begin(tokens, NULL, NULL);
+        list_add_before(&scanner.tokens, &tokens->tokens);
+        list_del(&scanner.tokens);
+    }
+    else
+    {
+        tiny_scanner_end(&scanner);
+    }
+    tiny_lex_end(&lex);
+    return result;
+}
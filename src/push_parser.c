@@ -0,0 +1,276 @@
+#include "push_parser.h"
+#include "string_util.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PUSH_NORMAL 0
+#define PUSH_LINE_COMMENT 1
+#define PUSH_BLOCK_COMMENT 2
+#define PUSH_STRING 3
+
+#define PUSH_MORE -1
+
+void tiny_parse_begin(tiny_push_parser_t *ctx, struct trie *parsers, const char *root_name,
+                      void *arg, void (*on_item)(void *arg, tiny_ast_t *item))
+{
+    ctx->parsers = parsers;
+    ctx->symbols = NULL;
+    tiny_symbol_table_init(&ctx->own_symbols);
+    ctx->root_name = root_name;
+    ctx->buf = NULL;
+    ctx->len = ctx->size = 0;
+    ctx->scan = 0;
+    ctx->state = PUSH_NORMAL;
+    ctx->quote = 0;
+    ctx->escape = false;
+    ctx->depth = 0;
+    ctx->line_number = 1;
+    ctx->line_column = 0;
+    ctx->result.ast = NULL;
+    ctx->result.state = 0;
+    ctx->result.fatal = false;
+    ctx->result.required_token = NULL;
+    ctx->arg = arg;
+    ctx->on_item = on_item;
+}
+
+void tiny_parse_end(tiny_push_parser_t *ctx)
+{
+    free(ctx->buf);
+    ctx->buf = NULL;
+    ctx->len = ctx->size = 0;
+    tiny_symbol_table_free(&ctx->own_symbols);
+}
+
+static int peek(tiny_push_parser_t *ctx, int i)
+{
+    return i < ctx->len ? ctx->buf[i] : TINY_EOF;
+}
+
+/**
+ * 与 tiny_lex_next 使用相同的规则跳过从 i 开始的数字、标识符或符号
+ * @return token 的结束位置，PUSH_MORE 表示 token 可能延续到下一块输入中
+ */
+static int skip_token(tiny_push_parser_t *ctx, int i, bool finished)
+{
+    int c = peek(ctx, i);
+    int end;
+    if (isdigit(c))
+    {
+        end = i + 1;
+        if (peek(ctx, end) == 'x' || peek(ctx, end) == 'X')
+        {
+            for (end++; is_hex_digit(peek(ctx, end)); end++)
+                ;
+        }
+        else
+        {
+            while (c = peek(ctx, end), isdigit(c) || c == '.')
+                end++;
+            if (c == 'e')
+            {
+                end++;
+                if (c = peek(ctx, end), c == '+' || c == '-')
+                    end++;
+                while (isdigit(peek(ctx, end)))
+                    end++;
+            }
+        }
+    }
+    else if (is_name_char(c))
+    {
+        for (end = i + 1; is_name_char(peek(ctx, end)); end++)
+            ;
+    }
+    else
+    {
+        // 组合符号最多 3 个字符
+        if (i + 2 >= ctx->len && !finished)
+            return PUSH_MORE;
+        int len = is_symbol(c, peek(ctx, i + 1), peek(ctx, i + 2));
+        end = i + (len > 0 ? len : 1);
+    }
+
+    // token 一直延续到了缓冲区末尾，需要等待下一块输入才能确定它的结束位置
+    if (end >= ctx->len && !finished)
+        return PUSH_MORE;
+    return end;
+}
+
+/**
+ * 从 ctx->scan 开始推进状态机
+ * @return 下一个完整的顶层 func/vars 的结束位置，PUSH_MORE 表示需要更多输入
+ */
+static int scan_item(tiny_push_parser_t *ctx, bool finished)
+{
+    while (ctx->scan < ctx->len)
+    {
+        int i = ctx->scan;
+        int c = ctx->buf[i];
+        if (ctx->state == PUSH_LINE_COMMENT)
+        {
+            const char *nl = memchr(ctx->buf + i, '\n', ctx->len - i);
+            ctx->scan = nl ? nl - ctx->buf + 1 : ctx->len;
+            if (nl)
+                ctx->state = PUSH_NORMAL;
+        }
+        else if (ctx->state == PUSH_BLOCK_COMMENT)
+        {
+            if (c == '*' && i + 1 >= ctx->len && !finished)
+                return PUSH_MORE;
+            if (c == '*' && peek(ctx, i + 1) == '/')
+            {
+                ctx->scan = i + 2;
+                ctx->state = PUSH_NORMAL;
+            }
+            else
+            {
+                ctx->scan = i + 1;
+            }
+        }
+        else if (ctx->state == PUSH_STRING)
+        {
+            if (ctx->escape)
+                ctx->escape = false;
+            else if (c == '\\')
+                ctx->escape = true;
+            else if (c == ctx->quote)
+                ctx->state = PUSH_NORMAL;
+            ctx->scan = i + 1;
+        }
+        else if (isspace(c))
+        {
+            ctx->scan = i + 1;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            ctx->state = PUSH_STRING;
+            ctx->quote = c;
+            ctx->escape = false;
+            ctx->scan = i + 1;
+        }
+        else
+        {
+            int end = skip_token(ctx, i, finished);
+            if (end == PUSH_MORE)
+                return PUSH_MORE;
+            ctx->scan = end;
+
+            const char *s = ctx->buf + i, *e = ctx->buf + end;
+            if (strsecmp(s, e, "//"))
+                ctx->state = PUSH_LINE_COMMENT;
+            else if (strsecmp(s, e, "/*"))
+                ctx->state = PUSH_BLOCK_COMMENT;
+            else if (strsecmp(s, e, "BEGIN"))
+                ctx->depth++;
+            else if (strsecmp(s, e, "END") && ctx->depth > 0 && --ctx->depth == 0)
+                return end; // func 的函数体结束
+            else if (strsecmp(s, e, ";") && ctx->depth == 0)
+                return end; // vars 结束
+        }
+    }
+    return PUSH_MORE;
+}
+
+/**
+ * 解析 buf[0, end) 中的顶层 func/vars，并丢弃这部分源码
+ */
+static int parse_items(tiny_push_parser_t *ctx, int end)
+{
+    tiny_lex_token_t range;
+    range.error = 0;
+    range.kind = TINY_TOKEN_NONE;
+    range.symbol = TINY_NO_SYMBOL;
+    range.head = ctx->buf;
+    range.tail = ctx->buf + ctx->len;
+    range.s = ctx->buf;
+    range.e = ctx->buf + end;
+
+    tiny_symbol_table_t *symbols = ctx->symbols ? ctx->symbols : &ctx->own_symbols;
+    tiny_parser_result_t result = tiny_syntax_parse_range(ctx->parsers, symbols, ctx->root_name, range, NULL);
+    if (result.state != 0)
+    {
+        // 保留缓冲区，使错误 token 在 tiny_parse_end 之前一直有效
+        ctx->result = result;
+        return result.state;
+    }
+
+    tiny_ast_t *item = result.ast->child;
+    while (item)
+    {
+        tiny_ast_t *next = item->sibling;
+        item->sibling = NULL;
+        if (ctx->on_item)
+            ctx->on_item(ctx->arg, item);
+        else
+            tiny_free_ast(item);
+        item = next;
+    }
+    free(result.ast);
+    // item 中的 token 只在回调期间有效，其中的名字与字符串不再需要
+    if (!ctx->symbols)
+        tiny_symbol_table_reset(&ctx->own_symbols);
+
+    // 更新缓冲区起始处的行列号
+    const char *nl = NULL;
+    for (const char *p = ctx->buf; p < ctx->buf + end && (p = memchr(p, '\n', ctx->buf + end - p)); ++p)
+        ctx->line_number++, nl = p;
+    ctx->line_column = nl ? ctx->buf + end - nl - 1 : ctx->line_column + end;
+
+    memmove(ctx->buf, ctx->buf + end, ctx->len - end);
+    ctx->len -= end;
+    ctx->scan -= end;
+    return 0;
+}
+
+int tiny_parse_feed(tiny_push_parser_t *ctx, const char *bytes, int len)
+{
+    if (ctx->result.state != 0)
+        return ctx->result.state;
+
+    if (ctx->len + len + 1 > ctx->size)
+    {
+        while (ctx->len + len + 1 > ctx->size)
+            ctx->size = ctx->size ? ctx->size * 2 : 4096;
+        ctx->buf = realloc(ctx->buf, ctx->size);
+    }
+    memcpy(ctx->buf + ctx->len, bytes, len);
+    ctx->len += len;
+    ctx->buf[ctx->len] = '\0';
+
+    int end;
+    while ((end = scan_item(ctx, false)) != PUSH_MORE)
+    {
+        int ret = parse_items(ctx, end);
+        if (ret != 0)
+            return ret;
+    }
+    return 0;
+}
+
+int tiny_parse_finish(tiny_push_parser_t *ctx)
+{
+    if (ctx->result.state != 0)
+        return ctx->result.state;
+
+    if (!ctx->buf)
+        tiny_parse_feed(ctx, "", 0);
+
+    int end;
+    while ((end = scan_item(ctx, true)) != PUSH_MORE)
+    {
+        int ret = parse_items(ctx, end);
+        if (ret != 0)
+            return ret;
+    }
+    // 剩余的部分可能是空白、注释或不完整的 func/vars，交给语法分析器报告错误
+    return parse_items(ctx, ctx->len);
+}
+
+void tiny_parse_line_index(tiny_push_parser_t *ctx, tiny_line_index_t *index)
+{
+    tiny_line_index_build(index, ctx->buf, ctx->len);
+    index->base_line = ctx->line_number;
+    index->base_column = ctx->line_column;
+}
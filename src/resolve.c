@@ -0,0 +1,301 @@
+#include "resolve.h"
+#include "syntax_def.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 解析过程中的状态
+ *
+ * binding[symbol] 为该名字当前可见的声明，shadowed[decl] 为该声明遮蔽的同名声明。
+ * active 按声明顺序保存当前所有作用域中的声明，离开作用域时将其弹出并恢复被遮蔽的声明
+ */
+struct resolver_s
+{
+    tiny_resolve_t *resolve;
+
+    int *binding;
+    int binding_size;
+    int *shadowed;
+
+    int *active;
+    int active_count;
+
+    int scope;      // 当前作用域的编号
+    int scope_next; // 下一个新作用域的编号
+
+    tiny_ast_t *func; // 正在解析的 func 节点
+    int func_decl;    // 正在解析的函数的声明
+};
+
+static int symbol_of(struct resolver_s *r, tiny_ast_t *id)
+{
+    if (id->token.symbol == TINY_NO_SYMBOL)
+        id->token.symbol = tiny_symbol_intern(r->resolve->symbols, id->token.s, id->token.e);
+    return id->token.symbol;
+}
+
+static int lookup(struct resolver_s *r, int symbol)
+{
+    return symbol < r->binding_size ? r->binding[symbol] : -1;
+}
+
+static void report(struct resolver_s *r, int error, tiny_ast_t *id)
+{
+    tiny_resolve_t *resolve = r->resolve;
+    if (resolve->error_count == resolve->error_size)
+    {
+        resolve->error_size = resolve->error_size ? resolve->error_size * 2 : 16;
+        resolve->errors = realloc(resolve->errors, resolve->error_size * sizeof(tiny_semantic_error_t));
+    }
+    resolve->errors[resolve->error_count].error = error;
+    resolve->errors[resolve->error_count].token = id->token;
+    resolve->error_count++;
+}
+
+static int open_scope(struct resolver_s *r)
+{
+    int outer = r->scope;
+    r->scope = r->scope_next++;
+    return outer;
+}
+
+/**
+ * 离开作用域，弹出其中的声明
+ * @param mark 进入作用域时 active 的大小
+ */
+static void close_scope(struct resolver_s *r, int outer, int mark)
+{
+    while (r->active_count > mark)
+    {
+        int decl = r->active[--r->active_count];
+        r->binding[r->resolve->decls[decl].symbol] = r->shadowed[decl];
+    }
+    r->scope = outer;
+}
+
+/**
+ * 在当前作用域中声明 symbol，同一作用域中重复的声明会被记录但不可见
+ * @return 声明的编号
+ */
+static int declare(struct resolver_s *r, int kind, int symbol, tiny_ast_t *node, tiny_ast_t *type)
+{
+    tiny_resolve_t *resolve = r->resolve;
+    if (resolve->decl_count == resolve->decl_size)
+    {
+        resolve->decl_size = resolve->decl_size ? resolve->decl_size * 2 : 64;
+        resolve->decls = realloc(resolve->decls, resolve->decl_size * sizeof(tiny_decl_t));
+        r->shadowed = realloc(r->shadowed, resolve->decl_size * sizeof(int));
+        r->active = realloc(r->active, resolve->decl_size * sizeof(int));
+    }
+    if (symbol >= r->binding_size)
+    {
+        int size = r->binding_size;
+        while (symbol >= r->binding_size)
+            r->binding_size = r->binding_size ? r->binding_size * 2 : 64;
+        r->binding = realloc(r->binding, r->binding_size * sizeof(int));
+        memset(r->binding + size, -1, (r->binding_size - size) * sizeof(int));
+    }
+
+    int decl = resolve->decl_count++;
+    tiny_decl_t *d = &resolve->decls[decl];
+    d->kind = kind;
+    d->symbol = symbol;
+    d->node = node;
+    d->type = type;
+    d->func = kind != TINY_DECL_FUNC ? r->func : NULL;
+    d->scope = r->scope;
+    d->locals = 0;
+    if (kind == TINY_DECL_FUNC)
+        d->index = resolve->func_count++;
+    else if (d->func)
+        d->index = resolve->decls[r->func_decl].locals++;
+    else
+        d->index = kind == TINY_DECL_VAR ? resolve->global_count++ : 0;
+    if (node)
+        resolve->decl_of[node->id] = decl;
+
+    int visible = lookup(r, symbol);
+    if (visible >= 0 && resolve->decls[visible].scope == r->scope)
+    {
+        report(r, TINY_DUPLICATE_NAME, node);
+        return decl;
+    }
+    r->shadowed[decl] = visible;
+    r->binding[symbol] = decl;
+    r->active[r->active_count++] = decl;
+    return decl;
+}
+
+/**
+ * vars -> type identifier (',' identifier)* ';'
+ */
+static void declare_vars(struct resolver_s *r, tiny_ast_t *vars)
+{
+    tiny_ast_t *type = vars->child;
+    for (tiny_ast_t *id = type->sibling->child; id; id = id->sibling)
+        if (id->desc == TINY_DESC_IDENTIFIER)
+            declare(r, TINY_DECL_VAR, symbol_of(r, id), id, type);
+}
+
+/**
+ * 将名字的使用绑定到可见的声明
+ * @param call 是否作为函数调用的目标
+ */
+static int use(struct resolver_s *r, tiny_ast_t *id, bool call)
+{
+    int decl = lookup(r, symbol_of(r, id));
+    if (decl < 0)
+    {
+        report(r, TINY_UNDEFINED_NAME, id);
+        return -1;
+    }
+
+    int kind = r->resolve->decls[decl].kind;
+    bool is_func = kind == TINY_DECL_FUNC || kind == TINY_DECL_BUILTIN;
+    if (call && !is_func)
+        report(r, TINY_NOT_A_FUNCTION, id);
+    else if (!call && is_func)
+        report(r, TINY_NOT_A_VARIABLE, id);
+    r->resolve->decl_of[id->id] = decl;
+    return decl;
+}
+
+static void resolve_expr(struct resolver_s *r, tiny_ast_t *expr)
+{
+    if (expr->desc == TINY_DESC_IDENTIFIER)
+    {
+        use(r, expr, false);
+    }
+    else if (expr->desc == TINY_DESC_CALL) // call -> identifier '(' actual_params ')'
+    {
+        r->resolve->decl_of[expr->id] = use(r, expr->child, true);
+        resolve_expr(r, expr->child->sibling->sibling);
+    }
+    else
+    {
+        for (tiny_ast_t *cld = expr->child; cld; cld = cld->sibling)
+            resolve_expr(r, cld);
+    }
+}
+
+static void resolve_statement(struct resolver_s *r, tiny_ast_t *stmt);
+
+/**
+ * block -> 'BEGIN' statement* 'END'
+ * @param scoped 是否为 block 开启新的作用域，函数体最外层的 block 与参数共用作用域
+ */
+static void resolve_block(struct resolver_s *r, tiny_ast_t *block, bool scoped)
+{
+    if (block->desc != TINY_DESC_BLOCK)
+        return; // 惰性函数体
+
+    int mark = r->active_count;
+    int outer = scoped ? open_scope(r) : r->scope;
+    for (tiny_ast_t *stmt = block->child->sibling->child; stmt; stmt = stmt->sibling)
+        resolve_statement(r, stmt);
+    if (scoped)
+        close_scope(r, outer, mark);
+}
+
+static void resolve_statement(struct resolver_s *r, tiny_ast_t *stmt)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+    case TINY_DESC_LAZY_BLOCK:
+        resolve_block(r, stmt, true);
+        break;
+    case TINY_DESC_DECL:
+        declare_vars(r, stmt);
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+    {
+        tiny_ast_t *cond = stmt->child->sibling->sibling;
+        tiny_ast_t *then = cond->sibling->sibling;
+        resolve_expr(r, cond);
+        resolve_statement(r, then);
+        if (then->sibling->child)
+            resolve_statement(r, then->sibling->child->child->sibling);
+        break;
+    }
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+        resolve_expr(r, stmt->child->sibling);
+        break;
+    default: // expression ';'
+        resolve_expr(r, stmt);
+        break;
+    }
+}
+
+/**
+ * func -> type ['MAIN'] identifier '(' formal_params ')' block
+ */
+static void resolve_func(struct resolver_s *r, tiny_ast_t *func)
+{
+    tiny_ast_t *name = func->child->sibling->sibling;
+    tiny_ast_t *params = name->sibling->sibling;
+    tiny_ast_t *block = params->sibling->sibling;
+
+    r->func = func;
+    r->func_decl = r->resolve->decl_of[name->id];
+    int mark = r->active_count;
+    int outer = open_scope(r);
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM) // formal_param -> type identifier
+            declare(r, TINY_DECL_PARAM, symbol_of(r, param->child->sibling), param->child->sibling, param->child);
+    resolve_block(r, block, false);
+    close_scope(r, outer, mark);
+    r->func = NULL;
+}
+
+int tiny_resolve(tiny_resolve_t *resolve, tiny_symbol_table_t *symbols, tiny_ast_t *root)
+{
+    memset(resolve, 0, sizeof(tiny_resolve_t));
+    resolve->symbols = symbols;
+    resolve->node_count = tiny_ast_number(root, 0);
+    resolve->decl_of = malloc(resolve->node_count * sizeof(int));
+    memset(resolve->decl_of, -1, resolve->node_count * sizeof(int));
+
+    struct resolver_s r;
+    memset(&r, 0, sizeof(r));
+    r.resolve = resolve;
+
+    // 内建函数所在的作用域
+    static const char *BUILTINS[] = {"READ", "WRITE"};
+    int builtins = open_scope(&r);
+    for (int i = 0; i < 2; ++i)
+        declare(&r, TINY_DECL_BUILTIN, tiny_symbol_intern(symbols, BUILTINS[i], BUILTINS[i] + strlen(BUILTINS[i])), NULL, NULL);
+
+    // 全局作用域
+    int outer = open_scope(&r);
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+    {
+        if (item->desc == TINY_DESC_FUNC)
+        {
+            tiny_ast_t *name = item->child->sibling->sibling;
+            declare(&r, TINY_DECL_FUNC, symbol_of(&r, name), name, item->child);
+        }
+        else if (item->desc == TINY_DESC_DECL)
+        {
+            declare_vars(&r, item);
+        }
+    }
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+            resolve_func(&r, item);
+    close_scope(&r, outer, 2);
+    close_scope(&r, builtins, 0);
+
+    free(r.binding);
+    free(r.shadowed);
+    free(r.active);
+    return resolve->error_count;
+}
+
+void tiny_resolve_free(tiny_resolve_t *resolve)
+{
+    free(resolve->decl_of);
+    free(resolve->decls);
+    free(resolve->errors);
+    memset(resolve, 0, sizeof(tiny_resolve_t));
+}
@@ -0,0 +1,75 @@
+#include "runtime.h"
+#include "error.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+void tiny_runtime_init(tiny_runtime_t *rt)
+{
+    rt->files = NULL;
+    rt->count = rt->size = 0;
+}
+
+void tiny_runtime_free(tiny_runtime_t *rt)
+{
+    for (int i = 0; i < rt->count; ++i)
+    {
+        fclose(rt->files[i].file);
+        free(rt->files[i].name);
+    }
+    free(rt->files);
+    tiny_runtime_init(rt);
+}
+
+/**
+ * 取得以 write 方式打开的文件 name，第一次使用时打开
+ */
+static FILE *open_file(tiny_runtime_t *rt, const char *name, bool write)
+{
+    for (int i = 0; i < rt->count; ++i)
+        if (rt->files[i].write == write && strcmp(rt->files[i].name, name) == 0)
+            return rt->files[i].file;
+
+    FILE *file = fopen(name, write ? "w" : "r");
+    if (!file)
+        return NULL;
+    if (rt->count == rt->size)
+    {
+        rt->size = rt->size ? rt->size * 2 : 4;
+        rt->files = realloc(rt->files, rt->size * sizeof(struct tiny_runtime_file_s));
+    }
+    rt->files[rt->count].name = strdup(name);
+    rt->files[rt->count].file = file;
+    rt->files[rt->count].write = write;
+    rt->count++;
+    return file;
+}
+
+int tiny_runtime_read(tiny_runtime_t *rt, const char *name, bool real, tiny_value_t *value)
+{
+    FILE *file = open_file(rt, name, false);
+    if (!file)
+        return TINY_IO_ERROR;
+    int ret = real ? fscanf(file, "%lf", &value->r) : fscanf(file, "%" SCNd64, &value->i);
+    return ret == 1 ? 0 : TINY_IO_ERROR;
+}
+
+int tiny_runtime_write(tiny_runtime_t *rt, const char *name, bool real, tiny_value_t value)
+{
+    FILE *file = open_file(rt, name, true);
+    if (!file)
+        return TINY_IO_ERROR;
+    int ret = real ? fprintf(file, "%.17g\n", value.r) : fprintf(file, "%" PRId64 "\n", value.i);
+    return ret > 0 ? 0 : TINY_IO_ERROR;
+}
+
+int64_t tiny_real_to_int(double r)
+{
+    if (r != r)
+        return 0;
+    if (r >= 9223372036854775808.0)
+        return INT64_MAX;
+    if (r < -9223372036854775808.0)
+        return INT64_MIN;
+    return (int64_t)r;
+}
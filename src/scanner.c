@@ -1,16 +1,31 @@
 #include "scanner.h"
 #include <stdlib.h>
 
+/**
+ * 通过 reader 读取一个 token 追加到链表末尾，优先复用回收的内存
+ */
+static void read_token(tiny_scanner_t *scanner)
+{
+    tiny_scanner_token_t *token;
+    if (!list_empty(&scanner->spare))
+    {
+        token = le2scannertoken(list_next(&scanner->spare), list);
+        list_del(&token->list);
+    }
+    else
+    {
+        token = malloc(sizeof(tiny_scanner_token_t));
+    }
+    list_init(&token->list);
+    scanner->reader(scanner->ctx, &token->token);
+    list_add_before(&scanner->tokens, &token->list);
+}
+
 tiny_lex_token_t tiny_scanner_next(tiny_scanner_t *scanner)
 {
     // 如果指向当前 token 的指针没有下一个元素，那么通过 reader 读取
     if (list_next(scanner->cur) == &scanner->tokens)
-    {
-        tiny_scanner_token_t *token = malloc(sizeof(tiny_scanner_token_t));
-        list_init(&token->list);
-        scanner->reader(scanner->ctx, &token->token);
-        list_add_before(&scanner->tokens, &token->list);
-    }
+        read_token(scanner);
 
     scanner->cur = list_next(scanner->cur);
     return tiny_scanner_now(scanner)->token;
@@ -20,12 +35,7 @@ tiny_lex_token_t tiny_scanner_peek(tiny_scanner_t *scanner)
 {
     // 如果指向当前 token 的指针没有下一个元素，那么通过 reader 读取
     if (list_next(scanner->cur) == &scanner->tokens)
-    {
-        tiny_scanner_token_t *token = malloc(sizeof(tiny_scanner_token_t));
-        list_init(&token->list);
-        scanner->reader(scanner->ctx, &token->token);
-        list_add_before(&scanner->tokens, &token->list);
-    }
+        read_token(scanner);
 
     return le2scannertoken(list_next(scanner->cur), list)->token;
 }
@@ -55,7 +65,44 @@ int tiny_scanner_diff(tiny_scanner_t *scanner, tiny_scanner_token_t *token)
 void tiny_scanner_begin(tiny_scanner_t *scanner, void *ctx, void (*reader)(void *ctx, tiny_lex_token_t *token))
 {
     list_init(&scanner->tokens);
+    list_init(&scanner->spare);
     scanner->cur = &scanner->tokens;
     scanner->ctx = ctx;
     scanner->reader = reader;
 }
+
+void tiny_scanner_restart(tiny_scanner_t *scanner, void *ctx)
+{
+    if (!list_empty(&scanner->tokens))
+    {
+        // 把 tokens 整段接到 spare 的末尾
+        list_entry_t *first = list_next(&scanner->tokens), *last = list_prev(&scanner->tokens);
+        list_entry_t *tail = list_prev(&scanner->spare);
+        tail->next = first;
+        first->prev = tail;
+        last->next = &scanner->spare;
+        scanner->spare.prev = last;
+        list_init(&scanner->tokens);
+    }
+    scanner->cur = &scanner->tokens;
+    scanner->ctx = ctx;
+}
+
+static void free_tokens(list_entry_t *list)
+{
+    list_entry_t *entry = list_next(list);
+    while (entry != list)
+    {
+        list_entry_t *next = list_next(entry);
+        free(le2scannertoken(entry, list));
+        entry = next;
+    }
+    list_init(list);
+}
+
+void tiny_scanner_end(tiny_scanner_t *scanner)
+{
+    free_tokens(&scanner->tokens);
+    free_tokens(&scanner->spare);
+    scanner->cur = &scanner->tokens;
+}
@@ -0,0 +1,322 @@
+#define _GNU_SOURCE // accept4
+#include "server.h"
+#include "error.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int make_address(const char *path, struct sockaddr_un *addr)
+{
+    if (strlen(path) >= sizeof(addr->sun_path))
+        return TINY_IO_ERROR;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int tiny_server_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) != 0)
+        return TINY_IO_ERROR;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return TINY_IO_ERROR;
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return TINY_IO_ERROR;
+    }
+    return fd;
+}
+
+int tiny_server_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) != 0)
+        return TINY_IO_ERROR;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return TINY_IO_ERROR;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return TINY_IO_ERROR;
+    }
+    return fd;
+}
+
+int tiny_server_read(int fd, void *data, size_t len)
+{
+    char *p = data;
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = read(fd, p + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0 && done == 0)
+            return TINY_EOF;
+        if (n <= 0)
+            return TINY_IO_ERROR;
+        done += n;
+    }
+    return 0;
+}
+
+int tiny_server_write(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0)
+    {
+        // 对方已经断开时返回错误，不产生 SIGPIPE
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return TINY_IO_ERROR;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int tiny_server_sendfile(int fd, int file, uint64_t len)
+{
+    off_t offset = 0;
+    while ((uint64_t)offset < len)
+    {
+        ssize_t n = sendfile(fd, file, &offset, len - offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return TINY_IO_ERROR;
+    }
+    return 0;
+}
+
+struct server_s
+{
+    const tiny_server_handler_t *handler;
+    int epoll;
+    pthread_mutex_t lock; // 保护队列与 stop
+    pthread_cond_t ready;
+    int *queue; // 可读的连接，环形队列
+    int head, count, size;
+    bool stop;
+};
+
+struct server_worker_s
+{
+    pthread_t thread;
+    void *state;
+    long requests;
+    struct server_s *server;
+};
+
+/**
+ * 读取并处理连接 fd 上的一个请求，写出响应
+ * @return 0，TINY_EOF（连接已关闭）或 TINY_IO_ERROR（请求无效或连接出错）
+ */
+static int serve_request(struct server_worker_s *self, int fd)
+{
+    tiny_request_t request;
+    int ret = tiny_server_read(fd, &request, sizeof(request));
+    if (ret != 0)
+        return ret;
+    if (request.magic != TINY_SERVER_MAGIC || request.name_len == 0 || request.name_len > TINY_REQUEST_MAX_NAME ||
+        request.source_len > TINY_REQUEST_MAX_SOURCE ||
+        (!(request.flags & TINY_REQUEST_SOURCE) && request.source_len != 0))
+        return TINY_IO_ERROR;
+
+    char name[TINY_REQUEST_MAX_NAME + 1];
+    if (tiny_server_read(fd, name, request.name_len) != 0)
+        return TINY_IO_ERROR;
+    name[request.name_len] = '\0';
+    char *code = NULL;
+    if (request.flags & TINY_REQUEST_SOURCE)
+    {
+        code = malloc(request.source_len + 1);
+        if (!code || (request.source_len > 0 && tiny_server_read(fd, code, request.source_len) != 0))
+        {
+            free(code);
+            return TINY_IO_ERROR;
+        }
+        code[request.source_len] = '\0';
+    }
+
+    tiny_server_reply_t reply = {.ast_fd = -1};
+    self->server->handler->handle(self->state, &request, name, code, &reply);
+
+    tiny_response_t response = {TINY_SERVER_MAGIC, reply.failed, reply.out_len, reply.err_len, 0};
+    if (reply.ast_fd != -1)
+    {
+        off_t size = lseek(reply.ast_fd, 0, SEEK_END);
+        response.ast_len = size > 0 ? size : 0;
+    }
+    ret = tiny_server_write(fd, &response, sizeof(response)) != 0 ||
+                  tiny_server_write(fd, reply.out, reply.out_len) != 0 ||
+                  tiny_server_write(fd, reply.err, reply.err_len) != 0 ||
+                  (response.ast_len > 0 && tiny_server_sendfile(fd, reply.ast_fd, response.ast_len) != 0)
+              ? TINY_IO_ERROR
+              : 0;
+
+    if (reply.ast_fd != -1)
+        close(reply.ast_fd);
+    free(reply.out);
+    free(reply.err);
+    free(code);
+    self->requests++;
+    return ret;
+}
+
+static void *server_worker_main(void *arg)
+{
+    struct server_worker_s *self = arg;
+    struct server_s *server = self->server;
+    for (;;)
+    {
+        pthread_mutex_lock(&server->lock);
+        while (server->count == 0 && !server->stop)
+            pthread_cond_wait(&server->ready, &server->lock);
+        if (server->stop)
+        {
+            pthread_mutex_unlock(&server->lock);
+            return NULL;
+        }
+        int fd = server->queue[server->head];
+        server->head = (server->head + 1) % server->size;
+        server->count--;
+        pthread_mutex_unlock(&server->lock);
+
+        // 主线程交出连接前已把它移出 epoll，处理完一个请求后再加回，同一时刻只有一个线程处理它
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+        if (serve_request(self, fd) != 0 || epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+            close(fd);
+    }
+}
+
+/**
+ * 把可读的连接 fd 交给工作线程
+ */
+static void server_push(struct server_s *server, int fd)
+{
+    pthread_mutex_lock(&server->lock);
+    if (server->count == server->size)
+    {
+        // 扩大后把环形队列展开到新数组的开头
+        int size = server->size * 2;
+        int *queue = malloc(size * sizeof(int));
+        for (int i = 0; i < server->count; ++i)
+            queue[i] = server->queue[(server->head + i) % server->size];
+        free(server->queue);
+        server->queue = queue;
+        server->head = 0;
+        server->size = size;
+    }
+    server->queue[(server->head + server->count) % server->size] = fd;
+    server->count++;
+    pthread_cond_signal(&server->ready);
+    pthread_mutex_unlock(&server->lock);
+}
+
+int tiny_server_run(const char *path, int nworkers, const tiny_server_handler_t *handler)
+{
+    // 信号通过 signalfd 与连接一起等待，工作线程继承屏蔽字，不会被信号打断
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    int sigfd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+    int listener = tiny_server_listen(path);
+    if (listener < 0 || sigfd < 0)
+    {
+        perror("cannot listen on socket");
+        return 2;
+    }
+    struct server_s server = {.handler = handler, .epoll = epoll_create1(EPOLL_CLOEXEC)};
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    server.size = 64;
+    server.queue = malloc(server.size * sizeof(int));
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = listener};
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = sigfd;
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, sigfd, &event);
+
+    struct server_worker_s *workers = calloc(nworkers, sizeof(struct server_worker_s));
+    for (int w = 0; w < nworkers; ++w)
+    {
+        struct server_worker_s *worker = &workers[w];
+        worker->state = handler->init(handler->arg);
+        worker->server = &server;
+        pthread_create(&worker->thread, NULL, server_worker_main, worker);
+    }
+    fprintf(stderr, "serving on %s with %d threads\n", path, nworkers);
+
+    bool running = true;
+    while (running)
+    {
+        struct epoll_event events[64];
+        int n = epoll_wait(server.epoll, events, 64, -1);
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == sigfd)
+            {
+                running = false;
+            }
+            else if (fd == listener)
+            {
+                int client = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+                struct epoll_event request = {.events = EPOLLIN, .data.fd = client};
+                if (client >= 0 && epoll_ctl(server.epoll, EPOLL_CTL_ADD, client, &request) != 0)
+                    close(client);
+            }
+            else
+            {
+                epoll_ctl(server.epoll, EPOLL_CTL_DEL, fd, NULL);
+                server_push(&server, fd);
+            }
+        }
+    }
+
+    // 正在处理的请求完成后工作线程退出，其余的连接在进程退出时关闭
+    pthread_mutex_lock(&server.lock);
+    server.stop = true;
+    pthread_cond_broadcast(&server.ready);
+    pthread_mutex_unlock(&server.lock);
+    long requests = 0;
+    for (int w = 0; w < nworkers; ++w)
+        pthread_join(workers[w].thread, NULL);
+    for (int w = 0; w < nworkers; ++w)
+    {
+        requests += workers[w].requests;
+        handler->end(handler->arg, workers[w].state);
+    }
+    fprintf(stderr, "served %ld requests\n", requests);
+
+    unlink(path);
+    close(listener);
+    close(sigfd);
+    close(server.epoll);
+    free(server.queue);
+    free(workers);
+    pthread_cond_destroy(&server.ready);
+    pthread_mutex_destroy(&server.lock);
+    return 0;
+}
@@ -32,30 +32,61 @@ int is_symbol(int s1, int s2, int s3) {
 	return 0;
 }
 
-struct parse_string_literal_result_s parse_string_literal(const char *s, const char *e)
+static int hex_value(char c)
+{
+    return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+static char escape_char(char c)
+{
+    switch (c)
+    {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case '0': return '\0';
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: return c; // \\ \' \" 以及其他字符均表示其本身
+    }
+}
+
+struct parse_string_literal_result_s parse_string_literal(const char *s, const char *e, char *buf)
 {
     struct parse_string_literal_result_s result;
     result.ret = 0;
-    for (const char *c = s; c != e; ++c)
+    result.column = 0;
+    result.len = 0;
+    result.escaped = false;
+    const char *q = e - 1; // 结束引号
+    for (const char *c = s + 1; c < q; ++c)
     {
-        if (*c == '\\')
+        char ch = *c;
+        if (ch == '\\')
         {
-            char nxt = *(c + 1);
-            if (nxt == 'x')
+            result.escaped = true;
+            if (c[1] == 'x')
             {
-                if (c + 2 == e || c + 3 == e)
+                if (c + 3 >= q || !is_hex_digit(c[2]) || !is_hex_digit(c[3]))
                 {
                     result.ret = TINY_INVALID_STRING_X_NO_FOLLOWING_HEX_DIGITS;
                     result.column = c - s;
                     return result;
                 }
+                ch = hex_value(c[2]) * 16 + hex_value(c[3]);
                 c += 3;
             }
             else
             {
+                ch = escape_char(c[1]);
                 c += 1;
             }
         }
+        if (buf)
+            buf[result.len] = ch;
+        result.len++;
     }
     return result;
 }
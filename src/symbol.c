@@ -0,0 +1,106 @@
+#include "symbol.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_INITIAL_CAPACITY 256
+
+static uint32_t hash_string(const char *s, const char *e)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; s != e; ++s)
+        hash = (hash ^ (unsigned char)*s) * 16777619u;
+    return hash;
+}
+
+void tiny_symbol_table_init(tiny_symbol_table_t *table)
+{
+    tiny_arena_init(&table->arena);
+    table->capacity = SYMBOL_INITIAL_CAPACITY;
+    table->slots = calloc(table->capacity, sizeof(uint32_t));
+    table->size = SYMBOL_INITIAL_CAPACITY / 2;
+    table->symbols = malloc(table->size * sizeof(tiny_symbol_t));
+    table->count = 0;
+}
+
+void tiny_symbol_table_free(tiny_symbol_table_t *table)
+{
+    tiny_arena_free(&table->arena);
+    free(table->slots);
+    free(table->symbols);
+    table->slots = NULL;
+    table->symbols = NULL;
+    table->count = table->size = 0;
+}
+
+void tiny_symbol_table_reset(tiny_symbol_table_t *table)
+{
+    tiny_arena_reset(&table->arena);
+    memset(table->slots, 0, table->capacity * sizeof(uint32_t));
+    table->count = 0;
+}
+
+/**
+ * @return s[0, e) 所在的槽，或者它应当插入的空槽
+ */
+static uint32_t *find_slot(const tiny_symbol_table_t *table, const char *s, const char *e, uint32_t hash)
+{
+    uint32_t mask = table->capacity - 1;
+    int len = e - s;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t *slot = &table->slots[i];
+        if (*slot == 0)
+            return slot;
+        const tiny_symbol_t *symbol = &table->symbols[*slot - 1];
+        if (symbol->hash == hash && symbol->len == len && memcmp(symbol->name, s, len) == 0)
+            return slot;
+    }
+}
+
+static void grow(tiny_symbol_table_t *table)
+{
+    free(table->slots);
+    table->capacity *= 2;
+    table->slots = calloc(table->capacity, sizeof(uint32_t));
+    uint32_t mask = table->capacity - 1;
+    for (int id = 0; id < table->count; ++id)
+    {
+        uint32_t i = table->symbols[id].hash & mask;
+        while (table->slots[i])
+            i = (i + 1) & mask;
+        table->slots[i] = id + 1;
+    }
+}
+
+int tiny_symbol_intern(tiny_symbol_table_t *table, const char *s, const char *e)
+{
+    uint32_t hash = hash_string(s, e);
+    uint32_t *slot = find_slot(table, s, e, hash);
+    if (*slot)
+        return *slot - 1;
+
+    if (table->count == table->size)
+        table->symbols = realloc(table->symbols, (table->size *= 2) * sizeof(tiny_symbol_t));
+    int id = table->count++;
+    table->symbols[id].name = tiny_arena_strndup(&table->arena, s, e - s);
+    table->symbols[id].len = e - s;
+    table->symbols[id].hash = hash;
+    *slot = id + 1;
+
+    // 装载因子保持在 1/2 以下
+    if ((uint32_t)table->count * 2 > table->capacity)
+        grow(table);
+    return id;
+}
+
+int tiny_symbol_find(const tiny_symbol_table_t *table, const char *s, const char *e)
+{
+    uint32_t *slot = find_slot(table, s, e, hash_string(s, e));
+    return *slot ? (int)*slot - 1 : TINY_NO_SYMBOL;
+}
+
+const char *tiny_symbol_name(const tiny_symbol_table_t *table, int symbol)
+{
+    return table->symbols[symbol].name;
+}
@@ -0,0 +1,677 @@
+#include "symindex.h"
+#include "error.h"
+#include "lexical.h"
+#include "outbuf.h"
+#include "syntax_def.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void tiny_index_source_init(tiny_index_source_t *source, const char *path)
+{
+    memset(source, 0, sizeof(*source));
+    source->path = path;
+    tiny_arena_init(&source->arena);
+}
+
+void tiny_index_source_free(tiny_index_source_t *source)
+{
+    tiny_arena_free(&source->arena);
+    free(source->records);
+    source->records = NULL;
+    source->count = source->size = 0;
+}
+
+static tiny_index_record_t *push_record(tiny_index_source_t *source)
+{
+    if (source->count == source->size)
+    {
+        source->size = source->size ? source->size * 2 : 64;
+        source->records = realloc(source->records, source->size * sizeof(tiny_index_record_t));
+    }
+    return &source->records[source->count++];
+}
+
+// ---------------------------------------------------------------- 提取
+
+struct collector_s
+{
+    tiny_index_source_t *source;
+    const char *code;
+    tiny_line_index_t lines;
+    const char *caller; // 当前函数的名字
+    uint32_t caller_len;
+};
+
+static tiny_index_record_t *add_record(struct collector_s *c, int kind, const tiny_ast_t *name)
+{
+    tiny_index_record_t *record = push_record(c->source);
+    int line, column;
+    tiny_line_index_position(&c->lines, name->token.s, &line, &column);
+    record->kind = kind;
+    record->name_len = name->token.e - name->token.s;
+    record->name = tiny_arena_strndup(&c->source->arena, name->token.s, record->name_len);
+    record->caller = NULL;
+    record->caller_len = 0;
+    record->offset = name->token.s - c->code;
+    record->line = line;
+    return record;
+}
+
+static void collect_calls(struct collector_s *c, const tiny_ast_t *ast)
+{
+    for (; ast; ast = ast->sibling)
+    {
+        // call -> identifier '(' actual_params ')'
+        if (ast->desc == TINY_DESC_CALL && ast->child && ast->child->token.s)
+        {
+            tiny_index_record_t *record = add_record(c, TINY_INDEX_CALL, ast->child);
+            record->caller = c->caller;
+            record->caller_len = c->caller_len;
+        }
+        collect_calls(c, ast->child);
+    }
+}
+
+void tiny_index_collect(tiny_index_source_t *source, const tiny_ast_t *root, const char *code, size_t len)
+{
+    struct collector_s c = {.source = source, .code = code};
+    tiny_line_index_build(&c.lines, code, len);
+    for (const tiny_ast_t *item = root->child; item; item = item->sibling)
+    {
+        const tiny_ast_t *type = item->child;
+        if (item->desc == TINY_DESC_FUNC) // func -> type [main] identifier '(' formal_params ')' block
+        {
+            tiny_index_record_t *record = add_record(&c, TINY_INDEX_FUNC, type->sibling->sibling);
+            c.caller = record->name;
+            c.caller_len = record->name_len;
+            collect_calls(&c, type->sibling->sibling->sibling);
+        }
+        else if (item->desc == TINY_DESC_DECL) // vars -> type identifier (',' identifier)* ';'
+        {
+            for (const tiny_ast_t *name = type->sibling->child; name; name = name->sibling)
+                if (name->desc == TINY_DESC_IDENTIFIER)
+                    add_record(&c, TINY_INDEX_VAR, name);
+        }
+    }
+    tiny_line_index_free(&c.lines);
+}
+
+// ---------------------------------------------------------------- 写入
+
+static int compare_names(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    return c ? c : (a_len > b_len) - (a_len < b_len);
+}
+
+static int compare_sources(const void *a, const void *b)
+{
+    return strcmp((*(tiny_index_source_t *const *)a)->path, (*(tiny_index_source_t *const *)b)->path);
+}
+
+/**
+ * 所有文件的记录，按 (name, kind, file, offset) 排序后相同名字的记录相邻，且已经是位置的编码顺序
+ */
+struct entry_s
+{
+    const tiny_index_record_t *record;
+    uint32_t file;
+};
+
+static int compare_entries(const void *a, const void *b)
+{
+    const struct entry_s *x = a, *y = b;
+    int c = compare_names(x->record->name, x->record->name_len, y->record->name, y->record->name_len);
+    if (c)
+        return c;
+    if (x->record->kind != y->record->kind)
+        return x->record->kind - y->record->kind;
+    if (x->file != y->file)
+        return x->file < y->file ? -1 : 1;
+    return (x->record->offset > y->record->offset) - (x->record->offset < y->record->offset);
+}
+
+struct bytes_s
+{
+    uint8_t *data;
+    size_t len, size;
+};
+
+static void put_varint(struct bytes_s *bytes, uint64_t v)
+{
+    if (bytes->len + 10 > bytes->size)
+    {
+        bytes->size = bytes->size ? bytes->size * 2 : 4096;
+        bytes->data = realloc(bytes->data, bytes->size);
+    }
+    while (v >= 0x80)
+    {
+        bytes->data[bytes->len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    bytes->data[bytes->len++] = (uint8_t)v;
+}
+
+/**
+ * 在已排序的 symbols[0, count) 中二分查找名字
+ */
+static int64_t find_symbol(const struct entry_s *const *symbols, int64_t count, const char *name, size_t len)
+{
+    int64_t l = 0, r = count - 1;
+    while (l <= r)
+    {
+        int64_t mid = l + (r - l) / 2;
+        const tiny_index_record_t *record = symbols[mid]->record;
+        int c = compare_names(record->name, record->name_len, name, len);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            l = mid + 1;
+        else
+            r = mid - 1;
+    }
+    return -1;
+}
+
+int tiny_index_write(const char *path, uint64_t fingerprint, tiny_index_source_t *sources, int count)
+{
+    tiny_index_source_t **files = malloc((count ? count : 1) * sizeof(tiny_index_source_t *));
+    size_t entry_count = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        files[i] = &sources[i];
+        entry_count += sources[i].count;
+    }
+    qsort(files, count, sizeof(tiny_index_source_t *), compare_sources);
+
+    struct entry_s *entries = malloc((entry_count ? entry_count : 1) * sizeof(struct entry_s));
+    size_t n = 0;
+    for (int i = 0; i < count; ++i)
+        for (int k = 0; k < files[i]->count; ++k)
+        {
+            entries[n].record = &files[i]->records[k];
+            entries[n++].file = i;
+        }
+    qsort(entries, entry_count, sizeof(struct entry_s), compare_entries);
+
+    // 每个符号的第一条记录
+    const struct entry_s **symbols = malloc((entry_count ? entry_count : 1) * sizeof(struct entry_s *));
+    int64_t symbol_count = 0;
+    for (size_t i = 0; i < entry_count; ++i)
+    {
+        const tiny_index_record_t *record = entries[i].record;
+        if (i == 0 || compare_names(entries[i - 1].record->name, entries[i - 1].record->name_len, record->name,
+                                    record->name_len) != 0)
+            symbols[symbol_count++] = &entries[i];
+    }
+
+    // 位置区
+    struct bytes_s postings = {0};
+    tiny_index_symbol_t *table = calloc(symbol_count ? symbol_count : 1, sizeof(tiny_index_symbol_t));
+    uint64_t string_size = 0;
+    for (int i = 0; i < count; ++i)
+        string_size += strlen(files[i]->path) + 1;
+    for (int64_t s = 0; s < symbol_count; ++s)
+    {
+        const struct entry_s *e = symbols[s], *end = s + 1 < symbol_count ? symbols[s + 1] : entries + entry_count;
+        tiny_index_symbol_t *symbol = &table[s];
+        symbol->name_offset = string_size;
+        symbol->name_len = e->record->name_len;
+        symbol->postings_offset = postings.len;
+        string_size += symbol->name_len + 1;
+
+        const struct entry_s *prev = NULL;
+        for (; e < end; prev = e++)
+        {
+            const tiny_index_record_t *record = e->record;
+            symbol->count[record->kind]++;
+            if (prev && prev->record->kind != record->kind)
+                prev = NULL;
+            uint32_t file = prev ? prev->file : 0;
+            put_varint(&postings, e->file - file);
+            if (prev && prev->file == e->file)
+            {
+                put_varint(&postings, record->offset - prev->record->offset);
+                put_varint(&postings, record->line - prev->record->line);
+            }
+            else
+            {
+                put_varint(&postings, record->offset);
+                put_varint(&postings, record->line);
+            }
+            if (record->kind == TINY_INDEX_CALL)
+                put_varint(&postings, find_symbol(symbols, symbol_count, record->caller, record->caller_len) + 1);
+        }
+        symbol->postings_len = postings.len - symbol->postings_offset;
+    }
+
+    tiny_index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TINY_INDEX_MAGIC, sizeof(TINY_INDEX_MAGIC));
+    header.version = TINY_INDEX_VERSION;
+    header.byte_order = TINY_INDEX_BYTE_ORDER;
+    header.fingerprint = fingerprint;
+    header.file_count = count;
+    header.file_offset = sizeof(header);
+    header.symbol_count = symbol_count;
+    header.symbol_offset = header.file_offset + count * sizeof(tiny_index_file_t);
+    header.postings_offset = header.symbol_offset + symbol_count * sizeof(tiny_index_symbol_t);
+    header.postings_size = postings.len;
+    header.string_offset = header.postings_offset + postings.len;
+    header.string_size = string_size;
+
+    char temp[4096];
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid());
+    tiny_outbuf_t out;
+    int ret = tiny_outbuf_open(&out, temp);
+    if (ret == 0)
+    {
+        tiny_outbuf_write(&out, (const char *)&header, sizeof(header));
+        uint64_t path_offset = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            tiny_index_file_t file = {files[i]->hash, path_offset, strlen(files[i]->path), files[i]->count};
+            tiny_outbuf_write(&out, (const char *)&file, sizeof(file));
+            path_offset += file.path_len + 1;
+        }
+        tiny_outbuf_write(&out, (const char *)table, symbol_count * sizeof(tiny_index_symbol_t));
+        tiny_outbuf_write(&out, (const char *)postings.data, postings.len);
+        for (int i = 0; i < count; ++i)
+            tiny_outbuf_write(&out, files[i]->path, strlen(files[i]->path) + 1);
+        for (int64_t s = 0; s < symbol_count; ++s)
+        {
+            tiny_outbuf_write(&out, symbols[s]->record->name, symbols[s]->record->name_len);
+            tiny_outbuf_putc(&out, '\0');
+        }
+        ret = tiny_outbuf_close(&out);
+        if (ret == 0 && rename(temp, path) != 0)
+            ret = TINY_IO_ERROR;
+        if (ret != 0)
+            unlink(temp);
+    }
+
+    free(postings.data);
+    free(table);
+    free(symbols);
+    free(entries);
+    free(files);
+    return ret;
+}
+
+// ---------------------------------------------------------------- 读取
+
+int tiny_index_open(tiny_index_t *index, const char *path)
+{
+    memset(index, 0, sizeof(*index));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return TINY_IO_ERROR;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return TINY_IO_ERROR;
+    }
+    if ((size_t)st.st_size < sizeof(tiny_index_header_t))
+    {
+        close(fd);
+        return TINY_INVALID_INDEX_FILE;
+    }
+    // 映射在关闭文件后仍然有效
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return TINY_IO_ERROR;
+
+    const tiny_index_header_t *header = base;
+    uint64_t size = st.st_size;
+    bool valid = memcmp(header->magic, TINY_INDEX_MAGIC, sizeof(TINY_INDEX_MAGIC)) == 0 &&
+                 header->version == TINY_INDEX_VERSION &&
+                 header->byte_order == TINY_INDEX_BYTE_ORDER &&
+                 header->file_offset % 8 == 0 &&
+                 header->file_offset >= sizeof(tiny_index_header_t) &&
+                 header->file_offset <= size &&
+                 header->file_count <= (size - header->file_offset) / sizeof(tiny_index_file_t) &&
+                 header->symbol_offset % 8 == 0 &&
+                 header->symbol_offset >= header->file_offset + header->file_count * sizeof(tiny_index_file_t) &&
+                 header->symbol_offset <= size &&
+                 header->symbol_count <= (size - header->symbol_offset) / sizeof(tiny_index_symbol_t) &&
+                 header->postings_offset >=
+                     header->symbol_offset + header->symbol_count * sizeof(tiny_index_symbol_t) &&
+                 header->postings_offset <= size &&
+                 header->postings_size <= size - header->postings_offset &&
+                 header->string_offset >= header->postings_offset + header->postings_size &&
+                 header->string_offset <= size &&
+                 header->string_size <= size - header->string_offset;
+    if (!valid)
+    {
+        munmap(base, st.st_size);
+        return TINY_INVALID_INDEX_FILE;
+    }
+
+    index->base = base;
+    index->size = st.st_size;
+    index->header = header;
+    index->files = (const tiny_index_file_t *)((const char *)base + header->file_offset);
+    index->symbols = (const tiny_index_symbol_t *)((const char *)base + header->symbol_offset);
+    index->postings = (const uint8_t *)base + header->postings_offset;
+    index->strings = (const char *)base + header->string_offset;
+    return 0;
+}
+
+void tiny_index_close(tiny_index_t *index)
+{
+    if (index->base)
+        munmap(index->base, index->size);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * 字符串区中 [offset, offset + len) 及其后的 '\0'，越界时返回 NULL
+ */
+static const char *string_at(const tiny_index_t *index, uint64_t offset, uint32_t len)
+{
+    uint64_t size = index->header->string_size;
+    if (offset > size || len >= size - offset || index->strings[offset + len] != '\0')
+        return NULL;
+    return index->strings + offset;
+}
+
+const char *tiny_index_name(const tiny_index_t *index, uint64_t symbol, size_t *len)
+{
+    *len = 0;
+    if (symbol >= index->header->symbol_count)
+        return NULL;
+    const tiny_index_symbol_t *entry = &index->symbols[symbol];
+    const char *name = string_at(index, entry->name_offset, entry->name_len);
+    if (name)
+        *len = entry->name_len;
+    return name;
+}
+
+const char *tiny_index_path(const tiny_index_t *index, uint64_t file, size_t *len)
+{
+    *len = 0;
+    if (file >= index->header->file_count)
+        return NULL;
+    const tiny_index_file_t *entry = &index->files[file];
+    const char *path = string_at(index, entry->path_offset, entry->path_len);
+    if (path)
+        *len = entry->path_len;
+    return path;
+}
+
+int64_t tiny_index_lookup(const tiny_index_t *index, const char *name, size_t len)
+{
+    int64_t l = 0, r = (int64_t)index->header->symbol_count - 1;
+    while (l <= r)
+    {
+        int64_t mid = l + (r - l) / 2;
+        size_t mid_len;
+        const char *mid_name = tiny_index_name(index, mid, &mid_len);
+        if (!mid_name)
+            return -1;
+        int c = compare_names(mid_name, mid_len, name, len);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            l = mid + 1;
+        else
+            r = mid - 1;
+    }
+    return -1;
+}
+
+int64_t tiny_index_find_file(const tiny_index_t *index, const char *path)
+{
+    int64_t l = 0, r = (int64_t)index->header->file_count - 1;
+    while (l <= r)
+    {
+        int64_t mid = l + (r - l) / 2;
+        size_t mid_len;
+        const char *mid_path = tiny_index_path(index, mid, &mid_len);
+        if (!mid_path)
+            return -1;
+        int c = strcmp(mid_path, path);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            l = mid + 1;
+        else
+            r = mid - 1;
+    }
+    return -1;
+}
+
+static bool read_varint(const uint8_t **p, const uint8_t *e, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; *p < e && shift < 64; shift += 7)
+    {
+        uint8_t b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void tiny_index_iter_begin(tiny_index_iter_t *iter, const tiny_index_t *index, uint64_t symbol, int kind)
+{
+    memset(iter, 0, sizeof(*iter));
+    iter->index = index;
+    iter->kind = kind;
+    if (symbol >= index->header->symbol_count || kind < 0 || kind >= TINY_INDEX_KINDS)
+        return;
+    const tiny_index_symbol_t *entry = &index->symbols[symbol];
+    uint64_t size = index->header->postings_size;
+    if (entry->postings_offset > size || entry->postings_len > size - entry->postings_offset)
+        return;
+    iter->p = index->postings + entry->postings_offset;
+    iter->e = iter->p + entry->postings_len;
+
+    // 之前各种 kind 的位置都没有调用者
+    uint64_t v;
+    for (int k = 0; k < kind; ++k)
+        for (uint64_t i = 0; i < (uint64_t)entry->count[k] * 3; ++i)
+            if (!read_varint(&iter->p, iter->e, &v))
+                return;
+    iter->remaining = entry->count[kind];
+}
+
+bool tiny_index_iter_next(tiny_index_iter_t *iter, tiny_index_posting_t *posting)
+{
+    if (iter->remaining == 0)
+        return false;
+    uint64_t file, offset, line, caller = 0;
+    if (!read_varint(&iter->p, iter->e, &file) || !read_varint(&iter->p, iter->e, &offset) ||
+        !read_varint(&iter->p, iter->e, &line) ||
+        (iter->kind == TINY_INDEX_CALL && !read_varint(&iter->p, iter->e, &caller)))
+    {
+        iter->remaining = 0;
+        return false;
+    }
+    tiny_index_posting_t *last = &iter->last;
+    if (iter->started && file == 0)
+    {
+        offset += last->offset;
+        line += last->line;
+    }
+    last->kind = iter->kind;
+    last->file = (iter->started ? last->file : 0) + file;
+    last->offset = offset;
+    last->line = line;
+    last->caller = (int64_t)caller - 1;
+    iter->started = true;
+    iter->remaining--;
+    *posting = *last;
+    return true;
+}
+
+void tiny_index_extract(const tiny_index_t *index, tiny_index_source_t **sources)
+{
+    for (uint64_t s = 0; s < index->header->symbol_count; ++s)
+    {
+        size_t name_len;
+        const char *name = tiny_index_name(index, s, &name_len);
+        if (!name)
+            continue;
+        for (int kind = 0; kind < TINY_INDEX_KINDS; ++kind)
+        {
+            tiny_index_iter_t iter;
+            tiny_index_posting_t posting;
+            tiny_index_iter_begin(&iter, index, s, kind);
+            while (tiny_index_iter_next(&iter, &posting))
+            {
+                if (posting.file >= index->header->file_count || !sources[posting.file])
+                    continue;
+                tiny_index_record_t *record = push_record(sources[posting.file]);
+                size_t caller_len = 0;
+                record->kind = kind;
+                record->name = name;
+                record->name_len = name_len;
+                record->caller = posting.caller >= 0 ? tiny_index_name(index, posting.caller, &caller_len) : NULL;
+                record->caller_len = caller_len;
+                record->offset = posting.offset;
+                record->line = posting.line;
+            }
+        }
+    }
+}
+
+struct path_list_s
+{
+    char **paths;
+    int count, size;
+};
+
+/**
+ * 把 path 加入 list：目录递归查找其中的 .tny 文件，其他路径直接加入
+ */
+static void find_sources(struct path_list_s *list, const char *path, bool top)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        if (top)
+            fprintf(stderr, "%s: file not found\n", path);
+        return;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        DIR *dir = opendir(path);
+        if (!dir)
+            return;
+        struct dirent *entry;
+        while ((entry = readdir(dir)))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            size_t len = strlen(path);
+            char *child = malloc(len + strlen(entry->d_name) + 2);
+            sprintf(child, len > 0 && path[len - 1] == '/' ? "%s%s" : "%s/%s", path, entry->d_name);
+            find_sources(list, child, false);
+            free(child);
+        }
+        closedir(dir);
+        return;
+    }
+    size_t len = strlen(path);
+    if (!top && (!S_ISREG(st.st_mode) || len < 4 || strcmp(path + len - 4, ".tny") != 0))
+        return;
+    if (list->count == list->size)
+    {
+        list->size = list->size ? list->size * 2 : 64;
+        list->paths = realloc(list->paths, list->size * sizeof(char *));
+    }
+    list->paths[list->count++] = strdup(path);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int tiny_index_build(const char *path, uint64_t fingerprint, char **paths, int count, tiny_index_parse_t parse,
+                     void *arg)
+{
+    struct path_list_s list = {0};
+    for (int i = 0; i < count; ++i)
+        find_sources(&list, paths[i], true);
+    qsort(list.paths, list.count, sizeof(char *), compare_paths);
+    // 同一个文件可能被多次给出
+    int n = 0;
+    for (int i = 0; i < list.count; ++i)
+    {
+        if (n > 0 && strcmp(list.paths[n - 1], list.paths[i]) == 0)
+            free(list.paths[i]);
+        else
+            list.paths[n++] = list.paths[i];
+    }
+    list.count = n;
+
+    tiny_index_t old;
+    bool has_old = tiny_index_open(&old, path) == 0;
+    if (has_old && old.header->fingerprint != fingerprint)
+    {
+        tiny_index_close(&old);
+        has_old = false;
+    }
+
+    tiny_index_source_t *sources = calloc(list.count ? list.count : 1, sizeof(tiny_index_source_t));
+    tiny_index_source_t **old_sources = has_old ? calloc(old.header->file_count + 1, sizeof(tiny_index_source_t *))
+                                                : NULL;
+    for (int i = 0; i < list.count; ++i)
+    {
+        tiny_index_source_init(&sources[i], list.paths[i]);
+        int64_t file = has_old ? tiny_index_find_file(&old, list.paths[i]) : -1;
+        if (file >= 0)
+        {
+            sources[i].known = true;
+            sources[i].hash = old.files[file].hash;
+        }
+    }
+
+    int failed = parse(arg, sources, list.count), reused = 0;
+    for (int i = 0; i < list.count; ++i)
+    {
+        if (sources[i].reused)
+        {
+            old_sources[tiny_index_find_file(&old, list.paths[i])] = &sources[i];
+            reused++;
+        }
+    }
+    if (reused > 0)
+        tiny_index_extract(&old, old_sources);
+
+    int ret = tiny_index_write(path, fingerprint, sources, list.count);
+    if (ret != 0)
+        fprintf(stderr, "cannot write %s\n", path);
+
+    tiny_index_t index;
+    if (ret == 0 && tiny_index_open(&index, path) == 0)
+    {
+        fprintf(stderr, "index: %d files, %d parsed, %d reused, %d failed, %lu symbols\n", list.count,
+                list.count - reused, reused, failed, (unsigned long)index.header->symbol_count);
+        tiny_index_close(&index);
+    }
+
+    // 沿用的记录指向旧索引的映射，写入之后才能关闭
+    if (has_old)
+        tiny_index_close(&old);
+    for (int i = 0; i < list.count; ++i)
+    {
+        tiny_index_source_free(&sources[i]);
+        free(list.paths[i]);
+    }
+    free(old_sources);
+    free(sources);
+    free(list.paths);
+    return ret == 0 ? failed : -1;
+}
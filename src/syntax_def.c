@@ -2,6 +2,9 @@
 #include "parser.h"
 #include <ctype.h>
 #include "string_util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #define DEFINE(name, descriptor, parser) \
     {                                    \
@@ -10,91 +13,71 @@
         p->desc = descriptor;            \
     }
 
-static bool is_identifier(const char *s, const char *e)
+// token 的种类和字面量的值已经由词法分析器确定
+static bool is_identifier(const tiny_lex_token_t *token)
 {
-    if (!isalpha(*s) && *s != '_')
-        return false;
-    for (const char *i = s + 1; i != e; ++i)
-        if (!isalpha(*s) && !isdigit(*s) && *s != '_')
-            return false;
-    return true;
+    return token->kind == TINY_TOKEN_IDENTIFIER;
 }
 
-static bool is_string(const char *s, const char *e)
+static bool is_string(const tiny_lex_token_t *token)
 {
-    return s < e && s + 1 < e && *s == '"' && *(e - 1) == '"';
+    return token->kind == TINY_TOKEN_STRING;
 }
 
-static bool is_character(const char *s, const char *e)
+static bool is_character(const tiny_lex_token_t *token)
 {
-    return s < e && s + 1 < e && *s == '\'' && *(e - 1) == '\'';
+    return token->kind == TINY_TOKEN_CHAR;
 }
 
-static bool is_number(const char *s, const char *e)
+static bool is_number(const tiny_lex_token_t *token)
 {
-    if (s >= e)
-        return false;
-    if (*s == '0' && s + 1 < e && tolower(*(s + 1)) == 'x') // 十六进制整数
-    {
-        s += 2;
-        bool has_digit = false;
-        while (s < e && is_hex_digit(*s))
-            s++, has_digit = true;
-        return has_digit && s >= e;
-    }
-    else if (*s == '0' && s + 1 < e) // 八进制整数
+    return token->kind == TINY_TOKEN_INT || token->kind == TINY_TOKEN_REAL;
+}
+
+static bool is_keyword(const tiny_lex_token_t *token, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    return (size_t)(token->e - token->s) == len && strncasecmp(token->s, keyword, len) == 0;
+}
+
+// 错误恢复时跳过 token 的规则：BEGIN 与 END 成对跳过，
+// 在最外层的 ';' 之后，或 END 与类型关键字（下一个声明的开始）之前停止
+static int sync_statement(const tiny_lex_token_t *token, int *depth)
+{
+    if (strsecmp(token->s, token->e, "BEGIN"))
     {
-        s++;
-        bool has_digit = false;
-        while (s < e && '0' <= *s && *s < '8')
-            s++, has_digit = true;
-        return has_digit && s >= e;
+        ++*depth;
+        return TINY_SYNC_SKIP;
     }
-    else
+    if (strsecmp(token->s, token->e, "END"))
     {
-        bool before_dot = false, dot = false, after_dot = false;
-        while (s < e && isdigit(*s))
-            s++, before_dot = true; // 跳过小数点前的数字位
-        if (s < e && *s == '.')     // 如果数字位后是小数点，则跳过
-        {
-            s++; // 跳过小数点后的数字
-            dot = true;
-            while (s < e && isdigit(*s))
-                s++, after_dot = true;
-        }
-        if (!before_dot && (!dot || dot && !after_dot))
-            return false;
-        if (s < e && tolower(*s) == 'e')
-        {
-            s++;
-            if (s >= e)
-                return false;
-            if (*s == '+' || *s == '-')
-                s++;
-            if (s >= e)
-                return false;
-            bool has_digit = false;
-            while (s < e && isdigit(*s))
-                s++, has_digit = true;
-            if (!has_digit)
-                return false;
-        }
-        return true;
+        if (*depth == 0)
+            return TINY_SYNC_BEFORE;
+        --*depth;
+        return TINY_SYNC_SKIP;
     }
+    if (*depth > 0)
+        return TINY_SYNC_SKIP;
+    if (strsecmp(token->s, token->e, ";"))
+        return TINY_SYNC_AFTER;
+    if (is_keyword(token, "int") || is_keyword(token, "real"))
+        return TINY_SYNC_BEFORE;
+    return TINY_SYNC_SKIP;
 }
 
 struct trie *prepare_parsers()
 {
     struct trie *parsers = trie_create();
-    // root -> (func | vars)*
+    // root -> (func | vars)*，出错的 func/vars 可以跳过
     DEFINE(
         root,
         TINY_DESC_ROOT,
-        KLEENE_UNTIL(
+        KLEENE_RECOVER(
             TOKEN_EOF,
             OR(
                 GRAMMAR(func),
-                GRAMMAR(vars))));
+                GRAMMAR(vars)),
+            sync_statement));
     // func -> type ['MAIN'] identifier '(' formal_params ')' block
     DEFINE(
         func,
@@ -107,6 +90,33 @@ struct trie *prepare_parsers()
             GRAMMAR(formal_params),
             TOKEN(")"),
             GRAMMAR(block)));
+    // lazy_root -> (lazy_func | vars)*，只解析函数签名和全局变量
+    DEFINE(
+        lazy_root,
+        TINY_DESC_ROOT,
+        KLEENE_RECOVER(
+            TOKEN_EOF,
+            OR(
+                GRAMMAR(lazy_func),
+                GRAMMAR(vars)),
+            sync_statement));
+    // lazy_func -> type ['MAIN'] identifier '(' formal_params ')' 'BEGIN' ... 'END'
+    DEFINE(
+        lazy_func,
+        TINY_DESC_FUNC,
+        SEQUENCE(
+            GRAMMAR(type),
+            WITH_DESC(TINY_DESC_MAIN, OPTIONAL(TOKEN_IGNORE_CASE("main"))),
+            GRAMMAR(identifier),
+            TOKEN("("),
+            GRAMMAR(formal_params),
+            TOKEN(")"),
+            GRAMMAR(lazy_block)));
+    // lazy_block -> 'BEGIN' ... 'END'，只记录函数体的范围
+    DEFINE(
+        lazy_block,
+        TINY_DESC_LAZY_BLOCK,
+        LAZY(TOKEN("BEGIN"), TOKEN("END")));
     // vars -> type identifier (',' identifier)* ';'
     DEFINE(
         vars,
@@ -121,14 +131,14 @@ struct trie *prepare_parsers()
     DEFINE(
         type,
         TINY_DESC_TYPE,
-        ERROR(TINY_EXPECT_TYPE, OR(
-                                    TOKEN_IGNORE_CASE("int"),
-                                    TOKEN_IGNORE_CASE("real"))));
+        ERROR(TINY_EXPECT_TYPE, WITH_DESC(TINY_DESC_TYPE, OR(
+                                                              TOKEN_IGNORE_CASE("int"),
+                                                              TOKEN_IGNORE_CASE("real")))));
     // identifier -> (alpha | '_') (alpha | digit | '_')*
     DEFINE(
         identifier,
         TINY_DESC_IDENTIFIER,
-        ERROR(TINY_EXPECT_IDENTIFIER, TOKEN_PREDICATE(is_identifier)));
+        ERROR(TINY_EXPECT_IDENTIFIER, WITH_DESC(TINY_DESC_IDENTIFIER, TOKEN_PREDICATE(is_identifier))));
     // formal_params = formal_param (',' formal_param)*
     DEFINE(
         formal_params,
@@ -143,13 +153,13 @@ struct trie *prepare_parsers()
         SEQUENCE(
             GRAMMAR(type),
             GRAMMAR(identifier)));
-    // block -> 'BEGIN' statement* 'END'
+    // block -> 'BEGIN' statement* 'END'，出错的 statement 可以跳过
     DEFINE(
         block,
         TINY_DESC_BLOCK,
         SEQUENCE(
             ERROR(TINY_EXPECT_BEGIN, TOKEN("BEGIN")),
-            KLEENE_UNTIL(TOKEN("END"), GRAMMAR(statement)),
+            KLEENE_RECOVER(TOKEN("END"), GRAMMAR(statement), sync_statement),
             ERROR(TINY_EXPECT_END, TOKEN("END"))));
     // statement -> block | vars | expression ';' | return | if
     DEFINE(
@@ -253,3 +263,89 @@ struct trie *prepare_parsers()
         GRAMMAR(unit5));
     return parsers;
 }
+
+static int free_production(const char *key, void *data, void *arg)
+{
+    (void)key;
+    (void)arg;
+    tiny_free_parser(data);
+    return 0;
+}
+
+void free_parsers(struct trie *parsers)
+{
+    trie_visit(parsers, "", free_production, NULL);
+    trie_free(parsers);
+}
+
+tiny_parser_result_t tiny_syntax_materialize(struct trie *parsers, tiny_symbol_table_t *symbols, tiny_ast_t *lazy)
+{
+    if (lazy->desc != TINY_DESC_LAZY_BLOCK)
+    {
+        tiny_parser_result_t result = {.ast = lazy, .state = 0, .fatal = false, .required_token = NULL};
+        return result;
+    }
+
+    tiny_parser_result_t result = tiny_syntax_parse_range(parsers, symbols, "block", lazy->token, NULL);
+    if (result.state == 0)
+    {
+        // 保留 lazy 在兄弟链表中的位置，只替换节点内容
+        tiny_ast_t *block = result.ast;
+        block->sibling = lazy->sibling;
+        *lazy = *block;
+        free(block);
+        result.ast = lazy;
+    }
+    return result;
+}
+
+tiny_parser_result_t tiny_syntax_materialize_all(struct trie *parsers, tiny_symbol_table_t *symbols, tiny_ast_t *root)
+{
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        for (tiny_ast_t *cld = item->child; cld; cld = cld->sibling)
+        {
+            tiny_parser_result_t result = tiny_syntax_materialize(parsers, symbols, cld);
+            if (result.state != 0)
+                return result;
+        }
+    tiny_parser_result_t result = {.ast = root, .state = 0, .fatal = false, .required_token = NULL};
+    return result;
+}
+
+static const char *const DESC_NAMES[] = {
+    [TINY_DESC_ELIMINATE] = "-",
+    [TINY_DESC_UNARY] = "unary",
+    [TINY_DESC_BINARY] = "binary",
+    [TINY_DESC_IF] = "if",
+    [TINY_DESC_WHILE] = "while",
+    [TINY_DESC_FOR] = "for",
+    [TINY_DESC_FUNC] = "func",
+    [TINY_DESC_NUMBER] = "number",
+    [TINY_DESC_CALL] = "call",
+    [TINY_DESC_DECL] = "vars",
+    [TINY_DESC_ASSIGN] = "assignment",
+    [TINY_DESC_ROOT] = "root",
+    [TINY_DESC_TYPE] = "type",
+    [TINY_DESC_IDENTIFIER] = "id",
+    [TINY_DESC_FORMAL_PARAMS] = "formal_params",
+    [TINY_DESC_FORMAL_PARAM] = "formal_param",
+    [TINY_DESC_BLOCK] = "block",
+    [TINY_DESC_STATEMENT] = "statement",
+    [TINY_DESC_STRING] = "string",
+    [TINY_DESC_ACTUAL_PARAMS] = "params",
+    [TINY_DESC_RETURN] = "return",
+    [TINY_DESC_EXPR] = "expression",
+    [TINY_DESC_MAIN] = "main",
+    [TINY_DESC_CHAR] = "char",
+    [TINY_DESC_LAZY_BLOCK] = "lazy_block",
+    [TINY_DESC_CONVERT] = "convert",
+    [TINY_DESC_ERROR] = "error",
+};
+
+const char *tiny_desc_name(int desc)
+{
+    int count = sizeof(DESC_NAMES) / sizeof(DESC_NAMES[0]);
+    if (desc < 0 || desc >= count || !DESC_NAMES[desc])
+        return "";
+    return DESC_NAMES[desc];
+}
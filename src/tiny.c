@@ -0,0 +1,230 @@
+#include "tiny.h"
+#include "syntax_def.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct tiny_grammar_s
+{
+    struct trie *parsers;
+};
+
+struct tiny_context_s
+{
+    const tiny_grammar_t *grammar;
+    tiny_symbol_table_t symbols;
+    tiny_lex_t lex;
+    tiny_scanner_t scanner;
+
+    char *code; // 源码副本，以 '\0' 结尾
+    size_t code_size;
+
+    tiny_ast_t *ast;
+    bool checked; // resolve 与 check 有效
+    tiny_resolve_t resolve;
+    tiny_typecheck_t check;
+
+    tiny_lex_token_t *tokens;
+    int token_count, token_size;
+    tiny_error_t *errors;
+    int error_count, error_size;
+    tiny_parser_errors_t syntax_errors; // TINY_PARSE_RECOVER 时恢复过的语法错误
+};
+
+tiny_grammar_t *tiny_grammar_create(void)
+{
+    tiny_grammar_t *grammar = malloc(sizeof(tiny_grammar_t));
+    if (grammar)
+        grammar->parsers = prepare_parsers();
+    return grammar;
+}
+
+void tiny_grammar_destroy(tiny_grammar_t *grammar)
+{
+    if (!grammar)
+        return;
+    free_parsers(grammar->parsers);
+    free(grammar);
+}
+
+tiny_context_t *tiny_context_create(const tiny_grammar_t *grammar)
+{
+    tiny_context_t *ctx = calloc(1, sizeof(tiny_context_t));
+    if (!ctx)
+        return NULL;
+    ctx->grammar = grammar;
+    tiny_symbol_table_init(&ctx->symbols);
+    tiny_scanner_begin(&ctx->scanner, &ctx->lex, tiny_lex_reader);
+    tiny_parser_errors_init(&ctx->syntax_errors);
+    return ctx;
+}
+
+/**
+ * 释放上一次解析的语法树与检查结果，保留可以复用的内存
+ */
+static void release_result(tiny_context_t *ctx)
+{
+    if (ctx->checked)
+    {
+        tiny_typecheck_free(&ctx->check);
+        tiny_resolve_free(&ctx->resolve);
+        ctx->checked = false;
+    }
+    tiny_free_ast(ctx->ast);
+    ctx->ast = NULL;
+    tiny_lex_end(&ctx->lex);
+    ctx->token_count = ctx->error_count = 0;
+}
+
+void tiny_context_destroy(tiny_context_t *ctx)
+{
+    if (!ctx)
+        return;
+    release_result(ctx);
+    tiny_scanner_end(&ctx->scanner);
+    tiny_symbol_table_free(&ctx->symbols);
+    free(ctx->code);
+    free(ctx->tokens);
+    free(ctx->errors);
+    tiny_parser_errors_free(&ctx->syntax_errors);
+    free(ctx);
+}
+
+static void add_error(tiny_context_t *ctx, const tiny_line_index_t *lines, const tiny_lex_token_t *token, int code,
+                      const char *required)
+{
+    if (ctx->error_count == ctx->error_size)
+    {
+        ctx->error_size = ctx->error_size ? ctx->error_size * 2 : 8;
+        ctx->errors = realloc(ctx->errors, ctx->error_size * sizeof(tiny_error_t));
+    }
+    tiny_error_t *error = &ctx->errors[ctx->error_count++];
+    error->code = code;
+    error->s = token->s;
+    error->e = token->e;
+    error->required = required;
+    // 词法错误的位置由 e 表示，语法错误的位置为 token 的起点
+    tiny_line_index_position(lines, token->error ? token->e : token->s, &error->line, &error->column);
+}
+
+static void add_semantic_errors(tiny_context_t *ctx, const tiny_line_index_t *lines,
+                                const tiny_semantic_error_t *errors, int count)
+{
+    for (int i = 0; i < count; ++i)
+        add_error(ctx, lines, &errors[i].token, errors[i].error, NULL);
+}
+
+static void collect_tokens(tiny_context_t *ctx)
+{
+    list_entry_t *head = &ctx->scanner.tokens;
+    for (list_entry_t *entry = list_next(head); entry != head; entry = list_next(entry))
+    {
+        const tiny_lex_token_t *token = &le2scannertoken(entry, list)->token;
+        if (token->error < 0)
+            continue;
+        if (ctx->token_count == ctx->token_size)
+        {
+            ctx->token_size = ctx->token_size ? ctx->token_size * 2 : 256;
+            ctx->tokens = realloc(ctx->tokens, ctx->token_size * sizeof(tiny_lex_token_t));
+        }
+        ctx->tokens[ctx->token_count++] = *token;
+    }
+}
+
+int tiny_context_parse(tiny_context_t *ctx, const char *code, size_t len, int flags)
+{
+    release_result(ctx);
+    if (ctx->code_size < len + 1)
+    {
+        free(ctx->code);
+        ctx->code_size = len + 1;
+        ctx->code = malloc(ctx->code_size);
+    }
+    memcpy(ctx->code, code, len);
+    ctx->code[len] = '\0';
+
+    tiny_symbol_table_reset(&ctx->symbols);
+    tiny_lex_begin(&ctx->lex, ctx->code);
+    ctx->lex.symbols = &ctx->symbols;
+    tiny_scanner_restart(&ctx->scanner, &ctx->lex);
+
+    tiny_parser_ctx_t parser;
+    parser.parsers = ctx->grammar->parsers;
+    parser.current_parser = trie_search(parser.parsers, (flags & TINY_PARSE_LAZY) ? "lazy_root" : "root");
+    parser.errors = (flags & TINY_PARSE_RECOVER) ? &ctx->syntax_errors : NULL;
+    ctx->syntax_errors.count = 0;
+    tiny_parser_result_t result = tiny_syntax_parse(parser, &ctx->scanner);
+    collect_tokens(ctx);
+
+    if (result.state != 0 || ctx->syntax_errors.count > 0)
+    {
+        tiny_line_index_t lines;
+        tiny_line_index_build(&lines, ctx->code, ctx->lex.len);
+        // 恢复过的错误都在使解析失败的错误之前
+        for (int i = 0; i < ctx->syntax_errors.count; ++i)
+        {
+            const tiny_parser_error_t *error = &ctx->syntax_errors.items[i];
+            add_error(ctx, &lines, &error->error_token, error->state, error->required_token);
+        }
+        if (result.state != 0)
+            add_error(ctx, &lines, &result.error_token, result.state, result.required_token);
+        tiny_line_index_free(&lines);
+        ctx->ast = result.state == 0 ? result.ast : NULL;
+        return ctx->errors[0].code;
+    }
+    ctx->ast = result.ast;
+
+    if (flags & TINY_PARSE_CHECK)
+    {
+        // 惰性函数体先解析为完整的语法树
+        result = tiny_syntax_materialize_all(ctx->grammar->parsers, &ctx->symbols, ctx->ast);
+        if (result.state != 0)
+        {
+            tiny_line_index_t lines;
+            tiny_line_index_build(&lines, ctx->code, ctx->lex.len);
+            add_error(ctx, &lines, &result.error_token, result.state, result.required_token);
+            tiny_line_index_free(&lines);
+            return result.state;
+        }
+        tiny_resolve(&ctx->resolve, &ctx->symbols, ctx->ast);
+        tiny_typecheck(&ctx->check, &ctx->resolve, ctx->ast);
+        ctx->checked = true;
+        if (ctx->resolve.error_count || ctx->check.error_count)
+        {
+            tiny_line_index_t lines;
+            tiny_line_index_build(&lines, ctx->code, ctx->lex.len);
+            add_semantic_errors(ctx, &lines, ctx->resolve.errors, ctx->resolve.error_count);
+            add_semantic_errors(ctx, &lines, ctx->check.errors, ctx->check.error_count);
+            tiny_line_index_free(&lines);
+            return ctx->errors[0].code;
+        }
+    }
+    return 0;
+}
+
+const tiny_ast_t *tiny_context_ast(const tiny_context_t *ctx)
+{
+    return ctx->ast;
+}
+
+const tiny_lex_token_t *tiny_context_tokens(const tiny_context_t *ctx, int *count)
+{
+    *count = ctx->token_count;
+    return ctx->tokens;
+}
+
+const tiny_error_t *tiny_context_errors(const tiny_context_t *ctx, int *count)
+{
+    *count = ctx->error_count;
+    return ctx->errors;
+}
+
+const tiny_symbol_table_t *tiny_context_symbols(const tiny_context_t *ctx)
+{
+    return &ctx->symbols;
+}
+
+const tiny_typecheck_t *tiny_context_typecheck(const tiny_context_t *ctx)
+{
+    return ctx->checked && ctx->error_count == 0 ? &ctx->check : NULL;
+}
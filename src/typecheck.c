@@ -0,0 +1,368 @@
+#include "typecheck.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_numeric(int type)
+{
+    return type == TINY_TYPE_INT || type == TINY_TYPE_REAL;
+}
+
+int tiny_decl_type(const tiny_decl_t *decl)
+{
+    if (!decl->type)
+        return TINY_TYPE_VOID;
+    return tolower(*decl->type->token.s) == 'i' ? TINY_TYPE_INT : TINY_TYPE_REAL;
+}
+
+/**
+ * 子树中第一个带 token 的节点，用于定位错误
+ */
+static tiny_ast_t *first_leaf(tiny_ast_t *ast)
+{
+    if (ast->token.s)
+        return ast;
+    for (tiny_ast_t *cld = ast->child; cld; cld = cld->sibling)
+    {
+        tiny_ast_t *leaf = first_leaf(cld);
+        if (leaf)
+            return leaf;
+    }
+    return NULL;
+}
+
+static void report(tiny_typecheck_t *c, int error, tiny_ast_t *at)
+{
+    if (c->error_count == c->error_size)
+    {
+        c->error_size = c->error_size ? c->error_size * 2 : 16;
+        c->errors = realloc(c->errors, c->error_size * sizeof(tiny_semantic_error_t));
+    }
+    c->errors[c->error_count].error = error;
+    c->errors[c->error_count].token = first_leaf(at)->token;
+    c->error_count++;
+}
+
+static int set_type(tiny_typecheck_t *c, tiny_ast_t *ast, int type)
+{
+    c->types[ast->id] = type;
+    return type;
+}
+
+/**
+ * 创建新节点并为其编号
+ */
+static tiny_ast_t *make_node(tiny_typecheck_t *c, int desc, int type)
+{
+    tiny_resolve_t *resolve = c->resolve;
+    tiny_ast_t *ast = tiny_make_ast(desc);
+    ast->id = resolve->node_count++;
+    if (ast->id >= c->type_size)
+    {
+        c->type_size *= 2;
+        c->types = realloc(c->types, c->type_size * sizeof(int));
+        resolve->decl_of = realloc(resolve->decl_of, c->type_size * sizeof(int));
+    }
+    resolve->decl_of[ast->id] = -1;
+    set_type(c, ast, type);
+    return ast;
+}
+
+/**
+ * 将 *link 替换为把它转换为 type 的节点
+ */
+static void convert(tiny_typecheck_t *c, tiny_ast_t **link, int type)
+{
+    tiny_ast_t *conv = make_node(c, TINY_DESC_CONVERT, type);
+    conv->child = *link;
+    conv->sibling = (*link)->sibling;
+    (*link)->sibling = NULL;
+    *link = conv;
+}
+
+/**
+ * 将类型为 from 的 *link 转换为 to，不能转换时报告错误
+ * @param at 报告错误的位置
+ */
+static bool coerce(tiny_typecheck_t *c, tiny_ast_t **link, int from, int to, tiny_ast_t *at)
+{
+    if (from == TINY_TYPE_ERROR || to == TINY_TYPE_ERROR || from == to)
+        return true;
+    if (is_numeric(from) && is_numeric(to))
+    {
+        convert(c, link, to);
+        return true;
+    }
+    report(c, TINY_TYPE_MISMATCH, at);
+    return false;
+}
+
+static int check_expr(tiny_typecheck_t *c, tiny_ast_t **link);
+
+/**
+ * binary -> operand (op operand)*，从左到右求值
+ *
+ * 左侧的部分结果为 INT 而右操作数为 REAL 时，需要先把左侧的部分结果转换为 REAL，
+ * 此时将 op 之前的所有子节点移入一个新的 binary 节点，再转换这个节点
+ */
+static int check_binary(tiny_typecheck_t *c, tiny_ast_t *node)
+{
+    int running = check_expr(c, &node->child);
+    for (tiny_ast_t *op = node->child->sibling; op; op = op->sibling->sibling)
+    {
+        int type = check_expr(c, &op->sibling);
+        bool compare = strsecmp(op->token.s, op->token.e, "==") || strsecmp(op->token.s, op->token.e, "!=");
+        if (running == TINY_TYPE_ERROR || type == TINY_TYPE_ERROR)
+        {
+            running = TINY_TYPE_ERROR;
+            continue;
+        }
+        if (!is_numeric(running) || !is_numeric(type))
+        {
+            report(c, TINY_TYPE_MISMATCH, op);
+            running = TINY_TYPE_ERROR;
+            continue;
+        }
+
+        if (running == TINY_TYPE_INT && type == TINY_TYPE_REAL)
+        {
+            if (node->child->sibling != op)
+            {
+                tiny_ast_t *prefix = make_node(c, node->desc, running);
+                tiny_ast_t *last = node->child;
+                while (last->sibling != op)
+                    last = last->sibling;
+                last->sibling = NULL;
+                prefix->child = node->child;
+                prefix->sibling = op;
+                node->child = prefix;
+            }
+            convert(c, &node->child, TINY_TYPE_REAL);
+            running = TINY_TYPE_REAL;
+        }
+        else if (running == TINY_TYPE_REAL && type == TINY_TYPE_INT)
+        {
+            convert(c, &op->sibling, TINY_TYPE_REAL);
+        }
+        if (compare)
+            running = TINY_TYPE_INT;
+    }
+    return set_type(c, node, running);
+}
+
+/**
+ * 赋值的左侧只能是变量，去掉只有一个子节点的 binary 或 assignment 后应当是 identifier
+ */
+static int check_target(tiny_typecheck_t *c, tiny_ast_t *target)
+{
+    tiny_ast_t *id = target;
+    while ((id->desc == TINY_DESC_BINARY || id->desc == TINY_DESC_ASSIGN) && id->child && !id->child->sibling)
+        id = id->child;
+    if (id->desc != TINY_DESC_IDENTIFIER)
+    {
+        report(c, TINY_NOT_ASSIGNABLE, target);
+        return TINY_TYPE_ERROR;
+    }
+    return check_expr(c, &target);
+}
+
+/**
+ * assignment -> target ':=' ... ':=' value，从右到左求值
+ *
+ * 当中间的赋值结果需要转换时，将 op 之后的部分移入一个新的 assignment 节点，再转换这个节点
+ */
+static int check_assign(tiny_typecheck_t *c, tiny_ast_t **link)
+{
+    tiny_ast_t *target = *link;
+    if (!target->sibling)
+        return check_expr(c, link);
+
+    tiny_ast_t *op = target->sibling;
+    int value = check_assign(c, &op->sibling);
+    int type = check_target(c, target);
+    if (value == TINY_TYPE_ERROR || type == TINY_TYPE_ERROR)
+        return TINY_TYPE_ERROR;
+    if (value != type && is_numeric(value) && is_numeric(type) && op->sibling->sibling)
+    {
+        tiny_ast_t *suffix = make_node(c, TINY_DESC_ASSIGN, value);
+        suffix->child = op->sibling;
+        op->sibling = suffix;
+    }
+    return coerce(c, &op->sibling, value, type, op) ? type : TINY_TYPE_ERROR;
+}
+
+/**
+ * call -> identifier '(' actual_params ')'
+ */
+static int check_call(tiny_typecheck_t *c, tiny_ast_t *call)
+{
+    tiny_ast_t *args = call->child->sibling->sibling;
+    int decl = c->resolve->decl_of[call->id];
+
+    // actual_params 与 formal_params 中参数和 ',' 交替出现
+    int argc = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+    {
+        argc++;
+        if (!arg->sibling)
+            break;
+    }
+
+    // 调用目标未定义或不是函数，已经在名字解析时报告过
+    if (decl < 0 || (c->resolve->decls[decl].kind != TINY_DECL_FUNC && c->resolve->decls[decl].kind != TINY_DECL_BUILTIN))
+    {
+        for (tiny_ast_t **arg = &args->child; *arg; arg = &(*arg)->sibling->sibling)
+            if (check_expr(c, arg), !(*arg)->sibling)
+                break;
+        return set_type(c, call, TINY_TYPE_ERROR);
+    }
+
+    const tiny_decl_t *d = &c->resolve->decls[decl];
+    if (d->kind == TINY_DECL_BUILTIN) // READ(variable, file) 与 WRITE(expression, file)
+    {
+        bool read = strsecmp(call->child->token.s, call->child->token.e, "READ");
+        if (argc != 2)
+        {
+            report(c, TINY_ARGUMENT_COUNT, call->child);
+            return set_type(c, call, TINY_TYPE_ERROR);
+        }
+        tiny_ast_t *value = args->child, **file = &value->sibling->sibling;
+        int type = read ? check_target(c, value) : check_expr(c, &args->child);
+        if (type != TINY_TYPE_ERROR && !is_numeric(type))
+            report(c, TINY_TYPE_MISMATCH, args->child);
+        if (check_expr(c, file) != TINY_TYPE_STRING)
+            report(c, TINY_TYPE_MISMATCH, *file);
+        return set_type(c, call, TINY_TYPE_VOID);
+    }
+
+    // formal_param -> type identifier
+    tiny_ast_t *params = d->node->sibling->sibling;
+    int paramc = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+            paramc++;
+    if (argc != paramc)
+        report(c, TINY_ARGUMENT_COUNT, call->child);
+
+    tiny_ast_t *param = params->child;
+    for (tiny_ast_t **arg = &args->child; *arg; arg = &(*arg)->sibling->sibling)
+    {
+        int type = check_expr(c, arg);
+        if (param && argc == paramc)
+        {
+            int expected = tolower(*param->child->token.s) == 'i' ? TINY_TYPE_INT : TINY_TYPE_REAL;
+            coerce(c, arg, type, expected, *arg);
+            param = param->sibling ? param->sibling->sibling : NULL;
+        }
+        if (!(*arg)->sibling)
+            break;
+    }
+    return set_type(c, call, tiny_decl_type(d));
+}
+
+/**
+ * 检查 *link 的类型，*link 可能被替换为转换节点
+ */
+static int check_expr(tiny_typecheck_t *c, tiny_ast_t **link)
+{
+    tiny_ast_t *expr = *link;
+    switch (expr->desc)
+    {
+    case TINY_DESC_NUMBER:
+        return set_type(c, expr, expr->token.kind == TINY_TOKEN_INT ? TINY_TYPE_INT : TINY_TYPE_REAL);
+    case TINY_DESC_STRING:
+    case TINY_DESC_CHAR:
+        return set_type(c, expr, TINY_TYPE_STRING);
+    case TINY_DESC_IDENTIFIER:
+    {
+        int decl = c->resolve->decl_of[expr->id];
+        if (decl < 0 || c->resolve->decls[decl].kind == TINY_DECL_FUNC || c->resolve->decls[decl].kind == TINY_DECL_BUILTIN)
+            return set_type(c, expr, TINY_TYPE_ERROR); // 已经在名字解析时报告过
+        return set_type(c, expr, tiny_decl_type(&c->resolve->decls[decl]));
+    }
+    case TINY_DESC_CALL:
+        return check_call(c, expr);
+    case TINY_DESC_BINARY:
+        return check_binary(c, expr);
+    case TINY_DESC_ASSIGN:
+        return set_type(c, expr, check_assign(c, &expr->child));
+    case TINY_DESC_CONVERT:
+        return c->types[expr->id];
+    default: // '(' expression ')'
+        if (expr->child && expr->child->sibling)
+            return set_type(c, expr, check_expr(c, &expr->child->sibling));
+        return set_type(c, expr, TINY_TYPE_ERROR);
+    }
+}
+
+static void check_statement(tiny_typecheck_t *c, tiny_ast_t *stmt, int ret);
+
+static void check_block(tiny_typecheck_t *c, tiny_ast_t *block, int ret)
+{
+    if (block->desc != TINY_DESC_BLOCK)
+        return; // 惰性函数体
+    for (tiny_ast_t *stmt = block->child->sibling->child; stmt; stmt = stmt->sibling)
+        check_statement(c, stmt, ret);
+}
+
+/**
+ * @param ret 所在函数的返回类型
+ */
+static void check_statement(tiny_typecheck_t *c, tiny_ast_t *stmt, int ret)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+    case TINY_DESC_LAZY_BLOCK:
+        check_block(c, stmt, ret);
+        break;
+    case TINY_DESC_DECL:
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+    {
+        tiny_ast_t **cond = &stmt->child->sibling->sibling;
+        int type = check_expr(c, cond);
+        if (type != TINY_TYPE_ERROR && !is_numeric(type))
+            report(c, TINY_TYPE_MISMATCH, stmt);
+        tiny_ast_t *then = (*cond)->sibling->sibling;
+        check_statement(c, then, ret);
+        if (then->sibling->child)
+            check_statement(c, then->sibling->child->child->sibling, ret);
+        break;
+    }
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+        coerce(c, &stmt->child->sibling, check_expr(c, &stmt->child->sibling), ret, stmt);
+        break;
+    default: // expression ';'
+        check_expr(c, &stmt->child);
+        break;
+    }
+}
+
+int tiny_typecheck(tiny_typecheck_t *check, tiny_resolve_t *resolve, tiny_ast_t *root)
+{
+    memset(check, 0, sizeof(tiny_typecheck_t));
+    check->resolve = resolve;
+    check->type_size = resolve->node_count > 0 ? resolve->node_count : 1;
+    check->types = calloc(check->type_size, sizeof(int)); // TINY_TYPE_NONE
+    resolve->decl_of = realloc(resolve->decl_of, check->type_size * sizeof(int));
+
+    // func -> type ['MAIN'] identifier '(' formal_params ')' block
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+        {
+            tiny_ast_t *name = item->child->sibling->sibling;
+            int ret = tiny_decl_type(&resolve->decls[resolve->decl_of[name->id]]);
+            check_block(check, name->sibling->sibling->sibling->sibling, ret);
+        }
+    return check->error_count;
+}
+
+void tiny_typecheck_free(tiny_typecheck_t *check)
+{
+    free(check->types);
+    free(check->errors);
+    memset(check, 0, sizeof(tiny_typecheck_t));
+}
@@ -0,0 +1,239 @@
+#include "vm.h"
+#include "jit.h"
+#include "memo.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+
+void tiny_vm_init(tiny_vm_t *vm, const tiny_program_t *program)
+{
+    vm->program = program;
+    vm->globals = calloc(program->global_count > 0 ? program->global_count : 1, sizeof(tiny_value_t));
+    vm->stack_size = TINY_VM_STACK_SIZE;
+    vm->stack = malloc(vm->stack_size * sizeof(tiny_value_t));
+    vm->frame_size = TINY_VM_FRAME_SIZE;
+    vm->frames = malloc(vm->frame_size * sizeof(tiny_vm_frame_t));
+    vm->jit = NULL;
+    vm->memo = NULL;
+    tiny_runtime_init(&vm->runtime);
+}
+
+void tiny_vm_free(tiny_vm_t *vm)
+{
+    free(vm->globals);
+    free(vm->stack);
+    free(vm->frames);
+    tiny_runtime_free(&vm->runtime);
+}
+
+int tiny_vm_call(tiny_vm_t *vm, int func, const tiny_value_t *args, tiny_value_t *result)
+{
+    if (vm->program->functions[func].nparams > 0)
+        memcpy(vm->stack, args, vm->program->functions[func].nparams * sizeof(tiny_value_t));
+    return tiny_vm_execute(vm, func, vm->stack, vm->frames, result);
+}
+
+int tiny_vm_execute(tiny_vm_t *vm, int func, tiny_value_t *base, tiny_vm_frame_t *frame, tiny_value_t *result)
+{
+#define TINY_OPCODE_LABEL(op) &&op_##op,
+    static const void *const labels[] = {TINY_OPCODES(TINY_OPCODE_LABEL)};
+#undef TINY_OPCODE_LABEL
+
+    const tiny_function_t *functions = vm->program->functions;
+    char *const *strings = vm->program->strings;
+    tiny_value_t *globals = vm->globals;
+    tiny_memo_t *memo = vm->memo;
+    const tiny_value_t *stack_end = vm->stack + vm->stack_size;
+    const tiny_vm_frame_t *frame_end = vm->frames + vm->frame_size;
+
+    const tiny_function_t *f = &functions[func];
+    if (frame == frame_end || base + f->nregs > stack_end)
+        return TINY_STACK_OVERFLOW;
+    tiny_vm_frame_t *fp = frame;
+    fp->func = f;
+    fp->base = base;
+    fp->memo_slot = -1;
+
+    // 当前函数的寄存器、常量与下一条指令
+    tiny_value_t *r = fp->base;
+    const tiny_value_t *k = f->consts;
+    const tiny_insn_t *pc = f->code;
+    const tiny_insn_t *insn;
+    tiny_value_t ret;
+    int error;
+
+#define DISPATCH()               \
+    do                           \
+    {                            \
+        insn = pc++;             \
+        goto *labels[insn->op];  \
+    } while (0)
+#define A r[insn->a]
+#define B r[insn->b]
+#define C r[insn->c]
+// INT 运算按补码回绕，避免有符号溢出
+#define ARITH_I(op) A.i = (int64_t)((uint64_t)B.i op(uint64_t) C.i)
+
+    DISPATCH();
+
+op_MOV:
+    A = B;
+    DISPATCH();
+op_LOADI:
+    A.i = (int32_t)insn->bx;
+    DISPATCH();
+op_LOADK:
+    A = k[insn->bx];
+    DISPATCH();
+op_ZERO:
+    A.i = 0;
+    DISPATCH();
+op_GETG:
+    A = globals[insn->bx];
+    DISPATCH();
+op_SETG:
+    globals[insn->bx] = A;
+    DISPATCH();
+op_ADDI:
+    ARITH_I(+);
+    DISPATCH();
+op_SUBI:
+    ARITH_I(-);
+    DISPATCH();
+op_MULI:
+    ARITH_I(*);
+    DISPATCH();
+op_DIVI:
+    if (C.i == 0)
+    {
+        error = TINY_DIVISION_BY_ZERO;
+        goto fail;
+    }
+    A.i = C.i == -1 ? (int64_t)(0 - (uint64_t)B.i) : B.i / C.i;
+    DISPATCH();
+op_ADDR:
+    A.r = B.r + C.r;
+    DISPATCH();
+op_SUBR:
+    A.r = B.r - C.r;
+    DISPATCH();
+op_MULR:
+    A.r = B.r * C.r;
+    DISPATCH();
+op_DIVR:
+    A.r = B.r / C.r;
+    DISPATCH();
+op_EQI:
+    A.i = B.i == C.i;
+    DISPATCH();
+op_NEI:
+    A.i = B.i != C.i;
+    DISPATCH();
+op_EQR:
+    A.i = B.r == C.r;
+    DISPATCH();
+op_NER:
+    A.i = B.r != C.r;
+    DISPATCH();
+op_I2R:
+    A.r = (double)B.i;
+    DISPATCH();
+op_R2I:
+    A.i = tiny_real_to_int(B.r);
+    DISPATCH();
+op_JMP:
+    pc = f->code + insn->bx;
+    DISPATCH();
+op_JZI:
+    if (A.i == 0)
+        pc = f->code + insn->bx;
+    DISPATCH();
+op_JZR:
+    if (A.r == 0)
+        pc = f->code + insn->bx;
+    DISPATCH();
+op_CALL:
+{
+    // 参数已经位于 r[a] 起的寄存器中，直接作为被调用者的 r0 起的寄存器
+    const tiny_function_t *callee = &functions[insn->bx];
+    tiny_value_t *base = r + insn->a;
+    int slot = -1;
+    unsigned stamp = 0;
+    if (memo && tiny_memo_cacheable(memo, insn->bx) &&
+        (slot = tiny_memo_lookup(memo, insn->bx, base, base, &stamp)) < 0)
+        DISPATCH(); // 命中，结果已经写入 r[a]
+    tiny_jit_func_t native;
+    if (vm->jit && (native = tiny_jit_lookup(vm->jit, insn->bx)))
+    {
+        // 被调用者已经编译为机器码，其中再调用未编译的函数时从 fp + 1 开始使用调用帧
+        vm->jit->frame = fp + 1;
+        if ((error = native(base, vm->jit, insn->bx)))
+            goto fail;
+        if (slot >= 0)
+            tiny_memo_store(memo, slot, stamp, base[0]);
+        DISPATCH();
+    }
+    if (fp + 1 == frame_end || base + callee->nregs > stack_end)
+    {
+        error = TINY_STACK_OVERFLOW;
+        goto fail;
+    }
+    fp->pc = pc;
+    ++fp;
+    fp->func = f = callee;
+    fp->base = r = base;
+    fp->memo_slot = slot;
+    fp->memo_stamp = stamp;
+    k = f->consts;
+    pc = f->code;
+    DISPATCH();
+}
+op_RET:
+    ret = A;
+    goto leave;
+op_RET0:
+    ret.i = 0;
+    goto leave;
+op_READI:
+    if ((error = tiny_runtime_read(&vm->runtime, strings[insn->bx], false, &A)))
+        goto fail;
+    DISPATCH();
+op_READR:
+    if ((error = tiny_runtime_read(&vm->runtime, strings[insn->bx], true, &A)))
+        goto fail;
+    DISPATCH();
+op_WRITEI:
+    if ((error = tiny_runtime_write(&vm->runtime, strings[insn->bx], false, A)))
+        goto fail;
+    DISPATCH();
+op_WRITER:
+    if ((error = tiny_runtime_write(&vm->runtime, strings[insn->bx], true, A)))
+        goto fail;
+    DISPATCH();
+
+leave:
+    // 被调用者的 r0 即调用者 CALL 指令的 r[a]
+    r[0] = ret;
+    if (fp->memo_slot >= 0)
+        tiny_memo_store(memo, fp->memo_slot, fp->memo_stamp, ret);
+    if (fp == frame)
+    {
+        *result = ret;
+        return 0;
+    }
+    --fp;
+    f = fp->func;
+    r = fp->base;
+    k = f->consts;
+    pc = fp->pc;
+    DISPATCH();
+
+fail:
+    return error;
+
+#undef DISPATCH
+#undef A
+#undef B
+#undef C
+#undef ARITH_I
+}
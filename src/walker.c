@@ -0,0 +1,274 @@
+#include "walker.h"
+#include "syntax_def.h"
+#include "string_util.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct env_s
+{
+    tiny_value_t *locals; // 参数与局部变量，以声明的 index 为下标
+    bool returned;
+    tiny_value_t ret;
+};
+
+struct walk_s
+{
+    tiny_walker_t *walker;
+    int error;
+};
+
+static const tiny_decl_t *decl_of(struct walk_s *w, tiny_ast_t *ast)
+{
+    const tiny_resolve_t *resolve = w->walker->check->resolve;
+    return &resolve->decls[resolve->decl_of[ast->id]];
+}
+
+static int type_of(struct walk_s *w, tiny_ast_t *ast)
+{
+    return w->walker->check->types[ast->id];
+}
+
+static tiny_value_t *slot(struct walk_s *w, struct env_s *env, const tiny_decl_t *decl)
+{
+    return decl->func ? &env->locals[decl->index] : &w->walker->globals[decl->index];
+}
+
+static tiny_ast_t *strip(tiny_ast_t *ast)
+{
+    while ((ast->desc == TINY_DESC_BINARY || ast->desc == TINY_DESC_ASSIGN) && !ast->child->sibling)
+        ast = ast->child;
+    return ast;
+}
+
+static int call(struct walk_s *w, int func, tiny_value_t *args, tiny_value_t *result);
+
+static tiny_value_t eval(struct walk_s *w, struct env_s *env, tiny_ast_t *expr);
+
+static tiny_value_t eval_binary(struct walk_s *w, struct env_s *env, tiny_ast_t *node)
+{
+    tiny_value_t value = eval(w, env, node->child);
+    for (tiny_ast_t *op = node->child->sibling; op && !w->error; op = op->sibling->sibling)
+    {
+        tiny_ast_t *rhs = op->sibling;
+        tiny_value_t r = eval(w, env, rhs);
+        const char *s = op->token.s, *e = op->token.e;
+        if (type_of(w, rhs) == TINY_TYPE_REAL)
+        {
+            if (strsecmp(s, e, "+"))
+                value.r += r.r;
+            else if (strsecmp(s, e, "-"))
+                value.r -= r.r;
+            else if (strsecmp(s, e, "*"))
+                value.r *= r.r;
+            else if (strsecmp(s, e, "/"))
+                value.r /= r.r;
+            else if (strsecmp(s, e, "=="))
+                value.i = value.r == r.r;
+            else
+                value.i = value.r != r.r;
+        }
+        else
+        {
+            if (strsecmp(s, e, "+"))
+                value.i = (int64_t)((uint64_t)value.i + (uint64_t)r.i);
+            else if (strsecmp(s, e, "-"))
+                value.i = (int64_t)((uint64_t)value.i - (uint64_t)r.i);
+            else if (strsecmp(s, e, "*"))
+                value.i = (int64_t)((uint64_t)value.i * (uint64_t)r.i);
+            else if (strsecmp(s, e, "/"))
+            {
+                if (r.i == 0)
+                    w->error = TINY_DIVISION_BY_ZERO;
+                else
+                    value.i = r.i == -1 ? (int64_t)(0 - (uint64_t)value.i) : value.i / r.i;
+            }
+            else if (strsecmp(s, e, "=="))
+                value.i = value.i == r.i;
+            else
+                value.i = value.i != r.i;
+        }
+    }
+    return value;
+}
+
+static tiny_value_t eval_assign(struct walk_s *w, struct env_s *env, tiny_ast_t *target)
+{
+    if (!target->sibling)
+        return eval(w, env, target);
+    tiny_value_t value = eval_assign(w, env, target->sibling->sibling);
+    *slot(w, env, decl_of(w, strip(target))) = value;
+    return value;
+}
+
+static tiny_value_t eval_call(struct walk_s *w, struct env_s *env, tiny_ast_t *node)
+{
+    const tiny_decl_t *decl = decl_of(w, node);
+    tiny_ast_t *args = node->child->sibling->sibling;
+    tiny_value_t result = {0};
+
+    if (decl->kind == TINY_DECL_BUILTIN) // READ(variable, file) 与 WRITE(expression, file)
+    {
+        tiny_ast_t *value = args->child, *file = strip(value->sibling->sibling);
+        bool real = type_of(w, value) == TINY_TYPE_REAL;
+        char *name = strndup(file->token.value.string.s, file->token.value.string.len);
+        if (strsecmp(node->child->token.s, node->child->token.e, "READ"))
+            w->error = tiny_runtime_read(&w->walker->runtime, name, real, slot(w, env, decl_of(w, strip(value))));
+        else
+        {
+            tiny_value_t v = eval(w, env, value);
+            if (!w->error)
+                w->error = tiny_runtime_write(&w->walker->runtime, name, real, v);
+        }
+        free(name);
+        return result;
+    }
+
+    int argc = 0;
+    for (tiny_ast_t *arg = args->child; arg; arg = arg->sibling->sibling)
+        if (argc++, !arg->sibling)
+            break;
+    tiny_value_t *values = malloc((argc + 1) * sizeof(tiny_value_t));
+    int i = 0;
+    for (tiny_ast_t *arg = args->child; arg && !w->error; arg = arg->sibling->sibling)
+        if (values[i++] = eval(w, env, arg), !arg->sibling)
+            break;
+    if (!w->error)
+        w->error = call(w, decl->index, values, &result);
+    free(values);
+    return result;
+}
+
+static tiny_value_t eval(struct walk_s *w, struct env_s *env, tiny_ast_t *expr)
+{
+    tiny_value_t value = {0};
+    switch (expr->desc)
+    {
+    case TINY_DESC_NUMBER:
+        if (expr->token.kind == TINY_TOKEN_INT)
+            value.i = expr->token.value.integer;
+        else
+            value.r = expr->token.value.real;
+        return value;
+    case TINY_DESC_IDENTIFIER:
+        return *slot(w, env, decl_of(w, expr));
+    case TINY_DESC_CONVERT:
+        value = eval(w, env, expr->child);
+        if (type_of(w, expr) == TINY_TYPE_REAL)
+            value.r = (double)value.i;
+        else
+            value.i = tiny_real_to_int(value.r);
+        return value;
+    case TINY_DESC_BINARY:
+        return eval_binary(w, env, expr);
+    case TINY_DESC_ASSIGN:
+        return eval_assign(w, env, expr->child);
+    case TINY_DESC_CALL:
+        return eval_call(w, env, expr);
+    default: // '(' expression ')'
+        return eval(w, env, expr->child->sibling);
+    }
+}
+
+static void exec(struct walk_s *w, struct env_s *env, tiny_ast_t *stmt)
+{
+    switch (stmt->desc)
+    {
+    case TINY_DESC_BLOCK:
+        for (tiny_ast_t *s = stmt->child->sibling->child; s && !env->returned && !w->error; s = s->sibling)
+            exec(w, env, s);
+        break;
+    case TINY_DESC_DECL:
+        for (tiny_ast_t *id = stmt->child->sibling->child; id; id = id->sibling)
+            if (id->desc == TINY_DESC_IDENTIFIER)
+                slot(w, env, decl_of(w, id))->i = 0;
+        break;
+    case TINY_DESC_IF: // if -> 'if' '(' expression ')' statement ['else' statement]
+    {
+        tiny_ast_t *cond = stmt->child->sibling->sibling;
+        tiny_ast_t *then = cond->sibling->sibling;
+        tiny_value_t value = eval(w, env, cond);
+        bool taken = type_of(w, cond) == TINY_TYPE_REAL ? value.r != 0 : value.i != 0;
+        if (w->error)
+            break;
+        if (taken)
+            exec(w, env, then);
+        else if (then->sibling->child)
+            exec(w, env, then->sibling->child->child->sibling);
+        break;
+    }
+    case TINY_DESC_RETURN: // return -> 'return' expression ';'
+        env->ret = eval(w, env, stmt->child->sibling);
+        env->returned = true;
+        break;
+    default: // expression ';'
+        eval(w, env, stmt->child);
+        break;
+    }
+}
+
+static int call(struct walk_s *w, int func, tiny_value_t *args, tiny_value_t *result)
+{
+    tiny_walker_t *walker = w->walker;
+    if (walker->depth == TINY_WALKER_MAX_DEPTH)
+        return TINY_STACK_OVERFLOW;
+
+    tiny_ast_t *name = walker->funcs[func]->child->sibling->sibling;
+    tiny_ast_t *params = name->sibling->sibling;
+    const tiny_decl_t *decl = decl_of(w, name);
+
+    struct env_s env = {.locals = calloc(decl->locals + 1, sizeof(tiny_value_t)), .returned = false};
+    int nparams = 0;
+    for (tiny_ast_t *param = params->child; param; param = param->sibling)
+        if (param->desc == TINY_DESC_FORMAL_PARAM)
+        {
+            env.locals[nparams] = args[nparams];
+            nparams++;
+        }
+
+    walker->depth++;
+    exec(w, &env, params->sibling->sibling);
+    walker->depth--;
+
+    *result = env.ret;
+    free(env.locals);
+    return w->error;
+}
+
+void tiny_walker_init(tiny_walker_t *walker, const tiny_typecheck_t *check, tiny_ast_t *root)
+{
+    const tiny_resolve_t *resolve = check->resolve;
+    walker->check = check;
+    walker->funcs = calloc(resolve->func_count + 1, sizeof(tiny_ast_t *));
+    walker->globals = calloc(resolve->global_count + 1, sizeof(tiny_value_t));
+    walker->depth = 0;
+    tiny_runtime_init(&walker->runtime);
+    for (tiny_ast_t *item = root->child; item; item = item->sibling)
+        if (item->desc == TINY_DESC_FUNC)
+        {
+            tiny_ast_t *name = item->child->sibling->sibling;
+            walker->funcs[resolve->decls[resolve->decl_of[name->id]].index] = item;
+        }
+}
+
+void tiny_walker_free(tiny_walker_t *walker)
+{
+    free(walker->funcs);
+    free(walker->globals);
+    tiny_runtime_free(&walker->runtime);
+}
+
+int tiny_walker_call(tiny_walker_t *walker, int func, const tiny_value_t *args, tiny_value_t *result)
+{
+    struct walk_s w = {.walker = walker, .error = 0};
+    walker->depth = 0;
+    return call(&w, func, (tiny_value_t *)args, result);
+}
+
+int tiny_walker_main(const tiny_walker_t *walker)
+{
+    for (int i = 0; i < walker->check->resolve->func_count; ++i)
+        if (walker->funcs[i] && walker->funcs[i]->child->sibling->child)
+            return i;
+    return -1;
+}